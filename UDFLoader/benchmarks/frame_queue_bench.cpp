@@ -0,0 +1,137 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Benchmark comparing the push to pop latency of the mutex based
+ *      @c utils::ThreadSafeQueue with the lock-free @c RingQueue.
+ *
+ * Usage: frame-queue-bench [frames] [fps]
+ *
+ * A producer pushes small frames at a fixed rate, stamping each frame with
+ * the time it was pushed, and a consumer waits on the queue and records how
+ * long every frame spent in it. The p50, p99 and p99.9 latencies are
+ * reported for both queue types.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <eii/utils/logger.h>
+#include <eii/utils/thread_safe_queue.h>
+#include "eii/udf/frame.h"
+#include "eii/udf/ring_queue.h"
+
+#define DEFAULT_FRAMES 20000
+#define DEFAULT_FPS    1000
+#define WIDTH          64
+#define HEIGHT         64
+#define QUEUE_SIZE     64
+
+using namespace eii::udf;
+using namespace eii::utils;
+
+// How often the consumer checks if it should quit
+static const std::chrono::milliseconds WAIT_TIME(250);
+
+/**
+ * Push @c num_frames frames at the given rate and pop them on a separate
+ * thread, returning the time each frame spent in the queue (in ns).
+ */
+template <typename Queue>
+static std::vector<int64_t> run(int num_frames, int fps) {
+    Queue queue(QUEUE_SIZE);
+    std::vector<int64_t> latencies;
+    latencies.reserve(num_frames);
+
+    std::thread consumer([&]() {
+        while ((int) latencies.size() < num_frames) {
+            if (!queue.wait_for(WAIT_TIME)) continue;
+            Frame* frame = queue.pop();
+            if (frame == NULL) continue;
+            auto now = std::chrono::steady_clock::now();
+            latencies.push_back(
+                    now.time_since_epoch().count() - frame->get_timestamp());
+            delete frame;
+        }
+    });
+
+    auto period = std::chrono::nanoseconds(1000000000LL / fps);
+    auto next = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_frames; i++) {
+        std::this_thread::sleep_until(next);
+        next += period;
+
+        void* data = malloc(WIDTH * HEIGHT);
+        Frame* frame = new Frame(data, free, data, WIDTH, HEIGHT, 1);
+        // The steady clock is used for the timestamp, since the frame never
+        // leaves the process
+        frame->set_timestamp(
+                std::chrono::steady_clock::now().time_since_epoch().count());
+        if (queue.push(frame) == QueueRetCode::QUEUE_FULL) {
+            queue.push_wait(frame);
+        }
+    }
+    consumer.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+/**
+ * Print the latency percentiles of a run.
+ */
+static void report(const char* name, const std::vector<int64_t>& lat) {
+    size_t n = lat.size();
+    printf("%-16s p50: %8.1f us  p99: %8.1f us  p99.9: %8.1f us  "
+           "max: %8.1f us\n", name,
+           lat[n / 2] / 1000.0,
+           lat[std::min(n - 1, n * 99 / 100)] / 1000.0,
+           lat[std::min(n - 1, n * 999 / 1000)] / 1000.0,
+           lat[n - 1] / 1000.0);
+}
+
+int main(int argc, char** argv) {
+    int num_frames = DEFAULT_FRAMES;
+    int fps = DEFAULT_FPS;
+
+    if (argc > 3) {
+        fprintf(stderr, "usage: %s [frames] [fps]\n", argv[0]);
+        return -1;
+    }
+    if (argc >= 2) num_frames = atoi(argv[1]);
+    if (argc == 3) fps = atoi(argv[2]);
+    if (num_frames <= 0 || fps <= 0) {
+        fprintf(stderr, "usage: %s [frames] [fps]\n", argv[0]);
+        return -1;
+    }
+
+    set_log_level(LOG_LVL_ERROR);
+
+    printf("%dx%d frames, %d frames at %d fps\n",
+           WIDTH, HEIGHT, num_frames, fps);
+
+    report("ThreadSafeQueue", run<ThreadSafeQueue<Frame*>>(num_frames, fps));
+    report("RingQueue", run<RingQueue<Frame*>>(num_frames, fps));
+
+    return 0;
+}
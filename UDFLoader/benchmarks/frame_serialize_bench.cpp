@@ -0,0 +1,158 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Benchmark for the latency of @c Frame::serialize() for multi-frame
+ *      @c Frame objects.
+ *
+ * Usage: frame-serialize-bench [--sequential] [iterations]
+ *
+ * The @c --sequential flag disables the shared encoder pool, so that all
+ * frames of a @c Frame are encoded one after the other on the calling thread.
+ */
+
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include <eii/utils/logger.h>
+#include "eii/udf/frame.h"
+#include "eii/udf/encoder_pool.h"
+#include "eii/udf/frame_buffer_pool.h"
+
+#define DEFAULT_ITERATIONS 50
+#define WIDTH    1920
+#define HEIGHT   1080
+#define CHANNELS 3
+
+using namespace eii::udf;
+
+/**
+ * Create a @c Frame with the given number of frames, each a copy of the
+ * given image.
+ */
+static Frame* create_frame(
+        cv::Mat& img, int num_frames, EncodeType enc_type, int enc_lvl) {
+    FrameBufferPool* pool = FrameBufferPool::get_instance();
+    size_t size = img.total() * img.elemSize();
+    Frame* frame = new Frame();
+
+    for (int i = 0; i < num_frames; i++) {
+        void* buf = pool->acquire(size);
+        memcpy(buf, img.data, size);
+        frame->add_frame(
+                buf, FrameBufferPool::free_buffer, buf,
+                img.cols, img.rows, img.channels(), enc_type, enc_lvl);
+    }
+
+    return frame;
+}
+
+/**
+ * Run the benchmark for one encoding and number of frames.
+ */
+static void run_bench(
+        cv::Mat& img, int num_frames, EncodeType enc_type, int enc_lvl,
+        const char* enc_name, int iterations) {
+    std::vector<double> latencies;
+
+    for (int i = 0; i < iterations; i++) {
+        Frame* frame = create_frame(img, num_frames, enc_type, enc_lvl);
+
+        auto start = std::chrono::steady_clock::now();
+        msg_envelope_t* msg = frame->serialize();
+        auto end = std::chrono::steady_clock::now();
+
+        latencies.push_back(
+                std::chrono::duration<double, std::milli>(end - start)
+                .count());
+
+        // Frees the frame as well
+        msgbus_msg_envelope_destroy(msg);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0.0;
+    for (auto l : latencies) {
+        total += l;
+    }
+
+    printf("%-5s frames: %d  mean: %8.2f ms  p50: %8.2f ms  p99: %8.2f ms\n",
+           enc_name, num_frames, total / latencies.size(),
+           latencies[latencies.size() / 2],
+           latencies[(latencies.size() * 99) / 100]);
+}
+
+int main(int argc, char** argv) {
+    int iterations = DEFAULT_ITERATIONS;
+    bool sequential = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sequential") == 0) {
+            sequential = true;
+        } else {
+            iterations = atoi(argv[i]);
+            if (iterations <= 0) {
+                fprintf(stderr,
+                        "usage: %s [--sequential] [iterations]\n", argv[0]);
+                return -1;
+            }
+        }
+    }
+
+    set_log_level(LOG_LVL_ERROR);
+
+    if (sequential) {
+        EncoderPool::set_default_workers(0);
+    }
+
+    EncoderPool* pool = EncoderPool::get_instance();
+    printf("%dx%dx%d frames, %d iterations, encoder workers: %d\n",
+           WIDTH, HEIGHT, CHANNELS, iterations,
+           (pool == NULL) ? 0 : pool->get_num_workers());
+
+    // Synthetic frame: gradient with noise, so that the encoders have
+    // realistic work to do
+    cv::Mat img(HEIGHT, WIDTH, CV_8UC(CHANNELS));
+    for (int y = 0; y < HEIGHT; y++) {
+        uchar* row = img.ptr(y);
+        for (int x = 0; x < WIDTH * CHANNELS; x++) {
+            row[x] = (uchar) (((x / CHANNELS) + y) / 12 + (rand() % 16));
+        }
+    }
+
+    int num_frames[] = { 1, 2, 4 };
+    for (int n : num_frames) {
+        run_bench(img, n, EncodeType::JPEG, 95, "JPEG", iterations);
+    }
+    for (int n : num_frames) {
+        run_bench(img, n, EncodeType::PNG, 4, "PNG", iterations);
+    }
+    for (int n : num_frames) {
+        run_bench(img, n, EncodeType::LZ4, 0, "LZ4", iterations);
+    }
+    for (int n : num_frames) {
+        run_bench(img, n, EncodeType::ZSTD, 1, "ZSTD", iterations);
+    }
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Benchmark comparing the frame rate of worker threads popping frames
+ *      from a single shared @c FrameQueue with the rate of workers fed by a
+ *      @c WorkStealingScheduler, for 1 to 64 workers.
+ *
+ * Usage: work-stealing-bench [frames]
+ *
+ * A producer thread pushes small frames into a bounded input queue, the way
+ * an ingestor feeds a @c UdfManager, and each worker does a small amount of
+ * work per frame (summing its pixels) before deleting it. In the
+ * work-stealing case a single feeder thread moves the frames from the input
+ * queue into the scheduler, like the @c UdfManager does.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <eii/utils/logger.h>
+#include "eii/udf/udf_manager.h"
+#include "eii/udf/work_stealing_scheduler.h"
+
+#define DEFAULT_FRAMES 100000
+#define WIDTH          64
+#define HEIGHT         64
+#define QUEUE_SIZE     64
+
+using namespace eii::udf;
+using namespace eii::utils;
+
+// How often idle workers check if they should quit
+static const std::chrono::milliseconds WAIT_TIME(250);
+
+// Keeps the per-frame work from being optimized away
+static std::atomic<uint64_t> g_checksum(0);
+
+/**
+ * Work done by a worker for each frame.
+ */
+static void process_frame(Frame* frame) {
+    const uint8_t* data = (const uint8_t*) frame->get_readonly_data();
+    uint64_t sum = 0;
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+        sum += data[i];
+    }
+    g_checksum += sum;
+    delete frame;
+}
+
+/**
+ * Allocate the frames up front, so that the producer only pushes them.
+ */
+static std::vector<Frame*> create_frames(int num_frames) {
+    std::vector<Frame*> frames;
+    for (int i = 0; i < num_frames; i++) {
+        void* data = malloc(WIDTH * HEIGHT);
+        memset(data, i & 0xff, WIDTH * HEIGHT);
+        frames.push_back(new Frame(data, free, data, WIDTH, HEIGHT, 1));
+    }
+    return frames;
+}
+
+/**
+ * Push all frames into the queue, blocking while it is full.
+ */
+static void produce(FrameQueue* queue, std::vector<Frame*>& frames) {
+    for (auto frame : frames) {
+        if (queue->push(frame) == QueueRetCode::QUEUE_FULL) {
+            queue->push_wait(frame);
+        }
+    }
+}
+
+/**
+ * Frames per second with all workers popping from the shared queue.
+ */
+static double run_central(int num_workers, int num_frames) {
+    std::vector<Frame*> frames = create_frames(num_frames);
+    FrameQueue queue(QUEUE_SIZE);
+    std::atomic<int> done(0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < num_workers; i++) {
+        workers.push_back(std::thread([&]() {
+            while (done.load() < num_frames) {
+                if (queue.wait_for(WAIT_TIME)) {
+                    Frame* frame = queue.pop();
+                    if (frame == NULL) continue;
+                    process_frame(frame);
+                    done++;
+                }
+            }
+        }));
+    }
+    produce(&queue, frames);
+    for (auto& th : workers) {
+        th.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    return num_frames / std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * Frames per second with the workers fed by a work-stealing scheduler.
+ */
+static double run_work_stealing(
+        int num_workers, int num_frames, uint64_t* steals) {
+    std::vector<Frame*> frames = create_frames(num_frames);
+    FrameQueue queue(QUEUE_SIZE);
+    WorkStealingScheduler scheduler(num_workers);
+    std::atomic<int> done(0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread feeder([&]() {
+        for (int i = 0; i < num_frames;) {
+            if (queue.wait_for(WAIT_TIME)) {
+                Frame* frame = queue.pop();
+                if (frame == NULL) continue;
+                scheduler.push(frame);
+                i++;
+            }
+        }
+    });
+    std::vector<std::thread> workers;
+    for (int i = 0; i < num_workers; i++) {
+        workers.push_back(std::thread([&, i]() {
+            while (done.load() < num_frames) {
+                Frame* frame = scheduler.pop(i, WAIT_TIME);
+                if (frame == NULL) continue;
+                process_frame(frame);
+                done++;
+            }
+        }));
+    }
+    produce(&queue, frames);
+    feeder.join();
+    for (auto& th : workers) {
+        th.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    *steals = scheduler.get_steals();
+    return num_frames / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+    int num_frames = DEFAULT_FRAMES;
+
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+        return -1;
+    } else if (argc == 2) {
+        num_frames = atoi(argv[1]);
+        if (num_frames <= 0) {
+            fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    set_log_level(LOG_LVL_ERROR);
+
+    printf("%dx%d frames, %d frames per run, %u CPUs\n",
+           WIDTH, HEIGHT, num_frames, std::thread::hardware_concurrency());
+
+    int num_workers[] = { 1, 2, 4, 8, 16, 32, 64 };
+    for (int n : num_workers) {
+        uint64_t steals = 0;
+        double central = run_central(n, num_frames);
+        double stealing = run_work_stealing(n, num_frames, &steals);
+        printf("workers: %2d  central: %10.0f fps  work-stealing: "
+               "%10.0f fps  (%lu frames stolen)\n",
+               n, central, stealing, (unsigned long) steals);
+    }
+
+    return 0;
+}
@@ -35,6 +35,10 @@
 
 #define SERVICE_NAME "load-example"
 
+// Maximum size of the frame queues, the ring queue (WITH_RING_QUEUE=ON)
+// cannot be unbounded
+#define QUEUE_SIZE 16
+
 using namespace eii::udf;
 using namespace eii::msgbus;
 
@@ -56,9 +60,9 @@ int main(int argc, char** argv) {
         config_t* sub_config = json_config_new("msgbus_config.json");
 
         LOG_INFO_0("Initializing queues");
-        FrameQueue* input_queue = new FrameQueue(-1);
-        FrameQueue* output_queue = new FrameQueue(-1);
-        FrameQueue* sub_queue = new FrameQueue(-1);
+        FrameQueue* input_queue = new FrameQueue(QUEUE_SIZE);
+        FrameQueue* output_queue = new FrameQueue(QUEUE_SIZE);
+        FrameQueue* sub_queue = new FrameQueue(QUEUE_SIZE);
 
         LOG_INFO_0("Initializing UDFManager");
         UdfManager* manager = new UdfManager(
@@ -97,7 +101,10 @@ int main(int argc, char** argv) {
                 cv_frame2->cols, cv_frame2->rows, cv_frame2->channels(),
                 EncodeType::JPEG, 50);
 
-        input_queue->push(frame);
+        if(input_queue->push(frame) != eii::utils::QueueRetCode::SUCCESS) {
+            delete frame;
+            throw "Failed to push frame into the input queue";
+        }
 
         LOG_INFO_0("Waiting for processed frame...");
         output_queue->wait();
@@ -27,6 +27,7 @@
 #define _EII_UDF_BASE_UDF_H
 
 #include <atomic>
+#include <vector>
 #include <opencv2/opencv.hpp>
 #include <eii/msgbus/msg_envelope.h>
 #include <eii/utils/config.h>
@@ -63,6 +64,23 @@ public:
      * @return @c UdfRetCode
      */
     virtual UdfRetCode process(cv::Mat& frame, cv::Mat& output, msg_envelope_t* meta) = 0;
+
+    /**
+     * Process a batch of frames at once, e.g. to run inference with a batch
+     * size greater than 1. The default implementation calls @c process()
+     * for each frame.
+     *
+     * @param frames  - @c cv::Mat frame objects
+     * @param outputs - Output frames, one (empty) @c cv::Mat per frame
+     * @param metas   - @c msg_envelope_t meta data of each frame
+     * @param rets    - Return code for each frame, which decides if that
+     *                  frame is dropped, like the return code of
+     *                  @c process()
+     */
+    virtual void process_batch(
+            std::vector<cv::Mat>& frames, std::vector<cv::Mat>& outputs,
+            std::vector<msg_envelope_t*>& metas,
+            std::vector<UdfRetCode>& rets);
 };
 
 } // udf
@@ -0,0 +1,123 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief Vectorized color and layout conversion kernels for frames.
+ */
+
+#ifndef _EII_UDF_COLOR_CONVERT_H
+#define _EII_UDF_COLOR_CONVERT_H
+
+#include <cstddef>
+
+// Forward declaration, so that users of the kernels do not need OpenCV
+namespace cv {
+class Mat;
+}
+
+namespace eii {
+namespace udf {
+
+/**
+ * Conversions supported by @c convert_color().
+ *
+ * \note The color conversions operate on 8-bit pixels. The layout
+ *      conversions operate on 8-bit, 16-bit and 32-bit elements.
+ */
+enum ColorConversion {
+    // Swap the red and blue channels of 3 channel pixels
+    BGR2RGB,
+    RGB2BGR,
+    // 3 channel pixels to single channel luma (ITU-R BT.601)
+    BGR2GRAY,
+    RGB2GRAY,
+    // Planar YUV 4:2:0 (ITU-R BT.601, limited range) to 3 channel BGR pixels
+    NV12_2BGR,
+    I420_2BGR,
+    // Interleaved pixels (height, width, channels) to planes
+    // (channels, height, width), e.g. for inference engine input tensors
+    HWC2CHW,
+    // Planes (channels, height, width) to interleaved pixels
+    // (height, width, channels)
+    CHW2HWC,
+};
+
+/**
+ * Get the name of the instruction set the conversion kernels use on this
+ * CPU, i.e. "avx512", "avx2", "sse4" or "scalar". The instruction set is
+ * selected at runtime.
+ *
+ * @return const char*
+ */
+const char* get_color_convert_isa();
+
+/**
+ * Get the number of channels of the output of a conversion.
+ *
+ * @param conversion - Conversion
+ * @param channels   - Number of channels of the input
+ * @return int
+ */
+int get_converted_channels(ColorConversion conversion, int channels);
+
+/**
+ * Convert a buffer.
+ *
+ * The @c width and @c height are always those of the image, i.e. a planar
+ * YUV input has 1.5 * @c height rows, and the planar output of
+ * @c HWC2CHW (as well as the planar input of @c CHW2HWC) has
+ * @c channels * @c height rows of @c width elements. The chroma planes of
+ * I420 inputs have half the stride of the luma plane.
+ *
+ * @param conversion - Conversion to apply
+ * @param src        - Input buffer
+ * @param src_stride - Bytes between the start of two rows of the input
+ * @param dst        - Output buffer, which must not overlap the input
+ * @param dst_stride - Bytes between the start of two rows of the output
+ * @param width      - Width of the image
+ * @param height     - Height of the image
+ * @param channels   - Number of channels of the interleaved image
+ * @param elem_size  - (Optional) Size of a single element in bytes, only
+ *                     used by the layout conversions (default: 1)
+ */
+void convert_color(
+        ColorConversion conversion, const void* src, size_t src_stride,
+        void* dst, size_t dst_stride, int width, int height, int channels,
+        size_t elem_size=1);
+
+/**
+ * Convert a @c cv::Mat, allocating the output from the frame buffer pool.
+ *
+ * Planar YUV inputs are single channel with 1.5 * height rows. The planar
+ * output of @c HWC2CHW (and the input of @c CHW2HWC) is a 3 dimensional
+ * @c cv::Mat of size (channels, height, width).
+ *
+ * @param conversion - Conversion to apply
+ * @param src        - Input
+ * @param dst        - Output, (re)allocated if its size or type differs
+ */
+void convert_color(
+        ColorConversion conversion, const cv::Mat& src, cv::Mat& dst);
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_COLOR_CONVERT_H
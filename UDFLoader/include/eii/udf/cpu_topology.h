@@ -0,0 +1,95 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief CPU topology (L3 caches and NUMA nodes) of the host.
+ */
+
+#ifndef _EII_UDF_CPU_TOPOLOGY_H
+#define _EII_UDF_CPU_TOPOLOGY_H
+
+#include <string>
+#include <vector>
+
+namespace eii {
+namespace udf {
+
+/**
+ * L3 cache and NUMA node of each CPU, -1 where unknown. CPUs sharing an L3
+ * cache are identified by the first CPU of the cache's CPU list.
+ */
+typedef struct {
+    std::vector<int> l3;
+    std::vector<int> node;
+} CpuTopology;
+
+/**
+ * Get the CPU topology of the host, which is read from sysfs on the first
+ * call.
+ *
+ * @return @c CpuTopology
+ */
+const CpuTopology& get_cpu_topology();
+
+/**
+ * Get the NUMA node of a CPU.
+ *
+ * @param cpu - CPU number
+ * @return int, -1 if unknown
+ */
+int get_numa_node(int cpu);
+
+/**
+ * Get the CPUs of a NUMA node.
+ *
+ * @param node - NUMA node
+ * @return CPUs of the node, empty if the node does not exist
+ */
+std::vector<int> get_node_cpus(int node);
+
+/**
+ * Get the NUMA node of the CPU the calling thread is running on.
+ *
+ * @return int, -1 if unknown
+ */
+int get_current_numa_node();
+
+/**
+ * Parse a CPU list in the sysfs/taskset format, e.g. "0-3,8-11".
+ *
+ * @param[in]  list - CPU list
+ * @param[out] cpus - Parsed CPUs are appended to this vector
+ * @return false if the list is malformed
+ */
+bool parse_cpu_list(const char* list, std::vector<int>& cpus);
+
+/**
+ * Format CPUs as a CPU list, e.g. "0-3,8-11".
+ *
+ * @param cpus - CPUs, in ascending order
+ * @return std::string
+ */
+std::string format_cpu_list(const std::vector<int>& cpus);
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_CPU_TOPOLOGY_H
@@ -0,0 +1,81 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+/**
+ * @file
+ * @brief Shared thread pool for encoding frames.
+ */
+
+#ifndef _EII_UDF_ENCODER_POOL_H
+#define _EII_UDF_ENCODER_POOL_H
+
+#include <string>
+
+#include "eii/udf/worker_pool.h"
+
+namespace eii {
+namespace udf {
+
+/**
+ * @c WorkerPool encoding the frames of a multi-frame @c Frame in parallel,
+ * of which there is one shared instance per process. Like its base it cannot
+ * be copied.
+ */
+class EncoderPool : public WorkerPool {
+public:
+    /**
+     * Constructor
+     *
+     * @param num_workers - Number of worker threads
+     * @param max_queued  - Maximum number of jobs which can be queued
+     * @param placement   - (Optional) CPU affinity and scheduling settings
+     *                      of the workers, which must outlive the pool
+     * @param name        - (Optional) Name of the workers for the log
+     *                      (default: "Encoder")
+     */
+    EncoderPool(int num_workers, int max_queued,
+                ThreadPlacement* placement=NULL,
+                const std::string& name="Encoder");
+
+    /**
+     * Get the shared encoder pool used by @c Frame::serialize() to encode
+     * the frames of a multi-frame @c Frame in parallel.
+     *
+     * @return @c EncoderPool*, NULL if parallel encoding is disabled
+     */
+    static EncoderPool* get_instance();
+
+    /**
+     * Set the number of workers for the shared encoder pool.
+     *
+     * \note This must be called before the shared pool is first used,
+     *      otherwise it has no effect. A value of 0 disables parallel
+     *      encoding.
+     *
+     * @param num_workers - Number of worker threads
+     */
+    static void set_default_workers(int num_workers);
+};
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_ENCODER_POOL_H
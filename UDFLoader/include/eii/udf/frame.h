@@ -27,11 +27,14 @@
 #define _EII_UDF_FRAME_H
 
 #include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <eii/msgbus/msg_envelope.h>
 #include <eii/utils/logger.h>
+#include "eii/udf/color_convert.h"
+#include "eii/udf/shm_ring.h"
 
 namespace eii {
 namespace udf {
@@ -43,6 +46,32 @@ enum EncodeType {
     NONE,
     JPEG,
     PNG,
+    // Lossless LZ4 compression of the raw pixels, level 0 is the fast
+    // compressor and levels 1 - 12 use the high compression compressor
+    LZ4,
+    // Lossless Zstandard compression of the raw pixels, levels 1 - 22
+    ZSTD,
+};
+
+/**
+ * Pixel formats (i.e. layout and element type of the pixels) for the given
+ * frame.
+ */
+enum PixelFormat {
+    // Interleaved pixels with unsigned 8-bit channels (e.g. BGR, grayscale)
+    U8,
+    // Interleaved pixels with unsigned 16-bit channels (e.g. depth)
+    U16,
+    // Interleaved pixels with signed 16-bit channels
+    S16,
+    // Interleaved pixels with 32-bit float channels (e.g. tensors)
+    F32,
+    // Planar YUV 4:2:0, full resolution Y plane followed by an interleaved
+    // half resolution UV plane (single channel, 1.5 * height rows)
+    NV12,
+    // Planar YUV 4:2:0, full resolution Y plane followed by half resolution
+    // U and V planes (single channel, 1.5 * height rows)
+    I420,
 };
 
 /**
@@ -58,6 +87,11 @@ private:
     int m_channels;
     EncodeType m_encode_type;
     int m_encode_level;
+    PixelFormat m_pixel_format;
+
+    // Flag for if the meta-data differs from what is in the frame's
+    // msg_envelope_t meta-data
+    bool m_dirty;
 
     /**
      * Private @c FrameMetaData copy constructor.
@@ -77,7 +111,8 @@ public:
      */
     FrameMetaData(
             std::string img_handle, int width, int height, int channels,
-            EncodeType encode_type, int encode_level);
+            EncodeType encode_type, int encode_level,
+            PixelFormat pixel_format=PixelFormat::U8);
 
     /**
      * Destructor
@@ -90,6 +125,15 @@ public:
     void set_channels(int channels);
     void set_encoding(EncodeType encode_type, int encode_level);
 
+    /**
+     * Set whether the meta-data differs from what is in the frame's
+     * @c msg_envelope_t meta-data. New meta-data is always dirty, and all
+     * setters mark the meta-data as dirty.
+     *
+     * @param dirty - Dirty flag
+     */
+    void set_dirty(bool dirty);
+
     // Getters
     std::string get_img_handle();
     int get_width();
@@ -97,6 +141,37 @@ public:
     int get_channels();
     EncodeType get_encode_type();
     int get_encode_level();
+    PixelFormat get_pixel_format();
+    bool is_dirty();
+
+    /**
+     * Get the size in bytes of a single channel of a pixel.
+     *
+     * @return size_t
+     */
+    size_t get_element_size();
+
+    /**
+     * Get the number of rows in the frame's buffer, which is larger than the
+     * height for planar YUV frames.
+     *
+     * @return int
+     */
+    int get_rows();
+
+    /**
+     * Get the size in bytes of a tightly packed row of the frame's buffer.
+     *
+     * @return size_t
+     */
+    size_t get_row_size();
+
+    /**
+     * Get the OpenCV type (e.g. @c CV_8UC3) of the frame's buffer.
+     *
+     * @return int
+     */
+    int get_cv_type();
 };
 
 /**
@@ -107,11 +182,73 @@ public:
 class FrameData {
 private:
     FrameMetaData* m_meta;
-    void* m_frame;
+
+    // Underlying frame, which may be shared with frames created through
+    // Frame::share(). It is freed when the last reference is released.
+    std::shared_ptr<void> m_frame;
+
+    // Token shared only by the FrameData objects reading the same pixels
+    // (see share()), which may write the pixels in place while it is not
+    // shared. This is separate from m_frame, because the frames of a packed
+    // blob all hold the blob without sharing their pixels.
+    std::shared_ptr<void> m_pixels_token;
     void* m_data;
-    void (*m_free_frame)(void*);
     size_t m_size;
 
+    // Number of bytes between the start of two consecutive rows in m_data
+    size_t m_stride;
+
+    // Encoded bytes the frame was received with (NULL once the pixels may
+    // have been modified), and the encoding they were received with. The
+    // pointer references the bytes and keeps the blob holding them alive.
+    std::shared_ptr<void> m_encoded;
+    size_t m_encoded_len;
+    EncodeType m_encoded_type;
+    int m_encoded_level;
+
+    // Flag for if the pixels have been handed out for writing
+    bool m_modified;
+
+    // Flag for if the underlying frame must not be written to (e.g. pixels
+    // mapped from a shared memory ring)
+    bool m_readonly;
+
+    /**
+     * Decode the received encoded frame into @c m_data, if it has not been
+     * decoded yet.
+     *
+     * \note Throws if the encoded bytes cannot be decoded, or if the decoded
+     *      frame does not match the meta-data (which was already handed out
+     *      before decoding, so it cannot be corrected).
+     */
+    void decode();
+
+    /**
+     * Release the received encoded bytes.
+     */
+    void release_encoded();
+
+    /**
+     * Set the underlying frame, releasing the reference to the previous one.
+     *
+     * @param frame      - Underlying frame object
+     * @param free_frame - Function to free the underlying frame (can be NULL)
+     */
+    void set_frame(void* frame, void (*free_frame)(void*));
+
+    /**
+     * Copy the pixels into a tightly packed buffer, if the rows are padded.
+     *
+     * @param force - Copy the pixels even if the rows are not padded
+     */
+    void compact(bool force=false);
+
+    /**
+     * Losslessly compress the pixels with LZ4 or Zstandard, based on the
+     * frame's encoding type.
+     */
+    void compress();
+
     /**
      * Private @c FrameData copy constructor.
      */
@@ -123,17 +260,121 @@ private:
     FrameData& operator=(const FrameData& src);
 
 public:
-    // TODO(kmidkiff): Document this more
+    /**
+     * Constructor
+     *
+     * \note The @c data may be a view into a larger parent buffer (e.g. a
+     *      crop), in which case @c frame is the parent and @c stride is the
+     *      parent's row stride.
+     *
+     * @param frame      - Underlying frame object
+     * @param free_frame - Function to free the underlying frame
+     * @param data       - Pointer to the first pixel of the frame
+     * @param meta       - Frame meta-data
+     * @param stride     - (Optional) Bytes between the start of two rows, 0 if
+     *                     the rows are tightly packed (default: 0)
+     */
     FrameData(
             void* frame, void (*free_frame)(void*), void* data,
-            FrameMetaData* meta);
+            FrameMetaData* meta, size_t stride=0);
+
+    /**
+     * Constructor for a frame received in an encoded form. The frame is only
+     * decoded the first time its data is accessed.
+     *
+     * \note The @c FrameData takes ownership of the encoded blob element.
+     *
+     * @param encoded - Message envelope blob element with the encoded frame
+     * @param meta    - Frame meta-data, including the encoding of the blob
+     */
+    FrameData(msg_envelope_elem_body_t* encoded, FrameMetaData* meta);
+
+    /**
+     * Constructor for a frame received as a slice of a larger buffer (e.g.
+     * a packed multi-frame blob). Encoded frames are only decoded the first
+     * time their data is accessed.
+     *
+     * @param owner - Reference keeping the larger buffer alive
+     * @param data  - Pointer to the frame's (encoded) bytes in the buffer
+     * @param len   - Number of bytes of the frame
+     * @param meta  - Frame meta-data, including the encoding of the bytes
+     */
+    FrameData(std::shared_ptr<void> owner, void* data, size_t len,
+              FrameMetaData* meta);
 
     ~FrameData();
 
     FrameMetaData* get_meta_data();
+
+    /**
+     * Create a new @c FrameData sharing the underlying frame (and the
+     * received encoded bytes) with this one. The meta-data is copied.
+     *
+     * @return @c FrameData*
+     */
+    FrameData* share();
+
+    /**
+     * Check if the pixels are shared with another @c FrameData created with
+     * @c share().
+     *
+     * @return bool
+     */
+    bool is_shared();
+
+    /**
+     * Get the frame's pixels for writing, decoding the frame first if
+     * needed. This marks the frame as modified.
+     *
+     * \note If the pixels are shared with another frame or read-only, they
+     *      are first copied into a private, tightly packed buffer.
+     *
+     * @return void*
+     */
     void* get_data();
+
+    /**
+     * Get the frame's pixels for reading only, decoding the frame first if
+     * needed. The frame is not marked as modified.
+     *
+     * @return const void*
+     */
+    const void* get_readonly_data();
+
     size_t get_size();
 
+    /**
+     * Get the number of bytes between the start of two consecutive rows.
+     *
+     * @return size_t
+     */
+    size_t get_stride();
+
+    /**
+     * Check if the frame's pixels are available without decoding.
+     *
+     * @return bool
+     */
+    bool is_decoded();
+
+    /**
+     * Check if the frame's pixels have been handed out for writing.
+     *
+     * @return bool
+     */
+    bool is_modified();
+
+    /**
+     * Mark the frame's pixels as modified.
+     */
+    void set_modified();
+
+    /**
+     * Mark the underlying frame as read-only, so that the pixels are copied
+     * before they are handed out for writing.
+     */
+    void set_readonly();
+
     /**
      * Encode the underlying frame.
      *
@@ -176,6 +417,10 @@ private:
     // Meta-data associated with the frame
     msg_envelope_t* m_meta_data;
     // Additional frames array in the meta-data (if it exists)
+    //
+    // NOTE: The core meta-data of each frame (width, height, etc.) is kept in
+    // its FrameMetaData and only written into m_meta_data when the envelope
+    // is handed out by get_meta_data() or serialize()
     msg_envelope_elem_body_t* m_additional_frames_arr;
 
     // Must-have attributes
@@ -186,6 +431,22 @@ private:
     // Flag for if the frame has been serailized already
     std::atomic<bool> m_serialized;
 
+    // Shared memory ring to publish the frames through (if set)
+    std::shared_ptr<ShmRing> m_shm_ring;
+
+    // Flag for if all frames are serialized into a single blob
+    bool m_packed;
+
+    // Flag for if the frames have been encoded ahead of serialization
+    bool m_encoded;
+
+    // Position of the frame in the input of a @c UdfManager (not serialized)
+    uint64_t m_sequence;
+
+    // Capture or ingest time of the frame in nanoseconds since the epoch
+    // (not serialized)
+    int64_t m_timestamp;
+
     // Encoding type for the frame
     // EncodeType m_encode_type;
 
@@ -193,9 +454,48 @@ private:
     // int m_encode_level;
 
     /**
-     * Private helper function to encode the given frame during serialization.
+     * Private helper function to encode all frames during serialization.
+     *
+     * The frames of a multi-frame object are encoded in parallel on the
+     * shared @c EncoderPool.
+     */
+    void encode_frames();
+
+    /**
+     * Private helper function to write the core meta-data (img_handle,
+     * width, height, etc.) of all frames whose meta-data changed into the
+     * meta-data envelope, before the envelope is handed out.
      */
-    // void encode_frame();
+    void write_meta_data();
+
+    /**
+     * Private helper function to copy all frames into the shared memory
+     * ring during serialization. On success the frames are freed and the
+     * returned blob of @c ShmFrameDescriptor owns the @c Frame.
+     *
+     * @return Blob to add to the envelope, NULL if the frames do not fit
+     *         into the ring and must be sent as blobs
+     */
+    msg_envelope_elem_body_t* write_shm_frames();
+
+    /**
+     * Private helper function to destroy a blob owning the @c Frame (see
+     * @c write_shm_frames() and @c pack_frames()) which could not be added
+     * to the envelope. The @c Frame stays owned by the caller, and its
+     * meta-data is freed, since its frames have already been freed.
+     *
+     * @param blob - Blob which was not added to the envelope
+     */
+    void destroy_unsent_blob(msg_envelope_elem_body_t* blob);
+
+    /**
+     * Private helper function to copy all frames into a single blob during
+     * serialization, and to write the offset table into the meta-data. The
+     * frames are freed and the returned blob owns the @c Frame.
+     *
+     * @return Blob to add to the envelope
+     */
+    msg_envelope_elem_body_t* pack_frames();
 
     /**
      * Function to be passed to the EII Message Bus for freeing the frame after
@@ -237,10 +537,16 @@ public:
      *                            (default:  @c EncodeType:NONE)
      * @param encode_level      - (Optional) Encode level
      *                            (value depends on encoding type)
+     * @param stride            - (Optional) Bytes between the start of two
+     *                            rows, 0 if the rows are tightly packed
+     *                            (default: 0)
+     * @param pixel_format      - (Optional) Pixel format of the data
+     *                            (default: @c PixelFormat::U8)
      */
     Frame(void* frame, void (*free_frame)(void*), void* data,
           int width, int height, int channels,
-          EncodeType encode_type=EncodeType::NONE, int encode_level=0);
+          EncodeType encode_type=EncodeType::NONE, int encode_level=0,
+          size_t stride=0, PixelFormat pixel_format=PixelFormat::U8);
 
     /**
      * Initialize an empty frame.
@@ -307,13 +613,142 @@ public:
      */
     int get_channels(int index=0);
 
+    /**
+     * Get the pixel format of the frame.
+     *
+     * @param index - Index of the internal frame (default: 0)
+     * @return @c PixelFormat
+     */
+    PixelFormat get_pixel_format(int index=0);
+
+    /**
+     * Get the number of rows in the frame's data. This is the same as the
+     * height, except for planar YUV frames.
+     *
+     * @param index - Index of the internal frame (default: 0)
+     * @return int
+     */
+    int get_rows(int index=0);
+
+    /**
+     * Get the OpenCV type (e.g. @c CV_16UC1) to wrap the frame's data with,
+     * i.e. cv::Mat(get_rows(), get_width(), get_cv_type(), get_data(),
+     * get_stride()).
+     *
+     * @param index - Index of the internal frame (default: 0)
+     * @return int
+     */
+    int get_cv_type(int index=0);
+
+    /**
+     * Get the number of bytes between the start of two consecutive rows of
+     * the frame's data.
+     *
+     * \note Rows may be padded (e.g. frames from GStreamer buffers or crops
+     *      of a larger frame), so this can be larger than
+     *      width * channels. Frames are only compacted when they are
+     *      serialized without encoding.
+     *
+     * @param index - Index of the internal frame (default: 0)
+     * @return size_t
+     */
+    size_t get_stride(int index=0);
+
     /**
      * Get the underlying frame data.
      *
+     * \note If the frame was received encoded, it is decoded on the first
+     *      call to this method. The frame is considered modified afterwards,
+     *      so it is re-encoded when serialized (see @c get_readonly_data()).
+     *      A frame which fails to decode (e.g. a corrupt blob) throws here
+     *      rather than when it is received.
+     *
+     * \note If the pixels are shared with another frame (see @c share()),
+     *      they are copied first, which can change the frame's stride. Call
+     *      @c get_stride() after this method.
+     *
      * @param index - Index of the internal frame (default: 0)
      * @return void* */
     void* get_data(int index=0);
 
+    /**
+     * Get the underlying frame data for reading only.
+     *
+     * \note Frames which were received encoded and are only accessed through
+     *      this method are re-published with the bytes they were received
+     *      with, if their encoding is unchanged. Like @c get_data(), this
+     *      throws if the frame fails to decode.
+     *
+     * @param index - Index of the internal frame (default: 0)
+     * @return const void*
+     */
+    const void* get_readonly_data(int index=0);
+
+    /**
+     * Check if the frame's pixels have been modified, i.e. accessed through
+     * @c get_data() or replaced with @c set_data().
+     *
+     * @param index - Index of the internal frame (default: 0)
+     * @return bool
+     */
+    bool is_modified(int index=0);
+
+    /**
+     * Check if the frame's pixels have been decoded. Frames received in an
+     * encoded form are only decoded when their data is accessed.
+     *
+     * @param index - Index of the internal frame (default: 0)
+     * @return bool
+     */
+    bool is_decoded(int index=0);
+
+    /**
+     * Check if the frame's pixels are shared with another frame, i.e. if
+     * writing to them would require a copy.
+     *
+     * @param index - Index of the internal frame (default: 0)
+     * @return bool
+     */
+    bool is_shared(int index=0);
+
+    /**
+     * Create a new frame which shares the pixels of this frame, e.g. to hand
+     * the same frame to multiple publishers or @c UdfManager instances
+     * without copying it.
+     *
+     * The pixels are copy-on-write: they are read by all of the frames at
+     * once, and a frame only makes a private copy of them when they are
+     * written through @c get_data(). Replacing them with @c set_data() or
+     * serializing the frame does not affect the other frames. The meta-data
+     * (i.e. the @c msg_envelope_t and frame attributes) is copied, so each
+     * frame can change it independently.
+     *
+     * \note A frame received in an encoded form which has not been decoded
+     *      yet shares the encoded bytes, each frame decodes them separately.
+     *
+     * \note Each frame returned by this method is owned by the caller and
+     *      can be used from a different thread than this frame.
+     *
+     * @return @c Frame*
+     */
+    Frame* share();
+
+    /**
+     * Merge the meta-data of another frame into this frame, e.g. to join
+     * the results of UDFs which ran on frames created with @c share().
+     *
+     * Only the keys which this frame does not have yet are added, the
+     * values of the keys present in both frames are left unchanged. The
+     * other frame is not modified.
+     *
+     * \note The keys are copied into this frame's meta-data envelope in
+     *      place, so pointers previously obtained into it (see
+     *      @c get_meta_data()) stay valid.
+     *
+     * @param other - Frame to take the meta-data from
+     */
+    void merge_meta_data(Frame* other);
+
     /**
      * Get the number of frames in Frame object.
      *
@@ -334,11 +769,17 @@ public:
      *                            (default:  @c EncodeType:NONE)
      * @param encode_level      - (Optional) Encode level
      *                            (value depends on encoding type)
+     * @param stride            - (Optional) Bytes between the start of two
+     *                            rows, 0 if the rows are tightly packed
+     *                            (default: 0)
+     * @param pixel_format      - (Optional) Pixel format of the data
+     *                            (default: @c PixelFormat::U8)
      */
     void add_frame(
             void* frame, void (*free_frame)(void*), void* data,
             int width, int height, int channels,
-            EncodeType encode_type=EncodeType::NONE, int encode_level=0);
+            EncodeType encode_type=EncodeType::NONE, int encode_level=0,
+            size_t stride=0, PixelFormat pixel_format=PixelFormat::U8);
 
     /**
      * Modify data for a frame.
@@ -349,10 +790,17 @@ public:
      * @param data              - Constant pointer to the underlying frame data
      * @param width             - Frame width
      * @param height            - Frame height
+     * @param channels          - Number of channels in the frame
+     * @param stride            - (Optional) Bytes between the start of two
+     *                            rows, 0 if the rows are tightly packed
+     *                            (default: 0)
+     * @param pixel_format      - (Optional) Pixel format of the data
+     *                            (default: @c PixelFormat::U8)
      */
     void set_data(
             int index, void* frame, void (*free_frame)(void*), void* data,
-            int width, int height, int channels);
+            int width, int height, int channels, size_t stride=0,
+            PixelFormat pixel_format=PixelFormat::U8);
 
     /**
      * Set the encoding for the frame.
@@ -363,11 +811,126 @@ public:
      */
     void set_encoding(EncodeType enc_type, int enc_lvl, int index=0);
 
+    /**
+     * Convert the pixels of a frame with the vectorized conversion kernels
+     * (see @c convert_color()). The converted pixels are written into a
+     * buffer from the frame buffer pool, which replaces the frame's data.
+     *
+     * \note Only the color conversions are supported, since the planar
+     *      output of the layout conversions is not a frame.
+     *
+     * @param conversion - Color conversion, which must match the frame's
+     *                     pixel format (i.e. 8-bit pixels, NV12 or I420)
+     * @param index      - Index of frame to convert (df: index 0)
+     */
+    void convert_color(ColorConversion conversion, int index=0);
+
+    /**
+     * Publish the pixels of the frames through a shared memory ring when
+     * the frame is serialized, so that only a small descriptor is sent over
+     * the message bus. Subscribers on the same host map the pixels from the
+     * ring without copying them.
+     *
+     * \note If a frame is larger than a slot of the ring, or all slots are
+     *      still pinned by subscribers, the frames are sent as blobs.
+     *
+     * \note Subscribers must run on the same host (and have access to the
+     *      same /dev/shm) as the publisher.
+     *
+     * @param ring - Ring created with @c ShmRing::create(), NULL to send
+     *               the frames as blobs
+     */
+    void set_shm_ring(std::shared_ptr<ShmRing> ring);
+
+    /**
+     * Serialize all frames of a multi-frame object into a single aligned
+     * blob instead of one blob per frame. The offset and length of each
+     * frame is sent in the "packed_offsets" and "packed_lengths" meta-data
+     * arrays, and the deserialized frames are slices of the one blob.
+     *
+     * \note The frames are copied into the packed blob, which pays off for
+     *      objects with many (small) frames where the per-blob overhead of
+     *      the transport dominates.
+     *
+     * @param packed - Serialize with the packed layout
+     */
+    void set_packed_layout(bool packed);
+
+    /**
+     * Set the position of the frame in the stream of frames processed by a
+     * @c UdfManager, which is used to publish the frames in order.
+     *
+     * \note The sequence number is local to the process, it is not
+     *      serialized with the frame.
+     *
+     * @param sequence - Sequence number
+     */
+    void set_sequence(uint64_t sequence);
+
+    /**
+     * Get the sequence number of the frame (see @c set_sequence()).
+     *
+     * @return uint64_t, 0 if it was never set
+     */
+    uint64_t get_sequence();
+
+    /**
+     * Set the time at which the frame was captured, from which the age of
+     * the frame is measured (e.g. for the latency budget of a
+     * @c UdfManager). Defaults to the time the @c Frame was constructed.
+     *
+     * \note The timestamp is local to the process, it is not serialized
+     *      with the frame.
+     *
+     * @param timestamp - Nanoseconds since the epoch (system clock)
+     */
+    void set_timestamp(int64_t timestamp);
+
+    /**
+     * Get the capture timestamp of the frame (see @c set_timestamp()).
+     *
+     * @return int64_t, nanoseconds since the epoch
+     */
+    int64_t get_timestamp();
+
+    /**
+     * Get the time since the frame was captured.
+     *
+     * @return int64_t, milliseconds
+     */
+    int64_t get_age_ms();
+
+    /**
+     * Encode all frames with their encoding type and level ahead of
+     * serialization, so that @c serialize() only has to wrap the encoded
+     * bytes. This allows encoding the frames on a different thread than
+     * the one publishing them.
+     *
+     * \note This PERMANENTLY replaces the pixels with the encoded bytes.
+     *      Afterwards the frames' data can no longer be accessed or
+     *      changed, only the meta-data and the serialization settings
+     *      (e.g. @c set_shm_ring()). Calling it again has no effect.
+     */
+    void encode();
+
+    /**
+     * Check if the frames have been encoded with @c encode().
+     *
+     * @return bool
+     */
+    bool is_encoded();
+
     /**
      * Get @c msg_envelope_t meta-data envelope.
      *
      * \note NULL will be returned if the frame has already been serialized.
      *
+     * \note The core meta-data of the frames (img_handle, width, height,
+     *      channels, encoding and pixel format) is written into the envelope
+     *      by this method, if it changed since the envelope was last handed
+     *      out. Changes made to the frame afterwards (e.g. @c set_data())
+     *      are only visible in the envelope after calling this method again.
+     *
      * @return @c msg_envelope_t*
      */
     msg_envelope_t* get_meta_data();
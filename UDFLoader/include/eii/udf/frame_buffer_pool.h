@@ -0,0 +1,278 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief Recycling pool for frame pixel buffers.
+ */
+
+#ifndef _EII_UDF_FRAME_BUFFER_POOL_H
+#define _EII_UDF_FRAME_BUFFER_POOL_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Forward declaration, so that users of the pool do not need OpenCV
+namespace cv {
+class MatAllocator;
+}
+
+namespace eii {
+namespace udf {
+
+// Alignment (in bytes) of every buffer handed out by the pool
+#define FRAME_BUFFER_ALIGNMENT 64
+
+// Smallest size class is 4KB (2^12), largest pooled size class is 1GB (2^30).
+// Every power of two is split into 4 size classes, so the worst case slack
+// for a pooled buffer is 25%.
+#define FRAME_BUFFER_MIN_SHIFT      12
+#define FRAME_BUFFER_MAX_SHIFT      30
+#define FRAME_BUFFER_CLASSES_PER_2X 4
+#define FRAME_BUFFER_NUM_CLASSES \
+    ((FRAME_BUFFER_MAX_SHIFT - FRAME_BUFFER_MIN_SHIFT) * \
+        FRAME_BUFFER_CLASSES_PER_2X + 1)
+
+// Number of NUMA nodes with separate free lists, buffers of higher nodes
+// share the free lists of the lower nodes
+#define FRAME_BUFFER_MAX_NODES 8
+
+// Default maximum number of bytes kept in the pool's free lists
+#define FRAME_BUFFER_DEFAULT_MAX_CACHED (512UL * 1024UL * 1024UL)
+
+/**
+ * Snapshot of the statistics of a @c FrameBufferPool.
+ */
+typedef struct {
+    // Number of acquire() calls served from a cached buffer
+    uint64_t hits;
+
+    // Number of acquire() calls which required a new allocation
+    uint64_t misses;
+
+    // Number of released buffers returned to the system, because the pool
+    // was already holding the maximum number of cached bytes
+    uint64_t evictions;
+
+    // Bytes held in the pool's free lists, ready to be reused
+    size_t resident_bytes;
+
+    // Bytes currently handed out by the pool
+    size_t in_use_bytes;
+
+    // hits / (hits + misses), 0 if nothing has been acquired yet
+    double hit_rate;
+} FrameBufferPoolStats;
+
+/**
+ * Size-class based recycling pool for frame pixel memory.
+ *
+ * All buffers are aligned to @c FRAME_BUFFER_ALIGNMENT bytes. Buffers which
+ * are at least one huge page in size can optionally be backed by transparent
+ * huge pages to reduce TLB pressure and page faults for high resolution
+ * frames.
+ *
+ * Buffers can optionally be allocated on the NUMA node of the thread
+ * acquiring them, in which case they are only reused by threads on the same
+ * node.
+ *
+ * The pool is shared by the whole process (see @c get_instance()), so that a
+ * buffer allocated while decoding a frame can be reused for a frame produced
+ * by a UDF, etc. All methods are thread-safe.
+ */
+class FrameBufferPool {
+private:
+    // Free list for a single size class
+    struct FreeList {
+        std::mutex mtx;
+        std::vector<void*> buffers;
+    };
+
+    // Free lists for all size classes, for buffers which are not bound to a
+    // NUMA node (index 0) and for the buffers of each node
+    FreeList m_free_lists[FRAME_BUFFER_MAX_NODES + 1][FRAME_BUFFER_NUM_CLASSES];
+
+    // Maximum number of bytes to keep in the free lists
+    std::atomic<size_t> m_max_cached_bytes;
+
+    // Flag for if large buffers should be backed by huge pages
+    std::atomic<bool> m_use_hugepages;
+
+    // Flag for if buffers are allocated on the acquiring thread's NUMA node
+    std::atomic<bool> m_numa_local;
+
+    // Statistics
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<uint64_t> m_evictions;
+    std::atomic<size_t> m_resident_bytes;
+    std::atomic<size_t> m_in_use_bytes;
+
+    // OpenCV allocator drawing from this pool
+    cv::MatAllocator* m_mat_allocator;
+
+    /**
+     * Allocate a new buffer from the system.
+     *
+     * @param size_class - Size class index (-1 if not pooled)
+     * @param capacity   - Usable size of the buffer
+     * @param node       - NUMA node to allocate the buffer on (-1 for any)
+     * @return void*, NULL on failure
+     */
+    void* allocate_buffer(int size_class, size_t capacity, int node);
+
+    /**
+     * Get the free lists holding the buffers of a NUMA node.
+     *
+     * @param node - NUMA node (-1 for buffers not bound to a node)
+     * @return @c FreeList array indexed by size class
+     */
+    FreeList* get_free_lists(int node);
+
+    /**
+     * Return a buffer to the system.
+     *
+     * @param data - Buffer to free
+     */
+    void free_buffer_memory(void* data);
+
+    /**
+     * Private @c FrameBufferPool copy constructor.
+     */
+    FrameBufferPool(const FrameBufferPool& src);
+
+    /**
+     * Private @c FrameBufferPool assignment operator.
+     */
+    FrameBufferPool& operator=(const FrameBufferPool& src);
+
+public:
+    /**
+     * Constructor
+     *
+     * @param max_cached_bytes - Maximum number of bytes to keep in the pool
+     * @param use_hugepages    - Back large buffers with huge pages
+     */
+    FrameBufferPool(
+            size_t max_cached_bytes=FRAME_BUFFER_DEFAULT_MAX_CACHED,
+            bool use_hugepages=false);
+
+    /**
+     * Destructor
+     *
+     * \note Buffers which are still in use are NOT freed.
+     */
+    ~FrameBufferPool();
+
+    /**
+     * Get the process wide frame buffer pool.
+     *
+     * \note The process wide pool is never destroyed, so that frames which
+     *      are freed during process exit can still be released to it.
+     *
+     * @return @c FrameBufferPool*
+     */
+    static FrameBufferPool* get_instance();
+
+    /**
+     * Free method matching the signature of the @c free_frame parameter of
+     * the @c Frame object, which releases the given buffer back to the
+     * process wide pool.
+     *
+     * @param data - Buffer obtained from @c acquire()
+     */
+    static void free_buffer(void* data);
+
+    /**
+     * Update the pool's settings.
+     *
+     * @param max_cached_bytes - Maximum number of bytes to keep in the pool
+     * @param use_hugepages    - Back large buffers with huge pages
+     */
+    void configure(size_t max_cached_bytes, bool use_hugepages);
+
+    /**
+     * Set if buffers are allocated on the NUMA node of the thread acquiring
+     * them (default: false).
+     *
+     * \note This only has an effect on hosts with multiple NUMA nodes, it
+     *      is most useful with the threads pinned to the CPUs of a node.
+     *
+     * @param numa_local - Allocate buffers NUMA-locally
+     */
+    void set_numa_local(bool numa_local);
+
+    /**
+     * Acquire a buffer of at least the given size.
+     *
+     * @param size - Required size in bytes
+     * @return void*, NULL if the allocation fails
+     */
+    void* acquire(size_t size);
+
+    /**
+     * Release a buffer previously obtained with @c acquire() back to the
+     * pool.
+     *
+     * @param data - Buffer to release
+     */
+    void release(void* data);
+
+    /**
+     * Get the usable size of a buffer obtained with @c acquire().
+     *
+     * @param data - Buffer
+     * @return size_t
+     */
+    size_t get_capacity(void* data);
+
+    /**
+     * Free all cached buffers.
+     */
+    void trim();
+
+    /**
+     * Get the @c cv::MatAllocator which allocates @c cv::Mat memory from
+     * this pool.
+     *
+     * @return @c cv::MatAllocator*
+     */
+    cv::MatAllocator* get_mat_allocator();
+
+    /**
+     * Get a snapshot of the pool statistics.
+     *
+     * @return @c FrameBufferPoolStats
+     */
+    FrameBufferPoolStats get_stats();
+
+    /**
+     * Log the current pool statistics.
+     */
+    void log_stats();
+};
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_FRAME_BUFFER_POOL_H
@@ -0,0 +1,54 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief Queue type used to pass frames between threads.
+ */
+
+#ifndef _EII_UDF_FRAME_QUEUE_H
+#define _EII_UDF_FRAME_QUEUE_H
+
+#include <eii/utils/thread_safe_queue.h>
+
+#include "eii/udf/frame.h"
+#include "eii/udf/ring_queue.h"
+
+namespace eii {
+namespace udf {
+
+// The UDF loader is built with the lock-free ring queue when configured
+// with WITH_RING_QUEUE=ON, which defines EII_UDF_RING_FRAME_QUEUE for the
+// library and for everything linking against it.
+//
+// NOTE: This is a build-time ABI switch, the library and the applications
+// using it must agree on it. The ring queue is always bounded and throws if
+// it is created with a maximum size of 0 or less, so a FrameQueue meant to
+// work with either build must be created with a positive maximum size.
+#ifdef EII_UDF_RING_FRAME_QUEUE
+typedef RingQueue<Frame*> FrameQueue;
+#else
+typedef utils::ThreadSafeQueue<Frame*> FrameQueue;
+#endif
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_FRAME_QUEUE_H
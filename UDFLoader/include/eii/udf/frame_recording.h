@@ -0,0 +1,353 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief Recording of serialized frames into an indexed, memory-mappable
+ *      file and replaying them into a @c FrameQueue.
+ */
+
+#ifndef _EII_UDF_FRAME_RECORDING_H
+#define _EII_UDF_FRAME_RECORDING_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <eii/msgbus/msg_envelope.h>
+
+#include "eii/udf/frame.h"
+#include "eii/udf/udf_manager.h"
+
+namespace eii {
+namespace udf {
+
+// Alignment (in bytes) of every record and of every part within a record,
+// so that the pixels mapped from the file can be used directly
+#define FRAME_RECORDING_ALIGNMENT 64
+
+// Version of the recording file format
+#define FRAME_RECORDING_VERSION 1
+
+/**
+ * Timing with which a @c FrameReplayer pushes frames into its queue.
+ */
+enum ReplayTiming {
+    // Same inter-frame timing as when the frames were recorded
+    RECORDED,
+    // Fixed frame rate
+    FIXED_RATE,
+    // As fast as the queue accepts the frames
+    AS_FAST_AS_POSSIBLE,
+};
+
+/**
+ * Appends serialized frames to a recording file.
+ *
+ * Each record holds the parts of the serialized message envelope (i.e. the
+ * JSON meta-data followed by one blob per frame, encoded or raw) exactly as
+ * they are sent over the message bus, along with the time at which the
+ * frame was recorded. The index of all records is written at the end of the
+ * file by @c close(), a recording without an index (e.g. because the
+ * recording process crashed) is re-indexed when it is opened.
+ *
+ * All methods are thread-safe.
+ */
+class FrameRecorder {
+private:
+    // Path of the recording file
+    std::string m_path;
+
+    // File descriptor of the recording file
+    int m_fd;
+
+    // Offset at which the next record is written
+    uint64_t m_offset;
+
+    // Offsets of all records written so far
+    std::vector<uint64_t> m_index;
+
+    // Time the recording was started
+    std::chrono::steady_clock::time_point m_start;
+
+    // Lock for appending records
+    std::mutex m_mtx;
+
+    /**
+     * Write the given bytes at the current offset.
+     *
+     * @param data - Bytes to write (NULL for zero padding)
+     * @param len  - Number of bytes to write
+     */
+    void write_bytes(const void* data, size_t len);
+
+    /**
+     * Private @c FrameRecorder copy constructor.
+     */
+    FrameRecorder(const FrameRecorder& src);
+
+    /**
+     * Private @c FrameRecorder assignment operator.
+     */
+    FrameRecorder& operator=(const FrameRecorder& src);
+
+public:
+    /**
+     * Constructor, creates (or truncates) the recording file.
+     *
+     * @param path - Path of the recording file
+     */
+    FrameRecorder(const std::string& path);
+
+    /**
+     * Destructor, closes the recording if it was not closed yet.
+     */
+    ~FrameRecorder();
+
+    /**
+     * Append a serialized frame to the recording. The message envelope is
+     * not modified and is still owned by the caller.
+     *
+     * @param msg - Message envelope of a serialized @c Frame
+     */
+    void record(msg_envelope_t* msg);
+
+    /**
+     * Serialize a frame and append it to the recording.
+     *
+     * \note The frame is freed by this method, in the same way as it is
+     *      freed after it is published over the message bus.
+     *
+     * @param frame - Frame to record
+     */
+    void record(Frame* frame);
+
+    /**
+     * Get the number of frames recorded so far.
+     *
+     * @return size_t
+     */
+    size_t get_num_frames();
+
+    /**
+     * Write the index and close the recording file. No more frames can be
+     * recorded afterwards.
+     */
+    void close();
+};
+
+/**
+ * Read-only view of a recording file, which is mapped into memory.
+ *
+ * Frames read from the recording reference the pixels in the mapping
+ * without copying them. The mapping is private, so a UDF writing to the
+ * pixels of a frame only gets a private copy of the touched pages and the
+ * recording is never modified.
+ */
+class FrameRecording {
+private:
+    // Path of the recording file
+    std::string m_path;
+
+    // Mapping of the recording file, unmapped once the recording and all
+    // frames read from it are freed
+    std::shared_ptr<void> m_mapping;
+    size_t m_size;
+
+    // Offsets of all records
+    std::vector<uint64_t> m_index;
+
+    /**
+     * Rebuild the index of a recording which was not closed, by walking
+     * over all complete records.
+     */
+    void scan_records();
+
+    /**
+     * Get the validated header of a record.
+     *
+     * @param index - Index of the record
+     * @return Pointer to the record's header
+     */
+    const void* get_record(size_t index);
+
+    /**
+     * Private @c FrameRecording copy constructor.
+     */
+    FrameRecording(const FrameRecording& src);
+
+    /**
+     * Private @c FrameRecording assignment operator.
+     */
+    FrameRecording& operator=(const FrameRecording& src);
+
+public:
+    /**
+     * Constructor
+     *
+     * @param path - Path of the recording file
+     */
+    FrameRecording(const std::string& path);
+
+    /**
+     * Destructor
+     */
+    ~FrameRecording();
+
+    /**
+     * Get the number of frames in the recording.
+     *
+     * @return size_t
+     */
+    size_t get_num_frames();
+
+    /**
+     * Get the time at which a frame was recorded, relative to the start of
+     * the recording.
+     *
+     * @param index - Index of the frame
+     * @return std::chrono::nanoseconds
+     */
+    std::chrono::nanoseconds get_timestamp(size_t index);
+
+    /**
+     * Get the serialized message envelope of a frame. The blobs in the
+     * envelope reference the mapping.
+     *
+     * @param index - Index of the frame
+     * @return @c msg_envelope_t*, which must be freed by the caller
+     */
+    msg_envelope_t* get_message(size_t index);
+
+    /**
+     * Deserialize a frame.
+     *
+     * @param index - Index of the frame
+     * @return @c Frame*, which must be freed by the caller
+     */
+    Frame* get_frame(size_t index);
+};
+
+/**
+ * Thread which replays the frames of a recording into a @c FrameQueue
+ * (e.g. the input queue of a @c UdfManager).
+ */
+class FrameReplayer {
+private:
+    // Recording to replay
+    std::shared_ptr<FrameRecording> m_recording;
+
+    // Queue to push the frames into
+    FrameQueue* m_queue;
+
+    // Replay settings
+    ReplayTiming m_timing;
+    double m_fps;
+    int m_loops;
+
+    // Replay thread
+    std::thread* m_th;
+
+    // Flag to stop the replay thread
+    std::atomic<bool> m_stop;
+
+    // Number of frames pushed into the queue
+    std::atomic<uint64_t> m_replayed;
+
+    // Number of frames which were pushed later than scheduled, because the
+    // queue was full
+    std::atomic<uint64_t> m_late;
+
+    /**
+     * Replay thread run method.
+     */
+    void run();
+
+    /**
+     * Private @c FrameReplayer copy constructor.
+     */
+    FrameReplayer(const FrameReplayer& src);
+
+    /**
+     * Private @c FrameReplayer assignment operator.
+     */
+    FrameReplayer& operator=(const FrameReplayer& src);
+
+public:
+    /**
+     * Constructor
+     *
+     * @param recording - Recording to replay
+     * @param queue     - Queue to push the frames into
+     * @param timing    - Timing of the replayed frames
+     *                    (df: @c ReplayTiming::RECORDED)
+     * @param fps       - Frame rate for @c ReplayTiming::FIXED_RATE
+     *                    (df: 30)
+     * @param loops     - Number of times to replay the recording, 0 to
+     *                    replay it until the replayer is stopped (df: 1)
+     */
+    FrameReplayer(std::shared_ptr<FrameRecording> recording,
+                  FrameQueue* queue,
+                  ReplayTiming timing=ReplayTiming::RECORDED,
+                  double fps=30.0, int loops=1);
+
+    /**
+     * Destructor, stops the replay.
+     */
+    ~FrameReplayer();
+
+    /**
+     * Start replaying the frames.
+     */
+    void start();
+
+    /**
+     * Stop replaying the frames.
+     */
+    void stop();
+
+    /**
+     * Wait until all frames have been replayed (or the replay was stopped).
+     */
+    void wait();
+
+    /**
+     * Get the number of frames pushed into the queue.
+     *
+     * @return uint64_t
+     */
+    uint64_t get_frames_replayed();
+
+    /**
+     * Get the number of frames which were pushed later than scheduled.
+     *
+     * @return uint64_t
+     */
+    uint64_t get_frames_late();
+};
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_FRAME_RECORDING_H
@@ -0,0 +1,136 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief Overflow policies for pushing frames into a full frame queue.
+ */
+
+#ifndef _EII_UDF_LOAD_SHEDDER_H
+#define _EII_UDF_LOAD_SHEDDER_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "eii/udf/frame.h"
+#include "eii/udf/frame_queue.h"
+
+namespace eii {
+namespace udf {
+
+/**
+ * What to do with a frame pushed into a full queue.
+ */
+enum ShedPolicy {
+    // Wait for room in the queue
+    SHED_BLOCK = 0,
+
+    // Drop the frame being pushed
+    SHED_DROP_NEWEST = 1,
+
+    // Drop the oldest queued frame to make room for the frame being pushed
+    SHED_DROP_OLDEST = 2,
+
+    // Wait for room for every Nth frame pushed into the full queue and drop
+    // the others
+    SHED_KEEP_EVERY_NTH = 3,
+};
+
+/**
+ * Parse the name of a shedding policy, i.e. "block", "drop_newest",
+ * "drop_oldest" or "keep_every_nth".
+ *
+ * @param name   - Name of the policy
+ * @param policy - Output policy
+ * @return True if the name is a known policy
+ */
+bool parse_shed_policy(const char* name, ShedPolicy* policy);
+
+/**
+ * Pushes frames into a bounded frame queue, applying a @c ShedPolicy when
+ * the queue is full and counting the frames which were shed.
+ *
+ * All methods are thread-safe.
+ */
+class LoadShedder {
+private:
+    // Policy applied to a full queue
+    ShedPolicy m_policy;
+
+    // Every how many frames pushed into a full queue one is kept
+    int m_keep_every;
+
+    // Number of frames pushed into a full queue (for SHED_KEEP_EVERY_NTH)
+    std::atomic<uint64_t> m_overflows;
+
+    // Number of frames dropped
+    std::atomic<uint64_t> m_shed;
+
+    /**
+     * Private @c LoadShedder copy constructor.
+     */
+    LoadShedder(const LoadShedder& src);
+
+    /**
+     * Private @c LoadShedder assignment operator.
+     */
+    LoadShedder& operator=(const LoadShedder& src);
+
+public:
+    /**
+     * Constructor
+     *
+     * @param policy     - Policy applied to a full queue
+     * @param keep_every - Every how many frames pushed into a full queue one
+     *                     is kept, only used by @c SHED_KEEP_EVERY_NTH
+     */
+    LoadShedder(ShedPolicy policy, int keep_every=2);
+
+    /**
+     * Push a frame into the queue.
+     *
+     * @param queue   - Queue to push the frame into
+     * @param frame   - Frame to push, which is owned by the queue afterwards
+     *                  (or deleted if it was shed)
+     * @param blocked - (Optional) Set to whether the push had to wait for
+     *                  room in the queue
+     * @return True if the frame was enqueued, false if it was shed
+     */
+    bool push(FrameQueue* queue, Frame* frame, bool* blocked=NULL);
+
+    /**
+     * Get the policy applied to a full queue.
+     *
+     * @return @c ShedPolicy
+     */
+    ShedPolicy get_policy();
+
+    /**
+     * Get the number of frames dropped because the queue was full.
+     *
+     * @return uint64_t
+     */
+    uint64_t get_shed();
+};
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_LOAD_SHEDDER_H
@@ -59,7 +59,8 @@ public:
      *
      * @param name        - Name of the UDF to load
      * @param config      - Configuration for the UDF
-     * @param max_workers - Maximum number of worker threads for executing UDFs
+     * @param max_workers - Maximum number of threads executing the UDF at
+     *                      once, 0 for no limit
      * @return @c UdfHandle, NULL if not found
      */
     UdfHandle* load(std::string name, config_t* config, int max_workers);
@@ -55,6 +55,9 @@ private:
     // Reference to the process() method on the Python object
     PyObject* m_udf_func;
 
+    // Reference to the optional process_batch() method on the Python object
+    PyObject* m_udf_batch_func;
+
 public:
     /**
      * Constructor
@@ -83,6 +86,17 @@ public:
      * @return UdfRetCode
      */
     UdfRetCode process(Frame* frame) override;
+
+    /**
+     * Overridden batch processing method. Calls the process_batch() method
+     * of the UDF if it has one, otherwise calls process() for each frame.
+     *
+     * @param frames - Frames to process
+     * @param rets   - Output return code for each frame
+     */
+    void process_batch(
+            std::vector<Frame*>& frames,
+            std::vector<UdfRetCode>& rets) override;
 };
 
 } // udf
@@ -27,6 +27,7 @@
 #define _EII_UDF_RAW_BASE_UDF_H
 
 #include <atomic>
+#include <vector>
 #include <opencv2/opencv.hpp>
 #include <eii/msgbus/msg_envelope.h>
 #include <eii/utils/config.h>
@@ -64,6 +65,19 @@ public:
      * @return @c UdfRetCode
      */
     virtual UdfRetCode process(Frame* frame) = 0;
+
+    /**
+     * Process a batch of frames at once, e.g. to run inference with a batch
+     * size greater than 1. The default implementation calls @c process()
+     * for each frame.
+     *
+     * @param frames - Frames to process
+     * @param rets   - Return code for each frame, which decides if that
+     *                 frame is dropped, like the return code of
+     *                 @c process()
+     */
+    virtual void process_batch(
+            std::vector<Frame*>& frames, std::vector<UdfRetCode>& rets);
 };
 
 } // udf
@@ -79,6 +79,17 @@ public:
      * @return UdfRetCode
      */
     UdfRetCode process(Frame* frame) override;
+
+    /**
+     * Overridden batch processing method, which hands all frames to the
+     * UDF's @c process_batch() at once.
+     *
+     * @param frames - Frames to process
+     * @param rets   - Return code for each frame
+     */
+    void process_batch(
+            std::vector<Frame*>& frames,
+            std::vector<UdfRetCode>& rets) override;
 };
 
 } // eii
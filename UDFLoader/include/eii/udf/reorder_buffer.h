@@ -0,0 +1,175 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief Bounded buffer which restores the input order of frames processed
+ *      by multiple workers.
+ */
+
+#ifndef _EII_UDF_REORDER_BUFFER_H
+#define _EII_UDF_REORDER_BUFFER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+#include "eii/udf/frame.h"
+
+namespace eii {
+namespace udf {
+
+/**
+ * Buffer releasing frames in the order of their sequence numbers.
+ *
+ * Every sequence number handed out by the producer must either be pushed
+ * (with the processed frame) or skipped (if the frame was dropped), so that
+ * the buffer knows it is not waiting for it. When the frame for the next
+ * sequence number is missing for longer than the latency cap, the buffer
+ * gives up on it and continues with the frames behind it. A frame which
+ * arrives after it was given up on is deleted.
+ *
+ * All methods are thread-safe. Frames are released one at a time from
+ * within the calling thread, while the buffer's lock is held.
+ */
+class ReorderBuffer {
+private:
+    // Frame waiting to be released (NULL for a skipped sequence number)
+    typedef struct {
+        Frame* frame;
+        std::chrono::steady_clock::time_point inserted;
+    } Entry;
+
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+
+    // Frames waiting for the frames before them, by sequence number
+    std::map<uint64_t, Entry> m_pending;
+
+    // Next sequence number to release
+    uint64_t m_next_seq;
+
+    // Maximum number of buffered frames
+    size_t m_capacity;
+
+    // How long to wait for a missing frame
+    std::chrono::milliseconds m_max_latency;
+
+    // Called with each released frame, in order
+    std::function<void(Frame*)> m_release;
+
+    // Statistics
+    uint64_t m_skipped;
+    uint64_t m_late;
+
+    /**
+     * Release all frames which are next in order. Must be called with the
+     * lock held.
+     */
+    void release_ready();
+
+    /**
+     * Give up on the missing frames before the first buffered frame. Must
+     * be called with the lock held.
+     */
+    void skip_gap();
+
+    /**
+     * Get the time at which the missing frames before the first buffered
+     * frame are given up on. Must be called with the lock held.
+     */
+    std::chrono::steady_clock::time_point gap_deadline();
+
+    /**
+     * Private @c ReorderBuffer copy constructor.
+     */
+    ReorderBuffer(const ReorderBuffer& src);
+
+    /**
+     * Private @c ReorderBuffer assignment operator.
+     */
+    ReorderBuffer& operator=(const ReorderBuffer& src);
+
+public:
+    /**
+     * Constructor
+     *
+     * @param release        - Called with each released frame, in order.
+     *                         Owns the frame afterwards.
+     * @param capacity       - Maximum number of buffered frames, pushing a
+     *                         frame into a full buffer blocks until there
+     *                         is room or the missing frame is given up on
+     * @param max_latency_ms - Time (in ms) to wait for a missing frame
+     * @param first_seq      - Sequence number of the first frame (df: 0)
+     */
+    ReorderBuffer(std::function<void(Frame*)> release, size_t capacity,
+                  int max_latency_ms, uint64_t first_seq=0);
+
+    /**
+     * Destructor, deletes all frames which have not been released.
+     */
+    ~ReorderBuffer();
+
+    /**
+     * Add a processed frame to the buffer.
+     *
+     * @param seq   - Sequence number of the frame
+     * @param frame - Frame, which is owned by the buffer afterwards
+     */
+    void push(uint64_t seq, Frame* frame);
+
+    /**
+     * Mark a sequence number as dropped, so that the frames after it do not
+     * wait for it.
+     *
+     * @param seq - Sequence number of the dropped frame
+     */
+    void skip(uint64_t seq);
+
+    /**
+     * Give up on a missing frame if it has exceeded the latency cap. Should
+     * be called periodically, since otherwise the frames behind it are only
+     * released when the next frame is pushed.
+     */
+    void flush();
+
+    /**
+     * Get the number of missing frames which were given up on.
+     *
+     * @return uint64_t
+     */
+    uint64_t get_skipped();
+
+    /**
+     * Get the number of frames deleted because they arrived after they
+     * were given up on.
+     *
+     * @return uint64_t
+     */
+    uint64_t get_late();
+};
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_REORDER_BUFFER_H
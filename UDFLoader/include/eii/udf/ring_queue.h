@@ -0,0 +1,387 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief Lock-free bounded multi-producer/multi-consumer ring queue.
+ */
+
+#ifndef _EII_UDF_RING_QUEUE_H
+#define _EII_UDF_RING_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <eii/utils/thread_safe_queue.h>
+
+namespace eii {
+namespace udf {
+
+// Number of times a waiting thread polls the queue before it sleeps
+#define RING_QUEUE_SPIN_COUNT 256
+
+// Size of a cache line, used to keep the producer and consumer positions
+// and the slots from sharing cache lines
+#define RING_QUEUE_CACHE_LINE 64
+
+/**
+ * Bounded MPMC queue with the same interface as
+ * @c utils::ThreadSafeQueue, so that it can be used as a @c FrameQueue.
+ *
+ * Producers and consumers claim slots with a compare-and-swap on their
+ * position in the ring, every slot carrying a sequence number which tells
+ * whether it is ready to be written or read (D. Vyukov's bounded MPMC
+ * queue). No lock is taken to push or pop. The sequence number of the slot
+ * at position @c pos is @c 2*pos while it is free and @c 2*pos+1 once it
+ * has been written, which keeps a queue with a single slot from
+ * mistaking a written slot for a free one.
+ *
+ * Threads waiting for a frame (@c wait_for(), @c wait()) or for room
+ * (@c push_wait()) first spin on the queue and then sleep on a futex, which
+ * is only signaled while there are sleeping waiters.
+ *
+ * \note Unlike @c utils::ThreadSafeQueue the queue is always bounded, so
+ *      the maximum size must be positive.
+ *
+ * \note Elements still in the queue when it is destroyed are not freed.
+ */
+template <typename T>
+class RingQueue {
+private:
+    // Slot of the ring, padded to a cache line
+    typedef struct {
+        std::atomic<size_t> seq;
+        T value;
+        char padding[RING_QUEUE_CACHE_LINE - sizeof(std::atomic<size_t>) -
+                     sizeof(T)];
+    } Slot;
+
+    static_assert(sizeof(T) + sizeof(std::atomic<size_t>) <
+                  RING_QUEUE_CACHE_LINE, "Ring queue element is too large");
+
+    Slot* m_slots;
+    size_t m_capacity;
+
+    char m_pad0[RING_QUEUE_CACHE_LINE];
+
+    // Position of the next push
+    std::atomic<size_t> m_push_pos;
+
+    char m_pad1[RING_QUEUE_CACHE_LINE];
+
+    // Position of the next pop
+    std::atomic<size_t> m_pop_pos;
+
+    char m_pad2[RING_QUEUE_CACHE_LINE];
+
+    // Futex words bumped on every push/pop, and the number of threads
+    // sleeping on them
+    std::atomic<int> m_push_epoch;
+    std::atomic<int> m_empty_waiters;
+
+    char m_pad3[RING_QUEUE_CACHE_LINE];
+
+    std::atomic<int> m_pop_epoch;
+    std::atomic<int> m_full_waiters;
+
+    char m_pad4[RING_QUEUE_CACHE_LINE];
+
+    /**
+     * Hint to the CPU that the thread is spinning.
+     */
+    static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    /**
+     * Sleep until the futex word no longer has the given value, the futex
+     * is signaled or the timeout expires.
+     *
+     * @param word    - Futex word
+     * @param value   - Expected value of the word
+     * @param timeout - Maximum time to sleep (NULL to sleep until woken)
+     */
+    static void futex_wait(
+            std::atomic<int>* word, int value,
+            const std::chrono::nanoseconds* timeout) {
+        struct timespec ts;
+        struct timespec* pts = NULL;
+        if(timeout != NULL) {
+            ts.tv_sec = (time_t) (timeout->count() / 1000000000LL);
+            ts.tv_nsec = (long) (timeout->count() % 1000000000LL);
+            pts = &ts;
+        }
+        syscall(SYS_futex, reinterpret_cast<int*>(word),
+                FUTEX_WAIT_PRIVATE, value, pts, NULL, 0);
+    }
+
+    /**
+     * Bump the futex word and wake a sleeping waiter, if there is one.
+     *
+     * @param word    - Futex word
+     * @param waiters - Number of waiters sleeping on the word
+     */
+    static void futex_notify(
+            std::atomic<int>* word, std::atomic<int>* waiters) {
+        word->fetch_add(1);
+        if(waiters->load() > 0) {
+            syscall(SYS_futex, reinterpret_cast<int*>(word),
+                    FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+        }
+    }
+
+    /**
+     * Private @c RingQueue copy constructor.
+     */
+    RingQueue(const RingQueue& src);
+
+    /**
+     * Private @c RingQueue assignment operator.
+     */
+    RingQueue& operator=(const RingQueue& src);
+
+public:
+    /**
+     * Constructor
+     *
+     * \note Throws an exception if @c max_size is 0 or less, the queue
+     *      cannot be unbounded.
+     *
+     * @param max_size - Maximum number of elements in the queue
+     */
+    explicit RingQueue(ssize_t max_size) :
+        m_slots(NULL), m_capacity(max_size > 0 ? (size_t) max_size : 0),
+        m_push_pos(0), m_pop_pos(0), m_push_epoch(0), m_empty_waiters(0),
+        m_pop_epoch(0), m_full_waiters(0)
+    {
+        if(m_capacity == 0) {
+            throw "Ring queue maximum size must be positive";
+        }
+        void* mem = NULL;
+        if(posix_memalign(&mem, RING_QUEUE_CACHE_LINE,
+                          sizeof(Slot) * m_capacity) != 0) {
+            throw "Failed to allocate ring queue";
+        }
+        m_slots = (Slot*) mem;
+        for(size_t i = 0; i < m_capacity; i++) {
+            new (&m_slots[i].seq) std::atomic<size_t>(2 * i);
+            new (&m_slots[i].value) T();
+        }
+    }
+
+    /**
+     * Destructor
+     */
+    ~RingQueue() {
+        for(size_t i = 0; i < m_capacity; i++) {
+            m_slots[i].value.~T();
+        }
+        free(m_slots);
+    }
+
+    /**
+     * Push an element into the queue without waiting.
+     *
+     * @param value - Element to push
+     * @return @c QueueRetCode::QUEUE_FULL if there is no room
+     */
+    utils::QueueRetCode push(T value) {
+        size_t pos = m_push_pos.load(std::memory_order_relaxed);
+        Slot* slot = NULL;
+        while(true) {
+            slot = &m_slots[pos % m_capacity];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) (2 * pos);
+            if(diff == 0) {
+                if(m_push_pos.compare_exchange_weak(
+                            pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if(diff < 0) {
+                // The slot still holds the element of the previous lap
+                return utils::QueueRetCode::QUEUE_FULL;
+            } else {
+                pos = m_push_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->value = value;
+        slot->seq.store(2 * pos + 1, std::memory_order_release);
+        futex_notify(&m_push_epoch, &m_empty_waiters);
+        return utils::QueueRetCode::SUCCESS;
+    }
+
+    /**
+     * Push an element into the queue, waiting for room if it is full.
+     *
+     * @param value - Element to push
+     * @return @c QueueRetCode
+     */
+    utils::QueueRetCode push_wait(T value) {
+        int spins = 0;
+        while(push(value) == utils::QueueRetCode::QUEUE_FULL) {
+            if(spins < RING_QUEUE_SPIN_COUNT) {
+                spins++;
+                cpu_relax();
+                continue;
+            }
+
+            // Announce the waiter before re-checking, so that a pop either
+            // sees it or happens before the re-check
+            m_full_waiters.fetch_add(1);
+            int epoch = m_pop_epoch.load();
+            utils::QueueRetCode ret = push(value);
+            if(ret != utils::QueueRetCode::QUEUE_FULL) {
+                m_full_waiters.fetch_sub(1);
+                return ret;
+            }
+            futex_wait(&m_pop_epoch, epoch, NULL);
+            m_full_waiters.fetch_sub(1);
+        }
+        return utils::QueueRetCode::SUCCESS;
+    }
+
+    /**
+     * Pop the oldest element from the queue without waiting.
+     *
+     * @return The element, a default constructed @c T (i.e. NULL) if the
+     *      queue is empty
+     */
+    T pop() {
+        size_t pos = m_pop_pos.load(std::memory_order_relaxed);
+        Slot* slot = NULL;
+        while(true) {
+            slot = &m_slots[pos % m_capacity];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) (2 * pos + 1);
+            if(diff == 0) {
+                if(m_pop_pos.compare_exchange_weak(
+                            pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if(diff < 0) {
+                // The slot has not been written in this lap yet
+                return T();
+            } else {
+                pos = m_pop_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        T value = slot->value;
+        slot->value = T();
+        slot->seq.store(2 * (pos + m_capacity), std::memory_order_release);
+        futex_notify(&m_pop_epoch, &m_full_waiters);
+        return value;
+    }
+
+    /**
+     * Get the oldest element without removing it.
+     *
+     * \note Only meaningful with a single consumer, with multiple consumers
+     *      the element may be popped by another thread at any time.
+     *
+     * @return The element, a default constructed @c T if the queue is empty
+     */
+    T front() {
+        size_t pos = m_pop_pos.load(std::memory_order_relaxed);
+        Slot* slot = &m_slots[pos % m_capacity];
+        if(slot->seq.load(std::memory_order_acquire) != 2 * pos + 1) {
+            return T();
+        }
+        return slot->value;
+    }
+
+    /**
+     * Check if the queue is empty.
+     *
+     * @return bool
+     */
+    bool empty() {
+        size_t pos = m_pop_pos.load(std::memory_order_acquire);
+        Slot* slot = &m_slots[pos % m_capacity];
+        return slot->seq.load(std::memory_order_acquire) != 2 * pos + 1;
+    }
+
+    /**
+     * Get the number of elements in the queue.
+     *
+     * @return int
+     */
+    int get_size() {
+        size_t pop_pos = m_pop_pos.load(std::memory_order_acquire);
+        size_t push_pos = m_push_pos.load(std::memory_order_acquire);
+        return push_pos > pop_pos ? (int) (push_pos - pop_pos) : 0;
+    }
+
+    /**
+     * Wait for the queue to be non-empty.
+     *
+     * @param timeout - Maximum time to wait
+     * @return True if the queue is non-empty, false on timeout
+     */
+    bool wait_for(std::chrono::milliseconds timeout) {
+        for(int i = 0; i < RING_QUEUE_SPIN_COUNT; i++) {
+            if(!empty()) return true;
+            cpu_relax();
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        bool ready = false;
+
+        // Announce the waiter before re-checking, so that a push either
+        // sees it or happens before the re-check
+        m_empty_waiters.fetch_add(1);
+        while(true) {
+            int epoch = m_push_epoch.load();
+            if(!empty()) {
+                ready = true;
+                break;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if(now >= deadline) break;
+            std::chrono::nanoseconds remaining = deadline - now;
+            futex_wait(&m_push_epoch, epoch, &remaining);
+        }
+        m_empty_waiters.fetch_sub(1);
+        return ready;
+    }
+
+    /**
+     * Wait until the queue is non-empty.
+     */
+    void wait() {
+        while(!wait_for(std::chrono::milliseconds(INT_MAX)));
+    }
+};
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_RING_QUEUE_H
@@ -0,0 +1,239 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief Shared memory ring for publishing frames to same-host subscribers.
+ */
+
+#ifndef _EII_UDF_SHM_RING_H
+#define _EII_UDF_SHM_RING_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace eii {
+namespace udf {
+
+// Magic number at the start of every ring ("EIISHMRG")
+#define SHM_RING_MAGIC 0x45494953484d5247ULL
+
+// Version of the ring's memory layout
+#define SHM_RING_VERSION 1
+
+// Alignment (in bytes) of every slot's pixels
+#define SHM_RING_ALIGNMENT 4096
+
+/**
+ * Descriptor of a frame in a @c ShmRing, which is sent in place of the
+ * frame's pixels.
+ */
+typedef struct {
+    // Index of the slot holding the frame
+    uint32_t slot;
+
+    // Generation of the slot when the frame was written
+    uint32_t generation;
+
+    // Number of bytes written into the slot
+    uint64_t len;
+} ShmFrameDescriptor;
+
+/**
+ * Header at the start of the shared memory of a @c ShmRing.
+ */
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t num_slots;
+    uint64_t slot_size;
+
+    // Random identifier, used to detect that a publisher re-created the ring
+    uint64_t ring_id;
+
+    // Next slot the publisher tries to write into
+    std::atomic<uint32_t> next;
+} ShmRingHeader;
+
+/**
+ * Fixed size ring of slots in POSIX shared memory.
+ *
+ * The publisher copies the frame's pixels into a free slot and only sends a
+ * @c ShmFrameDescriptor over the message bus. Subscribers on the same host
+ * map the ring and pin the slot, which gives them the pixels without any
+ * copy. The publisher only reuses a slot once every reader has released its
+ * pin.
+ *
+ * The state of each slot is a 64-bit word with the slot's generation in the
+ * upper 32 bits and the number of readers in the lower 32 bits. Writing a
+ * slot bumps its generation, so a subscriber which was too slow to pin the
+ * slot before it was reused detects that the frame is gone instead of
+ * reading the pixels of another frame.
+ *
+ * \note Pins are not reclaimed if a subscriber crashes while holding them.
+ *      Each pin left behind permanently removes its slot from the ring
+ *      until the publisher re-creates the ring (e.g. on restart), so the
+ *      ring should have enough slots to absorb such failures.
+ *
+ * \note Slots are reused oldest first, so the number of slots bounds how
+ *      far subscribers can lag behind the publisher.
+ */
+class ShmRing {
+private:
+    // Name of the shared memory object
+    std::string m_name;
+
+    // Mapped shared memory
+    void* m_mem;
+    size_t m_mem_size;
+
+    // Header of the ring
+    ShmRingHeader* m_header;
+
+    // State of each slot
+    std::atomic<uint64_t>* m_states;
+
+    // Start of the slots
+    uint8_t* m_slots;
+
+    // Flag for if this process created (and so unlinks) the ring
+    bool m_owner;
+
+    /**
+     * Private constructor, use @c create() or @c open().
+     */
+    ShmRing(const std::string& name, void* mem, size_t mem_size, bool owner);
+
+    /**
+     * Private @c ShmRing copy constructor.
+     */
+    ShmRing(const ShmRing& src);
+
+    /**
+     * Private @c ShmRing assignment operator.
+     */
+    ShmRing& operator=(const ShmRing& src);
+
+public:
+    /**
+     * Destructor
+     *
+     * \note Unmapping the ring does not invalidate frames of subscribers in
+     *      other processes, which keep their own mappings.
+     */
+    ~ShmRing();
+
+    /**
+     * Create a new ring for publishing frames. An existing ring with the
+     * same name (e.g. left behind by a crashed publisher) is replaced.
+     *
+     * @param name      - Name of the shared memory object (e.g. "/camera1")
+     * @param slot_size - Maximum size (in bytes) of a single frame
+     * @param num_slots - Number of slots in the ring
+     * @return @c std::shared_ptr<ShmRing>
+     */
+    static std::shared_ptr<ShmRing> create(
+            const std::string& name, size_t slot_size, int num_slots);
+
+    /**
+     * Get the mapping of a ring created by a publisher. Mappings are cached,
+     * so all frames received from the same ring share one mapping.
+     *
+     * @param name    - Name of the shared memory object
+     * @param ring_id - Expected ring identifier (see @c get_ring_id())
+     * @return @c std::shared_ptr<ShmRing>
+     */
+    static std::shared_ptr<ShmRing> open(
+            const std::string& name, uint64_t ring_id);
+
+    /**
+     * Get the name of the shared memory object.
+     *
+     * @return std::string
+     */
+    std::string get_name();
+
+    /**
+     * Get the random identifier of the ring.
+     *
+     * @return uint64_t
+     */
+    uint64_t get_ring_id();
+
+    /**
+     * Get the maximum size (in bytes) of a single frame.
+     *
+     * @return size_t
+     */
+    size_t get_slot_size();
+
+    /**
+     * Get the number of slots in the ring.
+     *
+     * @return int
+     */
+    int get_num_slots();
+
+    /**
+     * Claim a free slot for writing a frame. The slot cannot be pinned by
+     * readers until it is published with @c commit().
+     *
+     * @param len        - Number of bytes to write into the slot
+     * @param[out] desc  - Descriptor of the claimed slot
+     * @return Pointer to the slot's memory, NULL if the frame is too large
+     *         or all slots are pinned by readers
+     */
+    void* claim(size_t len, ShmFrameDescriptor* desc);
+
+    /**
+     * Publish a slot which was claimed with @c claim(), after which readers
+     * can pin it.
+     *
+     * @param desc - Descriptor returned by @c claim()
+     */
+    void commit(const ShmFrameDescriptor* desc);
+
+    /**
+     * Pin a slot for reading, the slot is not reused until it is released
+     * with @c unpin().
+     *
+     * \note The pin is held in the shared memory, not by the process, so it
+     *      is not released if the process exits without calling @c unpin().
+     *
+     * @param desc - Descriptor sent by the publisher
+     * @return Pointer to the frame, NULL if the slot was already reused
+     */
+    const void* pin(const ShmFrameDescriptor* desc);
+
+    /**
+     * Release the pin of a reader on a slot.
+     *
+     * @param slot - Index of the slot
+     */
+    void unpin(uint32_t slot);
+};
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_SHM_RING_H
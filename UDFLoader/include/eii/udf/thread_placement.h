@@ -0,0 +1,121 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief CPU affinity and scheduling settings of a group of threads.
+ */
+
+#ifndef _EII_UDF_THREAD_PLACEMENT_H
+#define _EII_UDF_THREAD_PLACEMENT_H
+
+#include <climits>
+#include <string>
+#include <vector>
+#include <sched.h>
+
+namespace eii {
+namespace udf {
+
+// Nice level of a placement which leaves the threads' nice level unchanged
+#define THREAD_NICE_UNSET INT_MIN
+
+/**
+ * Parse the name of a scheduling policy ("other", "fifo" or "rr").
+ *
+ * @param[in]  name   - Name of the policy
+ * @param[out] policy - Policy (e.g. @c SCHED_FIFO)
+ * @return false if the name is not a known policy
+ */
+bool parse_sched_policy(const char* name, int* policy);
+
+/**
+ * CPU affinity, scheduling policy and nice level applied to every thread of
+ * a group (e.g. the UDF workers) when the thread starts.
+ */
+class ThreadPlacement {
+private:
+    // CPUs the threads may run on (empty to leave the affinity unchanged)
+    std::vector<int> m_cpus;
+
+    // Scheduling policy and its static priority
+    int m_sched_policy;
+    int m_sched_priority;
+
+    // Nice level (THREAD_NICE_UNSET to leave it unchanged)
+    int m_nice;
+
+public:
+    /**
+     * Constructor
+     *
+     * @param cpus           - CPUs the threads may run on, empty to leave
+     *                         the affinity unchanged
+     * @param sched_policy   - (Optional) Scheduling policy, e.g.
+     *                         @c SCHED_FIFO (default: @c SCHED_OTHER)
+     * @param sched_priority - (Optional) Static priority, 1 to 99 for
+     *                         @c SCHED_FIFO and @c SCHED_RR (default: 0)
+     * @param nice           - (Optional) Nice level, -20 to 19
+     *                         (default: @c THREAD_NICE_UNSET)
+     */
+    ThreadPlacement(
+            const std::vector<int>& cpus, int sched_policy=SCHED_OTHER,
+            int sched_priority=0, int nice=THREAD_NICE_UNSET);
+
+    /**
+     * Apply the placement to the calling thread and log the resulting
+     * placement.
+     *
+     * \note Failures are logged and the thread keeps running with the
+     *      settings which could not be applied unchanged (e.g.
+     *      @c SCHED_FIFO without the @c CAP_SYS_NICE capability).
+     *
+     * @param name - Name of the thread for the log
+     * @return false if any of the settings could not be applied
+     */
+    bool apply(const std::string& name);
+
+    /**
+     * Get the CPUs the threads may run on.
+     *
+     * @return CPUs, empty if the affinity is left unchanged
+     */
+    const std::vector<int>& get_cpus();
+
+    /**
+     * Get the scheduling policy.
+     *
+     * @return int
+     */
+    int get_sched_policy();
+
+    /**
+     * Get the actual placement of the calling thread, e.g.
+     * "cpus 0-7 (node 0), SCHED_FIFO priority 10, nice 0, on cpu 3".
+     *
+     * @return std::string
+     */
+    static std::string describe_current();
+};
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_THREAD_PLACEMENT_H
@@ -0,0 +1,306 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief Directed acyclic graph of UDFs with conditional edges.
+ */
+
+#ifndef _EII_UDF_UDF_GRAPH_H
+#define _EII_UDF_UDF_GRAPH_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <eii/msgbus/msg_envelope.h>
+
+#include "eii/udf/udf_handle.h"
+#include "eii/udf/frame.h"
+#include "eii/udf/worker_pool.h"
+
+namespace eii {
+namespace udf {
+
+/**
+ * Condition of a @c MetaPredicate on the value of a meta-data key.
+ */
+enum MetaCondition {
+    // Key is (or is not) set
+    META_EXISTS = 0,
+
+    // Value is (not) equal to the predicate's value
+    META_EQUALS = 1,
+    META_NOT_EQUALS = 2,
+
+    // Number is greater/less than the predicate's value
+    META_GREATER_THAN = 3,
+    META_LESS_THAN = 4,
+};
+
+/**
+ * Parse the name of a meta-data condition, i.e. "exists", "equals",
+ * "not_equals", "greater_than" or "less_than".
+ *
+ * @param name - Name of the condition
+ * @param cond - Output condition
+ * @return True if the name is a known condition
+ */
+bool parse_meta_condition(const char* name, MetaCondition* cond);
+
+/**
+ * Predicate on a key of a frame's meta-data, used to route frames along the
+ * edges of a @c UdfGraph.
+ */
+class MetaPredicate {
+private:
+    // Meta-data key
+    std::string m_key;
+
+    // Condition on the key's value
+    MetaCondition m_cond;
+
+    // Value to compare with, a boolean for META_EXISTS
+    msg_envelope_elem_body_t* m_value;
+
+    /**
+     * Private @c MetaPredicate copy constructor.
+     */
+    MetaPredicate(const MetaPredicate& src);
+
+    /**
+     * Private @c MetaPredicate assignment operator.
+     */
+    MetaPredicate& operator=(const MetaPredicate& src);
+
+public:
+    /**
+     * Constructor
+     *
+     * \note Comparisons with a value of another type, or with a key which
+     *      is not set, are false (true for @c META_NOT_EQUALS).
+     *
+     * @param key   - Meta-data key
+     * @param cond  - Condition on the key's value
+     * @param value - Value to compare with, which must be an integer, float,
+     *                string or boolean (a boolean for @c META_EXISTS, a
+     *                number for @c META_GREATER_THAN and @c META_LESS_THAN).
+     *                The predicate takes ownership of the value.
+     */
+    MetaPredicate(const std::string& key, MetaCondition cond,
+                  msg_envelope_elem_body_t* value);
+
+    /**
+     * Destructor
+     */
+    ~MetaPredicate();
+
+    /**
+     * Evaluate the predicate on the meta-data of a frame.
+     *
+     * @param frame - Frame to evaluate the predicate on
+     * @return bool
+     */
+    bool evaluate(Frame* frame);
+
+    /**
+     * Get a description of the predicate for the log, e.g.
+     * "score greater_than 0.5".
+     *
+     * @return std::string
+     */
+    std::string describe();
+};
+
+/**
+ * Directed acyclic graph of UDFs.
+ *
+ * A frame enters the graph at every UDF without incoming edges (the roots)
+ * and follows the edges whose predicate holds after the source UDF ran. A
+ * UDF runs once all of its incoming edges have been decided, if at least
+ * one of them was taken, otherwise it is skipped along with the edges
+ * leaving it.
+ *
+ * Branches run concurrently: where a frame follows several edges, every
+ * edge after the first gets a frame created with @c Frame::share(), which
+ * is handed to the branch pool. Where branches meet again, and once all UDFs
+ * are done, the meta-data keys of the other branches' frames which the
+ * frame of the first branch (in edge/UDF order) does not have are merged
+ * into it, see @c Frame::merge_meta_data(). Changes to the pixels are only
+ * kept on the first branch.
+ *
+ * A UDF dropping the frame (or failing) drops it for the whole graph, the
+ * UDFs which have not started yet are skipped.
+ */
+class UdfGraph {
+public:
+    /**
+     * Function running a UDF on a frame, which returns the frame to
+     * continue with, or NULL if the frame was dropped (and deleted).
+     */
+    typedef std::function<Frame*(UdfHandle*, Frame*)> RunUdfFn;
+
+private:
+    // UDF of the graph with its edges
+    typedef struct {
+        std::string id;
+        UdfHandle* udf;
+        std::vector<int> in_edges;
+        std::vector<int> out_edges;
+    } Node;
+
+    // Edge between two UDFs, taken if the predicate holds (or is NULL)
+    typedef struct {
+        int from;
+        int to;
+        MetaPredicate* when;
+    } Edge;
+
+    // State of the execution of the graph on a single frame
+    struct Run;
+
+    // UDFs and edges
+    std::vector<Node> m_nodes;
+    std::vector<Edge> m_edges;
+
+    // Roots of the graph
+    std::vector<int> m_roots;
+
+    // Function running a single UDF
+    RunUdfFn m_run_udf;
+
+    // Pool running the branches (NULL to run them on the calling thread)
+    WorkerPool* m_pool;
+
+    /**
+     * Get the index of a UDF.
+     *
+     * @param id - ID of the UDF
+     * @return int, -1 if there is no UDF with the ID
+     */
+    int find_node(const std::string& id);
+
+    /**
+     * Run a UDF of the graph on the frame(s) of its taken incoming edges
+     * (or skip it) and decide its outgoing edges.
+     *
+     * @param run  - Execution the UDF belongs to
+     * @param node - Index of the UDF
+     */
+    void run_node(std::shared_ptr<Run> run, int node);
+
+    /**
+     * Run UDFs which became ready, all but the first on the branch pool.
+     *
+     * @param run   - Execution the UDFs belong to
+     * @param nodes - Indexes of the UDFs
+     */
+    void dispatch(std::shared_ptr<Run> run, const std::vector<int>& nodes);
+
+    /**
+     * Join frames of parallel branches.
+     *
+     * @param frames - Frames to join, all but the first are deleted
+     * @return The first frame, with the meta-data of the others merged in
+     */
+    static Frame* join(const std::vector<Frame*>& frames);
+
+    /**
+     * Private @c UdfGraph copy constructor.
+     */
+    UdfGraph(const UdfGraph& src);
+
+    /**
+     * Private @c UdfGraph assignment operator.
+     */
+    UdfGraph& operator=(const UdfGraph& src);
+
+public:
+    /**
+     * Constructor
+     *
+     * @param run_udf - Function running a single UDF on a frame
+     */
+    UdfGraph(RunUdfFn run_udf);
+
+    /**
+     * Destructor
+     *
+     * \note The UDF handles are not owned by the graph.
+     */
+    ~UdfGraph();
+
+    /**
+     * Add a UDF to the graph.
+     *
+     * @param id  - Unique ID of the UDF in the graph
+     * @param udf - UDF handle
+     */
+    void add_udf(const std::string& id, UdfHandle* udf);
+
+    /**
+     * Add an edge between two UDFs which have been added already.
+     *
+     * @param from - ID of the UDF the edge starts at
+     * @param to   - ID of the UDF the edge leads to
+     * @param when - (Optional) Predicate on the meta-data after @c from ran
+     *               for the edge to be taken, owned by the graph
+     *               afterwards. NULL if the edge is always taken.
+     */
+    void add_edge(const std::string& from, const std::string& to,
+                  MetaPredicate* when=NULL);
+
+    /**
+     * Check the graph once all UDFs and edges have been added.
+     *
+     * \note Throws an exception if the graph contains a cycle.
+     */
+    void finalize();
+
+    /**
+     * Check if the graph has branches which can run concurrently, i.e.
+     * more than one root or UDFs with more than one outgoing edge.
+     *
+     * @return bool
+     */
+    bool has_branches();
+
+    /**
+     * Set the pool running the branches of the graph concurrently.
+     *
+     * @param pool - Branch pool, which must outlive the graph (NULL to run
+     *               all UDFs on the thread calling @c execute())
+     */
+    void set_branch_pool(WorkerPool* pool);
+
+    /**
+     * Run the graph on a frame.
+     *
+     * @param frame - Frame to process
+     * @return The frame to continue with, NULL if it was dropped (in which
+     *      case it has already been deleted)
+     */
+    Frame* execute(Frame* frame);
+};
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_UDF_GRAPH_H
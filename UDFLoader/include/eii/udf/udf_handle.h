@@ -27,7 +27,10 @@
 #define _EII_UDF_UDF_HANDLE_H
 
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <vector>
 #include <eii/utils/config.h>
 #include "eii/udf/frame.h"
 #include "eii/udf/udfretcodes.h"
@@ -46,27 +49,44 @@ private:
     // Flag for if the UDF is initialized
     std::atomic<bool> m_initialized;
 
-    // Max number of worker threads for executing the UDF
+    // Max number of worker threads for executing the UDF (0 for no limit)
     int m_max_workers;
 
+    // Number of threads currently executing the UDF
+    int m_active_workers;
+    std::mutex m_workers_mtx;
+    std::condition_variable m_workers_cv;
+
+    // Flag for if the UDF only reads the frame's pixels
+    bool m_read_only;
+
     // Profiling start timestamp key
     std::string m_prof_entry_key;
 
     // Profiling end timestamp key
     std::string m_prof_exit_key;
 
+    /**
+     * Wait for a free worker slot (see @c execute()).
+     */
+    void acquire_worker();
+
+    /**
+     * Give up the worker slot taken by @c acquire_worker().
+     */
+    void release_worker();
+
 protected:
     // UDF Configuration
     config_t* m_config;
 
-    // TODO: Add thread pool definition
-
 public:
     /**
      * Constructor
      *
      * @param name        - Name of the UDF
-     * @param max_workers - Max number of worker threads for the UDF
+     * @param max_workers - Max number of threads executing the UDF at once
+     *                      through @c execute(), 0 for no limit
      */
     UdfHandle(std::string name, int max_workers);
 
@@ -89,6 +109,16 @@ public:
      */
     bool is_initialized();
 
+    /**
+     * Return whether or not the UDF is configured to only read the frame's
+     * pixels (i.e. "read_only": true in the UDF's configuration). Frames
+     * processed by read-only UDFs keep their received encoded bytes, so
+     * they can be re-published without being encoded again.
+     *
+     * @return bool
+     */
+    bool is_read_only();
+
     /**
      * Process the given frame.
      *
@@ -105,6 +135,49 @@ public:
      */
     virtual UdfRetCode process(Frame* frame) = 0;
 
+    /**
+     * Process a batch of frames. UDFs implementing a batch entry point get
+     * all frames in a single call, for all other UDFs the default
+     * implementation calls @c process() for each frame.
+     *
+     * @param frames - Frames to process
+     * @param rets   - Return code for each frame (see @c process()), must
+     *                 have the same size as @c frames
+     */
+    virtual void process_batch(
+            std::vector<Frame*>& frames, std::vector<UdfRetCode>& rets);
+
+    /**
+     * Process the given frame, while limiting the number of threads
+     * executing the UDF at once to the UDF's max workers. Threads over the
+     * limit wait until another thread is done with the UDF, so that UDFs
+     * which are not thread-safe can run alongside UDFs which are.
+     *
+     * See @c process() for the meaning of the return values.
+     *
+     * @param frame - Frame to process
+     * @return @c UdfRetCode
+     */
+    UdfRetCode execute(Frame* frame);
+
+    /**
+     * Process a batch of frames with @c process_batch(), which takes a
+     * single worker slot of the UDF (see @c execute()).
+     *
+     * @param frames - Frames to process
+     * @param rets   - Return code for each frame, must have the same size as
+     *                 @c frames
+     */
+    void execute_batch(
+            std::vector<Frame*>& frames, std::vector<UdfRetCode>& rets);
+
+    /**
+     * Get the max number of threads executing the UDF at once.
+     *
+     * @return int, 0 if there is no limit
+     */
+    int get_max_workers();
+
     /**
      * Get the name of the UDF.
      *
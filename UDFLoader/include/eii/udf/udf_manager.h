@@ -27,6 +27,9 @@
 
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <eii/utils/config.h>
 #include <eii/utils/thread_safe_queue.h>
@@ -35,11 +38,56 @@
 
 #include "eii/udf/udf_handle.h"
 #include "eii/udf/frame.h"
+#include "eii/udf/frame_queue.h"
+#include "eii/udf/shm_ring.h"
+#include "eii/udf/reorder_buffer.h"
+#include "eii/udf/work_stealing_scheduler.h"
+#include "eii/udf/load_shedder.h"
+#include "eii/udf/worker_pool.h"
+#include "eii/udf/thread_placement.h"
+#include "eii/udf/udf_graph.h"
 
 namespace eii {
 namespace udf {
 
-typedef utils::ThreadSafeQueue<Frame*> FrameQueue;
+/**
+ * Stage of the UDF chain executed by a @c UdfManager.
+ *
+ * Without pipelining the whole chain is a single stage reading from the
+ * manager's input queue and writing to its output queue. In pipelined mode
+ * every stage runs a slice of the chain on its own workers, with bounded
+ * queues between consecutive stages. UDFs connected by edges form a graph,
+ * which is always executed by a single stage.
+ */
+typedef struct {
+    // UDFs executed by the stage, in order
+    std::vector<UdfHandle*> udfs;
+
+    // Graph of the UDFs executed instead of running them in order (NULL
+    // for a chain)
+    UdfGraph* graph;
+
+    // Queue the stage pops its frames from
+    FrameQueue* input_queue;
+
+    // Queue the stage pushes its frames to
+    FrameQueue* output_queue;
+
+    // Number of worker threads for the stage
+    int workers;
+
+    // Flags for if the stage is the first/last stage of the chain
+    bool first;
+    bool last;
+
+    // Thread executor running the stage's workers
+    utils::ThreadExecutor* executor;
+
+    // Scheduler handing the frames to the workers, and the thread feeding
+    // it from the input queue (NULL if the workers pop the input queue)
+    WorkStealingScheduler* scheduler;
+    std::thread* feeder;
+} UdfStage;
 
 /**
  * UdfManager class
@@ -61,12 +109,12 @@ private:
     // UDF output queue
     FrameQueue* m_udf_output_queue;
 
-    // Thread executor
-    utils::ThreadExecutor* m_executor;
-
     // UDF Handles
     std::vector<UdfHandle*> m_udfs;
 
+    // Stages executing the UDF chain (a single stage unless pipelined)
+    std::vector<UdfStage*> m_stages;
+
     // Profiling handle
     utils::Profiling* m_profile;
 
@@ -83,11 +131,169 @@ private:
     EncodeType m_enc_type;
     int m_enc_lvl;
 
+    // Shared memory ring for publishing the output frames (if configured)
+    std::shared_ptr<ShmRing> m_shm_ring;
+
+    // Flag for if multi-frame output frames use the packed layout
+    bool m_pack_frames;
+
+    // Buffer restoring the input order of the output frames (NULL if the
+    // frames are published in the order they finish)
+    ReorderBuffer* m_reorder;
+
+    // Sequence number of the next frame popped from the input queue
+    uint64_t m_next_seq;
+    std::mutex m_seq_mtx;
+
+    // Maximum number of frames a worker dequeues and hands to the UDFs at
+    // once, and how long to wait for a batch to fill up
+    int m_batch_size;
+    std::chrono::milliseconds m_batch_max_wait;
+
+    // Overflow policies of the input and output queues
+    LoadShedder* m_input_shedder;
+    LoadShedder* m_output_shedder;
+
+    // Maximum age of a frame to still be processed (0 for no limit), and
+    // flag for if expired frames are published with their meta-data only
+    std::chrono::milliseconds m_latency_budget;
+    bool m_expired_stubs;
+
+    // Number of frames which exceeded the latency budget
+    std::atomic<uint64_t> m_expired;
+
+    // Threads encoding the output frames ahead of publishing (NULL if the
+    // frames are encoded when they are serialized)
+    WorkerPool* m_encoder;
+
+    // Threads running the branches of the UDF graph concurrently (NULL if
+    // the UDFs form a chain or the branches run on the UDF workers)
+    WorkerPool* m_branch_pool;
+
+    // CPU affinity and scheduling settings of the manager's own threads, the
+    // UDF workers and the encoder threads (NULL to leave them unchanged)
+    ThreadPlacement* m_manager_placement;
+    ThreadPlacement* m_worker_placement;
+    ThreadPlacement* m_encoder_placement;
+
     /**
      * @c UDFManager private thread run method.
+     *
+     * @param tid  - Worker thread ID
+     * @param stop - Flag for if the worker should stop
+     * @param varg - @c UdfStage executed by the worker
      */
     void run(int tid, std::atomic<bool>& stop, void* varg);
 
+    /**
+     * Feeder thread moving the frames from a stage's input queue into the
+     * stage's work-stealing scheduler.
+     *
+     * @param stage - Stage to feed
+     */
+    void feed(UdfStage* stage);
+
+    /**
+     * Pop a frame from a stage's input queue, numbering it if the output
+     * frames are published in input order.
+     *
+     * @param stage - Stage to pop the frame for
+     * @return @c Frame*, NULL if the queue was empty
+     */
+    Frame* pop_frame(UdfStage* stage);
+
+    /**
+     * Wait for the next frame of a stage.
+     *
+     * @param stage   - Stage to get the frame for
+     * @param tid     - Worker ID
+     * @param timeout - Maximum time to wait for a frame
+     * @return @c Frame*, NULL if no frame arrived in time
+     */
+    Frame* next_frame(
+            UdfStage* stage, int tid, std::chrono::milliseconds timeout);
+
+    /**
+     * Remove the frames which exceeded the latency budget from a batch,
+     * either dropping them or publishing them as meta-data stubs.
+     *
+     * @param stage  - Stage about to process the frames
+     * @param frames - Frames of the batch
+     * @param seqs   - Sequence numbers of the frames
+     */
+    void expire_frames(
+            UdfStage* stage, std::vector<Frame*>& frames,
+            std::vector<uint64_t>& seqs);
+
+    /**
+     * Check a frame against the latency budget. A frame which exceeded it is
+     * either dropped or turned into a stub carrying only its meta-data, whose
+     * pixels are replaced by an already encoded 1x1 placeholder.
+     *
+     * \note Stubs are recognized by @c Frame::is_encoded(), they skip the
+     *      remaining UDFs and the encoder stage.
+     *
+     * @param frame - Frame to check
+     * @return The frame or its stub, NULL if it was dropped (in which case
+     *      it has already been deleted)
+     */
+    Frame* check_latency_budget(Frame* frame);
+
+    /**
+     * Run the given UDFs on the frame.
+     *
+     * @param udfs  - UDFs to execute, in order
+     * @param frame - Frame to process
+     * @return The frame to continue with, NULL if it was dropped (in which
+     *      case it has already been deleted)
+     */
+    Frame* run_udfs(const std::vector<UdfHandle*>& udfs, Frame* frame);
+
+    /**
+     * Run the given UDFs on a batch of frames, each UDF getting all frames
+     * which have not been dropped by the UDFs before it in a single call.
+     *
+     * @param udfs   - UDFs to execute, in order
+     * @param frames - Frames to process, dropped frames are deleted and set
+     *                 to NULL
+     */
+    void run_udfs_batch(
+            const std::vector<UdfHandle*>& udfs, std::vector<Frame*>& frames);
+
+    /**
+     * Hand a frame which went through a stage's UDFs to the next stage, or
+     * publish it if the stage is the last stage.
+     *
+     * @param stage - Stage which processed the frame
+     * @param seq   - Sequence number of the frame
+     * @param frame - Processed frame, NULL if it was dropped
+     */
+    void forward(UdfStage* stage, uint64_t seq, Frame* frame);
+
+    /**
+     * Publish a frame which went through all UDFs, restoring the input
+     * order first if the output frames are published in input order.
+     *
+     * @param seq   - Sequence number of the frame
+     * @param frame - Frame to publish
+     */
+    void publish(uint64_t seq, Frame* frame);
+
+    /**
+     * Encode a frame which went through all UDFs and publish it.
+     *
+     * @param seq   - Sequence number of the frame
+     * @param frame - Frame to encode and publish
+     */
+    void encode_output(uint64_t seq, Frame* frame);
+
+    /**
+     * Push a processed frame to the manager's output queue.
+     *
+     * @param frame - Frame to publish
+     */
+    void push_output(Frame* frame);
+
     /**
      * Private @c UdfManager copy constructor.
      */
@@ -107,8 +313,9 @@ public:
      * @param output_queue - Output frame queue
      * @param enc_type     - Encoding to use on all frames put into the output
      *                       queue. (df: EncodeType::NONE)
-     * @param enc_lvl      - Encoding level, must be between 0 and 9 for PNG
-     *                       and 0 and 100 for JPEG (df: 0)
+     * @param enc_lvl      - Encoding level, must be between 0 and 9 for PNG,
+     *                       0 and 100 for JPEG, 0 and 12 for LZ4 and 1 and
+     *                       22 for ZSTD (df: 0)
      */
     UdfManager(config_t* udf_cfg, FrameQueue* input_queue,
                FrameQueue* output_queue, std::string service_name,
@@ -129,6 +336,38 @@ public:
      * Stop the UDFManager thread
      */
     void stop();
+
+    /**
+     * Push a frame into the input queue, applying the input queue's overflow
+     * policy if the queue is full. Producers which push into the input queue
+     * directly bypass the policy.
+     *
+     * @param frame - Frame to process, which is owned by the manager
+     *                afterwards
+     * @return True if the frame was enqueued, false if it was shed
+     */
+    bool push_input(Frame* frame);
+
+    /**
+     * Get the number of frames shed by the input queue's overflow policy.
+     *
+     * @return uint64_t
+     */
+    uint64_t get_input_shed();
+
+    /**
+     * Get the number of frames shed by the output queue's overflow policy.
+     *
+     * @return uint64_t
+     */
+    uint64_t get_output_shed();
+
+    /**
+     * Get the number of frames which exceeded the latency budget.
+     *
+     * @return uint64_t
+     */
+    uint64_t get_expired();
 };
 
 } // udf
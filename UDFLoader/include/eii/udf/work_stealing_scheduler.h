@@ -0,0 +1,195 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief Work-stealing scheduler distributing frames to worker threads.
+ */
+
+#ifndef _EII_UDF_WORK_STEALING_SCHEDULER_H
+#define _EII_UDF_WORK_STEALING_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+#include "eii/udf/frame.h"
+
+namespace eii {
+namespace udf {
+
+// Default number of queued frames per worker of a scheduler
+#define WORK_STEALING_FRAMES_PER_WORKER 4
+
+/**
+ * Scheduler with a local deque of frames for each worker thread.
+ *
+ * Frames are pushed to the workers' deques round-robin. A worker pops the
+ * frames from its own deque, and when that is empty it steals half of the
+ * frames of another worker. Workers on CPUs sharing the thief's L3 cache
+ * are tried first, then workers on the same NUMA node and then the rest, so
+ * that stolen frames stay as close as possible to the cache they are in.
+ *
+ * Workers only contend for a lock with the producer or a thief of their
+ * own deque, instead of all workers contending for a single queue. Idle
+ * workers sleep until a frame is pushed.
+ *
+ * All methods are thread-safe.
+ */
+class WorkStealingScheduler {
+private:
+    // Local deque of a worker
+    typedef struct {
+        std::mutex mtx;
+        std::deque<Frame*> frames;
+
+        // CPU the worker last ran on (-1 if unknown)
+        std::atomic<int> cpu;
+
+        // Keep the deques of different workers on different cache lines
+        char padding[64];
+    } Worker;
+
+    std::vector<Worker*> m_workers;
+
+    // Maximum number of queued frames
+    size_t m_capacity;
+
+    // Number of queued frames
+    std::atomic<size_t> m_size;
+
+    // Next worker to push a frame to
+    std::atomic<uint64_t> m_next;
+
+    // Sleeping workers and producers
+    std::mutex m_wait_mtx;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+    std::atomic<int> m_idle_workers;
+    std::atomic<int> m_full_waiters;
+
+    // Flag for if the scheduler has been stopped
+    std::atomic<bool> m_stop;
+
+    // Number of frames taken from another worker's deque
+    std::atomic<uint64_t> m_steals;
+
+    /**
+     * Pop a frame from the worker's deque, or steal frames from another
+     * worker if it is empty.
+     *
+     * @param worker - Worker index
+     * @return @c Frame*, NULL if no frame is queued
+     */
+    Frame* try_pop(int worker);
+
+    /**
+     * Steal half of the frames of another worker.
+     *
+     * @param worker - Worker index of the thief
+     * @return @c Frame*, NULL if all other deques are empty
+     */
+    Frame* steal(int worker);
+
+    /**
+     * Account for a frame taken out of a deque.
+     */
+    void taken();
+
+    /**
+     * Private @c WorkStealingScheduler copy constructor.
+     */
+    WorkStealingScheduler(const WorkStealingScheduler& src);
+
+    /**
+     * Private @c WorkStealingScheduler assignment operator.
+     */
+    WorkStealingScheduler& operator=(const WorkStealingScheduler& src);
+
+public:
+    /**
+     * Constructor
+     *
+     * @param num_workers - Number of worker threads popping frames
+     * @param capacity    - Maximum number of queued frames, 0 for
+     *                      @c WORK_STEALING_FRAMES_PER_WORKER per worker
+     */
+    WorkStealingScheduler(int num_workers, size_t capacity=0);
+
+    /**
+     * Destructor, deletes all frames which are still queued.
+     */
+    ~WorkStealingScheduler();
+
+    /**
+     * Queue a frame, blocking while the scheduler is full.
+     *
+     * @param frame - Frame, which is owned by the scheduler afterwards
+     * @return true if the frame was queued, false if the scheduler has been
+     *      stopped (in which case the caller still owns the frame)
+     */
+    bool push(Frame* frame);
+
+    /**
+     * Get a frame for a worker, waiting until one is queued.
+     *
+     * @param worker  - Worker index, between 0 and the number of workers
+     * @param timeout - Maximum time to wait
+     * @return @c Frame*, NULL if no frame was queued before the timeout or
+     *      the scheduler has been stopped
+     */
+    Frame* pop(int worker, std::chrono::milliseconds timeout);
+
+    /**
+     * Wake up all waiting workers and producers, after which no more frames
+     * are queued.
+     */
+    void stop();
+
+    /**
+     * Get the number of queued frames.
+     *
+     * @return size_t
+     */
+    size_t get_size();
+
+    /**
+     * Get the number of worker threads.
+     *
+     * @return int
+     */
+    int get_num_workers();
+
+    /**
+     * Get the number of frames which were stolen from another worker.
+     *
+     * @return uint64_t
+     */
+    uint64_t get_steals();
+};
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_WORK_STEALING_SCHEDULER_H
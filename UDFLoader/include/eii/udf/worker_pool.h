@@ -0,0 +1,133 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief Bounded thread pool for running jobs off of the calling thread.
+ */
+
+#ifndef _EII_UDF_WORKER_POOL_H
+#define _EII_UDF_WORKER_POOL_H
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include "eii/udf/thread_placement.h"
+
+namespace eii {
+namespace udf {
+
+/**
+ * Fixed size thread pool with a bounded job queue. It runs the encoder stage
+ * of the @c UdfManager, the branches of a @c UdfGraph and, through
+ * @c EncoderPool, the parallel encoding of multi-frame objects.
+ */
+class WorkerPool {
+private:
+    // Worker threads
+    std::vector<std::thread> m_threads;
+
+    // Queued jobs
+    std::deque<std::function<void()>> m_jobs;
+
+    // Maximum number of queued jobs
+    size_t m_max_queued;
+
+    // Flag for if the workers should stop
+    bool m_stop;
+
+    // Placement applied to the workers when they start (NULL for none)
+    ThreadPlacement* m_placement;
+
+    // Name of the workers for the log
+    std::string m_name;
+
+    // Synchronization for the job queue
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+
+    /**
+     * Worker thread run method.
+     *
+     * @param index - Index of the worker
+     */
+    void run(int index);
+
+    /**
+     * Private @c WorkerPool copy constructor.
+     */
+    WorkerPool(const WorkerPool& src);
+
+    /**
+     * Private @c WorkerPool assignment operator.
+     */
+    WorkerPool& operator=(const WorkerPool& src);
+
+public:
+    /**
+     * Constructor
+     *
+     * @param num_workers - Number of worker threads
+     * @param max_queued  - Maximum number of jobs which can be queued
+     * @param placement   - (Optional) CPU affinity and scheduling settings
+     *                      of the workers, which must outlive the pool
+     * @param name        - (Optional) Name of the workers for the log
+     *                      (default: "Worker")
+     */
+    WorkerPool(int num_workers, int max_queued,
+               ThreadPlacement* placement=NULL,
+               const std::string& name="Worker");
+
+    /**
+     * Destructor
+     *
+     * \note Jobs which are already queued are executed before the worker
+     *      threads exit.
+     */
+    virtual ~WorkerPool();
+
+    /**
+     * Submit a job to the pool.
+     *
+     * \note Jobs are responsible for reporting their own errors, an
+     *      exception escaping a job is only logged.
+     *
+     * @param job - Job to execute
+     * @return false if the job queue is full and the job was not queued
+     */
+    bool submit(std::function<void()> job);
+
+    /**
+     * Get the number of worker threads.
+     *
+     * @return int
+     */
+    int get_num_workers();
+};
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_WORKER_POOL_H
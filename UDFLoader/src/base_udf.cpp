@@ -36,3 +36,11 @@ BaseUdf::~BaseUdf() {
     // be internally wrapped by a @c UdfHandle which manages the memory for
     // the configuration object.
 }
+
+void BaseUdf::process_batch(
+        std::vector<cv::Mat>& frames, std::vector<cv::Mat>& outputs,
+        std::vector<msg_envelope_t*>& metas, std::vector<UdfRetCode>& rets) {
+    for(size_t i = 0; i < frames.size(); i++) {
+        rets[i] = this->process(frames[i], outputs[i], metas[i]);
+    }
+}
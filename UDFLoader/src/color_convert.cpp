@@ -0,0 +1,435 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Implementation of the color and layout conversion kernels
+ */
+
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <eii/utils/logger.h>
+
+#include "eii/udf/color_convert.h"
+#include "eii/udf/frame_buffer_pool.h"
+
+// Every kernel is compiled for each of the instruction sets below, and the
+// dynamic loader selects the best one for the CPU the first time the kernel
+// is called. The kernels are written so that the compiler can vectorize
+// them for each instruction set (see CMakeLists.txt for the optimization
+// level of this file).
+#if defined(__x86_64__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define COLOR_KERNEL_DISPATCH
+#define COLOR_KERNEL \
+    __attribute__((target_clones("avx512f", "avx2", "sse4.1", "default")))
+#endif
+#endif
+
+#ifndef COLOR_KERNEL
+#define COLOR_KERNEL
+#endif
+
+// Helpers inlined into every instruction set specific kernel
+#define KERNEL_INLINE inline __attribute__((always_inline))
+
+// ITU-R BT.601 luma weights in Q14 fixed point (same as OpenCV)
+#define GRAY_SHIFT 14
+#define GRAY_R     4899
+#define GRAY_G     9617
+#define GRAY_B     1868
+
+// ITU-R BT.601 limited range YUV to RGB coefficients in Q20 fixed point
+// (same as OpenCV)
+#define YUV_SHIFT 20
+#define YUV_CY    1220542
+#define YUV_CUB   2116026
+#define YUV_CUG   -409993
+#define YUV_CVG   -852492
+#define YUV_CVR   1673527
+
+using namespace eii::udf;
+
+static KERNEL_INLINE uint8_t clamp_u8(int value) {
+    return (uint8_t) (value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+//
+// Kernels
+//
+
+COLOR_KERNEL
+static void swap_rb_u8(
+        const uint8_t* src, size_t src_stride, uint8_t* dst,
+        size_t dst_stride, int width, int height) {
+    for (int y = 0; y < height; y++) {
+        const uint8_t* __restrict s = src + y * src_stride;
+        uint8_t* __restrict d = dst + y * dst_stride;
+        for (int x = 0; x < width; x++) {
+            d[3 * x]     = s[3 * x + 2];
+            d[3 * x + 1] = s[3 * x + 1];
+            d[3 * x + 2] = s[3 * x];
+        }
+    }
+}
+
+COLOR_KERNEL
+static void to_gray_u8(
+        const uint8_t* src, size_t src_stride, uint8_t* dst,
+        size_t dst_stride, int width, int height, int weight0, int weight2) {
+    for (int y = 0; y < height; y++) {
+        const uint8_t* __restrict s = src + y * src_stride;
+        uint8_t* __restrict d = dst + y * dst_stride;
+        for (int x = 0; x < width; x++) {
+            int luma = s[3 * x] * weight0 + s[3 * x + 1] * GRAY_G +
+                       s[3 * x + 2] * weight2 + (1 << (GRAY_SHIFT - 1));
+            d[x] = (uint8_t) (luma >> GRAY_SHIFT);
+        }
+    }
+}
+
+/**
+ * Convert a YUV 4:2:0 pixel to BGR.
+ */
+static KERNEL_INLINE void yuv_to_bgr(int y, int u, int v, uint8_t* d) {
+    int luma = (y > 16 ? y - 16 : 0) * YUV_CY + (1 << (YUV_SHIFT - 1));
+    d[0] = clamp_u8((luma + YUV_CUB * u) >> YUV_SHIFT);
+    d[1] = clamp_u8((luma + YUV_CVG * v + YUV_CUG * u) >> YUV_SHIFT);
+    d[2] = clamp_u8((luma + YUV_CVR * v) >> YUV_SHIFT);
+}
+
+/**
+ * Convert a row of YUV 4:2:0 pixels to BGR, where the U and V samples of
+ * neighbouring pixel pairs are @c UV_STEP elements apart.
+ */
+template <int UV_STEP>
+static KERNEL_INLINE void yuv420_row_to_bgr(
+        const uint8_t* __restrict ys, const uint8_t* __restrict us,
+        const uint8_t* __restrict vs, uint8_t* __restrict d, int width) {
+    // Each pair of pixels shares its chroma samples
+    for (int x = 0; x < width / 2; x++) {
+        int u = (int) us[x * UV_STEP] - 128;
+        int v = (int) vs[x * UV_STEP] - 128;
+        yuv_to_bgr(ys[2 * x], u, v, d + 6 * x);
+        yuv_to_bgr(ys[2 * x + 1], u, v, d + 6 * x + 3);
+    }
+}
+
+COLOR_KERNEL
+static void nv12_to_bgr_u8(
+        const uint8_t* src, size_t src_stride, uint8_t* dst,
+        size_t dst_stride, int width, int height) {
+    // Interleaved UV plane after the Y plane, with the same stride
+    const uint8_t* uv = src + height * src_stride;
+    for (int y = 0; y < height; y++) {
+        const uint8_t* uv_row = uv + (y / 2) * src_stride;
+        yuv420_row_to_bgr<2>(
+                src + y * src_stride, uv_row, uv_row + 1,
+                dst + y * dst_stride, width);
+    }
+}
+
+COLOR_KERNEL
+static void i420_to_bgr_u8(
+        const uint8_t* src, size_t src_stride, uint8_t* dst,
+        size_t dst_stride, int width, int height) {
+    // U plane and then V plane after the Y plane, with half the stride
+    size_t uv_stride = src_stride / 2;
+    const uint8_t* u = src + height * src_stride;
+    const uint8_t* v = u + (height / 2) * uv_stride;
+    for (int y = 0; y < height; y++) {
+        yuv420_row_to_bgr<1>(
+                src + y * src_stride, u + (y / 2) * uv_stride,
+                v + (y / 2) * uv_stride, dst + y * dst_stride, width);
+    }
+}
+
+template <typename T>
+static KERNEL_INLINE void hwc_to_chw(
+        const uint8_t* src, size_t src_stride, uint8_t* dst,
+        size_t dst_stride, int width, int height, int channels) {
+    for (int y = 0; y < height; y++) {
+        const T* __restrict s = (const T*) (src + y * src_stride);
+        if (channels == 3) {
+            // Common case of 3 channel frames
+            T* __restrict d0 = (T*) (dst + y * dst_stride);
+            T* __restrict d1 = (T*) (dst + (height + y) * dst_stride);
+            T* __restrict d2 = (T*) (dst + (2 * height + y) * dst_stride);
+            for (int x = 0; x < width; x++) {
+                d0[x] = s[3 * x];
+                d1[x] = s[3 * x + 1];
+                d2[x] = s[3 * x + 2];
+            }
+            continue;
+        }
+
+        for (int c = 0; c < channels; c++) {
+            T* __restrict d = (T*) (dst + (c * height + y) * dst_stride);
+            for (int x = 0; x < width; x++) {
+                d[x] = s[x * channels + c];
+            }
+        }
+    }
+}
+
+template <typename T>
+static KERNEL_INLINE void chw_to_hwc(
+        const uint8_t* src, size_t src_stride, uint8_t* dst,
+        size_t dst_stride, int width, int height, int channels) {
+    for (int y = 0; y < height; y++) {
+        T* __restrict d = (T*) (dst + y * dst_stride);
+        if (channels == 3) {
+            // Common case of 3 channel frames
+            const T* __restrict s0 = (const T*) (src + y * src_stride);
+            const T* __restrict s1 =
+                (const T*) (src + (height + y) * src_stride);
+            const T* __restrict s2 =
+                (const T*) (src + (2 * height + y) * src_stride);
+            for (int x = 0; x < width; x++) {
+                d[3 * x]     = s0[x];
+                d[3 * x + 1] = s1[x];
+                d[3 * x + 2] = s2[x];
+            }
+            continue;
+        }
+
+        for (int c = 0; c < channels; c++) {
+            const T* __restrict s =
+                (const T*) (src + (c * height + y) * src_stride);
+            for (int x = 0; x < width; x++) {
+                d[x * channels + c] = s[x];
+            }
+        }
+    }
+}
+
+// Instruction set specific layout kernels for each element size
+#define LAYOUT_KERNEL(name, type) \
+    COLOR_KERNEL \
+    static void name ## _ ## type( \
+            const uint8_t* src, size_t src_stride, uint8_t* dst, \
+            size_t dst_stride, int width, int height, int channels) { \
+        name<type>(src, src_stride, dst, dst_stride, width, height, \
+                   channels); \
+    }
+
+LAYOUT_KERNEL(hwc_to_chw, uint8_t)
+LAYOUT_KERNEL(hwc_to_chw, uint16_t)
+LAYOUT_KERNEL(hwc_to_chw, uint32_t)
+LAYOUT_KERNEL(chw_to_hwc, uint8_t)
+LAYOUT_KERNEL(chw_to_hwc, uint16_t)
+LAYOUT_KERNEL(chw_to_hwc, uint32_t)
+
+//
+// Public API
+//
+
+const char* eii::udf::get_color_convert_isa() {
+#ifdef COLOR_KERNEL_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) { return "avx512"; }
+    if (__builtin_cpu_supports("avx2"))     { return "avx2"; }
+    if (__builtin_cpu_supports("sse4.1"))   { return "sse4"; }
+#endif
+    return "scalar";
+}
+
+int eii::udf::get_converted_channels(
+        ColorConversion conversion, int channels) {
+    switch(conversion) {
+        case ColorConversion::BGR2GRAY:
+        case ColorConversion::RGB2GRAY:  return 1;
+        case ColorConversion::BGR2RGB:
+        case ColorConversion::RGB2BGR:
+        case ColorConversion::NV12_2BGR:
+        case ColorConversion::I420_2BGR: return 3;
+        case ColorConversion::HWC2CHW:
+        case ColorConversion::CHW2HWC:
+        default:                         return channels;
+    }
+}
+
+void eii::udf::convert_color(
+        ColorConversion conversion, const void* src, size_t src_stride,
+        void* dst, size_t dst_stride, int width, int height, int channels,
+        size_t elem_size) {
+    if (src == NULL || dst == NULL) {
+        throw "Conversion buffers cannot be NULL";
+    }
+    if (width <= 0 || height <= 0 || channels <= 0) {
+        throw "Invalid image size for the conversion";
+    }
+
+    const uint8_t* s = (const uint8_t*) src;
+    uint8_t* d = (uint8_t*) dst;
+    size_t out_channels = get_converted_channels(conversion, channels);
+
+    switch(conversion) {
+        case ColorConversion::BGR2RGB:
+        case ColorConversion::RGB2BGR:
+        case ColorConversion::BGR2GRAY:
+        case ColorConversion::RGB2GRAY:
+            if (channels != 3) {
+                throw "Color conversion requires 3 channel pixels";
+            }
+            if (src_stride < (size_t) width * 3 ||
+                    dst_stride < (size_t) width * out_channels) {
+                throw "Stride is smaller than a row of pixels";
+            }
+            if (conversion == ColorConversion::BGR2GRAY) {
+                to_gray_u8(s, src_stride, d, dst_stride, width, height,
+                           GRAY_B, GRAY_R);
+            } else if (conversion == ColorConversion::RGB2GRAY) {
+                to_gray_u8(s, src_stride, d, dst_stride, width, height,
+                           GRAY_R, GRAY_B);
+            } else {
+                swap_rb_u8(s, src_stride, d, dst_stride, width, height);
+            }
+            break;
+        case ColorConversion::NV12_2BGR:
+        case ColorConversion::I420_2BGR:
+            if (channels != 1 || (width % 2) != 0 || (height % 2) != 0) {
+                throw "Planar YUV frames must have 1 channel and even "
+                      "dimensions";
+            }
+            if (src_stride < (size_t) width ||
+                    dst_stride < (size_t) width * 3) {
+                throw "Stride is smaller than a row of pixels";
+            }
+            if (conversion == ColorConversion::NV12_2BGR) {
+                nv12_to_bgr_u8(s, src_stride, d, dst_stride, width, height);
+            } else {
+                i420_to_bgr_u8(s, src_stride, d, dst_stride, width, height);
+            }
+            break;
+        case ColorConversion::HWC2CHW:
+        case ColorConversion::CHW2HWC: {
+            size_t planar_row = (size_t) width * elem_size;
+            size_t interleaved_row = planar_row * channels;
+            bool to_chw = (conversion == ColorConversion::HWC2CHW);
+            if (src_stride < (to_chw ? interleaved_row : planar_row) ||
+                    dst_stride < (to_chw ? planar_row : interleaved_row)) {
+                throw "Stride is smaller than a row of pixels";
+            }
+
+            switch(elem_size) {
+                case 1:
+                    if (to_chw) {
+                        hwc_to_chw_uint8_t(s, src_stride, d, dst_stride,
+                                           width, height, channels);
+                    } else {
+                        chw_to_hwc_uint8_t(s, src_stride, d, dst_stride,
+                                           width, height, channels);
+                    }
+                    break;
+                case 2:
+                    if (to_chw) {
+                        hwc_to_chw_uint16_t(s, src_stride, d, dst_stride,
+                                            width, height, channels);
+                    } else {
+                        chw_to_hwc_uint16_t(s, src_stride, d, dst_stride,
+                                            width, height, channels);
+                    }
+                    break;
+                case 4:
+                    if (to_chw) {
+                        hwc_to_chw_uint32_t(s, src_stride, d, dst_stride,
+                                            width, height, channels);
+                    } else {
+                        chw_to_hwc_uint32_t(s, src_stride, d, dst_stride,
+                                            width, height, channels);
+                    }
+                    break;
+                default:
+                    throw "Layout conversions require 1, 2 or 4 byte "
+                          "elements";
+            }
+            break;
+        }
+        default:
+            throw "Unknown color conversion";
+    }
+}
+
+void eii::udf::convert_color(
+        ColorConversion conversion, const cv::Mat& src, cv::Mat& dst) {
+    if (src.empty()) {
+        throw "Cannot convert an empty cv::Mat";
+    }
+    if (dst.data != NULL && dst.data == src.data) {
+        throw "Conversions cannot be done in-place";
+    }
+
+    int depth = src.depth();
+    size_t elem_size = src.elemSize1();
+
+    // The output is drawn from the frame buffer pool
+    dst.allocator = FrameBufferPool::get_instance()->get_mat_allocator();
+
+    if (conversion == ColorConversion::CHW2HWC) {
+        if (src.dims != 3 || src.channels() != 1) {
+            throw "Planar input must be a (channels, height, width) cv::Mat";
+        }
+        int channels = src.size[0];
+        int height = src.size[1];
+        int width = src.size[2];
+
+        dst.create(height, width, CV_MAKETYPE(depth, channels));
+        convert_color(
+                conversion, src.data, src.step[1], dst.data, dst.step[0],
+                width, height, channels, elem_size);
+        return;
+    }
+
+    if (src.dims != 2) {
+        throw "Input must be a 2 dimensional cv::Mat";
+    }
+
+    int width = src.cols;
+    int height = src.rows;
+    int channels = src.channels();
+
+    if (conversion == ColorConversion::HWC2CHW) {
+        int sizes[3] = { channels, height, width };
+        dst.create(3, sizes, depth);
+        convert_color(
+                conversion, src.data, src.step[0], dst.data, dst.step[1],
+                width, height, channels, elem_size);
+        return;
+    }
+
+    if (depth != CV_8U) {
+        throw "Color conversions require 8-bit pixels";
+    }
+
+    if (conversion == ColorConversion::NV12_2BGR ||
+            conversion == ColorConversion::I420_2BGR) {
+        // The chroma planes are stacked below the luma plane
+        if ((height % 3) != 0) {
+            throw "Planar YUV cv::Mat must have 1.5 * height rows";
+        }
+        height = height * 2 / 3;
+    }
+
+    dst.create(height, width,
+               CV_8UC(get_converted_channels(conversion, channels)));
+    convert_color(
+            conversion, src.data, src.step[0], dst.data, dst.step[0],
+            width, height, channels);
+}
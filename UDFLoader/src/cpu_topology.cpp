@@ -0,0 +1,174 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief CPU topology implementation
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <sched.h>
+#include <unistd.h>
+
+#include "eii/udf/cpu_topology.h"
+
+#define SYSFS_CPU_L3 \
+    "/sys/devices/system/cpu/cpu%d/cache/index3/shared_cpu_list"
+#define SYSFS_NODE_CPUS "/sys/devices/system/node/node%d/cpulist"
+
+// Highest NUMA node number probed in sysfs
+#define MAX_NUMA_NODES 64
+
+using namespace eii::udf;
+
+/**
+ * Read a CPU list from a sysfs file.
+ *
+ * @param[in]  path - Path of the file
+ * @param[out] cpus - Parsed CPUs are appended to this vector
+ * @return false if the file could not be read
+ */
+static bool read_cpu_list(const char* path, std::vector<int>& cpus) {
+    FILE* f = fopen(path, "r");
+    if(f == NULL) {
+        return false;
+    }
+
+    char buf[1024];
+    bool ret = fgets(buf, sizeof(buf), f) != NULL &&
+        parse_cpu_list(buf, cpus);
+    fclose(f);
+
+    return ret;
+}
+
+const CpuTopology& eii::udf::get_cpu_topology() {
+    static CpuTopology topo;
+    static std::once_flag once;
+
+    std::call_once(once, []() {
+        long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+        if(num_cpus <= 0) {
+            return;
+        }
+        topo.l3.assign(num_cpus, -1);
+        topo.node.assign(num_cpus, -1);
+
+        char path[128];
+        std::vector<int> cpus;
+        for(int cpu = 0; cpu < num_cpus; cpu++) {
+            snprintf(path, sizeof(path), SYSFS_CPU_L3, cpu);
+            cpus.clear();
+            if(read_cpu_list(path, cpus) && !cpus.empty()) {
+                topo.l3[cpu] = cpus[0];
+            }
+        }
+
+        for(int node = 0; node < MAX_NUMA_NODES; node++) {
+            snprintf(path, sizeof(path), SYSFS_NODE_CPUS, node);
+            cpus.clear();
+            if(!read_cpu_list(path, cpus)) {
+                continue;
+            }
+            for(int cpu : cpus) {
+                if(cpu >= 0 && cpu < num_cpus) {
+                    topo.node[cpu] = node;
+                }
+            }
+        }
+    });
+
+    return topo;
+}
+
+int eii::udf::get_numa_node(int cpu) {
+    const CpuTopology& topo = get_cpu_topology();
+    if(cpu < 0 || cpu >= (int) topo.node.size()) {
+        return -1;
+    }
+    return topo.node[cpu];
+}
+
+std::vector<int> eii::udf::get_node_cpus(int node) {
+    const CpuTopology& topo = get_cpu_topology();
+    std::vector<int> cpus;
+    for(int cpu = 0; cpu < (int) topo.node.size(); cpu++) {
+        if(node >= 0 && topo.node[cpu] == node) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+int eii::udf::get_current_numa_node() {
+    return get_numa_node(sched_getcpu());
+}
+
+bool eii::udf::parse_cpu_list(const char* list, std::vector<int>& cpus) {
+    const char* p = list;
+    while(*p != '\0' && *p != '\n') {
+        char* end = NULL;
+        long first = strtol(p, &end, 10);
+        if(end == p || first < 0) {
+            return false;
+        }
+        long last = first;
+        p = end;
+        if(*p == '-') {
+            p++;
+            last = strtol(p, &end, 10);
+            if(end == p || last < first) {
+                return false;
+            }
+            p = end;
+        }
+        for(long cpu = first; cpu <= last; cpu++) {
+            cpus.push_back((int) cpu);
+        }
+        if(*p == ',') {
+            p++;
+        } else if(*p != '\0' && *p != '\n') {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string eii::udf::format_cpu_list(const std::vector<int>& cpus) {
+    std::string list;
+    size_t i = 0;
+    while(i < cpus.size()) {
+        // Extend the range while the CPUs are consecutive
+        size_t j = i;
+        while(j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            j++;
+        }
+        if(!list.empty()) {
+            list += ",";
+        }
+        list += std::to_string(cpus[i]);
+        if(j > i) {
+            list += "-" + std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return list;
+}
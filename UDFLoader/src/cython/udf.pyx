@@ -217,6 +217,34 @@ cdef extern from "eii/msgbus/msg_envelope.h":
             msg_envelope_serialized_part_t* parts, int num_parts)
 
 
+cdef extern from "eii/udf/frame_buffer_pool.h" namespace "eii::udf":
+    cdef cppclass FrameBufferPool:
+        void* acquire(size_t size)
+        void release(void* data)
+
+        @staticmethod
+        FrameBufferPool* get_instance()
+
+
+cdef extern from "eii/udf/color_convert.h" namespace "eii::udf":
+    ctypedef enum ColorConversion:
+        CC_BGR2RGB "eii::udf::BGR2RGB"
+        CC_RGB2BGR "eii::udf::RGB2BGR"
+        CC_BGR2GRAY "eii::udf::BGR2GRAY"
+        CC_RGB2GRAY "eii::udf::RGB2GRAY"
+        CC_NV12_2BGR "eii::udf::NV12_2BGR"
+        CC_I420_2BGR "eii::udf::I420_2BGR"
+        CC_HWC2CHW "eii::udf::HWC2CHW"
+        CC_CHW2HWC "eii::udf::CHW2HWC"
+
+    const char* get_color_convert_isa()
+    int get_converted_channels(ColorConversion conversion, int channels)
+    void c_convert_color "eii::udf::convert_color"(
+            ColorConversion conversion, const void* src, size_t src_stride,
+            void* dst, size_t dst_stride, int width, int height,
+            int channels, size_t elem_size) nogil except +
+
+
 cdef extern from "eii/udf/udfretcodes.h" namespace "eii::udf":
     ctypedef enum UdfRetCode:
         UDF_OK = 0
@@ -322,6 +350,153 @@ cdef object cfv_to_object(config_value_t* value):
     return ret_val
 
 
+# Conversions for convert_color()
+BGR2RGB = CC_BGR2RGB
+RGB2BGR = CC_RGB2BGR
+BGR2GRAY = CC_BGR2GRAY
+RGB2GRAY = CC_RGB2GRAY
+NV12_2BGR = CC_NV12_2BGR
+I420_2BGR = CC_I420_2BGR
+HWC2CHW = CC_HWC2CHW
+CHW2HWC = CC_CHW2HWC
+
+
+cdef class PooledBuffer:
+    """Buffer from the frame buffer pool, exposed through the Python buffer
+    protocol. The buffer is released back to the pool once the last object
+    using it (i.e. a NumPy array) is garbage collected.
+    """
+    cdef void* _data
+    cdef Py_ssize_t _size
+
+    def __cinit__(self):
+        """Cython constructor
+        """
+        self._data = NULL
+        self._size = 0
+
+    def __dealloc__(self):
+        """Cython destructor
+        """
+        if self._data != NULL:
+            FrameBufferPool.get_instance().release(self._data)
+
+    def __getbuffer__(self, Py_buffer* buffer, int flags):
+        """Expose the buffer as writable bytes
+        """
+        buffer.buf = self._data
+        buffer.format = 'B'
+        buffer.internal = NULL
+        buffer.itemsize = 1
+        buffer.len = self._size
+        buffer.ndim = 1
+        buffer.obj = self
+        buffer.readonly = 0
+        buffer.shape = &self._size
+        buffer.strides = NULL
+        buffer.suboffsets = NULL
+
+    def __releasebuffer__(self, Py_buffer* buffer):
+        """Nothing to release, the buffer lives as long as this object
+        """
+        pass
+
+    @staticmethod
+    cdef create(size_t size):
+        """Helper method to acquire a buffer from the pool.
+        """
+        b = PooledBuffer()
+        b._data = FrameBufferPool.get_instance().acquire(size)
+        if b._data == NULL:
+            raise MemoryError('Failed to acquire buffer from the pool')
+        b._size = <Py_ssize_t> size
+        return b
+
+
+def color_convert_isa():
+    """Get the instruction set used by the conversion kernels on this CPU.
+
+    :return: "avx512", "avx2", "sse4" or "scalar"
+    :rtype: str
+    """
+    return (<bytes> get_color_convert_isa()).decode('utf-8')
+
+
+def convert_color(frame, conversion):
+    """Convert a frame with the vectorized conversion kernels of the UDF
+    loader instead of calling cv2.cvtColor() or numpy.transpose(), e.g.
+    ``udf.convert_color(frame, udf.BGR2GRAY)``. The output is allocated from
+    the frame buffer pool.
+
+    Planar YUV frames have the shape (1.5 * height, width). The output of
+    HWC2CHW (and the input of CHW2HWC) has the shape
+    (channels, height, width). Single channel outputs have the shape
+    (height, width).
+
+    :param frame: Frame to convert
+    :type: numpy.ndarray
+    :param conversion: Conversion to apply (i.e. udf.BGR2RGB, etc.)
+    :type: int
+    :return: Converted frame
+    :rtype: numpy.ndarray
+    """
+    cdef ColorConversion conv = <ColorConversion> conversion
+    cdef uintptr_t src
+    cdef void* dst
+    cdef size_t src_stride
+    cdef size_t dst_stride
+    cdef size_t elem_size
+    cdef int width
+    cdef int height
+    cdef int channels
+
+    # The kernels expect rows of tightly packed elements
+    frame = np.ascontiguousarray(frame)
+    elem_size = frame.itemsize
+
+    if conv == CC_CHW2HWC:
+        assert frame.ndim == 3, 'Planar input must be (channels, height, width)'
+        channels, height, width = frame.shape
+        out_shape = (height, width, channels)
+        src_stride = width * elem_size
+        dst_stride = width * channels * elem_size
+    else:
+        if frame.ndim == 2:
+            height, width = frame.shape
+            channels = 1
+        else:
+            assert frame.ndim == 3, 'Frame must be (height, width, channels)'
+            height, width, channels = frame.shape
+        src_stride = width * channels * elem_size
+
+        if conv == CC_NV12_2BGR or conv == CC_I420_2BGR:
+            # The chroma planes are stacked below the luma plane
+            assert height % 3 == 0, 'Planar YUV frames need 1.5 * height rows'
+            height = height * 2 // 3
+
+        if conv == CC_HWC2CHW:
+            out_shape = (channels, height, width)
+            dst_stride = width * elem_size
+        else:
+            out_channels = get_converted_channels(conv, channels)
+            if out_channels == 1:
+                out_shape = (height, width)
+            else:
+                out_shape = (height, width, out_channels)
+            dst_stride = width * out_channels * elem_size
+
+    buf = PooledBuffer.create(int(np.prod(out_shape)) * elem_size)
+    dst = (<PooledBuffer> buf)._data
+    src = <uintptr_t> frame.__array_interface__['data'][0]
+
+    with nogil:
+        c_convert_color(
+            conv, <const void*> src, src_stride, dst, dst_stride, width,
+            height, channels, elem_size)
+
+    return np.frombuffer(buf, dtype=frame.dtype).reshape(out_shape)
+
+
 cdef public void cython_initialize(char* dev_mode, char* log_lvl):
     """Initialize the Cython Python environment
     """
@@ -476,22 +651,22 @@ cdef object msg_envelope_to_python(msg_envelope_t* msg):
         msgbus_msg_envelope_serialize_destroy(parts, num_parts)
 
 
-cdef public UdfRetCode call_udf(
-        object udf, object frame, PyObject*& output, msg_envelope_t* meta) except * with gil:
-    """Call UDF
+cdef UdfRetCode apply_udf_result(
+        object pret, PyObject** output, msg_envelope_t* meta,
+        object py_meta_cpy) except *:
+    """Verify the tuple returned by a UDF for a single frame and apply the
+    updated meta-data to the frame's message envelope.
+
+    :param pret: (drop, updated_frame, new_meta) tuple returned by the UDF
+    :param output: Set to a new reference to the updated frame (if any)
+    :param meta: Message envelope of the frame
+    :param py_meta_cpy: Meta-data which was given to the UDF
+    :return: UDF return code
     """
     cdef msgbus_ret_t ret = MSG_SUCCESS
     cdef msg_envelope_elem_body_t* body
     cdef UdfRetCode ret_code = UDF_OK
 
-    # Convert current meta-data to Python dictionary
-    py_meta = msg_envelope_to_python(meta)
-
-    # Create copy for later
-    py_meta_cpy = dict(py_meta)
-
-    pret = udf.process(frame, py_meta)
-
     # Verify UDF return value
     assert pret is not None, 'UDF return NoneType, must return tuple'
     assert isinstance(pret, (list, tuple,)), f'UDF returned {type(ret)}, must be tuple'
@@ -511,11 +686,11 @@ cdef public UdfRetCode call_udf(
     if updated_frame is not None:
         if isinstance(updated_frame, np.ndarray):
             Py_INCREF(updated_frame)
-            (&output)[0] = <PyObject*> updated_frame
+            output[0] = <PyObject*> updated_frame
             ret_code = UDF_FRAME_MODIFIED
         elif isinstance(updated_frame, list):
             Py_INCREF(updated_frame)
-            (&output)[0] = <PyObject*> updated_frame
+            output[0] = <PyObject*> updated_frame
             ret_code = UDF_FRAME_MODIFIED
 
     if new_meta is not None:
@@ -543,3 +718,43 @@ cdef public UdfRetCode call_udf(
                 body = NULL
 
     return ret_code
+
+
+cdef public UdfRetCode call_udf(
+        object udf, object frame, PyObject*& output, msg_envelope_t* meta) except * with gil:
+    """Call UDF
+    """
+    # Convert current meta-data to Python dictionary
+    py_meta = msg_envelope_to_python(meta)
+
+    # Create copy for later
+    py_meta_cpy = dict(py_meta)
+
+    pret = udf.process(frame, py_meta)
+
+    return apply_udf_result(pret, &output, meta, py_meta_cpy)
+
+
+cdef public void call_udf_batch(
+        object udf, object frames, msg_envelope_t** metas, UdfRetCode* rets,
+        PyObject** outputs, int num_frames) except * with gil:
+    """Call the process_batch() method of a UDF, which receives a list of
+    frames and a list of meta-data dictionaries and must return a list with
+    one (drop, updated_frame, new_meta) tuple per frame.
+    """
+    py_metas = [msg_envelope_to_python(metas[i]) for i in range(num_frames)]
+
+    # Create copies for later
+    py_meta_cpys = [dict(m) for m in py_metas]
+
+    prets = udf.process_batch(frames, py_metas)
+
+    # Verify UDF return value
+    assert isinstance(prets, (list, tuple,)), \
+        f'UDF returned {type(prets)}, must be list'
+    assert len(prets) == num_frames, \
+        f'UDF returned {len(prets)} results for {num_frames} frames'
+
+    for i in range(num_frames):
+        rets[i] = apply_udf_result(
+            prets[i], &outputs[i], metas[i], py_meta_cpys[i])
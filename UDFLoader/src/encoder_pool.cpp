@@ -0,0 +1,81 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Implementation of @c EncoderPool class
+ */
+
+#include <algorithm>
+#include <eii/utils/logger.h>
+
+#include "eii/udf/encoder_pool.h"
+
+// Upper bound for the default number of shared encoder workers
+#define MAX_DEFAULT_WORKERS 8
+
+// Number of queued jobs allowed per worker in the shared pool
+#define QUEUED_PER_WORKER 4
+
+using namespace eii::udf;
+
+// Globals for the shared encoder pool
+static std::mutex g_instance_mtx;
+static EncoderPool* g_instance = NULL;
+static int g_default_workers = -1;
+
+EncoderPool::EncoderPool(
+        int num_workers, int max_queued, ThreadPlacement* placement,
+        const std::string& name) :
+    WorkerPool(num_workers, max_queued, placement, name)
+{}
+
+EncoderPool* EncoderPool::get_instance() {
+    std::lock_guard<std::mutex> lk(g_instance_mtx);
+    if (g_instance == NULL) {
+        int num_workers = g_default_workers;
+        if (num_workers < 0) {
+            num_workers = std::min(
+                    (int) std::thread::hardware_concurrency(),
+                    MAX_DEFAULT_WORKERS);
+        }
+        if (num_workers <= 0) {
+            return NULL;
+        }
+
+        LOG_DEBUG("Initializing shared encoder pool with %d workers",
+                  num_workers);
+
+        // Intentionally never deleted, frames may be serialized up until
+        // the process exits
+        g_instance = new EncoderPool(
+                num_workers, num_workers * QUEUED_PER_WORKER);
+    }
+    return g_instance;
+}
+
+void EncoderPool::set_default_workers(int num_workers) {
+    std::lock_guard<std::mutex> lk(g_instance_mtx);
+    if (g_instance != NULL) {
+        LOG_WARN_0("Shared encoder pool already initialized, ignoring "
+                   "new number of workers");
+        return;
+    }
+    g_default_workers = num_workers;
+}
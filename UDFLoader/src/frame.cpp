@@ -22,32 +22,71 @@
  * @brief Implementation of @c Frame class
  */
 
+#include <chrono>
+#include <cstring>
 #include <sstream>
 #include <random>
 #include <vector>
+#include <future>
+#include <memory>
+#include <exception>
 #include <opencv2/opencv.hpp>
+#include <lz4.h>
+#include <lz4hc.h>
+#include <zstd.h>
 #include <safe_lib.h>
+#include <eii/msgbus/hashmap.h>
 #include <eii/utils/logger.h>
 
 #include "eii/udf/frame.h"
+#include "eii/udf/frame_buffer_pool.h"
+#include "eii/udf/encoder_pool.h"
 
 #define UUID_LENGTH 5
 
+// Meta-data keys of frames published through a shared memory ring
+#define SHM_RING_KEY    "shm_ring"
+#define SHM_RING_ID_KEY "shm_ring_id"
+
+// Meta-data keys of multi-frame objects serialized with the packed layout
+#define PACKED_OFFSETS_KEY "packed_offsets"
+#define PACKED_LENGTHS_KEY "packed_lengths"
+
+// Alignment (in bytes) of every frame in a packed blob
+#define PACKED_ALIGNMENT 64
+
 using namespace eii::udf;
 
 // Prototyes
 static void free_decoded(void* varg);
-static void free_encoded(void* varg);
 static void free_msg_env_blob(void* varg);
 static void free_frame_data(void* varg);
 static void free_frame_data_final(void* varg);
+static void free_nothing(void* varg);
 static cv::Mat* decode_frame(
-        EncodeType encode_type, uchar* encoded_data, size_t len);
+        EncodeType encode_type, uchar* encoded_data, size_t len,
+        FrameMetaData* meta);
+static cv::Mat* decompress_frame(
+        EncodeType encode_type, uchar* encoded_data, size_t len,
+        FrameMetaData* meta);
 static void add_frame_meta_env(msg_envelope_t* env, FrameMetaData* meta);
 static void add_frame_meta_obj(
         msg_envelope_elem_body_t* obj, FrameMetaData* meta);
 static EncodeType str_to_encode_type(const char* value);
+static const char* encode_type_to_str(EncodeType encode_type);
+static PixelFormat str_to_pixel_format(const char* value);
+static const char* pixel_format_to_str(PixelFormat pixel_format);
 static std::string generate_image_handle(int len);
+static msg_envelope_t* copy_meta_data(msg_envelope_t* env);
+static msg_envelope_elem_body_t* copy_meta_elem(
+        msg_envelope_elem_body_t* elem);
+static void get_meta_members(
+        hashmap_t* map,
+        std::vector<std::pair<const char*, msg_envelope_elem_body_t*>>& out);
+static msg_envelope_elem_body_t* pin_shm_frame(
+        std::shared_ptr<ShmRing> ring, const ShmFrameDescriptor* desc);
+static void free_shm_pin(void* varg);
+static int64_t now_ns();
 
 // Simple struct for use with free_frame_data_final()
 class FinalFreeWrapper {
@@ -58,6 +97,10 @@ private:
     // Reference to the final piece of frame data which needs to be deleted.
     FrameData* m_frame_data;
 
+    // Buffer which needs to be freed (if not NULL)
+    void* m_buffer;
+    void (*m_free_buffer)(void*);
+
     /**
      * Private @c FinalFreeWrapper copy constructor.
      */
@@ -69,16 +112,68 @@ private:
     FinalFreeWrapper& operator=(const FinalFreeWrapper& src);
 
 public:
-    FinalFreeWrapper(Frame* frame, FrameData* fd) :
-        m_frame(frame), m_frame_data(fd)
+    FinalFreeWrapper(Frame* frame, FrameData* fd, void* buffer=NULL,
+                     void (*free_buffer)(void*)=free) :
+        m_frame(frame), m_frame_data(fd), m_buffer(buffer),
+        m_free_buffer(free_buffer)
     {};
 
     ~FinalFreeWrapper() {
         delete m_frame_data;
         delete m_frame;
+        if (m_buffer != NULL) {
+            m_free_buffer(m_buffer);
+        }
+    };
+
+    /**
+     * Stop the wrapper from deleting the frame object, e.g. if the blob
+     * holding the wrapper could not be handed to the message envelope and
+     * the frame stays owned by the caller.
+     */
+    void release_frame() {
+        m_frame = NULL;
+    };
+};
+
+// Pin of a subscriber on a slot of a shared memory ring, for use with
+// free_shm_pin()
+class ShmPin {
+private:
+    // Ring holding the frame, kept mapped while the frame is in use
+    std::shared_ptr<ShmRing> m_ring;
+
+    // Pinned slot
+    uint32_t m_slot;
+
+    /**
+     * Private @c ShmPin copy constructor.
+     */
+    ShmPin(const ShmPin& src);
+
+    /**
+     * Private @c ShmPin assignment operator.
+     */
+    ShmPin& operator=(const ShmPin& src);
+
+public:
+    ShmPin(std::shared_ptr<ShmRing> ring, uint32_t slot) :
+        m_ring(ring), m_slot(slot)
+    {};
+
+    ~ShmPin() {
+        m_ring->unpin(m_slot);
     };
 };
 
+ShmPin::ShmPin(const ShmPin& src) {
+    throw "This object should not be copied";
+}
+
+ShmPin& ShmPin::operator=(const ShmPin& src) {
+    return *this;
+}
+
 FinalFreeWrapper::FinalFreeWrapper(const FinalFreeWrapper& src) {
     throw "This object should not be copied";
 }
@@ -92,14 +187,17 @@ FinalFreeWrapper& FinalFreeWrapper::operator=(const FinalFreeWrapper& src) {
  * encoding type.
  */
 static bool verify_encoding_level(EncodeType encode_type, int encode_level);
+static bool verify_encoding_format(
+        EncodeType encode_type, PixelFormat pixel_format);
 
 
 Frame::Frame(
         void* frame, void (*free_frame)(void*), void* data,
         int width, int height, int channels, EncodeType encode_type,
-        int encode_level) :
+        int encode_level, size_t stride, PixelFormat pixel_format) :
     Serializable(NULL), m_meta_data(NULL), m_additional_frames_arr(NULL),
-    m_serialized(false)
+    m_serialized(false), m_packed(false), m_encoded(false), m_sequence(0),
+    m_timestamp(now_ns())
 {
     if(free_frame == NULL) {
         throw "The free_frame() method cannot be NULL";
@@ -113,27 +211,30 @@ Frame::Frame(
 
     // TODO(kmidkiff): Image handle????
     FrameMetaData* meta = new FrameMetaData(
-            img_handle, width, height, channels, encode_type, encode_level);
-    FrameData* fd = new FrameData(frame, free_frame, data, meta);
-    this->m_frames.push_back(fd);
-
+            img_handle, width, height, channels, encode_type, encode_level,
+            pixel_format);
+    FrameData* fd = NULL;
     try {
-        m_meta_data = msgbus_msg_envelope_new(CT_JSON);
-        if(m_meta_data == NULL) {
-            throw "Failed to initialize meta data envelope";
-        }
-        add_frame_meta_env(m_meta_data, meta);
+        fd = new FrameData(frame, free_frame, data, meta, stride);
     } catch (const char* ex) {
+        delete meta;
+        throw ex;
+    }
+    this->m_frames.push_back(fd);
+
+    // NOTE: The frame's meta-data is written to the envelope in serialize()
+    m_meta_data = msgbus_msg_envelope_new(CT_JSON);
+    if(m_meta_data == NULL) {
         // Free allocated memory in error case
         delete fd;
-        msgbus_msg_envelope_destroy(m_meta_data);
-        throw ex;
+        throw "Failed to initialize meta data envelope";
     }
 }
 
 Frame::Frame() :
     Serializable(NULL), m_meta_data(NULL), m_additional_frames_arr(NULL),
-    m_serialized(false)
+    m_serialized(false), m_packed(false), m_encoded(false), m_sequence(0),
+    m_timestamp(now_ns())
 {
     m_meta_data = msgbus_msg_envelope_new(CT_JSON);
     if(m_meta_data == NULL) {
@@ -143,6 +244,23 @@ Frame::Frame() :
 
 #define MSG_TYPE_STR(value) #value
 
+// Helper defines to remove frame meta data from the root meta-data message
+// envelope or from the additional_frames meta-data array object.
+#define REMOVE_META(env, key) { \
+    ret = msgbus_msg_envelope_remove(env, key); \
+    if (ret != MSG_SUCCESS && ret != MSG_ERR_ELEM_NOT_EXIST) { \
+        LOG_ERROR("[%d] Failed to remove meta data: %s", ret,  key); \
+        throw "Failed to remove old meta-data key from envelope"; \
+    } \
+}
+#define REMOVE_META_OBJ(obj, key) { \
+    ret = msgbus_msg_envelope_elem_object_remove(obj, key); \
+    if (ret != MSG_SUCCESS && ret != MSG_ERR_ELEM_NOT_EXIST) { \
+        LOG_ERROR("[%d] Failed to remove meta data: %s", ret,  key); \
+        throw "Failed to remove old meta-data key from object"; \
+    } \
+}
+
 void get_meta_from_env(
         msg_envelope_t* env, const char* key,
         msg_envelope_elem_body_t** dest, msg_envelope_data_type_t expected) {
@@ -173,7 +291,8 @@ void get_meta_from_obj(
 
 Frame::Frame(msg_envelope_t* msg) :
     Serializable(NULL), m_meta_data(NULL), m_additional_frames_arr(NULL),
-    m_serialized(false)
+    m_serialized(false), m_packed(false), m_encoded(false), m_sequence(0),
+    m_timestamp(now_ns())
 {
     // TODO(kmidkiff): VERIFY IT IS CT_JSON
 
@@ -185,8 +304,18 @@ Frame::Frame(msg_envelope_t* msg) :
     msg_envelope_elem_body_t* enc_type = NULL;
     msg_envelope_elem_body_t* enc_lvl = NULL;
     msg_envelope_elem_body_t* img_handle = NULL;
+    msg_envelope_elem_body_t* pix_fmt = NULL;
     msg_envelope_elem_body_t* obj = NULL;
+    msg_envelope_elem_body_t* shm_ring = NULL;
+    msg_envelope_elem_body_t* shm_ring_id = NULL;
     EncodeType encode_type = EncodeType::NONE;
+    std::shared_ptr<ShmRing> ring;
+    const ShmFrameDescriptor* descs = NULL;
+    msg_envelope_elem_body_t* offsets = NULL;
+    msg_envelope_elem_body_t* lengths = NULL;
+    std::shared_ptr<void> packed;
+    std::vector<int64_t> packed_offsets;
+    std::vector<int64_t> packed_lengths;
 
     ret = msgbus_msg_envelope_get(msg, NULL, &blob);
     if(ret != MSG_SUCCESS) {
@@ -208,12 +337,112 @@ Frame::Frame(msg_envelope_t* msg) :
                 MSG_ENV_DT_ARRAY);
     }
 
+    // Frames published through a shared memory ring only carry a blob of
+    // descriptors for the slots holding their pixels
+    msgbus_msg_envelope_get(msg, SHM_RING_KEY, &shm_ring);
+    if (shm_ring != NULL) {
+        if (shm_ring->type != MSG_ENV_DT_STRING) {
+            throw "Shared memory ring name must be a string";
+        }
+        get_meta_from_env(
+                msg, SHM_RING_ID_KEY, &shm_ring_id, MSG_ENV_DT_INT);
+        if (blob->type != MSG_ENV_DT_BLOB || blob->body.blob->len == 0 ||
+                blob->body.blob->len % sizeof(ShmFrameDescriptor) != 0) {
+            throw "Invalid shared memory frame descriptors";
+        }
+
+        // NOTE: Function call throws exceptions
+        ring = ShmRing::open(
+                std::string(shm_ring->body.string),
+                (uint64_t) shm_ring_id->body.integer);
+
+        // The descriptors are only valid for this message, they must not be
+        // re-published with the frame
+        REMOVE_META(msg, SHM_RING_KEY);
+        REMOVE_META(msg, SHM_RING_ID_KEY);
+
+        descs = (const ShmFrameDescriptor*) blob->body.blob->data;
+        num_frames = (int) (blob->body.blob->len / sizeof(ShmFrameDescriptor));
+        if (num_frames > 1) {
+            get_meta_from_env(
+                    msg, "additional_frames", &m_additional_frames_arr,
+                    MSG_ENV_DT_ARRAY);
+        }
+    }
+
+    // Frames serialized with the packed layout are all in a single blob, the
+    // offset table in the meta-data gives the slice of each frame
+    msgbus_msg_envelope_get(msg, PACKED_OFFSETS_KEY, &offsets);
+    if (offsets != NULL) {
+        get_meta_from_env(
+                msg, PACKED_LENGTHS_KEY, &lengths, MSG_ENV_DT_ARRAY);
+        if (offsets->type != MSG_ENV_DT_ARRAY ||
+                blob->type != MSG_ENV_DT_BLOB || ring != nullptr) {
+            throw "Invalid packed frame layout";
+        }
+
+        num_frames = (int) offsets->body.array->len;
+        if (num_frames == 0 || num_frames != (int) lengths->body.array->len) {
+            throw "Packed frame offsets and lengths do not match";
+        }
+
+        for (int i = 0; i < num_frames; i++) {
+            msg_envelope_elem_body_t* offset =
+                msgbus_msg_envelope_elem_array_get_at(offsets, i);
+            msg_envelope_elem_body_t* length =
+                msgbus_msg_envelope_elem_array_get_at(lengths, i);
+            if (offset == NULL || length == NULL ||
+                    offset->type != MSG_ENV_DT_INT ||
+                    length->type != MSG_ENV_DT_INT) {
+                throw "Packed frame offsets and lengths must be integers";
+            }
+            if (offset->body.integer < 0 || length->body.integer < 0 ||
+                    (uint64_t) (offset->body.integer + length->body.integer) >
+                    blob->body.blob->len) {
+                throw "Packed frame is out of the bounds of the blob";
+            }
+            packed_offsets.push_back(offset->body.integer);
+            packed_lengths.push_back(length->body.integer);
+        }
+
+        // The offsets are only valid for this message
+        REMOVE_META(msg, PACKED_OFFSETS_KEY);
+        REMOVE_META(msg, PACKED_LENGTHS_KEY);
+
+        if (num_frames > 1) {
+            get_meta_from_env(
+                    msg, "additional_frames", &m_additional_frames_arr,
+                    MSG_ENV_DT_ARRAY);
+        }
+
+        // All frames reference the single blob, which is freed once the
+        // last of them is freed
+        packed = std::shared_ptr<void>((void*) blob, free_msg_env_blob);
+    }
+
     for (int i = 0; i < num_frames; i++) {
         msg_envelope_elem_body_t* frame = NULL;
         // Manually create a new blob
         msg_envelope_elem_body_t* elem = NULL;
         msg_envelope_blob_t* b = NULL;
-        if (blob->type == MSG_ENV_DT_ARRAY) {
+        if (ring != nullptr) {
+            // Map the pixels from the shared memory ring, the slot stays
+            // pinned until the frame's data is freed
+            try {
+                elem = pin_shm_frame(ring, &descs[i]);
+            } catch (const char* ex) {
+                for (auto fd : m_frames) {
+                    delete fd;
+                }
+                m_frames.clear();
+
+                // Hand the descriptors back to the envelope, so that the
+                // caller can still destroy it
+                msg->blob = blob;
+                throw ex;
+            }
+            frame = elem;
+        } else if (blob->type == MSG_ENV_DT_ARRAY) {
             LOG_DEBUG("GETTING FRAME BLOB: %d", i);
             frame = msgbus_msg_envelope_elem_array_get_at(blob, i);
             if (frame == NULL) {
@@ -254,10 +483,11 @@ Frame::Frame(msg_envelope_t* msg) :
             get_meta_from_env(msg, "height", &height, MSG_ENV_DT_INT);
             get_meta_from_env(msg, "channels", &channels, MSG_ENV_DT_INT);
 
-            // The following three meta-data items can be missing
+            // The following four meta-data items can be missing
             msgbus_msg_envelope_get(msg, "img_handle", &img_handle);
             msgbus_msg_envelope_get(msg, "encoding_type", &enc_type);
             msgbus_msg_envelope_get(msg, "encoding_level", &enc_lvl);
+            msgbus_msg_envelope_get(msg, "pixel_format", &pix_fmt);
         } else {
             obj = msgbus_msg_envelope_elem_array_get_at(
                     m_additional_frames_arr, i - 1);
@@ -275,13 +505,15 @@ Frame::Frame(msg_envelope_t* msg) :
             get_meta_from_obj(obj, "height", &height, MSG_ENV_DT_INT);
             get_meta_from_obj(obj, "channels", &channels, MSG_ENV_DT_INT);
 
-            // The following three meta-data items can be missing
+            // The following four meta-data items can be missing
             img_handle = msgbus_msg_envelope_elem_object_get(
                     obj, "img_handle");
             enc_type = msgbus_msg_envelope_elem_object_get(
                     obj, "encoding_type");
             enc_lvl = msgbus_msg_envelope_elem_object_get(
                     obj, "encoding_level");
+            pix_fmt = msgbus_msg_envelope_elem_object_get(
+                    obj, "pixel_format");
         }
 
         std::string img_handle_str = "";
@@ -294,6 +526,19 @@ Frame::Frame(msg_envelope_t* msg) :
             img_handle_str = std::string(img_handle->body.string);
         }
 
+        // Frames without a pixel format are 8-bit interleaved pixels
+        PixelFormat pixel_format = PixelFormat::U8;
+        if (pix_fmt != NULL) {
+            if (pix_fmt->type != MSG_ENV_DT_STRING) {
+                free(b);
+                msgbus_msg_envelope_elem_destroy(elem);
+                throw "Pixel format must be a string";
+            }
+
+            // Parse pixel format (NOTE: Function call throws exceptions)
+            pixel_format = str_to_pixel_format(pix_fmt->body.string);
+        }
+
         if (enc_type != NULL) {
             if(enc_type->type != MSG_ENV_DT_STRING) {
                 free(b);
@@ -312,34 +557,48 @@ Frame::Frame(msg_envelope_t* msg) :
             // Parse encoding type (NOTE: Function call throws exceptions)
             encode_type = str_to_encode_type(enc_type->body.string);
 
-            // Construct vector of bytes to pass to cv::imdecode
-            uchar* buf = (uchar*) frame->body.blob->data;
-            size_t len = (size_t) frame->body.blob->len;
-            cv::Mat* decoded = decode_frame(encode_type, buf, len);
-
-            // TODO(kmidkiff): Should check that the metadata is correct
-            // with what was decoded
+            // The frame is kept encoded until its data is accessed, the
+            // FrameData takes ownership of the blob
             FrameMetaData* meta = new FrameMetaData(
                     img_handle_str,
                     width->body.integer, height->body.integer,
                     channels->body.integer, encode_type,
-                    enc_lvl->body.integer);
-            FrameData* fd = new FrameData(
-                    (void*) decoded, free_decoded,
-                    (void*) decoded->data, meta);
+                    enc_lvl->body.integer, pixel_format);
+            meta->set_dirty(false);
+            FrameData* fd = NULL;
+            if (packed != nullptr) {
+                fd = new FrameData(
+                        packed, (void*) (blob->body.blob->data +
+                            packed_offsets[i]),
+                        (size_t) packed_lengths[i], meta);
+            } else {
+                fd = new FrameData(frame, meta);
+            }
             m_frames.push_back(fd);
-
-            msgbus_msg_envelope_elem_destroy(frame);
         } else {
             // TODO(kmidkiff): This could modify meta-data if enc level was
             // still specified (but this would be incorrect data...)
             FrameMetaData* meta = new FrameMetaData(
                     img_handle_str,
                     width->body.integer, height->body.integer,
-                    channels->body.integer, EncodeType::NONE, 0);
-            FrameData* fd = new FrameData(
-                    (void*) frame, free_msg_env_blob,
-                    (void*) frame->body.blob->data, meta);
+                    channels->body.integer, EncodeType::NONE, 0,
+                    pixel_format);
+            meta->set_dirty(false);
+            FrameData* fd = NULL;
+            if (packed != nullptr) {
+                fd = new FrameData(
+                        packed, (void*) (blob->body.blob->data +
+                            packed_offsets[i]),
+                        (size_t) packed_lengths[i], meta);
+            } else {
+                fd = new FrameData(
+                        (void*) frame, free_msg_env_blob,
+                        (void*) frame->body.blob->data, meta);
+            }
+            if (ring != nullptr) {
+                // The pixels are shared with the other subscribers
+                fd->set_readonly();
+            }
             m_frames.push_back(fd);
         }
 
@@ -348,11 +607,12 @@ Frame::Frame(msg_envelope_t* msg) :
         channels = NULL;
         enc_type = NULL;
         enc_lvl = NULL;
+        pix_fmt = NULL;
         frame = NULL;
     }
 
-    if (blob->type == MSG_ENV_DT_ARRAY) {
-        // Destroy the empty blob array
+    if (blob->type == MSG_ENV_DT_ARRAY || ring != nullptr) {
+        // Destroy the empty blob array (or the shared memory descriptors)
         msgbus_msg_envelope_elem_destroy(blob);
     }
 
@@ -409,6 +669,34 @@ int Frame::get_channels(int index) {
     return m_frames[index]->get_meta_data()->get_channels();
 }
 
+PixelFormat Frame::get_pixel_format(int index) {
+    if (index < 0 || index >= (int) m_frames.size()) {
+        throw "Index out of range";
+    }
+    return m_frames[index]->get_meta_data()->get_pixel_format();
+}
+
+int Frame::get_rows(int index) {
+    if (index < 0 || index >= (int) m_frames.size()) {
+        throw "Index out of range";
+    }
+    return m_frames[index]->get_meta_data()->get_rows();
+}
+
+int Frame::get_cv_type(int index) {
+    if (index < 0 || index >= (int) m_frames.size()) {
+        throw "Index out of range";
+    }
+    return m_frames[index]->get_meta_data()->get_cv_type();
+}
+
+size_t Frame::get_stride(int index) {
+    if (index < 0 || index >= (int) m_frames.size()) {
+        throw "Index out of range";
+    }
+    return m_frames[index]->get_stride();
+}
+
 EncodeType Frame::get_encode_type(int index) {
     if (index > (int) m_frames.size()) {
         throw "Index out of range";
@@ -429,12 +717,120 @@ void* Frame::get_data(int index) {
                 "Writable data method called after frame serialization");
         return NULL;
     }
+    if(m_encoded) {
+        LOG_ERROR_0("Writable data method called after frame encoding");
+        return NULL;
+    }
     if (index > (int) m_frames.size()) {
         throw "Index out of range";
     }
     return m_frames[index]->get_data();
 }
 
+const void* Frame::get_readonly_data(int index) {
+    if(m_serialized.load()) {
+        LOG_ERROR_0("Data method called after frame serialization");
+        return NULL;
+    }
+    if(m_encoded) {
+        LOG_ERROR_0("Data method called after frame encoding");
+        return NULL;
+    }
+    if (index < 0 || index >= (int) m_frames.size()) {
+        throw "Index out of range";
+    }
+    return m_frames[index]->get_readonly_data();
+}
+
+bool Frame::is_modified(int index) {
+    if (index < 0 || index >= (int) m_frames.size()) {
+        throw "Index out of range";
+    }
+    return m_frames[index]->is_modified();
+}
+
+bool Frame::is_decoded(int index) {
+    if (index < 0 || index >= (int) m_frames.size()) {
+        throw "Index out of range";
+    }
+    return m_frames[index]->is_decoded();
+}
+
+bool Frame::is_shared(int index) {
+    if (index < 0 || index >= (int) m_frames.size()) {
+        throw "Index out of range";
+    }
+    return m_frames[index]->is_shared();
+}
+
+Frame* Frame::share() {
+    if (m_serialized.load()) {
+        LOG_ERROR_0("Cannot share frame after serialization");
+        throw "Cannot share frame after serialization";
+    }
+
+    // Copy the meta-data first, so that nothing has to be cleaned up if it
+    // fails
+    msg_envelope_t* meta_data = copy_meta_data(m_meta_data);
+
+    Frame* frame = NULL;
+    try {
+        frame = new Frame();
+    } catch (const char* ex) {
+        msgbus_msg_envelope_destroy(meta_data);
+        throw ex;
+    }
+    msgbus_msg_envelope_destroy(frame->m_meta_data);
+    frame->m_meta_data = meta_data;
+    frame->m_timestamp = m_timestamp;
+
+    // The shared frames reference the already encoded bytes
+    frame->m_encoded = m_encoded;
+
+    try {
+        if (m_additional_frames_arr != NULL) {
+            get_meta_from_env(
+                    meta_data, "additional_frames",
+                    &frame->m_additional_frames_arr, MSG_ENV_DT_ARRAY);
+        }
+
+        // Share the underlying frames, the pixels are only copied once one
+        // of the frames writes to them
+        for (int i = 0; i < this->get_number_of_frames(); i++) {
+            frame->m_frames.push_back(this->m_frames[i]->share());
+        }
+    } catch (const char* ex) {
+        delete frame;
+        throw ex;
+    }
+
+    return frame;
+}
+
+void Frame::merge_meta_data(Frame* other) {
+    if (m_serialized.load() || other->m_serialized.load()) {
+        LOG_ERROR_0("Cannot merge meta-data after serialization");
+        throw "Cannot merge meta-data after serialization";
+    }
+
+    std::vector<std::pair<const char*, msg_envelope_elem_body_t*>> members;
+    get_meta_members(other->m_meta_data->map, members);
+
+    for (auto& m : members) {
+        msg_envelope_elem_body_t* existing = NULL;
+        if (msgbus_msg_envelope_get(m_meta_data, m.first, &existing) ==
+                MSG_SUCCESS) {
+            continue;
+        }
+        msg_envelope_elem_body_t* copy = copy_meta_elem(m.second);
+        if (msgbus_msg_envelope_put(m_meta_data, m.first, copy) !=
+                MSG_SUCCESS) {
+            msgbus_msg_envelope_elem_destroy(copy);
+            throw "Failed to merge frame meta-data";
+        }
+    }
+}
+
 int Frame::get_number_of_frames() {
     return (int) m_frames.size();
 }
@@ -442,101 +838,36 @@ int Frame::get_number_of_frames() {
 void Frame::add_frame(
         void* frame, void (*free_frame)(void*), void* data,
         int width, int height, int channels, EncodeType encode_type,
-        int encode_level) {
-    msgbus_ret_t ret = MSG_SUCCESS;
-    msg_envelope_elem_body_t* obj = NULL;
+        int encode_level, size_t stride, PixelFormat pixel_format) {
+    if (m_serialized.load()) {
+        LOG_ERROR_0("Cannot add frame after serialization");
+        throw "Cannot add frame after serialization";
+    }
+    if (m_encoded) {
+        throw "Cannot add frame after encoding";
+    }
+
+    // NOTE: The frame's meta-data is written to the envelope in serialize()
     std::string img_handle = generate_image_handle(UUID_LENGTH);
     FrameMetaData* meta = new FrameMetaData(
-            img_handle, width, height, channels, encode_type, encode_level);
+            img_handle, width, height, channels, encode_type, encode_level,
+            pixel_format);
 
+    FrameData* fd = NULL;
     try {
-        if (this->get_number_of_frames() == 0) {
-            // Adding the first frame to the frame object
-            add_frame_meta_env(m_meta_data, meta);
-        } else {
-            msg_envelope_elem_body_t* obj = msgbus_msg_envelope_new_object();
-            if (obj == NULL) {
-                delete meta;
-                throw "Failed to initialize message envelope object";
-            }
-            add_frame_meta_obj(obj, meta);
-
-            if (m_additional_frames_arr == NULL) {
-                // Need to create the additional array
-                m_additional_frames_arr = msgbus_msg_envelope_new_array();
-                if (m_additional_frames_arr == NULL) {
-                    delete meta;
-                    throw "Failed to initialize additional_frames array";
-                }
-
-                // Add here so that the meta-data is not changed if adding the
-                // object to the array fails
-                ret = msgbus_msg_envelope_elem_array_add(
-                        m_additional_frames_arr, obj);
-                if (ret != MSG_SUCCESS) {
-                    msgbus_msg_envelope_elem_destroy(m_additional_frames_arr);
-                    m_additional_frames_arr = NULL;
-                    delete meta;
-                    throw "Failed to add meta object to array";
-                }
-
-                ret = msgbus_msg_envelope_put(
-                        m_meta_data, "additional_frames",
-                        m_additional_frames_arr);
-                if (ret != MSG_SUCCESS) {
-                    msgbus_msg_envelope_elem_destroy(m_additional_frames_arr);
-                    m_additional_frames_arr = NULL;
-                    delete meta;
-                    throw "Failed to add additional frames array to meta-data";
-                }
-            } else {
-                // No free needed for the array, because it previously existed
-                // in the meta data envelope, if this fails, no changes will
-                // have occurred to the underlying meta-data
-                ret = msgbus_msg_envelope_elem_array_add(
-                        m_additional_frames_arr, obj);
-                if (ret != MSG_SUCCESS) {
-                    delete meta;
-                    throw "Failed to add meta object to array";
-                }
-            }
-        }
-
-        // Add the frame
-        FrameData* fd = new FrameData(frame, free_frame, data, meta);
-        this->m_frames.push_back(fd);
+        fd = new FrameData(frame, free_frame, data, meta, stride);
     } catch (const char* ex) {
         delete meta;
-        if (obj != NULL) {
-            msgbus_msg_envelope_elem_destroy(obj);
-        }
         throw ex;
     }
-}
-
-// Helper defines to remove frame meta data from the root meta-data message
-// envelope or from the additional_frames meta-data array object.
-#define REMOVE_META(env, key) { \
-    ret = msgbus_msg_envelope_remove(env, key); \
-    if (ret != MSG_SUCCESS && ret != MSG_ERR_ELEM_NOT_EXIST) { \
-        LOG_ERROR("[%d] Failed to remove meta data: %s", ret,  key); \
-        throw "Failed to remove old meta-data key from envelope"; \
-    } \
-}
-#define REMOVE_META_OBJ(obj, key) { \
-    ret = msgbus_msg_envelope_elem_object_remove(obj, key); \
-    if (ret != MSG_SUCCESS && ret != MSG_ERR_ELEM_NOT_EXIST) { \
-        LOG_ERROR("[%d] Failed to remove meta data: %s", ret,  key); \
-        throw "Failed to remove old meta-data key from object"; \
-    } \
+    this->m_frames.push_back(fd);
 }
 
 void Frame::set_data(
         int index, void* frame, void (*free_frame)(void*), void* data,
-        int width, int height, int channels)
+        int width, int height, int channels, size_t stride,
+        PixelFormat pixel_format)
 {
-    msgbus_ret_t ret = MSG_SUCCESS;
-
     if (index > this->get_number_of_frames() - 1) {
         throw "Index out-of-range";
     }
@@ -545,160 +876,202 @@ void Frame::set_data(
         LOG_ERROR_0("Cannot set data after serialization");
         throw "Cannot set data after serialization";
     }
-
+    if (m_encoded) {
+        throw "Cannot set data after encoding";
+    }
 
     // Replace the old frame data in m_frames and delete the old frame data
     FrameData* old_fd = this->m_frames[index];
     FrameMetaData* old_meta = old_fd->get_meta_data();
 
-    // Constructing the new FrameData
+    // Constructing the new FrameData, the new meta-data is written to the
+    // envelope in serialize()
     FrameMetaData* new_meta = new FrameMetaData(
             old_meta->get_img_handle(),
             width, height, channels,
             old_meta->get_encode_type(),
-            old_meta->get_encode_level());
-    FrameData* new_fd = new FrameData(frame, free_frame, data, new_meta);
+            old_meta->get_encode_level(),
+            pixel_format);
+    FrameData* new_fd = NULL;
+    try {
+        new_fd = new FrameData(frame, free_frame, data, new_meta, stride);
+    } catch (const char* ex) {
+        delete new_meta;
+        throw ex;
+    }
+    new_fd->set_modified();
 
     this->m_frames[index] = new_fd;
 
-    // Update the meta-data
-    // NOTE: An error here is somewhat irrecoverable
-    try {
-        if (index == 0) {
+    // Release old data
+    delete old_fd;
+}
 
-            // Remove old values
-            REMOVE_META(m_meta_data, "img_handle");
-            REMOVE_META(m_meta_data, "width");
-            REMOVE_META(m_meta_data, "height");
-            REMOVE_META(m_meta_data, "channels");
-            REMOVE_META(m_meta_data, "encoding_type");
-            REMOVE_META(m_meta_data, "encoding_level");
+void Frame::set_encoding(EncodeType encode_type, int encode_level, int index) {
+    if(!verify_encoding_level(encode_type, encode_level)) {
+        throw "Invalid encoding level for the encoding type";
+    }
 
-            // Add the new meta-data values
-            add_frame_meta_env(m_meta_data, new_meta);
-        } else {
-            // Update meta-data in additional frames list
-            // NOTE: This is just a sanity check, THIS SHOULD NEVER HAPPEN
-            assert(m_additional_frames_arr != NULL);
-
-            // Construct new meta-data object
-            //
-            // NOTE: Getting index - 1, because index - is technically at the
-            // root level of the frame meta-data in the msg_envelope_t. In the
-            // additional frames meta-data, index "0" is technically "1".
-            msg_envelope_elem_body_t* obj =
-                msgbus_msg_envelope_elem_array_get_at(
-                    m_additional_frames_arr, index - 1);
-            if (obj == NULL) {
-                throw "Failed to get meta-data object";
-            }
-
-            // Remove old values
-            REMOVE_META_OBJ(obj, "img_handle");
-            REMOVE_META_OBJ(obj, "width");
-            REMOVE_META_OBJ(obj, "height");
-            REMOVE_META_OBJ(obj, "channels");
-            REMOVE_META_OBJ(obj, "encoding_type");
-            REMOVE_META_OBJ(obj, "encoding_level");
-
-            // Add the new meta-data values
-            add_frame_meta_obj(obj, new_meta);
-        }
-
-        // Release old data
-        delete old_fd;
-    } catch (const char* ex) {
-        delete old_fd;
-        throw ex;
+    if (index > this->get_number_of_frames() - 1) {
+        throw "Index out-of-range";
     }
-}
 
-void Frame::set_encoding(EncodeType encode_type, int encode_level, int index) {
-    msgbus_ret_t ret = MSG_SUCCESS;
-    msg_envelope_elem_body_t* obj = NULL;
+    if (m_encoded) {
+        throw "Cannot change the encoding after encoding";
+    }
 
-    if(!verify_encoding_level(encode_type, encode_level)) {
-        throw "Invalid encoding level for the encoding type";
+    FrameMetaData* meta = this->m_frames[index]->get_meta_data();
+    if (!verify_encoding_format(encode_type, meta->get_pixel_format())) {
+        throw "Encoding type does not support the frame's pixel format";
     }
 
-    if (index > this->get_number_of_frames() - 1) {
+    // Set encoding on the meta data, which is written to the envelope in
+    // serialize()
+    meta->set_encoding(encode_type, encode_level);
+}
+
+void Frame::convert_color(ColorConversion conversion, int index) {
+    if (index < 0 || index >= this->get_number_of_frames()) {
         throw "Index out-of-range";
     }
 
-    if (index != 0) {
-        obj = msgbus_msg_envelope_elem_array_get_at(
-                    m_additional_frames_arr, index);
-        if (obj == NULL) {
-            throw "Failed to get meta-data object for additional frame";
-        }
+    if (m_serialized.load()) {
+        LOG_ERROR_0("Cannot convert frame after serialization");
+        throw "Cannot convert frame after serialization";
+    }
+    if (m_encoded) {
+        throw "Cannot convert frame after encoding";
     }
 
     FrameMetaData* meta = this->m_frames[index]->get_meta_data();
+    PixelFormat pixel_format = meta->get_pixel_format();
+    switch(conversion) {
+        case ColorConversion::BGR2RGB:
+        case ColorConversion::RGB2BGR:
+        case ColorConversion::BGR2GRAY:
+        case ColorConversion::RGB2GRAY:
+            if (pixel_format != PixelFormat::U8) {
+                throw "Color conversion requires 8-bit pixels";
+            }
+            break;
+        case ColorConversion::NV12_2BGR:
+            if (pixel_format != PixelFormat::NV12) {
+                throw "Conversion requires an NV12 frame";
+            }
+            break;
+        case ColorConversion::I420_2BGR:
+            if (pixel_format != PixelFormat::I420) {
+                throw "Conversion requires an I420 frame";
+            }
+            break;
+        default:
+            throw "Layout conversions are not supported on frames";
+    }
 
-    if (meta->get_encode_type() != EncodeType::NONE) {
-        if (index == 0) {
-            REMOVE_META(m_meta_data, "encoding_type");
-            REMOVE_META(m_meta_data, "encoding_level");
-        } else {
-            REMOVE_META_OBJ(obj, "encoding_type");
-            REMOVE_META_OBJ(obj, "encoding_level");
-        }
+    int width = meta->get_width();
+    int height = meta->get_height();
+    int channels = meta->get_channels();
+    int out_channels = get_converted_channels(conversion, channels);
+    size_t out_stride = (size_t) width * out_channels;
+
+    FrameBufferPool* pool = FrameBufferPool::get_instance();
+    void* buffer = pool->acquire(out_stride * height);
+    if (buffer == NULL) {
+        throw "Failed to acquire buffer for the converted frame";
     }
 
-    // Set encoding on the meta data
-    meta->set_encoding(encode_type, encode_level);
+    try {
+        // NOTE: Reading the pixels does not copy them if they are shared
+        eii::udf::convert_color(
+                conversion, this->get_readonly_data(index),
+                this->get_stride(index), buffer, out_stride, width, height,
+                channels);
+        this->set_data(
+                index, buffer, FrameBufferPool::free_buffer, buffer, width,
+                height, out_channels, 0, PixelFormat::U8);
+    } catch (const char* ex) {
+        pool->release(buffer);
+        throw ex;
+    }
+}
 
-    if (encode_type != EncodeType::NONE) {
-        msg_envelope_elem_body_t* enc_type = NULL;
-        msg_envelope_elem_body_t* enc_level =
-            msgbus_msg_envelope_new_integer(encode_level);
-        if (enc_level == NULL) {
-            throw "Failed to intialize new envelope integer";
-        }
+void Frame::write_meta_data() {
+    msgbus_ret_t ret = MSG_SUCCESS;
 
-        if(encode_type == EncodeType::JPEG) {
-            enc_type = msgbus_msg_envelope_new_string("jpeg");
-        } else {
-            enc_type = msgbus_msg_envelope_new_string("png");
-        }
-        if(enc_type == NULL) {
-            msgbus_msg_envelope_elem_destroy(enc_level);
-            throw "Failed initialize encoding type meta-data";
+    for (int i = 0; i < this->get_number_of_frames(); i++) {
+        FrameMetaData* meta = this->m_frames[i]->get_meta_data();
+        if (!meta->is_dirty()) {
+            // Meta-data in the envelope is still up to date
+            continue;
         }
 
-        if (index == 0) {
-            ret = msgbus_msg_envelope_put(
-                    m_meta_data, "encoding_type", enc_type);
-            if (ret != MSG_SUCCESS) {
-                msgbus_msg_envelope_elem_destroy(enc_level);
-                msgbus_msg_envelope_elem_destroy(enc_type);
-                throw "Failed to put \"encoding_type\" in envelope";
-            }
+        if (i == 0) {
+            // Remove old values
+            REMOVE_META(m_meta_data, "img_handle");
+            REMOVE_META(m_meta_data, "width");
+            REMOVE_META(m_meta_data, "height");
+            REMOVE_META(m_meta_data, "channels");
+            REMOVE_META(m_meta_data, "encoding_type");
+            REMOVE_META(m_meta_data, "encoding_level");
+            REMOVE_META(m_meta_data, "pixel_format");
 
-            ret = msgbus_msg_envelope_put(
-                    m_meta_data, "encoding_level", enc_level);
-            if (ret != MSG_SUCCESS) {
-                msgbus_msg_envelope_elem_destroy(enc_level);
-                throw "Failed to put \"encoding_type\" in envelope";
-            }
+            // Add the new meta-data values
+            add_frame_meta_env(m_meta_data, meta);
         } else {
-            ret = msgbus_msg_envelope_elem_object_put(
-                    obj, "encoding_type", enc_type);
-            if (ret != MSG_SUCCESS) {
-                msgbus_msg_envelope_elem_destroy(enc_level);
-                msgbus_msg_envelope_elem_destroy(enc_type);
-                throw "Failed to put \"encoding_type\" in object";
+            if (m_additional_frames_arr == NULL) {
+                m_additional_frames_arr = msgbus_msg_envelope_new_array();
+                if (m_additional_frames_arr == NULL) {
+                    throw "Failed to initialize additional_frames array";
+                }
+
+                ret = msgbus_msg_envelope_put(
+                        m_meta_data, "additional_frames",
+                        m_additional_frames_arr);
+                if (ret != MSG_SUCCESS) {
+                    msgbus_msg_envelope_elem_destroy(m_additional_frames_arr);
+                    m_additional_frames_arr = NULL;
+                    throw "Failed to add additional frames array to meta-data";
+                }
             }
 
-            ret = msgbus_msg_envelope_elem_object_put(
-                    obj, "encoding_level", enc_level);
-            if (ret != MSG_SUCCESS) {
-                msgbus_msg_envelope_elem_destroy(enc_level);
-                throw "Failed to put \"encoding_type\" in object";
+            // NOTE: Getting index - 1, because index 0 is at the root level
+            // of the frame meta-data in the msg_envelope_t. In the
+            // additional frames meta-data, index "0" is technically "1".
+            msg_envelope_elem_body_t* obj = NULL;
+            if (i - 1 < (int) m_additional_frames_arr->body.array->len) {
+                obj = msgbus_msg_envelope_elem_array_get_at(
+                        m_additional_frames_arr, i - 1);
+                if (obj == NULL) {
+                    throw "Failed to get meta-data object";
+                }
+
+                // Remove old values
+                REMOVE_META_OBJ(obj, "img_handle");
+                REMOVE_META_OBJ(obj, "width");
+                REMOVE_META_OBJ(obj, "height");
+                REMOVE_META_OBJ(obj, "channels");
+                REMOVE_META_OBJ(obj, "encoding_type");
+                REMOVE_META_OBJ(obj, "encoding_level");
+                REMOVE_META_OBJ(obj, "pixel_format");
+            } else {
+                // Frame added after the frame was constructed
+                obj = msgbus_msg_envelope_new_object();
+                if (obj == NULL) {
+                    throw "Failed to initialize message envelope object";
+                }
+                ret = msgbus_msg_envelope_elem_array_add(
+                        m_additional_frames_arr, obj);
+                if (ret != MSG_SUCCESS) {
+                    msgbus_msg_envelope_elem_destroy(obj);
+                    throw "Failed to add meta object to array";
+                }
             }
+
+            // Add the new meta-data values
+            add_frame_meta_obj(obj, meta);
         }
-    } else {
-        LOG_DEBUG("Removed encoding for frame: %d", index);
+
+        meta->set_dirty(false);
     }
 }
 
@@ -707,6 +1080,10 @@ msg_envelope_t* Frame::get_meta_data() {
         LOG_ERROR_0("Cannot get meta-data after frame serialization");
         return NULL;
     }
+
+    // UDFs and UDF graph predicates read the core meta-data from the
+    // envelope, so write the changes since the envelope was last handed out
+    this->write_meta_data();
     return m_meta_data;
 }
 
@@ -723,13 +1100,55 @@ msg_envelope_t* Frame::serialize() {
     // NOTE: Irrecoverable if an error occurs
     m_serialized.store(true);
 
+    // Write the meta-data of all frames which changed into the envelope
+    this->write_meta_data();
+
+    // Encode all of the frames before handing them to the message envelope,
+    // unless they have already been encoded
+    if (!m_encoded) {
+        this->encode_frames();
+    }
+
+    // Send only descriptors if the frames fit into the shared memory ring
+    if (m_shm_ring != nullptr) {
+        blob = this->write_shm_frames();
+        if (blob != NULL) {
+            ret = msgbus_msg_envelope_put(m_meta_data, NULL, blob);
+            if (ret != MSG_SUCCESS) {
+                LOG_ERROR("Failed to put blob: %d", ret);
+                this->destroy_unsent_blob(blob);
+                throw "Failed to add blob to message envelope";
+            }
+
+            msg_envelope_t* msg = m_meta_data;
+            m_meta_data = NULL;
+            return msg;
+        }
+    }
+
+    // Send all frames as a single blob with the packed layout
+    if (m_packed && this->get_number_of_frames() > 1) {
+        blob = this->pack_frames();
+        ret = msgbus_msg_envelope_put(m_meta_data, NULL, blob);
+        if (ret != MSG_SUCCESS) {
+            LOG_ERROR("Failed to put blob: %d", ret);
+            this->destroy_unsent_blob(blob);
+            throw "Failed to add blob to message envelope";
+        }
+
+        msg_envelope_t* msg = m_meta_data;
+        m_meta_data = NULL;
+        return msg;
+    }
+
     // Add all frames as blobs to the message envelope
     for (int i = 0; i < this->get_number_of_frames(); i++) {
         fd = this->m_frames[i];
-        fd->encode();
 
+        // NOTE: The data is only read from here on, so it is not copied if
+        // it is shared with another frame
         blob = msgbus_msg_envelope_new_blob(
-                (char*) fd->get_data(), fd->get_size());
+                (char*) fd->get_readonly_data(), fd->get_size());
         if (blob == NULL) {
             // TODO(kmidkiff): Need to manage memory freeing for this error
             LOG_ERROR_0("Failed to initialize new blob");
@@ -765,17 +1184,326 @@ msg_envelope_t* Frame::serialize() {
     return msg;
 }
 
+void Frame::set_shm_ring(std::shared_ptr<ShmRing> ring) {
+    if (m_serialized.load()) {
+        throw "Cannot set the shared memory ring after serialization";
+    }
+    m_shm_ring = ring;
+}
+
+msg_envelope_elem_body_t* Frame::write_shm_frames() {
+    msg_envelope_elem_body_t* e_name = NULL;
+    msg_envelope_elem_body_t* e_id = NULL;
+    msg_envelope_elem_body_t* blob = NULL;
+    msgbus_ret_t ret = MSG_SUCCESS;
+    int num_frames = this->get_number_of_frames();
+
+    size_t len = sizeof(ShmFrameDescriptor) * num_frames;
+    ShmFrameDescriptor* descs = (ShmFrameDescriptor*) malloc(len);
+    if (descs == NULL) {
+        throw "Failed to allocate shared memory frame descriptors";
+    }
+
+    // Claim a slot for every frame first, so that the frames can still be
+    // sent as blobs if the ring is full
+    std::vector<void*> slots;
+    for (int i = 0; i < num_frames; i++) {
+        void* slot = m_shm_ring->claim(m_frames[i]->get_size(), &descs[i]);
+        if (slot == NULL) {
+            LOG_DEBUG("Frame %d does not fit into the shared memory ring, "
+                      "sending the frames as blobs", i);
+            for (int j = 0; j < i; j++) {
+                m_shm_ring->commit(&descs[j]);
+            }
+            free(descs);
+            return NULL;
+        }
+        slots.push_back(slot);
+    }
+
+    for (int i = 0; i < num_frames; i++) {
+        memcpy(slots[i], m_frames[i]->get_readonly_data(),
+               m_frames[i]->get_size());
+        m_shm_ring->commit(&descs[i]);
+    }
+
+    try {
+        REMOVE_META(m_meta_data, SHM_RING_KEY);
+        REMOVE_META(m_meta_data, SHM_RING_ID_KEY);
+
+        e_name = msgbus_msg_envelope_new_string(
+                m_shm_ring->get_name().c_str());
+        if (e_name == NULL) {
+            throw "Failed to initialize shm_ring meta-data";
+        }
+        ret = msgbus_msg_envelope_put(m_meta_data, SHM_RING_KEY, e_name);
+        if (ret != MSG_SUCCESS) {
+            throw "Failed to put shm_ring meta-data";
+        }
+        e_name = NULL;
+
+        e_id = msgbus_msg_envelope_new_integer(
+                (int64_t) m_shm_ring->get_ring_id());
+        if (e_id == NULL) {
+            throw "Failed to initialize shm_ring_id meta-data";
+        }
+        ret = msgbus_msg_envelope_put(m_meta_data, SHM_RING_ID_KEY, e_id);
+        if (ret != MSG_SUCCESS) {
+            throw "Failed to put shm_ring_id meta-data";
+        }
+        e_id = NULL;
+
+        blob = msgbus_msg_envelope_new_blob((char*) descs, len);
+        if (blob == NULL) {
+            throw "Failed to initialize new blob";
+        }
+    } catch (const char* ex) {
+        if (e_name != NULL) { msgbus_msg_envelope_elem_destroy(e_name); }
+        if (e_id != NULL) { msgbus_msg_envelope_elem_destroy(e_id); }
+        free(descs);
+        throw ex;
+    }
+
+    // The pixels are in the ring now, so the frames can be freed right away
+    for (auto fd : m_frames) {
+        delete fd;
+    }
+    m_frames.clear();
+
+    // The blob is responsible for freeing the descriptors and deleting the
+    // Frame object itself
+    FinalFreeWrapper* ffw = new FinalFreeWrapper(this, NULL, (void*) descs);
+    blob->body.blob->shared->ptr = (void*) ffw;
+    blob->body.blob->shared->free = free_frame_data_final;
+    blob->body.blob->shared->owned = true;
+
+    return blob;
+}
+
+void Frame::destroy_unsent_blob(msg_envelope_elem_body_t* blob) {
+    FinalFreeWrapper* ffw = (FinalFreeWrapper*) blob->body.blob->shared->ptr;
+    ffw->release_frame();
+    msgbus_msg_envelope_elem_destroy(blob);
+
+    msgbus_msg_envelope_destroy(m_meta_data);
+    m_meta_data = NULL;
+}
+
+void Frame::set_packed_layout(bool packed) {
+    if (m_serialized.load()) {
+        throw "Cannot set the frame layout after serialization";
+    }
+    m_packed = packed;
+}
+
+void Frame::set_sequence(uint64_t sequence) {
+    m_sequence = sequence;
+}
+
+uint64_t Frame::get_sequence() {
+    return m_sequence;
+}
+
+void Frame::set_timestamp(int64_t timestamp) {
+    m_timestamp = timestamp;
+}
+
+int64_t Frame::get_timestamp() {
+    return m_timestamp;
+}
+
+int64_t Frame::get_age_ms() {
+    return (now_ns() - m_timestamp) / 1000000;
+}
+
+msg_envelope_elem_body_t* Frame::pack_frames() {
+    msg_envelope_elem_body_t* e_offsets = NULL;
+    msg_envelope_elem_body_t* e_lengths = NULL;
+    msg_envelope_elem_body_t* blob = NULL;
+    msgbus_ret_t ret = MSG_SUCCESS;
+    int num_frames = this->get_number_of_frames();
+
+    // Every frame starts at an aligned offset, so that the receiver can use
+    // the pixels in place
+    std::vector<size_t> offsets;
+    size_t len = 0;
+    for (auto fd : m_frames) {
+        offsets.push_back(len);
+        len += ((fd->get_size() + PACKED_ALIGNMENT - 1) / PACKED_ALIGNMENT) *
+            PACKED_ALIGNMENT;
+    }
+
+    FrameBufferPool* pool = FrameBufferPool::get_instance();
+    uint8_t* buffer = (uint8_t*) pool->acquire(len);
+    if (buffer == NULL) {
+        throw "Failed to acquire buffer for the packed frames";
+    }
+
+    try {
+        REMOVE_META(m_meta_data, PACKED_OFFSETS_KEY);
+        REMOVE_META(m_meta_data, PACKED_LENGTHS_KEY);
+
+        e_offsets = msgbus_msg_envelope_new_array();
+        e_lengths = msgbus_msg_envelope_new_array();
+        if (e_offsets == NULL || e_lengths == NULL) {
+            throw "Failed to initialize packed frame meta-data";
+        }
+
+        for (int i = 0; i < num_frames; i++) {
+            FrameData* fd = m_frames[i];
+            size_t size = fd->get_size();
+            memcpy(buffer + offsets[i], fd->get_readonly_data(), size);
+            memset(buffer + offsets[i] + size, 0,
+                   ((i + 1 < num_frames) ? offsets[i + 1] : len) -
+                   offsets[i] - size);
+
+            msg_envelope_elem_body_t* e_offset =
+                msgbus_msg_envelope_new_integer((int64_t) offsets[i]);
+            if (e_offset == NULL) {
+                throw "Failed to initialize packed frame offset";
+            }
+            ret = msgbus_msg_envelope_elem_array_add(e_offsets, e_offset);
+            if (ret != MSG_SUCCESS) {
+                msgbus_msg_envelope_elem_destroy(e_offset);
+                throw "Failed to add packed frame offset";
+            }
+
+            msg_envelope_elem_body_t* e_length =
+                msgbus_msg_envelope_new_integer((int64_t) size);
+            if (e_length == NULL) {
+                throw "Failed to initialize packed frame length";
+            }
+            ret = msgbus_msg_envelope_elem_array_add(e_lengths, e_length);
+            if (ret != MSG_SUCCESS) {
+                msgbus_msg_envelope_elem_destroy(e_length);
+                throw "Failed to add packed frame length";
+            }
+        }
+
+        ret = msgbus_msg_envelope_put(
+                m_meta_data, PACKED_OFFSETS_KEY, e_offsets);
+        if (ret != MSG_SUCCESS) {
+            throw "Failed to put packed_offsets meta-data";
+        }
+        e_offsets = NULL;
+
+        ret = msgbus_msg_envelope_put(
+                m_meta_data, PACKED_LENGTHS_KEY, e_lengths);
+        if (ret != MSG_SUCCESS) {
+            throw "Failed to put packed_lengths meta-data";
+        }
+        e_lengths = NULL;
+
+        blob = msgbus_msg_envelope_new_blob((char*) buffer, len);
+        if (blob == NULL) {
+            throw "Failed to initialize new blob";
+        }
+    } catch (const char* ex) {
+        if (e_offsets != NULL) { msgbus_msg_envelope_elem_destroy(e_offsets); }
+        if (e_lengths != NULL) { msgbus_msg_envelope_elem_destroy(e_lengths); }
+        pool->release(buffer);
+        throw ex;
+    }
+
+    // The pixels are in the packed buffer now, so the frames can be freed
+    // right away
+    for (auto fd : m_frames) {
+        delete fd;
+    }
+    m_frames.clear();
+
+    // The blob is responsible for releasing the packed buffer and deleting
+    // the Frame object itself
+    FinalFreeWrapper* ffw = new FinalFreeWrapper(
+            this, NULL, (void*) buffer, FrameBufferPool::free_buffer);
+    blob->body.blob->shared->ptr = (void*) ffw;
+    blob->body.blob->shared->free = free_frame_data_final;
+    blob->body.blob->shared->owned = true;
+
+    return blob;
+}
+
+void Frame::encode() {
+    if (m_serialized.load()) {
+        throw "Cannot encode frame after serialization";
+    }
+    if (m_encoded) {
+        return;
+    }
+
+    // NOTE: Irrecoverable if an error occurs, the frames may be partially
+    // encoded
+    m_encoded = true;
+    this->encode_frames();
+}
+
+bool Frame::is_encoded() {
+    return m_encoded;
+}
+
+void Frame::encode_frames() {
+    int num_frames = this->get_number_of_frames();
+    EncoderPool* pool = NULL;
+    if (num_frames > 1) {
+        pool = EncoderPool::get_instance();
+    }
+
+    if (pool == NULL) {
+        for (auto fd : m_frames) {
+            fd->encode();
+        }
+        return;
+    }
+
+    // Hand all frames but the first to the encoder pool, the first frame is
+    // encoded on the calling thread while the others are in flight. If the
+    // pool's queue is full, the frame is encoded on the calling thread.
+    std::vector<std::future<void>> pending;
+    std::exception_ptr err = nullptr;
+
+    for (int i = 1; i < num_frames; i++) {
+        FrameData* fd = m_frames[i];
+        auto task = std::make_shared<std::packaged_task<void()>>(
+                [fd]() { fd->encode(); });
+        std::future<void> fut = task->get_future();
+        if (pool->submit([task]() { (*task)(); })) {
+            pending.push_back(std::move(fut));
+        } else {
+            try {
+                fd->encode();
+            } catch (...) {
+                if (err == nullptr) { err = std::current_exception(); }
+            }
+        }
+    }
+
+    try {
+        m_frames[0]->encode();
+    } catch (...) {
+        if (err == nullptr) { err = std::current_exception(); }
+    }
+
+    // All encodes must finish before returning (even in the error case),
+    // since the frame data is owned by the message envelope afterwards
+    for (auto& fut : pending) {
+        try {
+            fut.get();
+        } catch (...) {
+            if (err == nullptr) { err = std::current_exception(); }
+        }
+    }
+
+    if (err != nullptr) {
+        std::rethrow_exception(err);
+    }
+}
+
 static void free_decoded(void* varg) {
     // Does nothing... Since the memory is managed by the cv::Mat itself
     cv::Mat* frame = (cv::Mat*) varg;
     delete frame;
 }
 
-static void free_encoded(void* varg) {
-    std::vector<uchar>* encoded_bytes = (std::vector<uchar>*) varg;
-    delete encoded_bytes;
-}
-
 static void free_msg_env_blob(void* varg) {
     msg_envelope_elem_body_t* elem = (msg_envelope_elem_body_t*) varg;
     msgbus_msg_envelope_elem_destroy(elem);
@@ -787,11 +1515,59 @@ static void free_frame_data(void* varg) {
 }
 
 
+static void free_nothing(void* varg) {}
+
 static void free_frame_data_final(void* varg) {
     FinalFreeWrapper* ffw = (FinalFreeWrapper*) varg;
     delete ffw;
 }
 
+static msg_envelope_elem_body_t* pin_shm_frame(
+        std::shared_ptr<ShmRing> ring, const ShmFrameDescriptor* desc) {
+    const void* data = ring->pin(desc);
+    if (data == NULL) {
+        LOG_ERROR("Slot %u of shared memory ring %s was reused before the "
+                  "frame was received", desc->slot, ring->get_name().c_str());
+        throw "Shared memory frame was overwritten before it was received";
+    }
+
+    ShmPin* pin = new ShmPin(ring, desc->slot);
+    owned_blob_t* shared = owned_blob_new(
+            (void*) pin, free_shm_pin, (const char*) data, (size_t) desc->len);
+    if (shared == NULL) {
+        delete pin;
+        throw "Failed to initialize shared memory blob";
+    }
+    shared->owned = true;
+
+    msg_envelope_blob_t* b = (msg_envelope_blob_t*) malloc(
+            sizeof(msg_envelope_blob_t));
+    if (b == NULL) {
+        owned_blob_destroy(shared);
+        throw "Failed to initialize new blob";
+    }
+    b->shared = shared;
+    b->len = shared->len;
+    b->data = shared->bytes;
+
+    msg_envelope_elem_body_t* elem = (msg_envelope_elem_body_t*) malloc(
+            sizeof(msg_envelope_elem_body_t));
+    if (elem == NULL) {
+        free(b);
+        owned_blob_destroy(shared);
+        throw "Failed to initailize new element";
+    }
+    elem->type = MSG_ENV_DT_BLOB;
+    elem->body.blob = b;
+
+    return elem;
+}
+
+static void free_shm_pin(void* varg) {
+    ShmPin* pin = (ShmPin*) varg;
+    delete pin;
+}
+
 static void add_frame_meta_env(msg_envelope_t* env, FrameMetaData* meta) {
     msg_envelope_elem_body_t* e_width = NULL;
     msg_envelope_elem_body_t* e_height = NULL;
@@ -799,6 +1575,7 @@ static void add_frame_meta_env(msg_envelope_t* env, FrameMetaData* meta) {
     msg_envelope_elem_body_t* e_enc_type = NULL;
     msg_envelope_elem_body_t* e_enc_lvl = NULL;
     msg_envelope_elem_body_t* e_img_handle = NULL;
+    msg_envelope_elem_body_t* e_pix_fmt = NULL;
     msgbus_ret_t ret = MSG_SUCCESS;
 
     try {
@@ -851,13 +1628,26 @@ static void add_frame_meta_env(msg_envelope_t* env, FrameMetaData* meta) {
         }
         e_channels = NULL;
 
+        // Add pixel format (if it is not the default 8-bit pixels, to keep
+        // the meta-data unchanged for existing consumers)
+        if(meta->get_pixel_format() != PixelFormat::U8) {
+            e_pix_fmt = msgbus_msg_envelope_new_string(
+                    pixel_format_to_str(meta->get_pixel_format()));
+            if(e_pix_fmt == NULL) {
+                throw "Failed to initialize pixel format meta-data";
+            }
+            ret = msgbus_msg_envelope_put(
+                    env, "pixel_format", e_pix_fmt);
+            if(ret != MSG_SUCCESS) {
+                throw "Failed to put pixel format meta-data";
+            }
+            e_pix_fmt = NULL;
+        }
+
         // Add encoding (if type is not NONE)
         if(meta->get_encode_type() != EncodeType::NONE) {
-            if(meta->get_encode_type() == EncodeType::JPEG) {
-                e_enc_type = msgbus_msg_envelope_new_string("jpeg");
-            } else {
-                e_enc_type = msgbus_msg_envelope_new_string("png");
-            }
+            e_enc_type = msgbus_msg_envelope_new_string(
+                    encode_type_to_str(meta->get_encode_type()));
             if(e_enc_type == NULL) {
                 throw "Failed initialize encoding type meta-data";
             }
@@ -897,6 +1687,9 @@ static void add_frame_meta_env(msg_envelope_t* env, FrameMetaData* meta) {
         if (e_enc_lvl != NULL) {
             msgbus_msg_envelope_elem_destroy(e_enc_lvl);
         }
+        if (e_pix_fmt != NULL) {
+            msgbus_msg_envelope_elem_destroy(e_pix_fmt);
+        }
 
         // Re-throw the exception
         throw ex;
@@ -911,6 +1704,7 @@ static void add_frame_meta_obj(
     msg_envelope_elem_body_t* e_enc_type = NULL;
     msg_envelope_elem_body_t* e_enc_lvl = NULL;
     msg_envelope_elem_body_t* e_img_handle = NULL;
+    msg_envelope_elem_body_t* e_pix_fmt = NULL;
     msgbus_ret_t ret = MSG_SUCCESS;
 
     try {
@@ -963,12 +1757,25 @@ static void add_frame_meta_obj(
         }
         e_channels = NULL;
 
-        if (meta->get_encode_type() != EncodeType::NONE) {
-            if(meta->get_encode_type() == EncodeType::JPEG) {
-                e_enc_type = msgbus_msg_envelope_new_string("jpeg");
-            } else {
-                e_enc_type = msgbus_msg_envelope_new_string("png");
+        // Add pixel format (if it is not the default 8-bit pixels, to keep
+        // the meta-data unchanged for existing consumers)
+        if(meta->get_pixel_format() != PixelFormat::U8) {
+            e_pix_fmt = msgbus_msg_envelope_new_string(
+                    pixel_format_to_str(meta->get_pixel_format()));
+            if(e_pix_fmt == NULL) {
+                throw "Failed to initialize pixel format meta-data";
             }
+            ret = msgbus_msg_envelope_elem_object_put(
+                    obj, "pixel_format", e_pix_fmt);
+            if(ret != MSG_SUCCESS) {
+                throw "Failed to put pixel format meta-data";
+            }
+            e_pix_fmt = NULL;
+        }
+
+        if (meta->get_encode_type() != EncodeType::NONE) {
+            e_enc_type = msgbus_msg_envelope_new_string(
+                    encode_type_to_str(meta->get_encode_type()));
             if(e_enc_type == NULL) {
                 throw "Failed initialize encoding type meta-data";
             }
@@ -1011,6 +1818,9 @@ static void add_frame_meta_obj(
         if (e_enc_lvl != NULL) {
             msgbus_msg_envelope_elem_destroy(e_enc_lvl);
         }
+        if (e_pix_fmt != NULL) {
+            msgbus_msg_envelope_elem_destroy(e_pix_fmt);
+        }
 
         // Re-throw the exception
         throw ex;
@@ -1022,40 +1832,143 @@ static bool verify_encoding_level(EncodeType encode_type, int encode_level) {
     switch(encode_type) {
         case EncodeType::JPEG: return encode_level >= 0 && encode_level <= 100;
         case EncodeType::PNG:  return encode_level >= 0 && encode_level <= 9;
+        case EncodeType::LZ4:  return encode_level >= 0 &&
+                                      encode_level <= LZ4HC_CLEVEL_MAX;
+        case EncodeType::ZSTD: return encode_level >= 1 &&
+                                      encode_level <= ZSTD_maxCLevel();
+        case EncodeType::NONE: return true;
+        default:               return true;
+    }
+}
+
+static bool verify_encoding_format(
+        EncodeType encode_type, PixelFormat pixel_format) {
+    switch(encode_type) {
+        case EncodeType::JPEG: return pixel_format == PixelFormat::U8;
+        case EncodeType::PNG:  return pixel_format == PixelFormat::U8 ||
+                                      pixel_format == PixelFormat::U16;
+        // LZ4 and Zstandard compress the raw bytes of any pixel format
+        case EncodeType::LZ4:
+        case EncodeType::ZSTD:
         case EncodeType::NONE: return true;
         default:               return true;
     }
 }
 
 static cv::Mat* decode_frame(
-        EncodeType encode_type, uchar* encoded_data, size_t len) {
-    // Construct vector of bytes to pass to cv::imdecode
-    std::vector<uchar> data;
-    data.assign(encoded_data, encoded_data + len);
+        EncodeType encode_type, uchar* encoded_data, size_t len,
+        FrameMetaData* meta) {
+    if (encode_type == EncodeType::LZ4 || encode_type == EncodeType::ZSTD) {
+        return decompress_frame(encode_type, encoded_data, len, meta);
+    }
 
-    // Decode the frame
-    // TODO: Should we always decode as color?
+    // Wrap the encoded bytes in a cv::Mat header, so that cv::imdecode reads
+    // them in-place without copying the blob
+    cv::Mat data(1, (int) len, CV_8UC1, encoded_data);
+
+    // Single channel 8-bit frames are decoded as grayscale, other 8-bit
+    // frames are decoded as BGR, and all other pixel formats are decoded
+    // as-is
+    int flags = cv::IMREAD_UNCHANGED;
+    int type = meta->get_cv_type();
+    if (meta->get_pixel_format() == PixelFormat::U8) {
+        if (meta->get_channels() == 1) {
+            flags = cv::IMREAD_GRAYSCALE;
+        } else {
+            flags = cv::IMREAD_COLOR;
+            type = CV_8UC3;
+        }
+    }
+
+    // The decoded pixels are allocated from the frame buffer pool and
+    // released back to it when the cv::Mat is deleted. The destination is
+    // preallocated from the frame's meta-data, so that cv::imdecode decodes
+    // straight into it. If the meta-data is wrong, cv::imdecode reallocates
+    // the destination (again from the pool).
     cv::Mat* decoded = new cv::Mat();
-    *decoded = cv::imdecode(data, cv::IMREAD_COLOR);
-    if(decoded->empty()) {
+    decoded->allocator = FrameBufferPool::get_instance()->get_mat_allocator();
+    if (meta->get_width() > 0 && meta->get_height() > 0) {
+        decoded->create(meta->get_height(), meta->get_width(), type);
+    }
+
+    cv::Mat result = cv::imdecode(data, flags, decoded);
+    if(result.empty() || decoded->empty()) {
         delete decoded;
         throw "Failed to decode the encoded frame";
     }
-    data.clear();
+
+    return decoded;
+}
+
+static cv::Mat* decompress_frame(
+        EncodeType encode_type, uchar* encoded_data, size_t len,
+        FrameMetaData* meta) {
+    // Compressed frames are the tightly packed pixels, so the size of the
+    // decompressed frame is fully defined by the meta-data
+    cv::Mat* decoded = new cv::Mat();
+    decoded->allocator = FrameBufferPool::get_instance()->get_mat_allocator();
+    decoded->create(meta->get_rows(), meta->get_width(), meta->get_cv_type());
+
+    size_t expected = meta->get_row_size() * meta->get_rows();
+    size_t decompressed = 0;
+    if (encode_type == EncodeType::LZ4) {
+        int ret = LZ4_decompress_safe(
+                (const char*) encoded_data, (char*) decoded->data,
+                (int) len, (int) expected);
+        if (ret < 0) {
+            delete decoded;
+            throw "Failed to decompress the LZ4 frame";
+        }
+        decompressed = (size_t) ret;
+    } else {
+        // Decompression context reused across frames on the same thread
+        thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> dctx(
+                ZSTD_createDCtx(), ZSTD_freeDCtx);
+        if (dctx == nullptr) {
+            delete decoded;
+            throw "Failed to initialize Zstandard decompression context";
+        }
+
+        decompressed = ZSTD_decompressDCtx(
+                dctx.get(), decoded->data, expected, encoded_data, len);
+        if (ZSTD_isError(decompressed)) {
+            LOG_ERROR("Zstandard decompression failed: %s",
+                      ZSTD_getErrorName(decompressed));
+            delete decoded;
+            throw "Failed to decompress the Zstandard frame";
+        }
+    }
+
+    if (decompressed != expected) {
+        LOG_ERROR("Decompressed frame is %zu bytes, expected %zu bytes",
+                  decompressed, expected);
+        delete decoded;
+        throw "Decompressed frame does not match the frame meta-data";
+    }
 
     return decoded;
 }
 
 FrameMetaData::FrameMetaData(
         std::string img_handle, int width, int height, int channels,
-        EncodeType encode_type, int encode_level) :
+        EncodeType encode_type, int encode_level, PixelFormat pixel_format) :
     m_img_handle(img_handle), m_width(width), m_height(height),
     m_channels(channels), m_encode_type(encode_type),
-    m_encode_level(encode_level)
+    m_encode_level(encode_level), m_pixel_format(pixel_format),
+    m_dirty(true)
 {
     if (!verify_encoding_level(encode_type, encode_level)) {
         throw "Invalid encode type/level combination";
     }
+    if (!verify_encoding_format(encode_type, pixel_format)) {
+        throw "Encoding type does not support the frame's pixel format";
+    }
+    if (pixel_format == PixelFormat::NV12 ||
+            pixel_format == PixelFormat::I420) {
+        if (channels != 1 || (width % 2) != 0 || (height % 2) != 0) {
+            throw "Planar YUV frames must have 1 channel and even dimensions";
+        }
+    }
 }
 
 FrameMetaData::FrameMetaData(const FrameMetaData& src) {
@@ -1068,30 +1981,139 @@ FrameMetaData& FrameMetaData::operator=(const FrameMetaData& src) {
 
 FrameMetaData::~FrameMetaData() {}
 
-void FrameMetaData::set_width(int width) { m_width = width; }
-void FrameMetaData::set_height(int height) { m_height = height; }
-void FrameMetaData::set_channels(int channels) { m_channels = channels; }
+void FrameMetaData::set_width(int width) {
+    m_width = width;
+    m_dirty = true;
+}
+
+void FrameMetaData::set_height(int height) {
+    m_height = height;
+    m_dirty = true;
+}
+
+void FrameMetaData::set_channels(int channels) {
+    m_channels = channels;
+    m_dirty = true;
+}
+
 void FrameMetaData::set_encoding(EncodeType encode_type, int encode_level) {
     if (!verify_encoding_level(encode_type, encode_level)) {
         throw "Invalid encoding type/level";
     }
     m_encode_type = encode_type;
     m_encode_level = encode_level;
+    m_dirty = true;
 }
 
+void FrameMetaData::set_dirty(bool dirty) { m_dirty = dirty; }
+bool FrameMetaData::is_dirty() { return m_dirty; }
+
 std::string FrameMetaData::get_img_handle() { return m_img_handle; }
 int FrameMetaData::get_width() { return m_width; }
 int FrameMetaData::get_height() { return m_height; }
 int FrameMetaData::get_channels() { return m_channels; }
 EncodeType FrameMetaData::get_encode_type() { return m_encode_type; }
 int FrameMetaData::get_encode_level() { return m_encode_level; }
+PixelFormat FrameMetaData::get_pixel_format() { return m_pixel_format; }
+
+size_t FrameMetaData::get_element_size() {
+    switch(m_pixel_format) {
+        case PixelFormat::U16:
+        case PixelFormat::S16:  return 2;
+        case PixelFormat::F32:  return 4;
+        case PixelFormat::U8:
+        case PixelFormat::NV12:
+        case PixelFormat::I420:
+        default:                return 1;
+    }
+}
+
+int FrameMetaData::get_rows() {
+    if (m_pixel_format == PixelFormat::NV12 ||
+            m_pixel_format == PixelFormat::I420) {
+        // Y plane followed by the chroma planes at half the resolution
+        return m_height + m_height / 2;
+    }
+    return m_height;
+}
+
+size_t FrameMetaData::get_row_size() {
+    return (size_t) m_width * m_channels * this->get_element_size();
+}
+
+int FrameMetaData::get_cv_type() {
+    switch(m_pixel_format) {
+        case PixelFormat::U16:  return CV_16UC(m_channels);
+        case PixelFormat::S16:  return CV_16SC(m_channels);
+        case PixelFormat::F32:  return CV_32FC(m_channels);
+        case PixelFormat::NV12:
+        case PixelFormat::I420: return CV_8UC1;
+        case PixelFormat::U8:
+        default:                return CV_8UC(m_channels);
+    }
+}
 
 FrameData::FrameData(
         void* frame, void (*free_frame)(void*), void* data,
+        FrameMetaData* meta, size_t stride) :
+    m_meta(meta), m_frame(), m_pixels_token(), m_data(data), m_encoded(),
+    m_encoded_len(0),
+    m_encoded_type(EncodeType::NONE), m_encoded_level(0), m_modified(false),
+    m_readonly(false)
+{
+    size_t row_size = meta->get_row_size();
+    if (stride == 0) {
+        stride = row_size;
+    } else if (stride < row_size) {
+        throw "Frame stride is smaller than a row of pixels";
+    }
+    m_stride = stride;
+    m_size = row_size * meta->get_rows();
+
+    // NOTE: Only taking ownership of the frame once nothing can throw
+    this->set_frame(frame, free_frame);
+}
+
+FrameData::FrameData(msg_envelope_elem_body_t* encoded, FrameMetaData* meta) :
+    m_meta(meta), m_frame(), m_pixels_token(std::make_shared<char>(0)),
+    m_data(NULL),
+    m_encoded(std::shared_ptr<msg_envelope_elem_body_t>(
+                encoded, msgbus_msg_envelope_elem_destroy),
+            (void*) encoded->body.blob->data),
+    m_encoded_len((size_t) encoded->body.blob->len),
+    m_encoded_type(meta->get_encode_type()),
+    m_encoded_level(meta->get_encode_level()), m_modified(false),
+    m_readonly(false)
+{
+    m_stride = meta->get_row_size();
+    m_size = m_stride * meta->get_rows();
+}
+
+FrameData::FrameData(
+        std::shared_ptr<void> owner, void* data, size_t len,
         FrameMetaData* meta) :
-    m_meta(meta), m_frame(frame), m_data(data), m_free_frame(free_frame)
+    m_meta(meta), m_frame(), m_pixels_token(std::make_shared<char>(0)),
+    m_data(NULL), m_encoded(), m_encoded_len(0),
+    m_encoded_type(meta->get_encode_type()),
+    m_encoded_level(meta->get_encode_level()), m_modified(false),
+    m_readonly(false)
 {
-    m_size = meta->get_width() * meta->get_height() * meta->get_channels();
+    m_stride = meta->get_row_size();
+    m_size = m_stride * meta->get_rows();
+
+    if (m_encoded_type == EncodeType::NONE) {
+        if (len != m_size) {
+            LOG_ERROR("Frame meta-data expects %lu bytes, got %lu",
+                      m_size, len);
+            throw "Frame meta-data does not match the size of the frame";
+        }
+        m_frame = owner;
+        m_data = data;
+    } else {
+        // The frame is kept encoded until its data is accessed
+        m_encoded = std::shared_ptr<void>(owner, data);
+        m_encoded_len = len;
+    }
 }
 
 FrameData::FrameData(const FrameData& src) {
@@ -1103,21 +2125,165 @@ FrameData& FrameData::operator=(const FrameData& src) {
 }
 
 FrameData::~FrameData() {
+    // The underlying frame and encoded bytes are freed once they are no
+    // longer shared with another FrameData
     delete m_meta;
-    if (this->m_free_frame != NULL) {
-        this->m_free_frame(this->m_frame);
-    }
 }
 
 FrameMetaData* FrameData::get_meta_data() { return m_meta; }
-void* FrameData::get_data() { return m_data; }
 size_t FrameData::get_size() { return m_size; }
+size_t FrameData::get_stride() { return m_stride; }
+bool FrameData::is_decoded() { return m_data != NULL; }
+bool FrameData::is_modified() { return m_modified; }
+void FrameData::set_modified() { m_modified = true; }
+void FrameData::set_readonly() { m_readonly = true; }
+bool FrameData::is_shared() { return m_pixels_token.use_count() > 1; }
+
+void FrameData::set_frame(void* frame, void (*free_frame)(void*)) {
+    if (free_frame == NULL) {
+        free_frame = free_nothing;
+    }
+    m_frame = std::shared_ptr<void>(frame, free_frame);
+    m_pixels_token = std::make_shared<char>(0);
+    m_readonly = false;
+}
+
+FrameData* FrameData::share() {
+    FrameMetaData* meta = new FrameMetaData(
+            m_meta->get_img_handle(),
+            m_meta->get_width(), m_meta->get_height(),
+            m_meta->get_channels(), m_meta->get_encode_type(),
+            m_meta->get_encode_level(), m_meta->get_pixel_format());
+    meta->set_dirty(m_meta->is_dirty());
+
+    FrameData* fd = NULL;
+    try {
+        fd = new FrameData(NULL, NULL, NULL, meta, m_stride);
+    } catch (const char* ex) {
+        delete meta;
+        throw ex;
+    }
+
+    fd->m_frame = m_frame;
+    fd->m_pixels_token = m_pixels_token;
+    fd->m_data = m_data;
+    fd->m_size = m_size;
+    fd->m_encoded = m_encoded;
+    fd->m_encoded_len = m_encoded_len;
+    fd->m_encoded_type = m_encoded_type;
+    fd->m_encoded_level = m_encoded_level;
+    fd->m_modified = m_modified;
+    fd->m_readonly = m_readonly;
+
+    return fd;
+}
+
+void* FrameData::get_data() {
+    this->decode();
+
+    // Copy-on-write, the pixels must not change under the other frames
+    // which are sharing them
+    if (m_data != NULL && (this->is_shared() || m_readonly)) {
+        this->compact(true);
+    }
+
+    // The pixels may be changed by the caller, so the received encoded bytes
+    // can no longer be re-published
+    m_modified = true;
+    this->release_encoded();
+
+    return m_data;
+}
+
+const void* FrameData::get_readonly_data() {
+    this->decode();
+    return m_data;
+}
+
+void FrameData::release_encoded() {
+    // NOTE: The encoded bytes are only destroyed once they are no longer
+    // shared with another FrameData
+    m_encoded.reset();
+}
+
+void FrameData::decode() {
+    if (m_data != NULL || m_encoded == NULL) {
+        return;
+    }
+
+    cv::Mat* decoded = decode_frame(
+            m_encoded_type,
+            (uchar*) m_encoded.get(), m_encoded_len, m_meta);
+
+    // The meta-data was already handed to the user before decoding, so a
+    // mismatch cannot be corrected at this point
+    if (decoded->cols != m_meta->get_width() ||
+            decoded->rows != m_meta->get_rows() ||
+            decoded->type() != m_meta->get_cv_type()) {
+        LOG_ERROR("Frame meta-data (%dx%dx%d) does not match the decoded "
+                  "frame (%dx%dx%d)",
+                  m_meta->get_width(), m_meta->get_height(),
+                  m_meta->get_channels(), decoded->cols, decoded->rows,
+                  decoded->channels());
+        delete decoded;
+        throw "Decoded frame does not match the frame meta-data";
+    }
+
+    // The encoded bytes are kept, in case the frame is re-published without
+    // its pixels being modified
+    this->set_frame((void*) decoded, free_decoded);
+    this->m_data = (void*) decoded->data;
+    this->m_stride = decoded->step[0];
+}
+
+void FrameData::compact(bool force) {
+    size_t row_size = m_meta->get_row_size();
+    if (m_stride == row_size && !force) {
+        return;
+    }
+
+    FrameBufferPool* pool = FrameBufferPool::get_instance();
+    uint8_t* buffer = (uint8_t*) pool->acquire(m_size);
+    if (buffer == NULL) {
+        throw "Failed to acquire buffer for compacting the frame";
+    }
+
+    const uint8_t* src = (const uint8_t*) m_data;
+    for (int row = 0; row < m_meta->get_rows(); row++) {
+        memcpy(buffer + row * row_size, src + row * m_stride, row_size);
+    }
+
+    this->set_frame((void*) buffer, FrameBufferPool::free_buffer);
+    this->m_data = (void*) buffer;
+    this->m_stride = row_size;
+}
 
 void FrameData::encode() {
-    std::vector<uchar>* encoded_bytes = new std::vector<uchar>();
+    // Scratch buffer for cv::imencode(), reused across frames encoded on the
+    // same thread so that its capacity only has to grow once
+    thread_local std::vector<uchar> encoded_bytes;
     std::vector<int> compression_params;
     std::string ext;
 
+    if (m_encoded != NULL) {
+        if (m_meta->get_encode_type() == m_encoded_type &&
+                m_meta->get_encode_level() == m_encoded_level) {
+            // The pixels were not modified and the frame is published with
+            // the same encoding it was received with, so re-publish the
+            // received bytes instead of encoding the frame again. The bytes
+            // stay alive while they are referenced by the frame.
+            this->m_data = m_encoded.get();
+            this->m_size = m_encoded_len;
+            this->m_frame = m_encoded;
+            this->m_encoded.reset();
+            return;
+        }
+
+        // The encoding changed, so the frame must be decoded and encoded
+        this->decode();
+        this->release_encoded();
+    }
+
     // Build compression parameters
     switch(m_meta->get_encode_type()) {
         case EncodeType::JPEG:
@@ -1128,9 +2294,14 @@ void FrameData::encode() {
             ext = ".png";
             compression_params.push_back(cv::IMWRITE_PNG_COMPRESSION);
             break;
+        case EncodeType::LZ4:
+        case EncodeType::ZSTD:
+            this->compress();
+            return;
         case EncodeType::NONE:
         default:
-            delete encoded_bytes;
+            // Raw frames are published as tightly packed pixels
+            this->compact();
             return;
     }
 
@@ -1139,42 +2310,150 @@ void FrameData::encode() {
 
     // Construct cv::Mat from our frame
     cv::Mat frame(
-            m_meta->get_height(), m_meta->get_width(),
-            CV_8UC(m_meta->get_channels()), m_data);
+            m_meta->get_rows(), m_meta->get_width(),
+            m_meta->get_cv_type(), m_data, m_stride);
 
     // Execute the encode
-    bool ret = cv::imencode(ext, frame, *encoded_bytes, compression_params);
+    encoded_bytes.clear();
+    bool ret = cv::imencode(ext, frame, encoded_bytes, compression_params);
     if(!ret) {
-        delete encoded_bytes;
         throw "Failed to encode the frame";
     }
 
-    // Free old data
-    if (this->m_free_frame != NULL) {
-        this->m_free_frame(this->m_frame);
+    // Copy the encoded bytes into a pooled buffer, which is released back to
+    // the pool after the message bus has transmitted the frame
+    FrameBufferPool* pool = FrameBufferPool::get_instance();
+    void* buffer = pool->acquire(encoded_bytes.size());
+    if (buffer == NULL) {
+        throw "Failed to acquire buffer for the encoded frame";
+    }
+    memcpy(buffer, encoded_bytes.data(), encoded_bytes.size());
+
+    // Setup new internal state, releasing the old data
+    this->set_frame(buffer, FrameBufferPool::free_buffer);
+    this->m_data = buffer;
+    this->m_size = encoded_bytes.size();
+}
+
+void FrameData::compress() {
+    // The compressed frame is the tightly packed pixels
+    this->compact();
+
+    // The frame is compressed straight into a pooled buffer, which is
+    // released back to the pool after the message bus has transmitted the
+    // frame
+    FrameBufferPool* pool = FrameBufferPool::get_instance();
+    size_t compressed = 0;
+    void* buffer = NULL;
+
+    if (m_meta->get_encode_type() == EncodeType::LZ4) {
+        int bound = LZ4_compressBound((int) m_size);
+        if (bound <= 0) {
+            throw "Frame is too large for LZ4 compression";
+        }
+        buffer = pool->acquire((size_t) bound);
+        if (buffer == NULL) {
+            throw "Failed to acquire buffer for the compressed frame";
+        }
+
+        int ret = 0;
+        if (m_meta->get_encode_level() == 0) {
+            ret = LZ4_compress_default(
+                    (const char*) m_data, (char*) buffer, (int) m_size, bound);
+        } else {
+            ret = LZ4_compress_HC(
+                    (const char*) m_data, (char*) buffer, (int) m_size, bound,
+                    m_meta->get_encode_level());
+        }
+        if (ret <= 0) {
+            pool->release(buffer);
+            throw "Failed to compress the frame with LZ4";
+        }
+        compressed = (size_t) ret;
+    } else {
+        // Compression context reused across frames on the same thread
+        thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> cctx(
+                ZSTD_createCCtx(), ZSTD_freeCCtx);
+        if (cctx == nullptr) {
+            throw "Failed to initialize Zstandard compression context";
+        }
+
+        size_t bound = ZSTD_compressBound(m_size);
+        buffer = pool->acquire(bound);
+        if (buffer == NULL) {
+            throw "Failed to acquire buffer for the compressed frame";
+        }
+
+        compressed = ZSTD_compressCCtx(
+                cctx.get(), buffer, bound, m_data, m_size,
+                m_meta->get_encode_level());
+        if (ZSTD_isError(compressed)) {
+            LOG_ERROR("Zstandard compression failed: %s",
+                      ZSTD_getErrorName(compressed));
+            pool->release(buffer);
+            throw "Failed to compress the frame with Zstandard";
+        }
     }
 
-    // Setup new internal state
-    this->m_frame = (void*) encoded_bytes;
-    this->m_data = (void*) encoded_bytes->data();
-    this->m_free_frame = free_encoded;
-    this->m_size = encoded_bytes->size();
+    // Setup new internal state, releasing the old data
+    this->set_frame(buffer, FrameBufferPool::free_buffer);
+    this->m_data = buffer;
+    this->m_size = compressed;
 }
 
 static EncodeType str_to_encode_type(const char* val) {
-    int ind_jpeg = 0;
-    int ind_png = 0;
+    static const EncodeType types[] = {
+        EncodeType::JPEG, EncodeType::PNG, EncodeType::LZ4,
+        EncodeType::ZSTD };
     size_t len = strlen(val);
 
-    strcmp_s(val, len, "jpeg", &ind_jpeg);
-    strcmp_s(val, len, "png", &ind_png);
-
-    if (ind_jpeg == 0) { return EncodeType::JPEG; }
-    if (ind_png == 0) { return EncodeType::PNG; }
+    for (EncodeType type : types) {
+        int ind = 0;
+        strcmp_s(val, len, encode_type_to_str(type), &ind);
+        if (ind == 0) { return type; }
+    }
 
     throw "Unknown encode type";
 }
 
+static const char* encode_type_to_str(EncodeType encode_type) {
+    switch(encode_type) {
+        case EncodeType::JPEG: return "jpeg";
+        case EncodeType::PNG:  return "png";
+        case EncodeType::LZ4:  return "lz4";
+        case EncodeType::ZSTD: return "zstd";
+        case EncodeType::NONE:
+        default:               return "none";
+    }
+}
+
+static PixelFormat str_to_pixel_format(const char* val) {
+    static const PixelFormat formats[] = {
+        PixelFormat::U8, PixelFormat::U16, PixelFormat::S16,
+        PixelFormat::F32, PixelFormat::NV12, PixelFormat::I420 };
+    size_t len = strlen(val);
+
+    for (PixelFormat fmt : formats) {
+        int ind = 0;
+        strcmp_s(val, len, pixel_format_to_str(fmt), &ind);
+        if (ind == 0) { return fmt; }
+    }
+
+    throw "Unknown pixel format";
+}
+
+static const char* pixel_format_to_str(PixelFormat pixel_format) {
+    switch(pixel_format) {
+        case PixelFormat::U16:  return "u16";
+        case PixelFormat::S16:  return "s16";
+        case PixelFormat::F32:  return "f32";
+        case PixelFormat::NV12: return "nv12";
+        case PixelFormat::I420: return "i420";
+        case PixelFormat::U8:
+        default:                return "u8";
+    }
+}
+
 static std::string generate_image_handle(int len) {
     std::stringstream ss;
     for (auto i = 0; i < len; i++) {
@@ -1189,3 +2468,139 @@ static std::string generate_image_handle(int len) {
     }
     return ss.str();
 }
+
+static msg_envelope_t* copy_meta_data(msg_envelope_t* env) {
+    // The blob is only added to the envelope when the frame is serialized,
+    // so only the meta-data keys have to be copied
+    std::vector<std::pair<const char*, msg_envelope_elem_body_t*>> members;
+    get_meta_members(env->map, members);
+
+    msg_envelope_t* copy = msgbus_msg_envelope_new(CT_JSON);
+    if (copy == NULL) {
+        throw "Failed to initialize meta-data envelope";
+    }
+    for (auto& m : members) {
+        msg_envelope_elem_body_t* elem = NULL;
+        try {
+            elem = copy_meta_elem(m.second);
+        } catch (const char* ex) {
+            msgbus_msg_envelope_destroy(copy);
+            throw ex;
+        }
+        if (msgbus_msg_envelope_put(copy, m.first, elem) != MSG_SUCCESS) {
+            msgbus_msg_envelope_elem_destroy(elem);
+            msgbus_msg_envelope_destroy(copy);
+            throw "Failed to copy frame meta-data";
+        }
+    }
+
+    return copy;
+}
+
+/**
+ * Deep copy a meta-data element.
+ *
+ * @param elem - Element to copy
+ * @return @c msg_envelope_elem_body_t*
+ */
+static msg_envelope_elem_body_t* copy_meta_elem(
+        msg_envelope_elem_body_t* elem) {
+    msg_envelope_elem_body_t* copy = NULL;
+    switch (elem->type) {
+        case MSG_ENV_DT_INT:
+            copy = msgbus_msg_envelope_new_integer(elem->body.integer);
+            break;
+        case MSG_ENV_DT_FLOATING:
+            copy = msgbus_msg_envelope_new_floating(elem->body.floating);
+            break;
+        case MSG_ENV_DT_STRING:
+            copy = msgbus_msg_envelope_new_string(elem->body.string);
+            break;
+        case MSG_ENV_DT_BOOLEAN:
+            copy = msgbus_msg_envelope_new_bool(elem->body.boolean);
+            break;
+        case MSG_ENV_DT_BLOB:
+            copy = msgbus_msg_envelope_new_blob(
+                    elem->body.blob->data, elem->body.blob->len);
+            break;
+        case MSG_ENV_DT_NONE:
+            copy = msgbus_msg_envelope_new_none();
+            break;
+        case MSG_ENV_DT_OBJECT:
+            copy = msgbus_msg_envelope_new_object();
+            break;
+        case MSG_ENV_DT_ARRAY:
+            copy = msgbus_msg_envelope_new_array();
+            break;
+        default:
+            throw "Unknown meta-data element type";
+    }
+    if (copy == NULL) {
+        throw "Failed to copy frame meta-data";
+    }
+
+    try {
+        if (elem->type == MSG_ENV_DT_OBJECT) {
+            std::vector<std::pair<const char*, msg_envelope_elem_body_t*>>
+                members;
+            get_meta_members(elem->body.object, members);
+            for (auto& m : members) {
+                msg_envelope_elem_body_t* value = copy_meta_elem(m.second);
+                if (msgbus_msg_envelope_elem_object_put(
+                            copy, m.first, value) != MSG_SUCCESS) {
+                    msgbus_msg_envelope_elem_destroy(value);
+                    throw "Failed to copy frame meta-data";
+                }
+            }
+        } else if (elem->type == MSG_ENV_DT_ARRAY) {
+            int len = (int) elem->body.array->len;
+            for (int i = 0; i < len; i++) {
+                msg_envelope_elem_body_t* value = copy_meta_elem(
+                        msgbus_msg_envelope_elem_array_get_at(elem, i));
+                if (msgbus_msg_envelope_elem_array_add(copy, value) !=
+                        MSG_SUCCESS) {
+                    msgbus_msg_envelope_elem_destroy(value);
+                    throw "Failed to copy frame meta-data";
+                }
+            }
+        }
+    } catch (const char* ex) {
+        msgbus_msg_envelope_elem_destroy(copy);
+        throw ex;
+    }
+
+    return copy;
+}
+
+/**
+ * Add a member of an envelope or an object element to a vector, used with
+ * @c hashmap_foreach().
+ */
+static void add_meta_member(const char* key, void* value, void* varg) {
+    auto out = (std::vector<std::pair<
+            const char*, msg_envelope_elem_body_t*>>*) varg;
+    out->push_back(std::make_pair(key, (msg_envelope_elem_body_t*) value));
+}
+
+/**
+ * Get the members of an envelope or an object element. The keys and values
+ * are owned by the map.
+ *
+ * @param[in]  map - Map of the envelope or object element
+ * @param[out] out - Keys and values
+ */
+static void get_meta_members(
+        hashmap_t* map,
+        std::vector<std::pair<const char*, msg_envelope_elem_body_t*>>& out) {
+    hashmap_foreach(map, add_meta_member, (void*) &out);
+}
+
+/**
+ * Get the current time of the system clock.
+ *
+ * @return int64_t, nanoseconds since the epoch
+ */
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+}
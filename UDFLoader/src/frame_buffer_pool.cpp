@@ -0,0 +1,422 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Implementation of @c FrameBufferPool class
+ */
+
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <opencv2/opencv.hpp>
+#include <eii/utils/logger.h>
+
+#include "eii/udf/frame_buffer_pool.h"
+#include "eii/udf/cpu_topology.h"
+
+// Magic value to sanity check buffers released to the pool
+#define BUFFER_MAGIC 0x46425546
+
+// Size of a (transparent) huge page on x86_64
+#define HUGEPAGE_SIZE (2UL * 1024UL * 1024UL)
+
+using namespace eii::udf;
+
+/**
+ * Header stored in the @c FRAME_BUFFER_ALIGNMENT bytes in front of every
+ * buffer handed out by the pool.
+ */
+typedef struct {
+    uint32_t magic;
+    int32_t size_class;
+    size_t capacity;
+    // Length of the mapping if the buffer was allocated with mmap(), 0
+    // otherwise
+    size_t mapped_len;
+    void* base;
+    // NUMA node the buffer was allocated on, -1 if not bound to a node
+    int32_t node;
+    // Non-zero if the buffer is backed by huge pages
+    int32_t hugepages;
+} buffer_header_t;
+
+static_assert(sizeof(buffer_header_t) <= FRAME_BUFFER_ALIGNMENT,
+              "Buffer header must fit in the alignment padding");
+
+// Prototypes
+static int size_class_index(size_t size, size_t* capacity);
+static bool bind_to_node(void* addr, size_t len, int node);
+
+static inline buffer_header_t* get_header(void* data) {
+    return (buffer_header_t*) (((uint8_t*) data) - FRAME_BUFFER_ALIGNMENT);
+}
+
+/**
+ * OpenCV allocator which draws @c cv::Mat memory from a @c FrameBufferPool.
+ *
+ * This mirrors OpenCV's default allocator, except for where the memory for
+ * the matrix comes from.
+ */
+class PoolMatAllocator : public cv::MatAllocator {
+private:
+    FrameBufferPool* m_pool;
+
+public:
+    PoolMatAllocator(FrameBufferPool* pool) : m_pool(pool) {};
+
+    cv::UMatData* allocate(
+            int dims, const int* sizes, int type, void* data0,
+            size_t* step, cv::AccessFlag flags,
+            cv::UMatUsageFlags usage_flags) const override {
+        size_t total = CV_ELEM_SIZE(type);
+        for (int i = dims - 1; i >= 0; i--) {
+            if (step) {
+                if (data0 && step[i] != CV_AUTOSTEP) {
+                    total = step[i];
+                } else {
+                    step[i] = total;
+                }
+            }
+            total *= sizes[i];
+        }
+
+        uint8_t* data = (uint8_t*) data0;
+        if (data == NULL) {
+            data = (uint8_t*) m_pool->acquire(total);
+            if (data == NULL) {
+                throw "Failed to acquire buffer for cv::Mat";
+            }
+        }
+
+        cv::UMatData* u = new cv::UMatData(this);
+        u->data = u->origdata = data;
+        u->size = total;
+        if (data0 != NULL) {
+            u->flags |= cv::UMatData::USER_ALLOCATED;
+        }
+
+        return u;
+    };
+
+    bool allocate(
+            cv::UMatData* u, cv::AccessFlag flags,
+            cv::UMatUsageFlags usage_flags) const override {
+        return u != NULL;
+    };
+
+    void deallocate(cv::UMatData* u) const override {
+        if (u == NULL) {
+            return;
+        }
+
+        if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+            m_pool->release(u->origdata);
+            u->origdata = NULL;
+        }
+        delete u;
+    };
+};
+
+FrameBufferPool::FrameBufferPool(
+        size_t max_cached_bytes, bool use_hugepages) :
+    m_max_cached_bytes(max_cached_bytes), m_use_hugepages(use_hugepages),
+    m_numa_local(false), m_hits(0), m_misses(0), m_evictions(0),
+    m_resident_bytes(0), m_in_use_bytes(0)
+{
+    m_mat_allocator = new PoolMatAllocator(this);
+}
+
+FrameBufferPool::FrameBufferPool(const FrameBufferPool& src) {
+    throw "This object should not be copied";
+}
+
+FrameBufferPool& FrameBufferPool::operator=(const FrameBufferPool& src) {
+    return *this;
+}
+
+FrameBufferPool::~FrameBufferPool() {
+    this->trim();
+    delete m_mat_allocator;
+}
+
+FrameBufferPool* FrameBufferPool::get_instance() {
+    // Intentionally never deleted, see the note in the header
+    static FrameBufferPool* pool = new FrameBufferPool();
+    return pool;
+}
+
+void FrameBufferPool::free_buffer(void* data) {
+    FrameBufferPool::get_instance()->release(data);
+}
+
+void FrameBufferPool::configure(size_t max_cached_bytes, bool use_hugepages) {
+    LOG_DEBUG("Frame buffer pool: max cached bytes: %lu, hugepages: %d",
+              max_cached_bytes, use_hugepages);
+    m_max_cached_bytes.store(max_cached_bytes);
+    m_use_hugepages.store(use_hugepages);
+
+    // Drop buffers if the pool is now holding too much memory
+    if (m_resident_bytes.load() > max_cached_bytes) {
+        this->trim();
+    }
+}
+
+void FrameBufferPool::set_numa_local(bool numa_local) {
+    LOG_DEBUG("Frame buffer pool: NUMA-local buffers: %d", numa_local);
+    m_numa_local.store(numa_local);
+}
+
+void* FrameBufferPool::acquire(size_t size) {
+    size_t capacity = 0;
+    void* data = NULL;
+    int size_class = size_class_index(size, &capacity);
+    int node = m_numa_local.load() ? get_current_numa_node() : -1;
+
+    if (size_class >= 0) {
+        FreeList& fl = get_free_lists(node)[size_class];
+        std::lock_guard<std::mutex> lk(fl.mtx);
+        if (!fl.buffers.empty()) {
+            data = fl.buffers.back();
+            fl.buffers.pop_back();
+        }
+    }
+
+    if (data != NULL) {
+        m_hits++;
+        m_resident_bytes -= capacity;
+    } else {
+        m_misses++;
+        data = this->allocate_buffer(size_class, capacity, node);
+        if (data == NULL) {
+            LOG_ERROR("Failed to allocate frame buffer of %lu bytes", size);
+            return NULL;
+        }
+    }
+
+    m_in_use_bytes += capacity;
+
+    return data;
+}
+
+void FrameBufferPool::release(void* data) {
+    if (data == NULL) {
+        return;
+    }
+
+    buffer_header_t* hdr = get_header(data);
+    if (hdr->magic != BUFFER_MAGIC) {
+        LOG_ERROR_0("Released buffer was not allocated by the pool");
+        return;
+    }
+
+    size_t capacity = hdr->capacity;
+    m_in_use_bytes -= capacity;
+
+    // Only cache the buffer if it matches the current huge page setting,
+    // that way toggling the setting takes effect for recycled buffers too
+    bool hugepage_match =
+        (hdr->hugepages != 0) == (m_use_hugepages.load() &&
+                                  capacity >= HUGEPAGE_SIZE);
+
+    // Buffers bound to a NUMA node are only cached while buffers are
+    // allocated NUMA-locally, since only then their free lists are used
+    bool numa_match = hdr->node < 0 || m_numa_local.load();
+
+    if (hdr->size_class >= 0 && hugepage_match && numa_match &&
+            m_resident_bytes.load() + capacity <= m_max_cached_bytes.load()) {
+        FreeList& fl = get_free_lists(hdr->node)[hdr->size_class];
+        std::lock_guard<std::mutex> lk(fl.mtx);
+        fl.buffers.push_back(data);
+        m_resident_bytes += capacity;
+        return;
+    }
+
+    m_evictions++;
+    this->free_buffer_memory(data);
+}
+
+size_t FrameBufferPool::get_capacity(void* data) {
+    buffer_header_t* hdr = get_header(data);
+    if (hdr->magic != BUFFER_MAGIC) {
+        throw "Buffer was not allocated by the pool";
+    }
+    return hdr->capacity;
+}
+
+void FrameBufferPool::trim() {
+    for (int n = 0; n <= FRAME_BUFFER_MAX_NODES; n++) {
+        for (int i = 0; i < FRAME_BUFFER_NUM_CLASSES; i++) {
+            FreeList& fl = m_free_lists[n][i];
+            std::lock_guard<std::mutex> lk(fl.mtx);
+            for (auto data : fl.buffers) {
+                m_resident_bytes -= get_header(data)->capacity;
+                this->free_buffer_memory(data);
+            }
+            fl.buffers.clear();
+        }
+    }
+}
+
+cv::MatAllocator* FrameBufferPool::get_mat_allocator() {
+    return m_mat_allocator;
+}
+
+FrameBufferPoolStats FrameBufferPool::get_stats() {
+    FrameBufferPoolStats stats;
+    stats.hits = m_hits.load();
+    stats.misses = m_misses.load();
+    stats.evictions = m_evictions.load();
+    stats.resident_bytes = m_resident_bytes.load();
+    stats.in_use_bytes = m_in_use_bytes.load();
+
+    uint64_t total = stats.hits + stats.misses;
+    stats.hit_rate = (total > 0) ? ((double) stats.hits) / total : 0.0;
+
+    return stats;
+}
+
+void FrameBufferPool::log_stats() {
+    FrameBufferPoolStats stats = this->get_stats();
+    LOG_INFO("Frame buffer pool: hit rate: %.2f%% (hits: %lu, misses: %lu), "
+             "evictions: %lu, resident bytes: %lu, in use bytes: %lu",
+             stats.hit_rate * 100.0, stats.hits, stats.misses,
+             stats.evictions, stats.resident_bytes, stats.in_use_bytes);
+}
+
+FrameBufferPool::FreeList* FrameBufferPool::get_free_lists(int node) {
+    if (node < 0) {
+        return m_free_lists[0];
+    }
+    return m_free_lists[1 + node % FRAME_BUFFER_MAX_NODES];
+}
+
+void* FrameBufferPool::allocate_buffer(
+        int size_class, size_t capacity, int node) {
+    size_t total = capacity + FRAME_BUFFER_ALIGNMENT;
+    size_t mapped_len = 0;
+    void* base = NULL;
+    bool hugepages = m_use_hugepages.load() && capacity >= HUGEPAGE_SIZE;
+
+    if (hugepages || node >= 0) {
+        // Round up to a whole number of (huge) pages
+        size_t page = hugepages ?
+            HUGEPAGE_SIZE : (size_t) sysconf(_SC_PAGESIZE);
+        mapped_len = ((total + page - 1) / page) * page;
+        base = mmap(NULL, mapped_len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            return NULL;
+        }
+        if (hugepages && madvise(base, mapped_len, MADV_HUGEPAGE) != 0) {
+            // Not fatal, the buffer is just backed by regular pages
+            LOG_DEBUG_0("madvise(MADV_HUGEPAGE) failed for frame buffer");
+        }
+        if (node >= 0 && !bind_to_node(base, mapped_len, node)) {
+            // Not fatal, the pages are placed by the default policy
+            LOG_DEBUG("mbind() to NUMA node %d failed for frame buffer",
+                      node);
+        }
+    } else {
+        if (posix_memalign(&base, FRAME_BUFFER_ALIGNMENT, total) != 0) {
+            return NULL;
+        }
+    }
+
+    buffer_header_t* hdr = (buffer_header_t*) base;
+    hdr->magic = BUFFER_MAGIC;
+    hdr->size_class = size_class;
+    hdr->capacity = capacity;
+    hdr->mapped_len = mapped_len;
+    hdr->base = base;
+    hdr->node = node;
+    hdr->hugepages = hugepages ? 1 : 0;
+
+    return ((uint8_t*) base) + FRAME_BUFFER_ALIGNMENT;
+}
+
+void FrameBufferPool::free_buffer_memory(void* data) {
+    buffer_header_t* hdr = get_header(data);
+    void* base = hdr->base;
+    size_t mapped_len = hdr->mapped_len;
+
+    // Clear the magic to catch double releases
+    hdr->magic = 0;
+
+    if (mapped_len > 0) {
+        munmap(base, mapped_len);
+    } else {
+        free(base);
+    }
+}
+
+/**
+ * Get the size class for the given size.
+ *
+ * @param[in]  size     - Requested size
+ * @param[out] capacity - Size of the buffer in the size class
+ * @return Size class index, -1 if the size is too large to be pooled
+ */
+static int size_class_index(size_t size, size_t* capacity) {
+    const size_t min_size = 1UL << FRAME_BUFFER_MIN_SHIFT;
+    const size_t max_size = 1UL << FRAME_BUFFER_MAX_SHIFT;
+
+    if (size <= min_size) {
+        *capacity = min_size;
+        return 0;
+    }
+
+    if (size > max_size) {
+        // Round up to the alignment, but do not pool the buffer
+        *capacity = ((size + FRAME_BUFFER_ALIGNMENT - 1) /
+                FRAME_BUFFER_ALIGNMENT) * FRAME_BUFFER_ALIGNMENT;
+        return -1;
+    }
+
+    // size is in the range (2^shift, 2^(shift + 1)]
+    int shift = 63 - __builtin_clzl((unsigned long) (size - 1));
+    size_t base = 1UL << shift;
+    size_t step = base / FRAME_BUFFER_CLASSES_PER_2X;
+    size_t sub = (size - base + step - 1) / step;
+
+    *capacity = base + sub * step;
+    return (shift - FRAME_BUFFER_MIN_SHIFT) * FRAME_BUFFER_CLASSES_PER_2X +
+        (int) sub;
+}
+
+/**
+ * Prefer allocating the pages of a mapping on the given NUMA node.
+ *
+ * @param addr - Start of the mapping
+ * @param len  - Length of the mapping
+ * @param node - NUMA node
+ * @return false on failure
+ */
+static bool bind_to_node(void* addr, size_t len, int node) {
+    unsigned long mask = 0;
+    if (node >= (int) (sizeof(mask) * 8)) {
+        return false;
+    }
+    mask = 1UL << node;
+    // NOTE: The kernel expects the number of bits in the mask plus one
+    return syscall(SYS_mbind, addr, len, MPOL_PREFERRED, &mask,
+                   sizeof(mask) * 8 + 1, 0) == 0;
+}
@@ -0,0 +1,621 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Implementation of the frame recording classes
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <eii/utils/logger.h>
+
+#include "eii/udf/frame_recording.h"
+
+#define RECORDING_MAGIC "EIIFRREC"
+#define INDEX_MAGIC     "EIIFRIDX"
+#define RECORD_MAGIC    0x43455246  // "FREC"
+#define MAGIC_LEN       8
+
+// Longest a replay thread sleeps before checking if it should stop
+#define MAX_SLEEP std::chrono::milliseconds(250)
+
+using namespace eii::udf;
+using namespace eii::utils;
+
+/**
+ * Header at the start of a recording file.
+ */
+typedef struct {
+    char magic[MAGIC_LEN];
+    uint32_t version;
+    uint32_t reserved;
+    // Wall clock time (in ns since the epoch) the recording was started
+    int64_t start_time_ns;
+    uint8_t padding[40];
+} recording_header_t;
+
+/**
+ * Header of a single record, followed by the length of each part and
+ * padding up to @c FRAME_RECORDING_ALIGNMENT. Each part is followed by at
+ * least one zero byte (so that the JSON meta-data is NULL terminated) and
+ * padding.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t num_parts;
+    // Time the frame was recorded, relative to the start of the recording
+    int64_t timestamp_ns;
+    // Length of the whole record, including all padding
+    uint64_t len;
+} record_header_t;
+
+/**
+ * Footer at the end of a recording file, preceded by the offsets of all
+ * records.
+ */
+typedef struct {
+    uint64_t index_offset;
+    uint64_t num_records;
+    char magic[MAGIC_LEN];
+} index_footer_t;
+
+static_assert(sizeof(recording_header_t) == FRAME_RECORDING_ALIGNMENT,
+              "Recording header must fill exactly one alignment unit");
+
+// Reference to the mapping of a recording held by a received blob, for use
+// with free_mapping_ref()
+typedef struct {
+    std::shared_ptr<void> mapping;
+} mapping_ref_t;
+
+// Zeros for padding records
+static const uint8_t g_zeros[FRAME_RECORDING_ALIGNMENT] = {0};
+
+// Prototypes
+static uint64_t round_up(uint64_t value);
+static uint64_t get_parts_offset(uint32_t num_parts);
+static void free_mapping_ref(void* varg);
+
+//
+// FrameRecorder
+//
+
+FrameRecorder::FrameRecorder(const std::string& path) :
+    m_path(path), m_fd(-1), m_offset(0),
+    m_start(std::chrono::steady_clock::now())
+{
+    m_fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (m_fd < 0) {
+        LOG_ERROR("Failed to open %s: %s", path.c_str(), strerror(errno));
+        throw "Failed to open the recording file";
+    }
+
+    recording_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDING_MAGIC, MAGIC_LEN);
+    header.version = FRAME_RECORDING_VERSION;
+    header.start_time_ns = std::chrono::duration_cast<
+        std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+    try {
+        this->write_bytes(&header, sizeof(header));
+    } catch (const char* ex) {
+        ::close(m_fd);
+        throw ex;
+    }
+}
+
+FrameRecorder::FrameRecorder(const FrameRecorder& src) {
+    throw "This object should not be copied";
+}
+
+FrameRecorder& FrameRecorder::operator=(const FrameRecorder& src) {
+    return *this;
+}
+
+FrameRecorder::~FrameRecorder() {
+    try {
+        this->close();
+    } catch (const char* ex) {
+        LOG_ERROR("Failed to close recording %s: %s", m_path.c_str(), ex);
+    }
+}
+
+void FrameRecorder::write_bytes(const void* data, size_t len) {
+    const uint8_t* bytes = (const uint8_t*) data;
+    while (len > 0) {
+        ssize_t n = pwrite(m_fd, bytes, len, (off_t) m_offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Failed to write to %s: %s",
+                      m_path.c_str(), strerror(errno));
+            throw "Failed to write to the recording file";
+        }
+        bytes += n;
+        len -= (size_t) n;
+        m_offset += (uint64_t) n;
+    }
+}
+
+void FrameRecorder::record(msg_envelope_t* msg) {
+    msg_envelope_elem_body_t* elem = NULL;
+    msg_envelope_serialized_part_t* parts = NULL;
+
+    // The pixels of those frames are not in the message
+    if (msgbus_msg_envelope_get(msg, "shm_ring", &elem) == MSG_SUCCESS) {
+        throw "Cannot record frames sent through a shared memory ring";
+    }
+
+    // Record the parts exactly as they are sent over the message bus, the
+    // blobs are not copied
+    int num_parts = msgbus_msg_envelope_serialize(msg, &parts);
+    if (num_parts <= 0) {
+        throw "Failed to serialize the frame for recording";
+    }
+
+    std::vector<uint64_t> lens(num_parts);
+    uint64_t parts_offset = get_parts_offset((uint32_t) num_parts);
+    uint64_t len = parts_offset;
+    for (int i = 0; i < num_parts; i++) {
+        lens[i] = (uint64_t) parts[i].len;
+        len += round_up(lens[i] + 1);
+    }
+
+    record_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = RECORD_MAGIC;
+    header.num_parts = (uint32_t) num_parts;
+    header.len = len;
+
+    std::lock_guard<std::mutex> lk(m_mtx);
+    if (m_fd < 0) {
+        msgbus_msg_envelope_serialize_destroy(parts, num_parts);
+        throw "Recording has already been closed";
+    }
+
+    header.timestamp_ns = std::chrono::duration_cast<
+        std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_start).count();
+
+    uint64_t record_offset = m_offset;
+    try {
+        this->write_bytes(&header, sizeof(header));
+        this->write_bytes(lens.data(), sizeof(uint64_t) * num_parts);
+        this->write_bytes(
+                g_zeros, parts_offset - sizeof(header) -
+                sizeof(uint64_t) * num_parts);
+        for (int i = 0; i < num_parts; i++) {
+            this->write_bytes(parts[i].bytes, parts[i].len);
+            this->write_bytes(g_zeros, round_up(lens[i] + 1) - lens[i]);
+        }
+    } catch (const char* ex) {
+        // Drop the partially written record
+        m_offset = record_offset;
+        if (ftruncate(m_fd, (off_t) m_offset) != 0) {
+            LOG_ERROR("Failed to truncate %s: %s",
+                      m_path.c_str(), strerror(errno));
+        }
+        msgbus_msg_envelope_serialize_destroy(parts, num_parts);
+        throw ex;
+    }
+
+    m_index.push_back(record_offset);
+    msgbus_msg_envelope_serialize_destroy(parts, num_parts);
+}
+
+void FrameRecorder::record(Frame* frame) {
+    // The pixels must be part of the recorded message
+    frame->set_shm_ring(nullptr);
+
+    msg_envelope_t* msg = frame->serialize();
+    if (msg == NULL) {
+        throw "Failed to serialize the frame for recording";
+    }
+
+    try {
+        this->record(msg);
+    } catch (const char* ex) {
+        msgbus_msg_envelope_destroy(msg);
+        throw ex;
+    }
+    msgbus_msg_envelope_destroy(msg);
+}
+
+size_t FrameRecorder::get_num_frames() {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    return m_index.size();
+}
+
+void FrameRecorder::close() {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    if (m_fd < 0) {
+        return;
+    }
+
+    index_footer_t footer;
+    memset(&footer, 0, sizeof(footer));
+    footer.index_offset = m_offset;
+    footer.num_records = m_index.size();
+    memcpy(footer.magic, INDEX_MAGIC, MAGIC_LEN);
+
+    try {
+        this->write_bytes(m_index.data(), sizeof(uint64_t) * m_index.size());
+        this->write_bytes(&footer, sizeof(footer));
+    } catch (const char* ex) {
+        ::close(m_fd);
+        m_fd = -1;
+        throw ex;
+    }
+
+    ::close(m_fd);
+    m_fd = -1;
+    LOG_INFO("Recorded %lu frames to %s", m_index.size(), m_path.c_str());
+}
+
+//
+// FrameRecording
+//
+
+FrameRecording::FrameRecording(const std::string& path) :
+    m_path(path), m_mapping(), m_size(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open %s: %s", path.c_str(), strerror(errno));
+        throw "Failed to open the recording file";
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+            (size_t) st.st_size < sizeof(recording_header_t)) {
+        ::close(fd);
+        throw "Recording file is too small";
+    }
+    size_t size = (size_t) st.st_size;
+
+    // The mapping is private, so that frames can be modified without
+    // modifying the recording (only the modified pages are copied)
+    void* mem = mmap(
+            NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_NORESERVE, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        throw "Failed to map the recording file";
+    }
+    m_mapping = std::shared_ptr<void>(
+            mem, [size](void* p) { munmap(p, size); });
+    m_size = size;
+
+    const recording_header_t* header = (const recording_header_t*) mem;
+    if (memcmp(header->magic, RECORDING_MAGIC, MAGIC_LEN) != 0) {
+        throw "File is not a frame recording";
+    }
+    if (header->version != FRAME_RECORDING_VERSION) {
+        LOG_ERROR("Unsupported recording version: %u", header->version);
+        throw "Unsupported recording version";
+    }
+
+    const uint8_t* bytes = (const uint8_t*) mem;
+    const index_footer_t* footer = NULL;
+    if (size >= sizeof(recording_header_t) + sizeof(index_footer_t)) {
+        footer = (const index_footer_t*) (
+                bytes + size - sizeof(index_footer_t));
+        if (memcmp(footer->magic, INDEX_MAGIC, MAGIC_LEN) != 0 ||
+                footer->num_records > size / sizeof(uint64_t) ||
+                footer->index_offset + sizeof(uint64_t) *
+                    footer->num_records + sizeof(index_footer_t) != size) {
+            footer = NULL;
+        }
+    }
+
+    if (footer == NULL) {
+        LOG_WARN("Recording %s has no index, it was not closed",
+                 path.c_str());
+        this->scan_records();
+    } else {
+        const uint64_t* offsets = (const uint64_t*) (
+                bytes + footer->index_offset);
+        m_index.assign(offsets, offsets + footer->num_records);
+    }
+
+    LOG_INFO("Opened recording %s with %lu frames",
+             path.c_str(), m_index.size());
+}
+
+FrameRecording::FrameRecording(const FrameRecording& src) {
+    throw "This object should not be copied";
+}
+
+FrameRecording& FrameRecording::operator=(const FrameRecording& src) {
+    return *this;
+}
+
+FrameRecording::~FrameRecording() {
+    // The mapping is released once all frames read from it are freed
+}
+
+void FrameRecording::scan_records() {
+    const uint8_t* bytes = (const uint8_t*) m_mapping.get();
+    uint64_t offset = sizeof(recording_header_t);
+    while (offset + sizeof(record_header_t) <= m_size) {
+        const record_header_t* header = (const record_header_t*) (
+                bytes + offset);
+        if (header->magic != RECORD_MAGIC || header->len == 0 ||
+                header->len % FRAME_RECORDING_ALIGNMENT != 0 ||
+                header->len > m_size - offset) {
+            break;
+        }
+        m_index.push_back(offset);
+        offset += header->len;
+    }
+}
+
+const void* FrameRecording::get_record(size_t index) {
+    if (index >= m_index.size()) {
+        throw "Index out of range";
+    }
+
+    uint64_t offset = m_index[index];
+    if (offset % FRAME_RECORDING_ALIGNMENT != 0 ||
+            offset + sizeof(record_header_t) > m_size) {
+        throw "Invalid record offset in the recording index";
+    }
+
+    const record_header_t* header = (const record_header_t*) (
+            ((const uint8_t*) m_mapping.get()) + offset);
+    if (header->magic != RECORD_MAGIC || header->num_parts == 0 ||
+            header->len > m_size - offset ||
+            get_parts_offset(header->num_parts) > header->len) {
+        throw "Corrupted record in the recording";
+    }
+
+    return header;
+}
+
+size_t FrameRecording::get_num_frames() {
+    return m_index.size();
+}
+
+std::chrono::nanoseconds FrameRecording::get_timestamp(size_t index) {
+    const record_header_t* header = (const record_header_t*)
+        this->get_record(index);
+    return std::chrono::nanoseconds(header->timestamp_ns);
+}
+
+msg_envelope_t* FrameRecording::get_message(size_t index) {
+    msg_envelope_serialized_part_t* parts = NULL;
+    msg_envelope_t* msg = NULL;
+
+    const record_header_t* header = (const record_header_t*)
+        this->get_record(index);
+    const uint8_t* record = (const uint8_t*) header;
+    const uint64_t* lens = (const uint64_t*) (record + sizeof(*header));
+    int num_parts = (int) header->num_parts;
+
+    msgbus_ret_t ret = msgbus_msg_envelope_serialize_parts_new(
+            num_parts, &parts);
+    if (ret != MSG_SUCCESS) {
+        throw "Failed to initialize serialized parts";
+    }
+
+    // Every part references the mapping, which stays alive until the
+    // received blobs are freed
+    uint64_t offset = get_parts_offset(header->num_parts);
+    for (int i = 0; i < num_parts; i++) {
+        if (lens[i] >= header->len ||
+                offset + round_up(lens[i] + 1) > header->len) {
+            msgbus_msg_envelope_serialize_destroy(parts, i);
+            throw "Corrupted record in the recording";
+        }
+
+        mapping_ref_t* ref = new mapping_ref_t;
+        ref->mapping = m_mapping;
+        parts[i].shared = owned_blob_new(
+                (void*) ref, free_mapping_ref,
+                (const char*) (record + offset), (size_t) lens[i]);
+        if (parts[i].shared == NULL) {
+            delete ref;
+            msgbus_msg_envelope_serialize_destroy(parts, i);
+            throw "Failed to initialize owned blob";
+        }
+        parts[i].len = (size_t) lens[i];
+        parts[i].bytes = parts[i].shared->bytes;
+
+        offset += round_up(lens[i] + 1);
+    }
+
+    ret = msgbus_msg_envelope_deserialize(
+            CT_JSON, parts, num_parts, NULL, &msg);
+    msgbus_msg_envelope_serialize_destroy(parts, num_parts);
+    if (ret != MSG_SUCCESS) {
+        LOG_ERROR("Failed to deserialize recorded frame %lu: %d",
+                  index, ret);
+        throw "Failed to deserialize recorded frame";
+    }
+
+    return msg;
+}
+
+Frame* FrameRecording::get_frame(size_t index) {
+    msg_envelope_t* msg = this->get_message(index);
+    try {
+        return new Frame(msg);
+    } catch (const char* ex) {
+        msgbus_msg_envelope_destroy(msg);
+        throw ex;
+    }
+}
+
+//
+// FrameReplayer
+//
+
+FrameReplayer::FrameReplayer(
+        std::shared_ptr<FrameRecording> recording, FrameQueue* queue,
+        ReplayTiming timing, double fps, int loops) :
+    m_recording(recording), m_queue(queue), m_timing(timing), m_fps(fps),
+    m_loops(loops), m_th(NULL), m_stop(false), m_replayed(0), m_late(0)
+{
+    if (recording == nullptr || queue == NULL) {
+        throw "The recording and queue cannot be NULL";
+    }
+    if (timing == ReplayTiming::FIXED_RATE && fps <= 0) {
+        throw "Replay frame rate must be greater than 0";
+    }
+    if (loops < 0) {
+        throw "Number of replay loops cannot be negative";
+    }
+}
+
+FrameReplayer::FrameReplayer(const FrameReplayer& src) {
+    throw "This object should not be copied";
+}
+
+FrameReplayer& FrameReplayer::operator=(const FrameReplayer& src) {
+    return *this;
+}
+
+FrameReplayer::~FrameReplayer() {
+    this->stop();
+    if (m_th != NULL) {
+        delete m_th;
+    }
+}
+
+void FrameReplayer::start() {
+    if (m_th != NULL) {
+        throw "Replay has already been started";
+    }
+    m_th = new std::thread(&FrameReplayer::run, this);
+}
+
+void FrameReplayer::stop() {
+    m_stop.store(true);
+    this->wait();
+}
+
+void FrameReplayer::wait() {
+    if (m_th != NULL && m_th->joinable()) {
+        m_th->join();
+    }
+}
+
+uint64_t FrameReplayer::get_frames_replayed() { return m_replayed.load(); }
+uint64_t FrameReplayer::get_frames_late() { return m_late.load(); }
+
+void FrameReplayer::run() {
+    size_t num_frames = m_recording->get_num_frames();
+    if (num_frames == 0) {
+        LOG_WARN_0("Recording has no frames to replay");
+        return;
+    }
+
+    std::chrono::nanoseconds interval(
+            (int64_t) (1000000000.0 / ((m_fps > 0) ? m_fps : 30.0)));
+    std::chrono::nanoseconds first = m_recording->get_timestamp(0);
+    std::chrono::nanoseconds span =
+        m_recording->get_timestamp(num_frames - 1) - first;
+
+    // With recorded timing, the next loop starts one average frame interval
+    // after the last frame of the previous loop
+    std::chrono::nanoseconds loop_len = span + ((num_frames > 1) ?
+            span / (int64_t) (num_frames - 1) : interval);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t seq = 0;
+
+    LOG_INFO("Replaying %lu frames", num_frames);
+
+    for (int loop = 0; (m_loops == 0 || loop < m_loops) && !m_stop.load();
+            loop++) {
+        for (size_t i = 0; i < num_frames && !m_stop.load(); i++, seq++) {
+            if (m_timing != ReplayTiming::AS_FAST_AS_POSSIBLE) {
+                std::chrono::steady_clock::time_point scheduled;
+                if (m_timing == ReplayTiming::RECORDED) {
+                    scheduled = start + loop_len * loop +
+                        (m_recording->get_timestamp(i) - first);
+                } else {
+                    scheduled = start + interval * (int64_t) seq;
+                }
+
+                // Sleep in short steps, so that the replay can be stopped
+                auto now = std::chrono::steady_clock::now();
+                while (now < scheduled && !m_stop.load()) {
+                    auto remaining = scheduled - now;
+                    if (remaining > MAX_SLEEP) {
+                        std::this_thread::sleep_for(MAX_SLEEP);
+                    } else {
+                        std::this_thread::sleep_until(scheduled);
+                    }
+                    now = std::chrono::steady_clock::now();
+                }
+                if (m_stop.load()) {
+                    break;
+                }
+            }
+
+            Frame* frame = NULL;
+            try {
+                frame = m_recording->get_frame(i);
+            } catch (const char* ex) {
+                LOG_ERROR("Failed to read recorded frame %lu: %s", i, ex);
+                continue;
+            }
+
+            QueueRetCode ret = m_queue->push(frame);
+            if (ret == QueueRetCode::QUEUE_FULL) {
+                if (m_timing != ReplayTiming::AS_FAST_AS_POSSIBLE) {
+                    m_late++;
+                }
+                ret = m_queue->push_wait(frame);
+            }
+            if (ret != QueueRetCode::SUCCESS) {
+                LOG_ERROR_0("Failed to enqueue replayed frame, frame dropped");
+                delete frame;
+                continue;
+            }
+            m_replayed++;
+        }
+    }
+
+    LOG_INFO("Replayed %lu frames (%lu late)",
+             m_replayed.load(), m_late.load());
+}
+
+static uint64_t round_up(uint64_t value) {
+    return ((value + FRAME_RECORDING_ALIGNMENT - 1) /
+            FRAME_RECORDING_ALIGNMENT) * FRAME_RECORDING_ALIGNMENT;
+}
+
+static uint64_t get_parts_offset(uint32_t num_parts) {
+    return round_up(sizeof(record_header_t) + sizeof(uint64_t) * num_parts);
+}
+
+static void free_mapping_ref(void* varg) {
+    mapping_ref_t* ref = (mapping_ref_t*) varg;
+    delete ref;
+}
@@ -0,0 +1,126 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief @c LoadShedder implementation
+ */
+
+#include <cstring>
+#include <eii/utils/logger.h>
+
+#include "eii/udf/load_shedder.h"
+
+using namespace eii::udf;
+using namespace eii::utils;
+
+bool eii::udf::parse_shed_policy(const char* name, ShedPolicy* policy) {
+    if(strcmp(name, "block") == 0) {
+        *policy = SHED_BLOCK;
+    } else if(strcmp(name, "drop_newest") == 0) {
+        *policy = SHED_DROP_NEWEST;
+    } else if(strcmp(name, "drop_oldest") == 0) {
+        *policy = SHED_DROP_OLDEST;
+    } else if(strcmp(name, "keep_every_nth") == 0) {
+        *policy = SHED_KEEP_EVERY_NTH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+LoadShedder::LoadShedder(ShedPolicy policy, int keep_every) :
+    m_policy(policy), m_keep_every(keep_every), m_overflows(0), m_shed(0)
+{
+    if(m_keep_every <= 0) {
+        throw "Load shedder keep_every must be greater than 0";
+    }
+}
+
+LoadShedder::LoadShedder(const LoadShedder& src) {
+    throw "This object should not be copied";
+}
+
+LoadShedder& LoadShedder::operator=(const LoadShedder& src) {
+    return *this;
+}
+
+bool LoadShedder::push(FrameQueue* queue, Frame* frame, bool* blocked) {
+    if(blocked != NULL) *blocked = false;
+
+    QueueRetCode ret = queue->push(frame);
+    if(ret == QueueRetCode::SUCCESS) {
+        return true;
+    }
+
+    bool wait = false;
+    if(ret == QueueRetCode::QUEUE_FULL) {
+        switch(m_policy) {
+            case SHED_BLOCK:
+                wait = true;
+                break;
+            case SHED_DROP_NEWEST:
+                break;
+            case SHED_DROP_OLDEST:
+                // Make room by dropping the stalest queued frame. The queue
+                // may be drained by its consumers at the same time, in which
+                // case the push succeeds without dropping anything.
+                while(ret == QueueRetCode::QUEUE_FULL) {
+                    if(!queue->empty()) {
+                        Frame* oldest = queue->pop();
+                        if(oldest != NULL) {
+                            delete oldest;
+                            m_shed++;
+                        }
+                    }
+                    ret = queue->push(frame);
+                }
+                if(ret == QueueRetCode::SUCCESS) {
+                    return true;
+                }
+                break;
+            case SHED_KEEP_EVERY_NTH:
+                wait = (++m_overflows % m_keep_every) == 0;
+                break;
+        }
+    }
+
+    if(wait) {
+        if(blocked != NULL) *blocked = true;
+        ret = queue->push_wait(frame);
+        if(ret == QueueRetCode::SUCCESS) {
+            return true;
+        }
+        LOG_ERROR_0("Failed to enqueue frame, frame dropped");
+    } else {
+        LOG_DEBUG_0("Queue full, frame dropped");
+    }
+
+    delete frame;
+    m_shed++;
+    return false;
+}
+
+ShedPolicy LoadShedder::get_policy() {
+    return m_policy;
+}
+
+uint64_t LoadShedder::get_shed() {
+    return m_shed.load();
+}
@@ -30,6 +30,7 @@
 #include <sstream>
 #include <eii/utils/logger.h>
 #include "eii/udf/native_udf_handle.h"
+#include "eii/udf/frame_buffer_pool.h"
 
 #define DELIM ':'
 
@@ -148,52 +149,203 @@ void free_native_cv_frame(void* varg) {
     delete frame;
 }
 
-UdfRetCode NativeUdfHandle::process(Frame* frame) {
-    UdfRetCode ret = UdfRetCode::UDF_OK;
-    int w = frame->get_width();
-    int h = frame->get_height();
-    int c = frame->get_channels();
+/**
+ * Get the pixel format and height of the frame produced by a native UDF.
+ *
+ * @param frame        - Frame given to the UDF
+ * @param output       - Output of the UDF
+ * @param pixel_format - Output pixel format
+ * @param height       - Output frame height
+ * @return bool, false if the output's type has no matching pixel format
+ */
+static bool get_output_format(
+        Frame* frame, const cv::Mat& output, PixelFormat* pixel_format,
+        int* height) {
+    *height = output.rows;
+    switch(output.depth()) {
+        case CV_8U:  *pixel_format = PixelFormat::U8;  break;
+        case CV_16U: *pixel_format = PixelFormat::U16; break;
+        case CV_16S: *pixel_format = PixelFormat::S16; break;
+        case CV_32F: *pixel_format = PixelFormat::F32; break;
+        default:     return false;
+    }
 
-    //TODO: Do we want to default to 8bit?
+    // Planar YUV frames keep their pixel format if the UDF produced a buffer
+    // with the same layout
+    PixelFormat input_format = frame->get_pixel_format(0);
+    if((input_format == PixelFormat::NV12 ||
+                input_format == PixelFormat::I420) &&
+            output.type() == CV_8UC1 &&
+            output.rows == frame->get_rows(0) &&
+            output.cols == frame->get_width(0)) {
+        *pixel_format = input_format;
+        *height = frame->get_height(0);
+    }
 
-    cv::Mat* mat_frame = new cv::Mat(h, w, CV_8UC(c), frame->get_data(0));
+    return true;
+}
 
-    // Output frame must be initialized to an empty frame
-    cv::Mat* output = new cv::Mat();
+/**
+ * Wrap the pixels of a frame in a @c cv::Mat for a native UDF.
+ *
+ * @param frame     - Frame to wrap
+ * @param read_only - Whether the UDF only reads the pixels
+ * @return @c cv::Mat
+ */
+static cv::Mat wrap_frame(Frame* frame, bool read_only) {
+    // Read-only UDFs must not modify the frame in-place, which allows the
+    // frame to be re-published with the encoded bytes it was received with
+    void* data = NULL;
+    if(read_only) {
+        data = const_cast<void*>(frame->get_readonly_data(0));
+    } else {
+        data = frame->get_data(0);
+    }
 
-    msg_envelope_t* meta_data = frame->get_meta_data();
+    // The cv::Mat type matches the frame's pixel format (planar YUV frames
+    // are single channel 8-bit with all planes stacked), and padded rows are
+    // exposed to the UDF through the cv::Mat's step
+    return cv::Mat(
+            frame->get_rows(), frame->get_width(), frame->get_cv_type(), data,
+            frame->get_stride(0));
+}
 
-    try {
-        ret = m_udf->process(*mat_frame, *output, meta_data);
-
-        // Check if the UDF has changed / modified the frame it was given. In
-        // this case, output will no longer be empty (like it was after its
-        // initialization above).
-        //
-        // NOTE: output->data and mat_frame->data (i.e. the underlying void* of
-        // the frame's data) must not be pointing to the same address. In this
-        // case, the UDF pointed output to an unchanged vesion of the frame
-        // it was given. In this case, the frame was not actually modified.
-        // To avoid potential memory issues, do not tell the Frame object to
-        // change the underlying data.
-        if(!output->empty() && output->data != mat_frame->data) {
-            LOG_DEBUG("Setting frame with new UDF frame");
-            frame->set_data(
-                    0, (void*) output, free_native_cv_frame, (void*) output->data,
-                    output->cols, output->rows, output->channels());
+/**
+ * Create the (empty) output frame for a native UDF. If the UDF allocates the
+ * output (i.e. output.create(), cv::resize(), etc.), the pixels are drawn
+ * from the frame buffer pool.
+ *
+ * @return @c cv::Mat
+ */
+static cv::Mat new_output() {
+    cv::Mat output;
+    output.allocator = FrameBufferPool::get_instance()->get_mat_allocator();
+    return output;
+}
+
+/**
+ * Replace the pixels of the frame with the output of a native UDF, if the
+ * UDF produced one.
+ *
+ * @param frame     - Frame given to the UDF
+ * @param mat_frame - @c cv::Mat given to the UDF
+ * @param output    - Output of the UDF
+ * @param ret       - Return code of the UDF
+ * @return @c UdfRetCode, @c UDF_ERROR if the output is unusable
+ */
+static UdfRetCode set_output(
+        Frame* frame, const cv::Mat& mat_frame, const cv::Mat& output,
+        UdfRetCode ret) {
+    // Check if the UDF has changed / modified the frame it was given. In
+    // this case, output will no longer be empty (like it was after its
+    // initialization).
+    //
+    // NOTE: output.data and mat_frame.data (i.e. the underlying void* of
+    // the frame's data) must not be pointing to the same address. In this
+    // case, the UDF pointed output to an unchanged vesion of the frame
+    // it was given. In this case, the frame was not actually modified.
+    // To avoid potential memory issues, do not tell the Frame object to
+    // change the underlying data.
+    PixelFormat pixel_format = PixelFormat::U8;
+    int height = 0;
+    if(!output.empty() && output.data != mat_frame.data &&
+            !get_output_format(frame, output, &pixel_format, &height)) {
+        LOG_ERROR("Unsupported output type from UDF: %d", output.type());
+        ret = UdfRetCode::UDF_ERROR;
+    } else if(!output.empty() && output.data != mat_frame.data) {
+        LOG_DEBUG("Setting frame with new UDF frame");
+
+        // If the output does not own its memory, it is a view into the
+        // frame given to the UDF (e.g. a crop of it), which is released
+        // by set_data(), so in that case the output must be copied.
+        // Views into memory owned by the output (e.g. a crop of a
+        // frame the UDF allocated) are kept as-is with their stride.
+        cv::Mat* owned = new cv::Mat();
+        if(output.u == NULL) {
+            owned->allocator =
+                FrameBufferPool::get_instance()->get_mat_allocator();
+            output.copyTo(*owned);
         } else {
-            delete output;
+            *owned = output;
         }
 
-        if (ret == UdfRetCode::UDF_ERROR)
-            LOG_ERROR_0("Error in UDF process() method");
+        frame->set_data(
+                0, (void*) owned, free_native_cv_frame, (void*) owned->data,
+                owned->cols, height, owned->channels(),
+                owned->step[0], pixel_format);
+    }
+
+    if (ret == UdfRetCode::UDF_ERROR)
+        LOG_ERROR_0("Error in UDF process() method");
+
+    return ret;
+}
+
+UdfRetCode NativeUdfHandle::process(Frame* frame) {
+    UdfRetCode ret = UdfRetCode::UDF_OK;
+
+    try {
+        // NOTE: Frames received encoded are decoded here, so a corrupt frame
+        // fails here instead of when it was received
+        cv::Mat mat_frame = wrap_frame(frame, this->is_read_only());
+        cv::Mat output = new_output();
+        msg_envelope_t* meta_data = frame->get_meta_data();
+
+        ret = m_udf->process(mat_frame, output, meta_data);
+        ret = set_output(frame, mat_frame, output, ret);
     } catch(const std::exception& exc) {
         LOG_ERROR("Error in UDF process() method: %s", exc.what());
         ret = UdfRetCode::UDF_ERROR;
-        delete output;
+    } catch(const char* ex) {
+        LOG_ERROR("Error in UDF process() method: %s", ex);
+        ret = UdfRetCode::UDF_ERROR;
     }
 
-    delete mat_frame;
-
     return ret;
 }
+
+void NativeUdfHandle::process_batch(
+        std::vector<Frame*>& frames, std::vector<UdfRetCode>& rets) {
+    // Frames which fail to decode are left out of the batch, so that they
+    // do not fail the other frames
+    std::vector<size_t> indexes;
+    std::vector<cv::Mat> mat_frames;
+    std::vector<cv::Mat> outputs;
+    std::vector<msg_envelope_t*> metas;
+    for(size_t i = 0; i < frames.size(); i++) {
+        try {
+            mat_frames.push_back(wrap_frame(frames[i], this->is_read_only()));
+        } catch(const char* ex) {
+            LOG_ERROR("Failed to get the pixels of batch frame %lu: %s",
+                      i, ex);
+            rets[i] = UdfRetCode::UDF_ERROR;
+            continue;
+        }
+        indexes.push_back(i);
+        outputs.push_back(new_output());
+        metas.push_back(frames[i]->get_meta_data());
+    }
+    if(indexes.empty()) {
+        return;
+    }
+
+    std::vector<UdfRetCode> batch_rets;
+    for(auto i : indexes) {
+        batch_rets.push_back(rets[i]);
+    }
+
+    try {
+        m_udf->process_batch(mat_frames, outputs, metas, batch_rets);
+        for(size_t j = 0; j < indexes.size(); j++) {
+            size_t i = indexes[j];
+            rets[i] = set_output(
+                    frames[i], mat_frames[j], outputs[j], batch_rets[j]);
+        }
+    } catch(const std::exception& exc) {
+        LOG_ERROR("Error in UDF process_batch() method: %s", exc.what());
+        for(auto i : indexes) rets[i] = UdfRetCode::UDF_ERROR;
+    } catch(const char* ex) {
+        LOG_ERROR("Error in UDF process_batch() method: %s", ex);
+        for(auto i : indexes) rets[i] = UdfRetCode::UDF_ERROR;
+    }
+}
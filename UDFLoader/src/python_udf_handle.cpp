@@ -37,12 +37,14 @@
 using namespace eii::udf;
 
 #define EII_UDF_PROCESS "process"
+#define EII_UDF_PROCESS_BATCH "process_batch"
 
 PythonUdfHandle::PythonUdfHandle(std::string name, int max_workers) :
     UdfHandle(name, max_workers)
 {
     m_udf_obj = NULL;
     m_udf_func = NULL;
+    m_udf_batch_func = NULL;
 }
 
 PythonUdfHandle::~PythonUdfHandle() {
@@ -57,6 +59,10 @@ PythonUdfHandle::~PythonUdfHandle() {
     if(m_udf_func != NULL && m_udf_func != Py_None)
         Py_DECREF(m_udf_func);
 
+    LOG_DEBUG_0("Releasing the process_batch function");
+    if(m_udf_batch_func != NULL)
+        Py_DECREF(m_udf_batch_func);
+
     LOG_DEBUG_0("Releasing process the Python object");
     if(m_udf_obj != NULL && m_udf_obj != Py_None)
         Py_DECREF(m_udf_obj);
@@ -123,6 +129,13 @@ bool PythonUdfHandle::initialize(config_t* config) {
         return false;
     }
 
+    // The process_batch() method is optional
+    if(PyObject_HasAttrString(m_udf_obj, EII_UDF_PROCESS_BATCH)) {
+        LOG_DEBUG("UDF %s supports batch processing", get_name().c_str());
+        m_udf_batch_func = PyObject_GetAttrString(
+                m_udf_obj, EII_UDF_PROCESS_BATCH);
+    }
+
     PyGILState_Release(gstate);
 
     return true;
@@ -143,65 +156,206 @@ void free_np_frame(void* varg) {
     LOG_DEBUG_0("Released");
 }
 
-UdfRetCode PythonUdfHandle::process(Frame* frame) {
-    // Get number of frames in Frame object
-    int num_frames = frame->get_number_of_frames();
-    PyObject* py_frame = Py_None;
-    PyObject* output = Py_None;
-
-    LOG_DEBUG_0("Aquiring the GIL");
-    PyGILState_STATE gstate;
-    gstate = PyGILState_Ensure();
-    LOG_DEBUG_0("Acquired GIL");
+/**
+ * Get the NumPy dtype for the given pixel format.
+ *
+ * @param pixel_format - Pixel format
+ * @param elem_size    - Output size in bytes of the dtype
+ * @return NumPy type number
+ */
+static int pixel_format_to_npy(PixelFormat pixel_format, npy_intp* elem_size) {
+    switch(pixel_format) {
+        case PixelFormat::U16:  *elem_size = 2; return NPY_UINT16;
+        case PixelFormat::S16:  *elem_size = 2; return NPY_INT16;
+        case PixelFormat::F32:  *elem_size = 4; return NPY_FLOAT32;
+        case PixelFormat::U8:
+        case PixelFormat::NV12:
+        case PixelFormat::I420:
+        default:                *elem_size = 1; return NPY_UINT8;
+    }
+}
 
-    if (num_frames == 1) {
-        std::vector<npy_intp> sizes;
-        sizes.push_back(frame->get_height());
-        sizes.push_back(frame->get_width());
-        sizes.push_back(frame->get_channels());
-        npy_intp* dims = sizes.data();
+/**
+ * Get the pixel format for the given NumPy dtype.
+ *
+ * @param type         - NumPy type number
+ * @param pixel_format - Output pixel format
+ * @return bool, false if there is no matching pixel format
+ */
+static bool npy_to_pixel_format(int type, PixelFormat* pixel_format) {
+    switch(type) {
+        case NPY_UINT8:   *pixel_format = PixelFormat::U8;  return true;
+        case NPY_UINT16:  *pixel_format = PixelFormat::U16; return true;
+        case NPY_INT16:   *pixel_format = PixelFormat::S16; return true;
+        case NPY_FLOAT32: *pixel_format = PixelFormat::F32; return true;
+        default:          return false;
+    }
+}
 
-        // Create new NumPy Array
-        py_frame = PyArray_SimpleNewFromData(
-                3, dims, NPY_UINT8, (void*) frame->get_data(0));
+static PyObject* new_frame_array(Frame* frame, int index, bool read_only) {
+    // Planar YUV frames are exposed as a single channel array with all of the
+    // planes stacked, i.e. (1.5 * height, width, 1)
+    npy_intp dims[3] = {
+        frame->get_rows(index), frame->get_width(index),
+        frame->get_channels(index) };
+
+    // NOTE: The data must be retrieved before the stride, because getting
+    // writable data may copy the pixels of a shared frame
+    void* data = NULL;
+    if(!read_only) {
+        data = frame->get_data(index);
     } else {
-        PyObject* py_temp_frame = Py_None;
+        data = const_cast<void*>(frame->get_readonly_data(index));
+    }
+
+    // Padded rows are exposed to the UDF through the array's strides
+    npy_intp elem_size = 1;
+    int type = pixel_format_to_npy(frame->get_pixel_format(index), &elem_size);
+    npy_intp strides[3] = {
+        (npy_intp) frame->get_stride(index), dims[2] * elem_size, elem_size };
+
+    if(!read_only) {
+        return PyArray_New(
+                &PyArray_Type, 3, dims, type, strides, data, 0,
+                NPY_ARRAY_WRITEABLE, NULL);
+    }
+
+    // Read-only UDFs get a non-writable array, so that in-place changes to
+    // the frame raise an error in the UDF instead of being silently lost when
+    // the frame is re-published with the encoded bytes it was received with
+    return PyArray_New(
+            &PyArray_Type, 3, dims, type, strides, data, 0, 0, NULL);
+}
+
+/**
+ * Get the pixel format and height of the frame produced by a Python UDF.
+ *
+ * @param arr          - Output array of the UDF
+ * @param frame        - Frame whose data is replaced
+ * @param index        - Index of the frame
+ * @param pixel_format - Output pixel format
+ * @param height       - Output frame height
+ * @return bool, false if the array's dtype has no matching pixel format
+ */
+static bool get_output_format(
+        PyArrayObject* arr, Frame* frame, int index,
+        PixelFormat* pixel_format, int* height) {
+    npy_intp* shape = PyArray_SHAPE(arr);
+    *height = (int) shape[0];
+    if(!npy_to_pixel_format(PyArray_TYPE(arr), pixel_format)) {
+        return false;
+    }
+
+    // Planar YUV frames keep their pixel format if the UDF produced an array
+    // with the same layout
+    PixelFormat input_format = frame->get_pixel_format(index);
+    if((input_format == PixelFormat::NV12 ||
+                input_format == PixelFormat::I420) &&
+            *pixel_format == PixelFormat::U8 &&
+            shape[0] == frame->get_rows(index) &&
+            shape[1] == frame->get_width(index) && shape[2] == 1) {
+        *pixel_format = input_format;
+        *height = frame->get_height(index);
+    }
+
+    return true;
+}
+
+/**
+ * Get the array to set as the new data of a frame from the output of a UDF.
+ *
+ * Arrays of interleaved pixels are referenced without copying, even if their
+ * rows are padded (e.g. a crop of a larger array). Any other layout, or a
+ * view into the frame's current pixels (which are released when the frame's
+ * data is replaced), is copied into a new C-contiguous array.
+ *
+ * @param arr    - Output array of the UDF
+ * @param frame  - Frame whose data is replaced
+ * @param index  - Index of the frame
+ * @param stride - Output row stride of the returned array
+ * @return New reference to the array, NULL if copying the array fails
+ */
+static PyArrayObject* get_output_array(
+        PyArrayObject* arr, Frame* frame, int index, size_t* stride) {
+    npy_intp* shape = PyArray_SHAPE(arr);
+    npy_intp* strides = PyArray_STRIDES(arr);
+    npy_intp elem_size = PyArray_ITEMSIZE(arr);
+
+    const uint8_t* data = (const uint8_t*) PyArray_DATA(arr);
+    const uint8_t* current = (const uint8_t*) frame->get_readonly_data(index);
+    size_t current_len = frame->get_stride(index) * frame->get_height(index);
+    bool is_view = data >= current && data < current + current_len;
+
+    if(!is_view && strides[2] == elem_size &&
+            strides[1] == shape[2] * elem_size &&
+            strides[0] >= shape[1] * shape[2] * elem_size) {
+        Py_INCREF(arr);
+        *stride = (size_t) strides[0];
+        return arr;
+    }
+
+    LOG_DEBUG_0("Copying UDF output into a contiguous array");
+    *stride = 0;
+    return (PyArrayObject*) PyArray_NewCopy(arr, NPY_CORDER);
+}
+
+/**
+ * Create the Python representation of the frames of a @c Frame, i.e. a
+ * NumPy array for a single frame or a list of arrays for multiple frames.
+ *
+ * \note Must be called with the GIL held.
+ *
+ * \note Frames received encoded are decoded here, so a corrupt frame fails
+ *      here instead of when it was received.
+ *
+ * @param frame     - Frame to convert
+ * @param read_only - Whether the UDF only reads the pixels
+ * @return New reference, NULL on failure
+ */
+static PyObject* new_py_frame(Frame* frame, bool read_only) {
+    PyObject* py_frame = NULL;
+    try {
+        // Get number of frames in Frame object
+        int num_frames = frame->get_number_of_frames();
+        if (num_frames == 1) {
+            // Create new NumPy Array
+            return new_frame_array(frame, 0, read_only);
+        }
+
         py_frame = PyList_New(num_frames);
         for (int i = 0; i < num_frames; i++) {
-            std::vector<npy_intp> sizes;
-            sizes.push_back(frame->get_height(i));
-            sizes.push_back(frame->get_width(i));
-            sizes.push_back(frame->get_channels(i));
-            npy_intp* dims = sizes.data();
-
             // Create new NumPy Array
-            py_temp_frame = PyArray_SimpleNewFromData(
-                    3, dims, NPY_UINT8, (void*) frame->get_data(i));
+            PyObject* py_temp_frame = new_frame_array(frame, i, read_only);
 
             // Append py_frame to py_list
             int result = PyList_SetItem(py_frame, i, py_temp_frame);
             if (result != 0) {
-                throw "Failed to set py_frame in py_list";
+                LOG_ERROR_0("Failed to set py_frame in py_list");
+                Py_DECREF(py_frame);
+                return NULL;
             }
         }
+    } catch(const char* ex) {
+        LOG_ERROR("Failed to get the frame's pixels: %s", ex);
+        if(py_frame != NULL) Py_DECREF(py_frame);
+        return NULL;
     }
+    return py_frame;
+}
 
-    LOG_DEBUG_0("Before process call");
-    UdfRetCode ret = call_udf(
-            m_udf_obj, py_frame, output, frame->get_meta_data());
-    LOG_DEBUG_0("process call done");
-
-    if(PyErr_Occurred() != NULL) {
-        Py_DECREF(py_frame);
-        LOG_ERROR_0("Error in UDF process() method");
-        PyErr_Print();
-        LOG_DEBUG_0("Releasing the GIL");
-        PyGILState_Release(gstate);
-        LOG_DEBUG_0("Released");
-        return UdfRetCode::UDF_ERROR;
-    }
-    LOG_DEBUG_0("process done");
-
+/**
+ * Replace the data of the frame with the output of a Python UDF.
+ *
+ * \note Must be called with the GIL held.
+ *
+ * @param frame    - Frame given to the UDF
+ * @param ret      - Return code of the UDF
+ * @param output   - Output frame(s) of the UDF (reference is stolen)
+ * @param py_frame - Frame(s) given to the UDF
+ * @return @c UdfRetCode
+ */
+static UdfRetCode set_output(
+        Frame* frame, UdfRetCode ret, PyObject* output, PyObject* py_frame) {
     // NOTE: If output == py_frame, then the UDF returned the same Python
     // object for the frame as was passed to it, this does not count as a
     // changed or updated frame.
@@ -210,8 +364,11 @@ UdfRetCode PythonUdfHandle::process(Frame* frame) {
 
         // If output is a list of numpy frames, call set_data for all
         // available numpy frames. Else set only for first frame
-        if (!PyList_Check(output)) {
-            PyArrayObject* py_array = (PyArrayObject*) output;
+        bool is_list = PyList_Check(output);
+        Py_ssize_t n = is_list ? PyList_Size(output) : 1;
+        for (int i = 0; i < n; i++) {
+            PyArrayObject* py_array = (PyArrayObject*) (
+                    is_list ? PyList_GetItem(output, i) : output);
 
             int dims = PyArray_NDIM(py_array);
             if(dims < 3 || dims > 3) {
@@ -219,50 +376,37 @@ UdfRetCode PythonUdfHandle::process(Frame* frame) {
                     "NumPy array has too many dimensions must be 3 not %d",
                     dims);
                 Py_DECREF(output);
-                Py_DECREF(py_frame);
-
-                LOG_DEBUG_0("Releasing the GIL");
-                PyGILState_Release(gstate);
-                LOG_DEBUG_0("Released");
-
                 return UdfRetCode::UDF_ERROR;
             }
 
-            npy_intp* shape = PyArray_SHAPE(py_array);
-            frame->set_data(
-                    0, (void*) output, free_np_frame, PyArray_DATA(py_array),
-                    shape[1], shape[0], shape[2]);
-
-            ret = UDF_OK;
-        } else {
-            Py_ssize_t n = PyList_Size(output);
-            for (int i = 0; i < n; i++) {
-                PyObject* item = PyList_GetItem(output, i);
-
-                PyArrayObject* py_array = (PyArrayObject*) item;
-                int dims = PyArray_NDIM(py_array);
-                if(dims < 3 || dims > 3) {
-                    LOG_ERROR(
-                        "NumPy array has too many dimensions must be 3 not %d",
-                        dims);
-                    Py_DECREF(output);
-                    Py_DECREF(py_frame);
-
-                    LOG_DEBUG_0("Releasing the GIL");
-                    PyGILState_Release(gstate);
-                    LOG_DEBUG_0("Released");
-
-                    return UdfRetCode::UDF_ERROR;
+            PixelFormat pixel_format = PixelFormat::U8;
+            int height = 0;
+            PyArrayObject* frame_array = NULL;
+            size_t stride = 0;
+            if(!get_output_format(
+                        py_array, frame, i, &pixel_format, &height)) {
+                LOG_ERROR("Unsupported NumPy dtype: %d",
+                          PyArray_TYPE(py_array));
+            } else {
+                frame_array = get_output_array(py_array, frame, i, &stride);
+                if(frame_array == NULL) {
+                    LOG_ERROR_0("Failed to copy the UDF's output array");
+                    PyErr_Print();
                 }
-
-                npy_intp* shape = PyArray_SHAPE(py_array);
-
-                frame->set_data(
-                        i, (void*) item, free_np_frame, PyArray_DATA(py_array),
-                        shape[1], shape[0], shape[2]);
             }
-            ret = UDF_OK;
+            if(frame_array == NULL) {
+                Py_DECREF(output);
+                return UdfRetCode::UDF_ERROR;
+            }
+
+            npy_intp* shape = PyArray_SHAPE(frame_array);
+            frame->set_data(
+                    i, (void*) frame_array, free_np_frame,
+                    PyArray_DATA(frame_array), shape[1], height, shape[2],
+                    stride, pixel_format);
         }
+        Py_DECREF(output);
+        ret = UDF_OK;
     } else if (output == py_frame) {
         // If output == py_frame, then an extra DECREF is required to make sure
         // the Python NumPy array is released (this will not free the
@@ -273,6 +417,37 @@ UdfRetCode PythonUdfHandle::process(Frame* frame) {
         ret = UDF_OK;
     }
 
+    return ret;
+}
+
+UdfRetCode PythonUdfHandle::process(Frame* frame) {
+    PyObject* output = Py_None;
+
+    LOG_DEBUG_0("Aquiring the GIL");
+    PyGILState_STATE gstate;
+    gstate = PyGILState_Ensure();
+    LOG_DEBUG_0("Acquired GIL");
+
+    PyObject* py_frame = new_py_frame(frame, this->is_read_only());
+    if(py_frame == NULL) {
+        PyGILState_Release(gstate);
+        return UdfRetCode::UDF_ERROR;
+    }
+
+    LOG_DEBUG_0("Before process call");
+    UdfRetCode ret = call_udf(
+            m_udf_obj, py_frame, output, frame->get_meta_data());
+    LOG_DEBUG_0("process call done");
+
+    if(PyErr_Occurred() != NULL) {
+        LOG_ERROR_0("Error in UDF process() method");
+        PyErr_Print();
+        ret = UdfRetCode::UDF_ERROR;
+    } else {
+        LOG_DEBUG_0("process done");
+        ret = set_output(frame, ret, output, py_frame);
+    }
+
     Py_DECREF(py_frame);
 
     LOG_DEBUG_0("Releasing the GIL");
@@ -281,3 +456,72 @@ UdfRetCode PythonUdfHandle::process(Frame* frame) {
 
     return ret;
 }
+
+void PythonUdfHandle::process_batch(
+        std::vector<Frame*>& frames, std::vector<UdfRetCode>& rets) {
+    // UDFs without a process_batch() method get one frame at a time
+    if(m_udf_batch_func == NULL) {
+        UdfHandle::process_batch(frames, rets);
+        return;
+    }
+
+    std::vector<msg_envelope_t*> metas;
+
+    LOG_DEBUG_0("Aquiring the GIL");
+    PyGILState_STATE gstate;
+    gstate = PyGILState_Ensure();
+    LOG_DEBUG_0("Acquired GIL");
+
+    // Frames which fail to decode are left out of the batch, so that they
+    // do not fail the other frames
+    std::vector<int> indexes;
+    std::vector<UdfRetCode> batch_rets;
+    PyObject* py_frames = PyList_New(0);
+    for(int i = 0; i < (int) frames.size(); i++) {
+        PyObject* py_frame = new_py_frame(frames[i], this->is_read_only());
+        if(py_frame == NULL) {
+            rets[i] = UdfRetCode::UDF_ERROR;
+            continue;
+        }
+        PyList_Append(py_frames, py_frame);
+        Py_DECREF(py_frame);
+        indexes.push_back(i);
+        batch_rets.push_back(rets[i]);
+        metas.push_back(frames[i]->get_meta_data());
+    }
+    int num_frames = (int) indexes.size();
+    if(num_frames == 0) {
+        Py_DECREF(py_frames);
+        PyGILState_Release(gstate);
+        return;
+    }
+    std::vector<PyObject*> outputs(num_frames, Py_None);
+
+    LOG_DEBUG_0("Before process_batch call");
+    call_udf_batch(
+            m_udf_obj, py_frames, metas.data(), batch_rets.data(),
+            outputs.data(), num_frames);
+    LOG_DEBUG_0("process_batch call done");
+
+    if(PyErr_Occurred() != NULL) {
+        LOG_ERROR_0("Error in UDF process_batch() method");
+        PyErr_Print();
+        for(int j = 0; j < num_frames; j++) {
+            if(outputs[j] != Py_None) Py_DECREF(outputs[j]);
+            rets[indexes[j]] = UdfRetCode::UDF_ERROR;
+        }
+    } else {
+        for(int j = 0; j < num_frames; j++) {
+            int i = indexes[j];
+            rets[i] = set_output(
+                    frames[i], batch_rets[j], outputs[j],
+                    PyList_GET_ITEM(py_frames, j));
+        }
+    }
+
+    Py_DECREF(py_frames);
+
+    LOG_DEBUG_0("Releasing the GIL");
+    PyGILState_Release(gstate);
+    LOG_DEBUG_0("Released");
+}
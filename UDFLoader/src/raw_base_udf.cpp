@@ -36,3 +36,10 @@ RawBaseUdf::~RawBaseUdf() {
     // be internally wrapped by a @c UdfHandle which manages the memory for
     // the configuration object.
 }
+
+void RawBaseUdf::process_batch(
+        std::vector<Frame*>& frames, std::vector<UdfRetCode>& rets) {
+    for(size_t i = 0; i < frames.size(); i++) {
+        rets[i] = this->process(frames[i]);
+    }
+}
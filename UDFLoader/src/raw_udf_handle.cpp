@@ -161,7 +161,25 @@ UdfRetCode RawUdfHandle::process(Frame* frame) {
     } catch(const std::exception& exc) {
         LOG_ERROR("Error in UDF process() method: %s", exc.what());
         ret = UdfRetCode::UDF_ERROR;
+    } catch(const char* ex) {
+        // e.g. a received frame which fails to decode when its pixels are
+        // accessed
+        LOG_ERROR("Error in UDF process() method: %s", ex);
+        ret = UdfRetCode::UDF_ERROR;
     }
 
     return ret;
 }
+
+void RawUdfHandle::process_batch(
+        std::vector<Frame*>& frames, std::vector<UdfRetCode>& rets) {
+    try {
+        m_udf->process_batch(frames, rets);
+    } catch(const std::exception& exc) {
+        LOG_ERROR("Error in UDF process_batch() method: %s", exc.what());
+        rets.assign(frames.size(), UdfRetCode::UDF_ERROR);
+    } catch(const char* ex) {
+        LOG_ERROR("Error in UDF process_batch() method: %s", ex);
+        rets.assign(frames.size(), UdfRetCode::UDF_ERROR);
+    }
+}
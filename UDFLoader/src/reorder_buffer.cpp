@@ -0,0 +1,150 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief @c ReorderBuffer implementation
+ */
+
+#include <eii/utils/logger.h>
+
+#include "eii/udf/reorder_buffer.h"
+
+using namespace eii::udf;
+
+ReorderBuffer::ReorderBuffer(
+        std::function<void(Frame*)> release, size_t capacity,
+        int max_latency_ms, uint64_t first_seq) :
+    m_next_seq(first_seq), m_capacity(capacity),
+    m_max_latency(max_latency_ms), m_release(release),
+    m_skipped(0), m_late(0)
+{
+    if(m_capacity == 0) {
+        throw "Reorder buffer capacity must be greater than 0";
+    }
+    if(max_latency_ms < 0) {
+        throw "Reorder buffer latency cap must not be negative";
+    }
+}
+
+ReorderBuffer::ReorderBuffer(const ReorderBuffer& src) {
+    throw "This object should not be copied";
+}
+
+ReorderBuffer& ReorderBuffer::operator=(const ReorderBuffer& src) {
+    return *this;
+}
+
+ReorderBuffer::~ReorderBuffer() {
+    for(auto& it : m_pending) {
+        if(it.second.frame != NULL) {
+            delete it.second.frame;
+        }
+    }
+}
+
+void ReorderBuffer::push(uint64_t seq, Frame* frame) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+
+    // Wait for room in the buffer, unless the frame can be released right
+    // away. The wait is bounded by the latency cap of the missing frame.
+    while(seq > m_next_seq && m_pending.size() >= m_capacity) {
+        if(m_cv.wait_until(lk, gap_deadline()) == std::cv_status::timeout &&
+                !m_pending.empty() &&
+                std::chrono::steady_clock::now() >= gap_deadline()) {
+            skip_gap();
+        }
+    }
+
+    if(seq < m_next_seq) {
+        LOG_DEBUG("Frame %lu arrived after it was skipped, dropping it",
+                  (unsigned long) seq);
+        m_late++;
+        delete frame;
+        return;
+    }
+
+    Entry entry = { frame, std::chrono::steady_clock::now() };
+    m_pending[seq] = entry;
+    release_ready();
+
+    if(!m_pending.empty() &&
+            std::chrono::steady_clock::now() >= gap_deadline()) {
+        skip_gap();
+    }
+}
+
+void ReorderBuffer::skip(uint64_t seq) {
+    std::lock_guard<std::mutex> lk(m_mtx);
+
+    // Never blocks, so that dropping a frame cannot stall a worker
+    if(seq < m_next_seq) {
+        return;
+    }
+    Entry entry = { NULL, std::chrono::steady_clock::now() };
+    m_pending[seq] = entry;
+    release_ready();
+}
+
+void ReorderBuffer::flush() {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    if(!m_pending.empty() &&
+            std::chrono::steady_clock::now() >= gap_deadline()) {
+        skip_gap();
+    }
+}
+
+uint64_t ReorderBuffer::get_skipped() {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    return m_skipped;
+}
+
+uint64_t ReorderBuffer::get_late() {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    return m_late;
+}
+
+void ReorderBuffer::release_ready() {
+    bool released = false;
+    auto it = m_pending.begin();
+    while(it != m_pending.end() && it->first == m_next_seq) {
+        if(it->second.frame != NULL) {
+            m_release(it->second.frame);
+        }
+        it = m_pending.erase(it);
+        m_next_seq++;
+        released = true;
+    }
+    if(released) {
+        m_cv.notify_all();
+    }
+}
+
+void ReorderBuffer::skip_gap() {
+    uint64_t first = m_pending.begin()->first;
+    LOG_WARN("Gave up waiting for %lu frame(s) before frame %lu",
+             (unsigned long) (first - m_next_seq), (unsigned long) first);
+    m_skipped += first - m_next_seq;
+    m_next_seq = first;
+    release_ready();
+}
+
+std::chrono::steady_clock::time_point ReorderBuffer::gap_deadline() {
+    return m_pending.begin()->second.inserted + m_max_latency;
+}
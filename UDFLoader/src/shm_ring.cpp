@@ -0,0 +1,307 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Implementation of @c ShmRing class
+ */
+
+#include <map>
+#include <mutex>
+#include <new>
+#include <random>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <eii/utils/logger.h>
+
+#include "eii/udf/shm_ring.h"
+
+// Bit in the reader count of a slot's state marking it as being written
+#define SLOT_WRITER   0x80000000ULL
+#define SLOT_READERS  0xffffffffULL
+
+using namespace eii::udf;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "Slot states in shared memory must be lock-free atomics");
+
+// Prototypes
+static size_t round_up(size_t value, size_t alignment);
+static size_t get_slot_stride(size_t slot_size);
+static size_t get_slots_offset(uint32_t num_slots);
+
+// Mappings of rings opened by subscribers in this process
+static std::mutex g_rings_mtx;
+static std::map<std::string, std::weak_ptr<ShmRing>> g_rings;
+
+ShmRing::ShmRing(
+        const std::string& name, void* mem, size_t mem_size, bool owner) :
+    m_name(name), m_mem(mem), m_mem_size(mem_size), m_owner(owner)
+{
+    m_header = (ShmRingHeader*) mem;
+    m_states = (std::atomic<uint64_t>*) (
+            ((uint8_t*) mem) + round_up(sizeof(ShmRingHeader), 64));
+    m_slots = ((uint8_t*) mem) + get_slots_offset(m_header->num_slots);
+}
+
+ShmRing::ShmRing(const ShmRing& src) {
+    throw "This object should not be copied";
+}
+
+ShmRing& ShmRing::operator=(const ShmRing& src) {
+    return *this;
+}
+
+ShmRing::~ShmRing() {
+    uint64_t ring_id = m_header->ring_id;
+    munmap(m_mem, m_mem_size);
+    if (!m_owner) {
+        return;
+    }
+
+    // Only remove the name if it was not taken over by a newer ring
+    int fd = shm_open(m_name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return;
+    }
+    uint64_t current_id = 0;
+    ssize_t n = pread(fd, &current_id, sizeof(current_id),
+                      offsetof(ShmRingHeader, ring_id));
+    close(fd);
+    if (n == (ssize_t) sizeof(current_id) && current_id == ring_id) {
+        shm_unlink(m_name.c_str());
+    }
+}
+
+std::shared_ptr<ShmRing> ShmRing::create(
+        const std::string& name, size_t slot_size, int num_slots) {
+    if (name.size() < 2 || name[0] != '/' ||
+            name.find('/', 1) != std::string::npos) {
+        throw "Shared memory ring name must be of the form \"/name\"";
+    }
+    if (slot_size == 0 || num_slots <= 0) {
+        throw "Shared memory ring must have at least one non-empty slot";
+    }
+
+    size_t mem_size = get_slots_offset((uint32_t) num_slots) +
+        get_slot_stride(slot_size) * num_slots;
+
+    // Replace a ring which was left behind by a crashed publisher, processes
+    // which still have it mapped keep their mapping
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) {
+        LOG_ERROR("shm_open(%s) failed: %s",
+                  name.c_str(), strerror(errno));
+        throw "Failed to create shared memory ring";
+    }
+    if (ftruncate(fd, (off_t) mem_size) != 0) {
+        LOG_ERROR("ftruncate(%s) failed: %s",
+                  name.c_str(), strerror(errno));
+        close(fd);
+        shm_unlink(name.c_str());
+        throw "Failed to size shared memory ring";
+    }
+    void* mem = mmap(
+            NULL, mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw "Failed to map shared memory ring";
+    }
+
+    std::random_device rd;
+    ShmRingHeader* header = (ShmRingHeader*) mem;
+    header->version = SHM_RING_VERSION;
+    header->num_slots = (uint32_t) num_slots;
+    header->slot_size = slot_size;
+    header->ring_id = (((uint64_t) rd()) << 32) | rd();
+    new (&header->next) std::atomic<uint32_t>(0);
+
+    std::atomic<uint64_t>* states = (std::atomic<uint64_t>*) (
+            ((uint8_t*) mem) + round_up(sizeof(ShmRingHeader), 64));
+    for (int i = 0; i < num_slots; i++) {
+        new (&states[i]) std::atomic<uint64_t>(0);
+    }
+
+    // Only mark the ring as valid once it is fully initialized
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHM_RING_MAGIC;
+
+    LOG_INFO("Created shared memory ring %s with %d slots of %lu bytes",
+             name.c_str(), num_slots, slot_size);
+
+    return std::shared_ptr<ShmRing>(new ShmRing(name, mem, mem_size, true));
+}
+
+std::shared_ptr<ShmRing> ShmRing::open(
+        const std::string& name, uint64_t ring_id) {
+    std::lock_guard<std::mutex> lk(g_rings_mtx);
+
+    auto it = g_rings.find(name);
+    if (it != g_rings.end()) {
+        std::shared_ptr<ShmRing> ring = it->second.lock();
+        if (ring != nullptr && ring->get_ring_id() == ring_id) {
+            return ring;
+        }
+        // The publisher re-created the ring, frames which are still using
+        // the old mapping keep it alive until they are freed
+        g_rings.erase(it);
+    }
+
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        LOG_ERROR("shm_open(%s) failed: %s",
+                  name.c_str(), strerror(errno));
+        throw "Failed to open shared memory ring";
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(ShmRingHeader)) {
+        close(fd);
+        throw "Shared memory ring is too small";
+    }
+    size_t mem_size = (size_t) st.st_size;
+
+    void* mem = mmap(
+            NULL, mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        throw "Failed to map shared memory ring";
+    }
+
+    ShmRingHeader* header = (ShmRingHeader*) mem;
+    if (header->magic != SHM_RING_MAGIC ||
+            header->version != SHM_RING_VERSION) {
+        munmap(mem, mem_size);
+        throw "Shared memory object is not a frame ring";
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->ring_id != ring_id) {
+        munmap(mem, mem_size);
+        throw "Shared memory ring was re-created by the publisher";
+    }
+    if (header->num_slots == 0 || mem_size <
+            get_slots_offset(header->num_slots) +
+            get_slot_stride(header->slot_size) * header->num_slots) {
+        munmap(mem, mem_size);
+        throw "Shared memory ring is too small";
+    }
+
+    // Subscribers only read the pixels, writing to them would corrupt the
+    // frames of the other subscribers
+    size_t slots_offset = get_slots_offset(header->num_slots);
+    if (mprotect(((uint8_t*) mem) + slots_offset, mem_size - slots_offset,
+                 PROT_READ) != 0) {
+        LOG_WARN("mprotect(%s) failed: %s", name.c_str(), strerror(errno));
+    }
+
+    std::shared_ptr<ShmRing> ring(new ShmRing(name, mem, mem_size, false));
+    g_rings[name] = ring;
+    return ring;
+}
+
+std::string ShmRing::get_name() { return m_name; }
+uint64_t ShmRing::get_ring_id() { return m_header->ring_id; }
+size_t ShmRing::get_slot_size() { return m_header->slot_size; }
+int ShmRing::get_num_slots() { return (int) m_header->num_slots; }
+
+void* ShmRing::claim(size_t len, ShmFrameDescriptor* desc) {
+    if (len > m_header->slot_size) {
+        return NULL;
+    }
+
+    // Start at the oldest slot, skipping the slots pinned by readers
+    uint32_t num_slots = m_header->num_slots;
+    uint32_t start = m_header->next.fetch_add(1, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < num_slots; i++) {
+        uint32_t slot = (start + i) % num_slots;
+        uint64_t state = m_states[slot].load(std::memory_order_relaxed);
+        if ((state & SLOT_READERS) != 0) {
+            continue;
+        }
+
+        uint32_t generation = (uint32_t) (state >> 32) + 1;
+        uint64_t claimed = (((uint64_t) generation) << 32) | SLOT_WRITER;
+        if (!m_states[slot].compare_exchange_strong(
+                    state, claimed, std::memory_order_acquire)) {
+            continue;
+        }
+
+        if (i > 0) {
+            m_header->next.store(slot + 1, std::memory_order_relaxed);
+        }
+
+        desc->slot = slot;
+        desc->generation = generation;
+        desc->len = len;
+        return m_slots + get_slot_stride(m_header->slot_size) * slot;
+    }
+
+    return NULL;
+}
+
+void ShmRing::commit(const ShmFrameDescriptor* desc) {
+    m_states[desc->slot].store(
+            ((uint64_t) desc->generation) << 32, std::memory_order_release);
+}
+
+const void* ShmRing::pin(const ShmFrameDescriptor* desc) {
+    if (desc->slot >= m_header->num_slots ||
+            desc->len > m_header->slot_size) {
+        return NULL;
+    }
+
+    std::atomic<uint64_t>& state = m_states[desc->slot];
+    uint64_t current = state.load(std::memory_order_acquire);
+    while ((uint32_t) (current >> 32) == desc->generation &&
+            (current & SLOT_WRITER) == 0) {
+        if (state.compare_exchange_weak(
+                    current, current + 1, std::memory_order_acquire)) {
+            return m_slots +
+                get_slot_stride(m_header->slot_size) * desc->slot;
+        }
+    }
+
+    // The publisher already reused the slot for a newer frame
+    return NULL;
+}
+
+void ShmRing::unpin(uint32_t slot) {
+    m_states[slot].fetch_sub(1, std::memory_order_release);
+}
+
+static size_t round_up(size_t value, size_t alignment) {
+    return ((value + alignment - 1) / alignment) * alignment;
+}
+
+static size_t get_slot_stride(size_t slot_size) {
+    return round_up(slot_size, SHM_RING_ALIGNMENT);
+}
+
+static size_t get_slots_offset(uint32_t num_slots) {
+    return round_up(
+            round_up(sizeof(ShmRingHeader), 64) +
+            sizeof(std::atomic<uint64_t>) * num_slots,
+            SHM_RING_ALIGNMENT);
+}
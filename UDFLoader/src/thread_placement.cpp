@@ -0,0 +1,193 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief @c ThreadPlacement implementation
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <eii/utils/logger.h>
+
+#include "eii/udf/thread_placement.h"
+#include "eii/udf/cpu_topology.h"
+
+using namespace eii::udf;
+
+bool eii::udf::parse_sched_policy(const char* name, int* policy) {
+    if(strcmp(name, "other") == 0) {
+        *policy = SCHED_OTHER;
+    } else if(strcmp(name, "fifo") == 0) {
+        *policy = SCHED_FIFO;
+    } else if(strcmp(name, "rr") == 0) {
+        *policy = SCHED_RR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Get the name of a scheduling policy for the log.
+ */
+static const char* sched_policy_name(int policy) {
+    switch(policy) {
+        case SCHED_OTHER: return "SCHED_OTHER";
+        case SCHED_FIFO:  return "SCHED_FIFO";
+        case SCHED_RR:    return "SCHED_RR";
+        default:          return "unknown";
+    }
+}
+
+/**
+ * Get the kernel thread ID of the calling thread, which setpriority()
+ * takes to change the nice level of a single thread.
+ */
+static pid_t get_tid() {
+    return (pid_t) syscall(SYS_gettid);
+}
+
+ThreadPlacement::ThreadPlacement(
+        const std::vector<int>& cpus, int sched_policy, int sched_priority,
+        int nice) :
+    m_cpus(cpus), m_sched_policy(sched_policy),
+    m_sched_priority(sched_priority), m_nice(nice)
+{
+    for(int cpu : m_cpus) {
+        if(cpu < 0 || cpu >= CPU_SETSIZE) {
+            throw "CPU number out of range";
+        }
+    }
+    if(m_sched_policy != SCHED_OTHER && m_sched_policy != SCHED_FIFO &&
+            m_sched_policy != SCHED_RR) {
+        throw "Unsupported scheduling policy";
+    }
+    int min_prio = sched_get_priority_min(m_sched_policy);
+    int max_prio = sched_get_priority_max(m_sched_policy);
+    if(m_sched_priority < min_prio || m_sched_priority > max_prio) {
+        throw "Scheduling priority out of range for the policy";
+    }
+    if(m_nice != THREAD_NICE_UNSET && (m_nice < -20 || m_nice > 19)) {
+        throw "Nice level must be between -20 and 19";
+    }
+}
+
+bool ThreadPlacement::apply(const std::string& name) {
+    bool ret = true;
+
+    if(!m_cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int cpu : m_cpus) {
+            CPU_SET(cpu, &set);
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if(err != 0) {
+            LOG_ERROR("%s: Failed to set CPU affinity to %s: %s",
+                      name.c_str(), format_cpu_list(m_cpus).c_str(),
+                      strerror(err));
+            ret = false;
+        }
+    }
+
+    // The nice level only applies to SCHED_OTHER, but it is kept if the
+    // thread is switched back later
+    if(m_nice != THREAD_NICE_UNSET) {
+        if(setpriority(PRIO_PROCESS, get_tid(), m_nice) != 0) {
+            LOG_ERROR("%s: Failed to set nice level %d: %s",
+                      name.c_str(), m_nice, strerror(errno));
+            ret = false;
+        }
+    }
+
+    if(m_sched_policy != SCHED_OTHER) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = m_sched_priority;
+        int err = pthread_setschedparam(
+                pthread_self(), m_sched_policy, &param);
+        if(err != 0) {
+            LOG_ERROR("%s: Failed to set scheduling policy %s: %s",
+                      name.c_str(), sched_policy_name(m_sched_policy),
+                      strerror(err));
+            ret = false;
+        }
+    }
+
+    LOG_INFO("%s placement: %s", name.c_str(), describe_current().c_str());
+    return ret;
+}
+
+const std::vector<int>& ThreadPlacement::get_cpus() {
+    return m_cpus;
+}
+
+int ThreadPlacement::get_sched_policy() {
+    return m_sched_policy;
+}
+
+std::string ThreadPlacement::describe_current() {
+    std::string desc;
+
+    // CPUs the thread may run on, and the NUMA nodes they belong to
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+        std::vector<int> cpus;
+        std::set<int> nodes;
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if(CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+                nodes.insert(get_numa_node(cpu));
+            }
+        }
+        desc += "cpus " + format_cpu_list(cpus);
+        if(nodes.count(-1) == 0) {
+            desc += " (node " + format_cpu_list(
+                    std::vector<int>(nodes.begin(), nodes.end())) + ")";
+        }
+    } else {
+        desc += "cpus unknown";
+    }
+
+    int policy = SCHED_OTHER;
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    if(pthread_getschedparam(pthread_self(), &policy, &param) == 0) {
+        desc += std::string(", ") + sched_policy_name(policy);
+        if(policy != SCHED_OTHER) {
+            desc += " priority " + std::to_string(param.sched_priority);
+        }
+    }
+
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, get_tid());
+    if(errno == 0) {
+        desc += ", nice " + std::to_string(nice);
+    }
+
+    desc += ", on cpu " + std::to_string(sched_getcpu());
+    return desc;
+}
@@ -0,0 +1,522 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Implementation of @c UdfGraph and @c MetaPredicate classes
+ */
+
+#include <cstring>
+#include <sstream>
+#include <mutex>
+#include <condition_variable>
+#include <eii/utils/logger.h>
+
+#include "eii/udf/udf_graph.h"
+
+using namespace eii::udf;
+
+/**
+ * State of the execution of the graph on a single frame, shared by the
+ * threads running its UDFs.
+ */
+struct UdfGraph::Run {
+    std::mutex mtx;
+    std::condition_variable cv;
+
+    // Frames entering the roots
+    std::vector<Frame*> inputs;
+
+    // Frames handed along the edges, NULL if an edge was not taken or the
+    // UDF it leads to has taken the frame already
+    std::vector<Frame*> edge_frames;
+
+    // Frames leaving the graph, i.e. of UDFs which ran but whose outgoing
+    // edges were not taken
+    std::vector<Frame*> outputs;
+
+    // Number of undecided incoming edges of each UDF
+    std::vector<size_t> pending;
+
+    // Number of UDFs which have not run (or been skipped) yet
+    size_t remaining;
+
+    // Flag for if a UDF dropped the frame
+    bool dropped;
+};
+
+bool eii::udf::parse_meta_condition(const char* name, MetaCondition* cond) {
+    if(strcmp(name, "exists") == 0) {
+        *cond = META_EXISTS;
+    } else if(strcmp(name, "equals") == 0) {
+        *cond = META_EQUALS;
+    } else if(strcmp(name, "not_equals") == 0) {
+        *cond = META_NOT_EQUALS;
+    } else if(strcmp(name, "greater_than") == 0) {
+        *cond = META_GREATER_THAN;
+    } else if(strcmp(name, "less_than") == 0) {
+        *cond = META_LESS_THAN;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Get the name of a meta-data condition for the log.
+ */
+static const char* meta_condition_name(MetaCondition cond) {
+    switch(cond) {
+        case META_EXISTS:       return "exists";
+        case META_EQUALS:       return "equals";
+        case META_NOT_EQUALS:   return "not_equals";
+        case META_GREATER_THAN: return "greater_than";
+        case META_LESS_THAN:    return "less_than";
+        default:                return "unknown";
+    }
+}
+
+static inline bool is_number(msg_envelope_elem_body_t* elem) {
+    return elem->type == MSG_ENV_DT_INT || elem->type == MSG_ENV_DT_FLOATING;
+}
+
+static inline double as_double(msg_envelope_elem_body_t* elem) {
+    if(elem->type == MSG_ENV_DT_INT) {
+        return (double) elem->body.integer;
+    }
+    return elem->body.floating;
+}
+
+/**
+ * Compare two meta-data values.
+ *
+ * @param[in]  a   - Value
+ * @param[in]  b   - Value to compare with
+ * @param[out] cmp - Less than, equal to or greater than 0 if a is less than,
+ *                   equal to or greater than b
+ * @return false if the values cannot be compared
+ */
+static bool compare_values(
+        msg_envelope_elem_body_t* a, msg_envelope_elem_body_t* b, int* cmp) {
+    if(a->type == MSG_ENV_DT_INT && b->type == MSG_ENV_DT_INT) {
+        *cmp = (a->body.integer > b->body.integer) -
+            (a->body.integer < b->body.integer);
+    } else if(is_number(a) && is_number(b)) {
+        double da = as_double(a);
+        double db = as_double(b);
+        *cmp = (da > db) - (da < db);
+    } else if(a->type == MSG_ENV_DT_STRING && b->type == MSG_ENV_DT_STRING) {
+        *cmp = strcmp(a->body.string, b->body.string);
+    } else if(a->type == MSG_ENV_DT_BOOLEAN &&
+            b->type == MSG_ENV_DT_BOOLEAN) {
+        *cmp = (int) a->body.boolean - (int) b->body.boolean;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+MetaPredicate::MetaPredicate(
+        const std::string& key, MetaCondition cond,
+        msg_envelope_elem_body_t* value) :
+    m_key(key), m_cond(cond), m_value(value)
+{
+    const char* err = NULL;
+    if(value == NULL) {
+        err = "Meta-data predicate requires a value";
+    } else if(cond == META_EXISTS) {
+        if(value->type != MSG_ENV_DT_BOOLEAN)
+            err = "Meta-data \"exists\" predicate requires a boolean";
+    } else if(cond == META_GREATER_THAN || cond == META_LESS_THAN) {
+        if(!is_number(value))
+            err = "Meta-data comparison requires a number";
+    } else if(!is_number(value) && value->type != MSG_ENV_DT_STRING &&
+            value->type != MSG_ENV_DT_BOOLEAN) {
+        err = "Meta-data predicate value must be a number, string or "
+              "boolean";
+    }
+    if(err != NULL) {
+        if(value != NULL) {
+            msgbus_msg_envelope_elem_destroy(value);
+        }
+        throw err;
+    }
+}
+
+MetaPredicate::MetaPredicate(const MetaPredicate& src) {
+    throw "This object should not be copied";
+}
+
+MetaPredicate& MetaPredicate::operator=(const MetaPredicate& src) {
+    return *this;
+}
+
+MetaPredicate::~MetaPredicate() {
+    msgbus_msg_envelope_elem_destroy(m_value);
+}
+
+bool MetaPredicate::evaluate(Frame* frame) {
+    msg_envelope_elem_body_t* value = NULL;
+    msgbus_ret_t ret = msgbus_msg_envelope_get(
+            frame->get_meta_data(), m_key.c_str(), &value);
+    bool exists = (ret == MSG_SUCCESS && value != NULL);
+
+    if(m_cond == META_EXISTS) {
+        return exists == m_value->body.boolean;
+    }
+
+    int cmp = 0;
+    bool comparable = exists && compare_values(value, m_value, &cmp);
+    switch(m_cond) {
+        case META_EQUALS:       return comparable && cmp == 0;
+        case META_NOT_EQUALS:   return !(comparable && cmp == 0);
+        case META_GREATER_THAN: return comparable && is_number(value) &&
+                                    cmp > 0;
+        case META_LESS_THAN:    return comparable && is_number(value) &&
+                                    cmp < 0;
+        default:                return false;
+    }
+}
+
+std::string MetaPredicate::describe() {
+    std::ostringstream os;
+    os << m_key << " " << meta_condition_name(m_cond) << " ";
+    switch(m_value->type) {
+        case MSG_ENV_DT_INT:      os << m_value->body.integer; break;
+        case MSG_ENV_DT_FLOATING: os << m_value->body.floating; break;
+        case MSG_ENV_DT_STRING:
+            os << "\"" << m_value->body.string << "\""; break;
+        case MSG_ENV_DT_BOOLEAN:
+            os << (m_value->body.boolean ? "true" : "false"); break;
+        default: break;
+    }
+    return os.str();
+}
+
+UdfGraph::UdfGraph(RunUdfFn run_udf) :
+    m_run_udf(run_udf), m_pool(NULL)
+{}
+
+UdfGraph::UdfGraph(const UdfGraph& src) {
+    throw "This object should not be copied";
+}
+
+UdfGraph& UdfGraph::operator=(const UdfGraph& src) {
+    return *this;
+}
+
+UdfGraph::~UdfGraph() {
+    for(auto& edge : m_edges) {
+        if(edge.when != NULL) delete edge.when;
+    }
+}
+
+int UdfGraph::find_node(const std::string& id) {
+    for(size_t i = 0; i < m_nodes.size(); i++) {
+        if(m_nodes[i].id == id) return (int) i;
+    }
+    return -1;
+}
+
+void UdfGraph::add_udf(const std::string& id, UdfHandle* udf) {
+    if(find_node(id) >= 0) {
+        LOG_ERROR("Duplicate UDF ID in graph: %s", id.c_str());
+        throw "UDF IDs must be unique";
+    }
+    Node node;
+    node.id = id;
+    node.udf = udf;
+    m_nodes.push_back(node);
+}
+
+void UdfGraph::add_edge(
+        const std::string& from, const std::string& to, MetaPredicate* when) {
+    int from_idx = find_node(from);
+    int to_idx = find_node(to);
+    const char* err = NULL;
+    if(from_idx < 0 || to_idx < 0) {
+        LOG_ERROR("Edge %s -> %s refers to an unknown UDF",
+                  from.c_str(), to.c_str());
+        err = "Edge refers to an unknown UDF ID";
+    } else {
+        for(auto e : m_nodes[from_idx].out_edges) {
+            if(m_edges[e].to == to_idx) {
+                err = "Duplicate edge between two UDFs";
+                break;
+            }
+        }
+    }
+    if(err != NULL) {
+        if(when != NULL) delete when;
+        throw err;
+    }
+
+    Edge edge;
+    edge.from = from_idx;
+    edge.to = to_idx;
+    edge.when = when;
+    m_edges.push_back(edge);
+    m_nodes[from_idx].out_edges.push_back((int) m_edges.size() - 1);
+    m_nodes[to_idx].in_edges.push_back((int) m_edges.size() - 1);
+}
+
+void UdfGraph::finalize() {
+    // Kahn's algorithm, every UDF is visited once all its predecessors
+    // have been visited, which never happens for UDFs on a cycle
+    std::vector<size_t> pending;
+    std::vector<int> visit;
+    m_roots.clear();
+    for(size_t i = 0; i < m_nodes.size(); i++) {
+        pending.push_back(m_nodes[i].in_edges.size());
+        if(pending[i] == 0) {
+            m_roots.push_back((int) i);
+            visit.push_back((int) i);
+        }
+    }
+    for(size_t i = 0; i < visit.size(); i++) {
+        for(auto e : m_nodes[visit[i]].out_edges) {
+            if(--pending[m_edges[e].to] == 0) {
+                visit.push_back(m_edges[e].to);
+            }
+        }
+    }
+    if(visit.size() != m_nodes.size()) {
+        throw "UDF graph must not contain cycles";
+    }
+
+    for(auto& edge : m_edges) {
+        if(edge.when != NULL) {
+            LOG_INFO("UDF graph edge: %s -> %s when %s",
+                     m_nodes[edge.from].id.c_str(),
+                     m_nodes[edge.to].id.c_str(),
+                     edge.when->describe().c_str());
+        } else {
+            LOG_INFO("UDF graph edge: %s -> %s",
+                     m_nodes[edge.from].id.c_str(),
+                     m_nodes[edge.to].id.c_str());
+        }
+    }
+}
+
+bool UdfGraph::has_branches() {
+    if(m_roots.size() > 1) return true;
+    for(auto& node : m_nodes) {
+        if(node.out_edges.size() > 1) return true;
+    }
+    return false;
+}
+
+void UdfGraph::set_branch_pool(WorkerPool* pool) {
+    m_pool = pool;
+}
+
+Frame* UdfGraph::execute(Frame* frame) {
+    if(m_nodes.empty()) {
+        return frame;
+    }
+
+    std::shared_ptr<Run> run = std::make_shared<Run>();
+    run->inputs.assign(m_nodes.size(), NULL);
+    run->edge_frames.assign(m_edges.size(), NULL);
+    run->outputs.assign(m_nodes.size(), NULL);
+    for(auto& node : m_nodes) {
+        run->pending.push_back(node.in_edges.size());
+    }
+    run->remaining = m_nodes.size();
+    run->dropped = false;
+
+    // The first root gets the frame, the other roots get frames sharing its
+    // pixels
+    run->inputs[m_roots[0]] = frame;
+    for(size_t i = 1; i < m_roots.size(); i++) {
+        try {
+            run->inputs[m_roots[i]] = frame->share();
+        } catch(const char* ex) {
+            LOG_ERROR("Failed to share frame with UDF graph branch, frame "
+                      "dropped: %s", ex);
+            for(auto f : run->inputs) {
+                if(f != NULL) delete f;
+            }
+            return NULL;
+        }
+    }
+
+    dispatch(run, m_roots);
+
+    // Wait for the branches running on the branch pool
+    {
+        std::unique_lock<std::mutex> lk(run->mtx);
+        run->cv.wait(lk, [&run] { return run->remaining == 0; });
+    }
+
+    std::vector<Frame*> outputs;
+    for(auto f : run->outputs) {
+        if(f != NULL) outputs.push_back(f);
+    }
+    if(run->dropped || outputs.empty()) {
+        for(auto f : outputs) {
+            delete f;
+        }
+        return NULL;
+    }
+    return join(outputs);
+}
+
+void UdfGraph::dispatch(
+        std::shared_ptr<Run> run, const std::vector<int>& nodes) {
+    if(nodes.empty()) {
+        return;
+    }
+
+    // Run the UDFs which could not be handed to the branch pool (because
+    // there is none or it is behind) on this thread, after the first
+    std::vector<int> inline_nodes(1, nodes[0]);
+    for(size_t i = 1; i < nodes.size(); i++) {
+        int node = nodes[i];
+        if(m_pool == NULL || !m_pool->submit(
+                    [this, run, node]() { run_node(run, node); })) {
+            inline_nodes.push_back(node);
+        }
+    }
+    for(auto node : inline_nodes) {
+        run_node(run, node);
+    }
+}
+
+void UdfGraph::run_node(std::shared_ptr<Run> run, int n) {
+    const Node& node = m_nodes[n];
+
+    // Take the frames of the taken incoming edges, which are not touched by
+    // any other thread once all incoming edges have been decided
+    std::vector<Frame*> inputs;
+    bool dropped = false;
+    {
+        std::lock_guard<std::mutex> lk(run->mtx);
+        dropped = run->dropped;
+        if(run->inputs[n] != NULL) {
+            inputs.push_back(run->inputs[n]);
+            run->inputs[n] = NULL;
+        }
+        for(auto e : node.in_edges) {
+            if(run->edge_frames[e] != NULL) {
+                inputs.push_back(run->edge_frames[e]);
+                run->edge_frames[e] = NULL;
+            }
+        }
+    }
+
+    // Run the UDF, unless none of its incoming edges were taken or the frame
+    // has been dropped by another branch
+    Frame* frame = NULL;
+    bool drop = false;
+    if(dropped) {
+        for(auto f : inputs) {
+            delete f;
+        }
+    } else if(!inputs.empty()) {
+        // An exception must not escape, otherwise the frame would never
+        // finish running through the graph
+        Frame* input = join(inputs);
+        try {
+            frame = m_run_udf(node.udf, input);
+        } catch(const char* ex) {
+            LOG_ERROR("Error in UDF graph node %s, frame dropped: %s",
+                      node.id.c_str(), ex);
+            delete input;
+        } catch(const std::exception& ex) {
+            LOG_ERROR("Error in UDF graph node %s, frame dropped: %s",
+                      node.id.c_str(), ex.what());
+            delete input;
+        } catch(...) {
+            LOG_ERROR("Unknown error in UDF graph node %s, frame dropped",
+                      node.id.c_str());
+            delete input;
+        }
+        drop = (frame == NULL);
+    }
+
+    // Decide the outgoing edges, the first taken edge gets the frame and
+    // the others get frames sharing its pixels
+    std::vector<size_t> taken;
+    std::vector<Frame*> out_frames(node.out_edges.size(), NULL);
+    if(frame != NULL) {
+        for(size_t i = 0; i < node.out_edges.size(); i++) {
+            MetaPredicate* when = m_edges[node.out_edges[i]].when;
+            if(when == NULL || when->evaluate(frame)) {
+                taken.push_back(i);
+            }
+        }
+        try {
+            for(size_t i = 1; i < taken.size(); i++) {
+                out_frames[taken[i]] = frame->share();
+            }
+            if(!taken.empty()) {
+                out_frames[taken[0]] = frame;
+            }
+        } catch(const char* ex) {
+            LOG_ERROR("Failed to share frame with UDF graph branch, frame "
+                      "dropped: %s", ex);
+            for(auto f : out_frames) {
+                if(f != NULL) delete f;
+            }
+            out_frames.assign(node.out_edges.size(), NULL);
+            delete frame;
+            frame = NULL;
+            drop = true;
+        }
+    }
+
+    std::vector<int> ready;
+    {
+        std::lock_guard<std::mutex> lk(run->mtx);
+        if(drop) {
+            run->dropped = true;
+        } else if(frame != NULL && taken.empty()) {
+            // The frame leaves the graph at this UDF
+            run->outputs[n] = frame;
+        }
+        for(size_t i = 0; i < node.out_edges.size(); i++) {
+            int e = node.out_edges[i];
+            run->edge_frames[e] = out_frames[i];
+            int to = m_edges[e].to;
+            if(--run->pending[to] == 0) {
+                ready.push_back(to);
+            }
+        }
+        if(--run->remaining == 0) {
+            run->cv.notify_all();
+        }
+    }
+
+    dispatch(run, ready);
+}
+
+Frame* UdfGraph::join(const std::vector<Frame*>& frames) {
+    Frame* frame = frames[0];
+    for(size_t i = 1; i < frames.size(); i++) {
+        try {
+            frame->merge_meta_data(frames[i]);
+        } catch(const char* ex) {
+            LOG_ERROR("Failed to join meta-data of UDF graph branches: %s",
+                      ex);
+        }
+        delete frames[i];
+    }
+    return frame;
+}
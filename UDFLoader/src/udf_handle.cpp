@@ -25,11 +25,13 @@
 #include "eii/udf/udf_handle.h"
 #include "eii/utils/logger.h"
 
+#define CFG_READ_ONLY "read_only"
+
 using namespace eii::udf;
 
 UdfHandle::UdfHandle(std::string name, int max_workers) :
     m_name(name), m_initialized(false), m_max_workers(max_workers),
-    m_config(NULL)
+    m_active_workers(0), m_read_only(false), m_config(NULL)
 {}
 
 UdfHandle::~UdfHandle() {
@@ -38,8 +40,6 @@ UdfHandle::~UdfHandle() {
     if(m_initialized.load()) {
         config_destroy(m_config);
     }
-
-    // TODO: Clean up thread pool
 }
 
 bool UdfHandle::initialize(config_t* config) {
@@ -53,9 +53,87 @@ bool UdfHandle::initialize(config_t* config) {
     m_initialized.store(true);
     m_config = config;
 
+    // Get the (optional) read-only flag
+    config_value_t* read_only = config_get(config, CFG_READ_ONLY);
+    if(read_only != NULL) {
+        if(read_only->type != CVT_BOOLEAN) {
+            LOG_ERROR_0("\"read_only\" must be a boolean");
+            config_value_destroy(read_only);
+            return false;
+        }
+        m_read_only = read_only->body.boolean;
+        config_value_destroy(read_only);
+    }
+
     return true;
 }
 
+void UdfHandle::process_batch(
+        std::vector<Frame*>& frames, std::vector<UdfRetCode>& rets) {
+    for(size_t i = 0; i < frames.size(); i++) {
+        rets[i] = this->process(frames[i]);
+    }
+}
+
+UdfRetCode UdfHandle::execute(Frame* frame) {
+    if(m_max_workers <= 0) {
+        return this->process(frame);
+    }
+
+    acquire_worker();
+    UdfRetCode ret = UdfRetCode::UDF_ERROR;
+    try {
+        ret = this->process(frame);
+    } catch(...) {
+        release_worker();
+        throw;
+    }
+    release_worker();
+
+    return ret;
+}
+
+void UdfHandle::execute_batch(
+        std::vector<Frame*>& frames, std::vector<UdfRetCode>& rets) {
+    if(m_max_workers <= 0) {
+        this->process_batch(frames, rets);
+        return;
+    }
+
+    acquire_worker();
+    try {
+        this->process_batch(frames, rets);
+    } catch(...) {
+        release_worker();
+        throw;
+    }
+    release_worker();
+}
+
+void UdfHandle::acquire_worker() {
+    std::unique_lock<std::mutex> lk(m_workers_mtx);
+    m_workers_cv.wait(lk, [this] {
+        return m_active_workers < m_max_workers;
+    });
+    m_active_workers++;
+}
+
+void UdfHandle::release_worker() {
+    {
+        std::lock_guard<std::mutex> lk(m_workers_mtx);
+        m_active_workers--;
+    }
+    m_workers_cv.notify_one();
+}
+
+int UdfHandle::get_max_workers() {
+    return m_max_workers;
+}
+
+bool UdfHandle::is_read_only() {
+    return m_read_only;
+}
+
 std::string UdfHandle::get_name() {
     return m_name;
 }
@@ -23,6 +23,7 @@
  */
 
 #include <functional>
+#include <memory>
 #include <chrono>
 #include <eii/utils/logger.h>
 #include <sstream>
@@ -31,16 +32,75 @@
 #include <cstring>
 #include <iostream>
 #include <cstdlib>
+#include <set>
 #include "eii/udf/udf_manager.h"
 #include "eii/udf/frame.h"
 #include "eii/udf/loader.h"
+#include "eii/udf/frame_buffer_pool.h"
+#include "eii/udf/cpu_topology.h"
 
 using namespace eii::udf;
 using namespace eii::utils;
 
 #define CFG_UDFS            "udfs"
 #define CFG_MAX_WORKERS     "max_workers"
+#define CFG_POOL_MAX_MB     "frame_pool_max_mb"
+#define CFG_POOL_HUGEPAGES  "frame_pool_hugepages"
+#define CFG_SHM_RING        "shm_ring"
+#define CFG_PACK_FRAMES     "pack_frames"
+#define CFG_SHM_NAME        "name"
+#define CFG_SHM_SLOT_MB     "slot_size_mb"
+#define CFG_SHM_NUM_SLOTS   "num_slots"
+#define CFG_PIPELINED       "pipelined"
+#define CFG_STAGE_QUEUE     "stage_queue_size"
+#define CFG_STAGE           "stage"
+#define CFG_STAGE_WORKERS   "stage_workers"
+#define CFG_ORDERED         "ordered"
+#define CFG_REORDER_SIZE    "reorder_buffer_size"
+#define CFG_REORDER_LATENCY "reorder_max_latency_ms"
+#define CFG_SCHEDULER       "scheduler"
+#define SCHEDULER_CENTRAL       "central"
+#define SCHEDULER_WORK_STEALING "work_stealing"
+#define CFG_BATCH_SIZE      "batch_size"
+#define CFG_BATCH_MAX_WAIT  "batch_max_wait_ms"
+#define CFG_INPUT_POLICY    "input_queue_policy"
+#define CFG_OUTPUT_POLICY   "output_queue_policy"
+#define CFG_KEEP_EVERY_NTH  "keep_every_nth"
+#define CFG_LATENCY_BUDGET  "latency_budget_ms"
+#define CFG_EXPIRED_STUBS   "expired_stubs"
+#define CFG_ENCODER_WORKERS "encoder_workers"
+#define CFG_ENCODER_QUEUE   "encoder_queue_size"
+#define CFG_PLACEMENT       "placement"
+#define CFG_PLACE_MANAGER   "manager"
+#define CFG_PLACE_WORKERS   "udf_workers"
+#define CFG_PLACE_ENCODER   "encoder"
+#define CFG_PLACE_NUMA_BUFS "numa_local_buffers"
+#define CFG_CPUS            "cpus"
+#define CFG_NUMA_NODE       "numa_node"
+#define CFG_SCHED_POLICY    "sched_policy"
+#define CFG_SCHED_PRIORITY  "sched_priority"
+#define CFG_NICE            "nice"
+#define CFG_EDGES           "edges"
+#define CFG_UDF_ID          "id"
+#define CFG_EDGE_FROM       "from"
+#define CFG_EDGE_TO         "to"
+#define CFG_EDGE_WHEN       "when"
+#define CFG_WHEN_KEY        "key"
+#define CFG_BRANCH_WORKERS  "branch_workers"
+#define META_EXPIRED        "expired"
+#define META_FRAME_AGE      "frame_age_ms"
+#define DEFAULT_SHM_SLOT_MB   32
+#define DEFAULT_SHM_NUM_SLOTS 16
 #define DEFAULT_MAX_WORKERS 4  // Default 4 threads to submit jobs to
+#define DEFAULT_STAGE_QUEUE 4  // Default bound of the inter-stage queues
+#define DEFAULT_STAGE_WORKERS 1
+#define DEFAULT_REORDER_SIZE    32
+#define DEFAULT_REORDER_LATENCY 1000
+#define DEFAULT_BATCH_SIZE      1
+#define DEFAULT_BATCH_MAX_WAIT  10
+#define DEFAULT_KEEP_EVERY_NTH  2
+#define DEFAULT_ENCODER_QUEUE   8
+#define BRANCH_QUEUED_PER_WORKER 4  // Queued branches per branch worker
 #define RANDOM_STR_LENGTH   5  // Size of random strings to be added for profiling keys
 
 // Globals
@@ -56,6 +116,292 @@ config_value_t* get_config_value(const void* cfg, const char* key) {
     return config_value_object_get(obj, key);
 }
 
+/**
+ * Get an (optional) queue overflow policy from the configuration.
+ *
+ * @param config - Configuration
+ * @param key    - Key of the policy
+ * @param policy - Output policy, left untouched if the key is not set
+ * @return Error message, NULL on success
+ */
+static const char* get_shed_policy(
+        config_t* config, const char* key, ShedPolicy* policy) {
+    config_value_t* cfg_policy = config_get(config, key);
+    if(cfg_policy == NULL) {
+        return NULL;
+    }
+
+    const char* err = NULL;
+    if(cfg_policy->type != CVT_STRING ||
+            !parse_shed_policy(cfg_policy->body.string, policy)) {
+        err = "Queue policy must be \"block\", \"drop_newest\", "
+              "\"drop_oldest\" or \"keep_every_nth\"";
+    } else {
+        LOG_INFO("%s: %s", key, cfg_policy->body.string);
+    }
+    config_value_destroy(cfg_policy);
+    return err;
+}
+
+/**
+ * Get the (optional) placement of a group of threads from the "placement"
+ * configuration object.
+ *
+ * @param[in]  placement - "placement" configuration object
+ * @param[in]  key       - Key of the group of threads
+ * @param[out] out       - Placement, left untouched if the key is not set
+ * @return Error message, NULL on success
+ */
+static const char* get_thread_placement(
+        config_value_t* placement, const char* key,
+        std::unique_ptr<ThreadPlacement>& out) {
+    config_value_t* obj = config_value_object_get(placement, key);
+    if(obj == NULL) {
+        return NULL;
+    }
+    if(obj->type != CVT_OBJECT) {
+        config_value_destroy(obj);
+        return "Thread placement must be an object";
+    }
+
+    config_value_t* cfg_cpus = config_value_object_get(obj, CFG_CPUS);
+    config_value_t* cfg_node = config_value_object_get(obj, CFG_NUMA_NODE);
+    config_value_t* cfg_policy = config_value_object_get(
+            obj, CFG_SCHED_POLICY);
+    config_value_t* cfg_priority = config_value_object_get(
+            obj, CFG_SCHED_PRIORITY);
+    config_value_t* cfg_nice = config_value_object_get(obj, CFG_NICE);
+    std::vector<int> cpus;
+    int policy = SCHED_OTHER;
+    int priority = 0;
+    int nice = THREAD_NICE_UNSET;
+    const char* err = NULL;
+
+    if(cfg_cpus != NULL && cfg_node != NULL) {
+        err = "Only one of \"cpus\" and \"numa_node\" may be set";
+    } else if(cfg_cpus != NULL && (cfg_cpus->type != CVT_STRING ||
+                !parse_cpu_list(cfg_cpus->body.string, cpus) ||
+                cpus.empty())) {
+        err = "\"cpus\" must be a CPU list, e.g. \"0-3,8-11\"";
+    } else if(cfg_node != NULL && (cfg_node->type != CVT_INTEGER ||
+                (cpus = get_node_cpus(cfg_node->body.integer)).empty())) {
+        err = "\"numa_node\" must be the number of an existing NUMA node";
+    } else if(cfg_policy != NULL && (cfg_policy->type != CVT_STRING ||
+                !parse_sched_policy(cfg_policy->body.string, &policy))) {
+        err = "\"sched_policy\" must be \"other\", \"fifo\" or \"rr\"";
+    } else if(cfg_priority != NULL && cfg_priority->type != CVT_INTEGER) {
+        err = "\"sched_priority\" must be an integer";
+    } else if(cfg_nice != NULL && cfg_nice->type != CVT_INTEGER) {
+        err = "\"nice\" must be an integer";
+    }
+
+    if(err == NULL) {
+        if(cfg_priority != NULL)
+            priority = cfg_priority->body.integer;
+        if(cfg_nice != NULL)
+            nice = cfg_nice->body.integer;
+        try {
+            out.reset(new ThreadPlacement(cpus, policy, priority, nice));
+        } catch(const char* ex) {
+            err = ex;
+        }
+    }
+
+    if(cfg_cpus != NULL)
+        config_value_destroy(cfg_cpus);
+    if(cfg_node != NULL)
+        config_value_destroy(cfg_node);
+    if(cfg_policy != NULL)
+        config_value_destroy(cfg_policy);
+    if(cfg_priority != NULL)
+        config_value_destroy(cfg_priority);
+    if(cfg_nice != NULL)
+        config_value_destroy(cfg_nice);
+    config_value_destroy(obj);
+    return err;
+}
+
+/**
+ * Get the predicate of an edge of the UDF graph from its "when" object,
+ * which has the meta-data "key" and at most one condition on its value. An
+ * object without a condition requires the key to be set.
+ *
+ * @param[in]  when - "when" configuration object
+ * @param[out] out  - Predicate
+ * @return Error message, NULL on success
+ */
+static const char* get_meta_predicate(
+        config_value_t* when, MetaPredicate** out) {
+    static const char* conditions[] = {
+        "exists", "equals", "not_equals", "greater_than", "less_than"
+    };
+
+    if(when->type != CVT_OBJECT) {
+        return "Edge \"when\" must be an object";
+    }
+    config_value_t* cfg_key = config_value_object_get(when, CFG_WHEN_KEY);
+    if(cfg_key == NULL || cfg_key->type != CVT_STRING) {
+        if(cfg_key != NULL)
+            config_value_destroy(cfg_key);
+        return "Edge \"when\" \"key\" must be a string";
+    }
+
+    config_value_t* cfg_value = NULL;
+    MetaCondition cond = META_EXISTS;
+    const char* err = NULL;
+    for(auto name : conditions) {
+        config_value_t* value = config_value_object_get(when, name);
+        if(value == NULL) continue;
+        if(cfg_value != NULL) {
+            config_value_destroy(value);
+            err = "Edge \"when\" must have a single condition";
+            break;
+        }
+        parse_meta_condition(name, &cond);
+        cfg_value = value;
+    }
+
+    msg_envelope_elem_body_t* value = NULL;
+    if(err == NULL) {
+        if(cfg_value == NULL) {
+            value = msgbus_msg_envelope_new_bool(true);
+        } else if(cfg_value->type == CVT_INTEGER) {
+            value = msgbus_msg_envelope_new_integer(cfg_value->body.integer);
+        } else if(cfg_value->type == CVT_FLOATING) {
+            value = msgbus_msg_envelope_new_floating(
+                    cfg_value->body.floating);
+        } else if(cfg_value->type == CVT_STRING) {
+            value = msgbus_msg_envelope_new_string(cfg_value->body.string);
+        } else if(cfg_value->type == CVT_BOOLEAN) {
+            value = msgbus_msg_envelope_new_bool(cfg_value->body.boolean);
+        } else {
+            err = "Edge \"when\" value must be a number, string or boolean";
+        }
+    }
+    if(err == NULL) {
+        if(value == NULL) {
+            err = "Failed to initialize edge \"when\" value";
+        } else {
+            try {
+                *out = new MetaPredicate(cfg_key->body.string, cond, value);
+            } catch(const char* ex) {
+                err = ex;
+            }
+        }
+    }
+
+    if(cfg_value != NULL)
+        config_value_destroy(cfg_value);
+    config_value_destroy(cfg_key);
+    return err;
+}
+
+/**
+ * Add an edge from the "edges" configuration array to the UDF graph.
+ *
+ * @param graph - UDF graph
+ * @param edges - "edges" configuration array
+ * @param index - Index of the edge in the array
+ * @return Error message, NULL on success
+ */
+static const char* add_graph_edge(
+        UdfGraph* graph, config_value_t* edges, int index) {
+    config_value_t* edge = config_value_array_get(edges, index);
+    if(edge == NULL) {
+        return "Failed to get configuration array element";
+    }
+    if(edge->type != CVT_OBJECT) {
+        config_value_destroy(edge);
+        return "Edges must be objects";
+    }
+
+    config_value_t* cfg_from = config_value_object_get(edge, CFG_EDGE_FROM);
+    config_value_t* cfg_to = config_value_object_get(edge, CFG_EDGE_TO);
+    config_value_t* cfg_when = config_value_object_get(edge, CFG_EDGE_WHEN);
+    MetaPredicate* when = NULL;
+    const char* err = NULL;
+
+    if(cfg_from == NULL || cfg_from->type != CVT_STRING ||
+            cfg_to == NULL || cfg_to->type != CVT_STRING) {
+        err = "Edge \"from\" and \"to\" must be UDF IDs";
+    } else if(cfg_when != NULL) {
+        err = get_meta_predicate(cfg_when, &when);
+    }
+    if(err == NULL) {
+        try {
+            graph->add_edge(cfg_from->body.string, cfg_to->body.string, when);
+        } catch(const char* ex) {
+            err = ex;
+        }
+    }
+
+    if(cfg_from != NULL)
+        config_value_destroy(cfg_from);
+    if(cfg_to != NULL)
+        config_value_destroy(cfg_to);
+    if(cfg_when != NULL)
+        config_value_destroy(cfg_when);
+    config_value_destroy(edge);
+    return err;
+}
+
+/**
+ * Get the (optional) graph ID, stage and concurrency settings of a UDF from
+ * its entry in the "udfs" configuration array. Settings which are not set are
+ * left untouched.
+ *
+ * @param cfg_obj       - UDF configuration object
+ * @param udf_id        - ID of the UDF in the UDF graph
+ * @param stage_name    - Name of the pipeline stage of the UDF
+ * @param stage_workers - Number of workers of the pipeline stage
+ * @param max_workers   - Limit of threads executing the UDF at once
+ * @return Error message, NULL on success
+ */
+static const char* get_udf_options(
+        config_value_t* cfg_obj, std::string& udf_id, std::string& stage_name,
+        int& stage_workers, int& max_workers) {
+    config_value_t* cfg_udf_id = config_value_object_get(cfg_obj, CFG_UDF_ID);
+    config_value_t* cfg_stage = config_value_object_get(cfg_obj, CFG_STAGE);
+    config_value_t* cfg_stage_workers = config_value_object_get(
+            cfg_obj, CFG_STAGE_WORKERS);
+    config_value_t* cfg_max_workers = config_value_object_get(
+            cfg_obj, CFG_MAX_WORKERS);
+    const char* err = NULL;
+
+    if(cfg_udf_id != NULL && cfg_udf_id->type != CVT_STRING) {
+        err = "UDF \"id\" must be a string";
+    } else if(cfg_stage != NULL && cfg_stage->type != CVT_STRING) {
+        err = "UDF \"stage\" must be a string";
+    } else if(cfg_stage_workers != NULL &&
+            (cfg_stage_workers->type != CVT_INTEGER ||
+             cfg_stage_workers->body.integer <= 0)) {
+        err = "UDF \"stage_workers\" must be a positive integer";
+    } else if(cfg_max_workers != NULL &&
+            (cfg_max_workers->type != CVT_INTEGER ||
+             cfg_max_workers->body.integer <= 0)) {
+        err = "UDF \"max_workers\" must be a positive integer";
+    } else {
+        if(cfg_udf_id != NULL)
+            udf_id = cfg_udf_id->body.string;
+        if(cfg_stage != NULL)
+            stage_name = cfg_stage->body.string;
+        if(cfg_stage_workers != NULL)
+            stage_workers = cfg_stage_workers->body.integer;
+        if(cfg_max_workers != NULL)
+            max_workers = cfg_max_workers->body.integer;
+    }
+
+    if(cfg_udf_id != NULL)
+        config_value_destroy(cfg_udf_id);
+    if(cfg_stage != NULL)
+        config_value_destroy(cfg_stage);
+    if(cfg_stage_workers != NULL)
+        config_value_destroy(cfg_stage_workers);
+    if(cfg_max_workers != NULL)
+        config_value_destroy(cfg_max_workers);
+    return err;
+}
+
 std::string generate_rand_string(const int len) {
     std::stringstream ss;
     for (auto i = 0; i < len; i++) {
@@ -76,7 +422,14 @@ UdfManager::UdfManager(
         std::string service_name, EncodeType enc_type, int enc_lvl) :
     m_th(NULL), m_stop(false), m_config(udf_cfg),
     m_udf_input_queue(input_queue), m_udf_output_queue(output_queue),
-    m_service_name(service_name), m_enc_type(enc_type), m_enc_lvl(enc_lvl)
+    m_service_name(service_name), m_enc_type(enc_type), m_enc_lvl(enc_lvl),
+    m_pack_frames(false), m_reorder(NULL), m_next_seq(0),
+    m_batch_size(DEFAULT_BATCH_SIZE),
+    m_batch_max_wait(DEFAULT_BATCH_MAX_WAIT),
+    m_input_shedder(NULL), m_output_shedder(NULL), m_latency_budget(0),
+    m_expired_stubs(false), m_expired(0), m_encoder(NULL),
+    m_branch_pool(NULL), m_manager_placement(NULL), m_worker_placement(NULL),
+    m_encoder_placement(NULL)
 {
     config_value_t* udfs = NULL;
 
@@ -104,79 +457,659 @@ UdfManager::UdfManager(
     }
     LOG_INFO("max_workers: %d", max_workers);
 
-    // Initialize thread executor
-    m_executor = new ThreadExecutor(
-            max_workers, std::bind(
-                &UdfManager::run, this,
-                std::placeholders::_1,
-                std::placeholders::_2,
-                std::placeholders::_3), NULL);
+    // Get the (optional) frame buffer pool settings
+    FrameBufferPool* pool = FrameBufferPool::get_instance();
+    size_t pool_max_bytes = FRAME_BUFFER_DEFAULT_MAX_CACHED;
+    bool pool_hugepages = false;
+    config_value_t* cfg_pool_max_mb = config_get(m_config, CFG_POOL_MAX_MB);
+    config_value_t* cfg_pool_hugepages = config_get(
+            m_config, CFG_POOL_HUGEPAGES);
+    if(cfg_pool_max_mb != NULL || cfg_pool_hugepages != NULL) {
+        if(cfg_pool_max_mb != NULL) {
+            if(cfg_pool_max_mb->type != CVT_INTEGER ||
+                    cfg_pool_max_mb->body.integer < 0) {
+                config_value_destroy(cfg_pool_max_mb);
+                if(cfg_pool_hugepages != NULL)
+                    config_value_destroy(cfg_pool_hugepages);
+                config_value_destroy(udfs);
+                throw "\"frame_pool_max_mb\" must be a positive integer";
+            }
+            pool_max_bytes = ((size_t) cfg_pool_max_mb->body.integer) *
+                1024 * 1024;
+            config_value_destroy(cfg_pool_max_mb);
+        }
+        if(cfg_pool_hugepages != NULL) {
+            if(cfg_pool_hugepages->type != CVT_BOOLEAN) {
+                config_value_destroy(cfg_pool_hugepages);
+                config_value_destroy(udfs);
+                throw "\"frame_pool_hugepages\" must be a boolean";
+            }
+            pool_hugepages = cfg_pool_hugepages->body.boolean;
+            config_value_destroy(cfg_pool_hugepages);
+        }
+        LOG_INFO("frame_pool_max_mb: %lu, frame_pool_hugepages: %d",
+                 pool_max_bytes / (1024 * 1024), pool_hugepages);
+        pool->configure(pool_max_bytes, pool_hugepages);
+    }
+
+    // Get the (optional) layout for serializing multi-frame output frames
+    config_value_t* cfg_pack_frames = config_get(m_config, CFG_PACK_FRAMES);
+    if(cfg_pack_frames != NULL) {
+        if(cfg_pack_frames->type != CVT_BOOLEAN) {
+            config_value_destroy(cfg_pack_frames);
+            config_value_destroy(udfs);
+            throw "\"pack_frames\" must be a boolean";
+        }
+        m_pack_frames = cfg_pack_frames->body.boolean;
+        config_value_destroy(cfg_pack_frames);
+        LOG_INFO("pack_frames: %d", m_pack_frames);
+    }
 
-    m_profile = new Profiling();
+    // Get the (optional) shared memory ring for publishing the output frames
+    config_value_t* cfg_shm_ring = config_get(m_config, CFG_SHM_RING);
+    if(cfg_shm_ring != NULL) {
+        if(cfg_shm_ring->type != CVT_OBJECT) {
+            config_value_destroy(cfg_shm_ring);
+            config_value_destroy(udfs);
+            throw "\"shm_ring\" must be an object";
+        }
 
-    int len = (int) config_value_array_len(udfs);
+        config_value_t* shm_name = config_value_object_get(
+                cfg_shm_ring, CFG_SHM_NAME);
+        config_value_t* shm_slot_mb = config_value_object_get(
+                cfg_shm_ring, CFG_SHM_SLOT_MB);
+        config_value_t* shm_num_slots = config_value_object_get(
+                cfg_shm_ring, CFG_SHM_NUM_SLOTS);
+        int slot_mb = DEFAULT_SHM_SLOT_MB;
+        int num_slots = DEFAULT_SHM_NUM_SLOTS;
+        const char* err = NULL;
 
-    for(int i = 0; i < len; i++) {
-        config_value_t* cfg_obj = config_value_array_get(udfs, i);
-        if(cfg_obj == NULL) {
-            throw "Failed to get configuration array element";
+        if(shm_name == NULL || shm_name->type != CVT_STRING) {
+            err = "\"shm_ring\" \"name\" must be a string";
+        } else if(shm_slot_mb != NULL && (shm_slot_mb->type != CVT_INTEGER ||
+                    shm_slot_mb->body.integer <= 0)) {
+            err = "\"slot_size_mb\" must be a positive integer";
+        } else if(shm_num_slots != NULL &&
+                (shm_num_slots->type != CVT_INTEGER ||
+                 shm_num_slots->body.integer <= 0)) {
+            err = "\"num_slots\" must be a positive integer";
         }
-        if(cfg_obj->type != CVT_OBJECT) {
-            throw "UDF configuration must be objects";
+
+        if(err == NULL) {
+            if(shm_slot_mb != NULL)
+                slot_mb = shm_slot_mb->body.integer;
+            if(shm_num_slots != NULL)
+                num_slots = shm_num_slots->body.integer;
+            LOG_INFO("shm_ring: %s, slot_size_mb: %d, num_slots: %d",
+                     shm_name->body.string, slot_mb, num_slots);
+            try {
+                m_shm_ring = ShmRing::create(
+                        shm_name->body.string,
+                        ((size_t) slot_mb) * 1024 * 1024, num_slots);
+            } catch(const char* ex) {
+                err = ex;
+            }
         }
-        config_value_t* name = config_value_object_get(cfg_obj, "name");
-        if(name == NULL) {
-            throw "Failed to get UDF name";
+
+        if(shm_name != NULL)
+            config_value_destroy(shm_name);
+        if(shm_slot_mb != NULL)
+            config_value_destroy(shm_slot_mb);
+        if(shm_num_slots != NULL)
+            config_value_destroy(shm_num_slots);
+        config_value_destroy(cfg_shm_ring);
+        if(err != NULL) {
+            config_value_destroy(udfs);
+            throw err;
         }
-        if(name->type != CVT_STRING) {
-            throw "UDF name must be a string";
+    }
+
+    // Get the (optional) pipelined execution settings
+    bool pipelined = false;
+    int stage_queue_size = DEFAULT_STAGE_QUEUE;
+    config_value_t* cfg_pipelined = config_get(m_config, CFG_PIPELINED);
+    if(cfg_pipelined != NULL) {
+        if(cfg_pipelined->type != CVT_BOOLEAN) {
+            config_value_destroy(cfg_pipelined);
+            config_value_destroy(udfs);
+            throw "\"pipelined\" must be a boolean";
         }
-        // TODO: Add max workers
-        void (*free_ptr)(void*) = NULL;
-        if(cfg_obj->body.object->free == NULL) {
-            free_ptr = free_fn;
-        } else {
-            free_ptr = cfg_obj->body.object->free;
+        pipelined = cfg_pipelined->body.boolean;
+        config_value_destroy(cfg_pipelined);
+    }
+    config_value_t* cfg_stage_queue = config_get(m_config, CFG_STAGE_QUEUE);
+    if(cfg_stage_queue != NULL) {
+        if(cfg_stage_queue->type != CVT_INTEGER ||
+                cfg_stage_queue->body.integer <= 0) {
+            config_value_destroy(cfg_stage_queue);
+            config_value_destroy(udfs);
+            throw "\"stage_queue_size\" must be a positive integer";
+        }
+        stage_queue_size = cfg_stage_queue->body.integer;
+        config_value_destroy(cfg_stage_queue);
+    }
+    if(pipelined) {
+        LOG_INFO("pipelined: %d, stage_queue_size: %d",
+                 pipelined, stage_queue_size);
+    }
+
+    // Get the (optional) settings for publishing the frames in input order
+    bool ordered = false;
+    int reorder_size = DEFAULT_REORDER_SIZE;
+    int reorder_latency = DEFAULT_REORDER_LATENCY;
+    config_value_t* cfg_ordered = config_get(m_config, CFG_ORDERED);
+    if(cfg_ordered != NULL) {
+        if(cfg_ordered->type != CVT_BOOLEAN) {
+            config_value_destroy(cfg_ordered);
+            config_value_destroy(udfs);
+            throw "\"ordered\" must be a boolean";
         }
-        config_t* cfg = config_new(
-                (void*) cfg_obj, free_ptr, get_config_value, NULL);
-        if(cfg == NULL) {
-            throw "Failed to initialize configuration for UDF";
+        ordered = cfg_ordered->body.boolean;
+        config_value_destroy(cfg_ordered);
+    }
+    config_value_t* cfg_reorder_size = config_get(m_config, CFG_REORDER_SIZE);
+    if(cfg_reorder_size != NULL) {
+        if(cfg_reorder_size->type != CVT_INTEGER ||
+                cfg_reorder_size->body.integer <= 0) {
+            config_value_destroy(cfg_reorder_size);
+            config_value_destroy(udfs);
+            throw "\"reorder_buffer_size\" must be a positive integer";
         }
+        reorder_size = cfg_reorder_size->body.integer;
+        config_value_destroy(cfg_reorder_size);
+    }
+    config_value_t* cfg_reorder_latency = config_get(
+            m_config, CFG_REORDER_LATENCY);
+    if(cfg_reorder_latency != NULL) {
+        if(cfg_reorder_latency->type != CVT_INTEGER ||
+                cfg_reorder_latency->body.integer < 0) {
+            config_value_destroy(cfg_reorder_latency);
+            config_value_destroy(udfs);
+            throw "\"reorder_max_latency_ms\" must be a non-negative integer";
+        }
+        reorder_latency = cfg_reorder_latency->body.integer;
+        config_value_destroy(cfg_reorder_latency);
+    }
+    if(ordered) {
+        LOG_INFO("ordered: %d, reorder_buffer_size: %d, "
+                 "reorder_max_latency_ms: %d",
+                 ordered, reorder_size, reorder_latency);
+    }
 
-        LOG_DEBUG("Loading UDF...");
-        UdfHandle* handle = g_loader.load(name->body.string, cfg, 1);
-        if(handle == NULL) {
-            throw "Failed to load UDF";
+    // Get the (optional) way frames are handed to the workers
+    bool work_stealing = false;
+    config_value_t* cfg_scheduler = config_get(m_config, CFG_SCHEDULER);
+    if(cfg_scheduler != NULL) {
+        if(cfg_scheduler->type != CVT_STRING) {
+            config_value_destroy(cfg_scheduler);
+            config_value_destroy(udfs);
+            throw "\"scheduler\" must be a string";
+        }
+        if(strcmp(cfg_scheduler->body.string, SCHEDULER_WORK_STEALING) == 0) {
+            work_stealing = true;
+        } else if(strcmp(cfg_scheduler->body.string,
+                         SCHEDULER_CENTRAL) != 0) {
+            config_value_destroy(cfg_scheduler);
+            config_value_destroy(udfs);
+            throw "\"scheduler\" must be \"central\" or \"work_stealing\"";
         }
+        LOG_INFO("scheduler: %s", cfg_scheduler->body.string);
+        config_value_destroy(cfg_scheduler);
+    }
 
-        if(m_profile->is_profiling_enabled()) {
+    // Get the (optional) batching settings
+    config_value_t* cfg_batch_size = config_get(m_config, CFG_BATCH_SIZE);
+    if(cfg_batch_size != NULL) {
+        if(cfg_batch_size->type != CVT_INTEGER ||
+                cfg_batch_size->body.integer <= 0) {
+            config_value_destroy(cfg_batch_size);
+            config_value_destroy(udfs);
+            throw "\"batch_size\" must be a positive integer";
+        }
+        m_batch_size = cfg_batch_size->body.integer;
+        config_value_destroy(cfg_batch_size);
+    }
+    config_value_t* cfg_batch_max_wait = config_get(
+            m_config, CFG_BATCH_MAX_WAIT);
+    if(cfg_batch_max_wait != NULL) {
+        if(cfg_batch_max_wait->type != CVT_INTEGER ||
+                cfg_batch_max_wait->body.integer < 0) {
+            config_value_destroy(cfg_batch_max_wait);
+            config_value_destroy(udfs);
+            throw "\"batch_max_wait_ms\" must be a non-negative integer";
+        }
+        m_batch_max_wait = std::chrono::milliseconds(
+                cfg_batch_max_wait->body.integer);
+        config_value_destroy(cfg_batch_max_wait);
+    }
+    if(m_batch_size > 1) {
+        LOG_INFO("batch_size: %d, batch_max_wait_ms: %ld", m_batch_size,
+                 (long) m_batch_max_wait.count());
+    }
 
-            std::string udf_name_str(name->body.string);
-            std::string rand_str = generate_rand_string(RANDOM_STR_LENGTH);
-            if(i == 0) {
-                std::string udf_entry_str = udf_name_str + "_" + rand_str + "_" + m_service_name + "_first" + "_entry";
-                std::string udf_exit_str = udf_name_str + "_" + rand_str + "_" + m_service_name + "_first" + "_exit";
+    // Get the (optional) policies for frames pushed into a full input or
+    // output queue
+    ShedPolicy input_policy = SHED_BLOCK;
+    ShedPolicy output_policy = SHED_BLOCK;
+    int keep_every_nth = DEFAULT_KEEP_EVERY_NTH;
+    const char* policy_err = get_shed_policy(
+            m_config, CFG_INPUT_POLICY, &input_policy);
+    if(policy_err == NULL) {
+        policy_err = get_shed_policy(
+                m_config, CFG_OUTPUT_POLICY, &output_policy);
+    }
+    if(policy_err != NULL) {
+        config_value_destroy(udfs);
+        throw policy_err;
+    }
+    config_value_t* cfg_keep_every = config_get(m_config, CFG_KEEP_EVERY_NTH);
+    if(cfg_keep_every != NULL) {
+        if(cfg_keep_every->type != CVT_INTEGER ||
+                cfg_keep_every->body.integer <= 0) {
+            config_value_destroy(cfg_keep_every);
+            config_value_destroy(udfs);
+            throw "\"keep_every_nth\" must be a positive integer";
+        }
+        keep_every_nth = cfg_keep_every->body.integer;
+        config_value_destroy(cfg_keep_every);
+    }
 
-                handle->set_prof_entry_key(udf_entry_str);
-                handle->set_prof_exit_key(udf_exit_str);
+    // Get the (optional) maximum age of a frame to still be processed
+    config_value_t* cfg_budget = config_get(m_config, CFG_LATENCY_BUDGET);
+    if(cfg_budget != NULL) {
+        if(cfg_budget->type != CVT_INTEGER || cfg_budget->body.integer < 0) {
+            config_value_destroy(cfg_budget);
+            config_value_destroy(udfs);
+            throw "\"latency_budget_ms\" must be a non-negative integer";
+        }
+        m_latency_budget = std::chrono::milliseconds(
+                cfg_budget->body.integer);
+        config_value_destroy(cfg_budget);
+    }
+    config_value_t* cfg_stubs = config_get(m_config, CFG_EXPIRED_STUBS);
+    if(cfg_stubs != NULL) {
+        if(cfg_stubs->type != CVT_BOOLEAN) {
+            config_value_destroy(cfg_stubs);
+            config_value_destroy(udfs);
+            throw "\"expired_stubs\" must be a boolean";
+        }
+        m_expired_stubs = cfg_stubs->body.boolean;
+        config_value_destroy(cfg_stubs);
+    }
+    if(m_latency_budget.count() > 0) {
+        LOG_INFO("latency_budget_ms: %ld, expired_stubs: %d",
+                 (long) m_latency_budget.count(), m_expired_stubs);
+    }
 
+    // Get the (optional) CPU affinity and scheduling settings of the threads,
+    // which are only handed to the members once the whole configuration has
+    // been validated
+    std::unique_ptr<ThreadPlacement> manager_placement;
+    std::unique_ptr<ThreadPlacement> worker_placement;
+    std::unique_ptr<ThreadPlacement> encoder_placement;
+    config_value_t* cfg_placement = config_get(m_config, CFG_PLACEMENT);
+    if(cfg_placement != NULL) {
+        const char* err = NULL;
+        if(cfg_placement->type != CVT_OBJECT) {
+            err = "\"placement\" must be an object";
+        }
+        if(err == NULL) {
+            err = get_thread_placement(
+                    cfg_placement, CFG_PLACE_MANAGER, manager_placement);
+        }
+        if(err == NULL) {
+            err = get_thread_placement(
+                    cfg_placement, CFG_PLACE_WORKERS, worker_placement);
+        }
+        if(err == NULL) {
+            err = get_thread_placement(
+                    cfg_placement, CFG_PLACE_ENCODER, encoder_placement);
+        }
+        if(err == NULL) {
+            config_value_t* cfg_numa_bufs = config_value_object_get(
+                    cfg_placement, CFG_PLACE_NUMA_BUFS);
+            if(cfg_numa_bufs != NULL) {
+                if(cfg_numa_bufs->type != CVT_BOOLEAN) {
+                    err = "\"numa_local_buffers\" must be a boolean";
+                } else if(cfg_numa_bufs->body.boolean) {
+                    LOG_INFO_0("numa_local_buffers: 1");
+                    pool->set_numa_local(true);
+                }
+                config_value_destroy(cfg_numa_bufs);
+            }
+        }
+        config_value_destroy(cfg_placement);
+        if(err != NULL) {
+            config_value_destroy(udfs);
+            throw err;
+        }
+
+        // Report the topology the placement refers to, each thread reports
+        // its own placement when it starts
+        const CpuTopology& topo = get_cpu_topology();
+        std::set<int> nodes(topo.node.begin(), topo.node.end());
+        nodes.erase(-1);
+        LOG_INFO("CPU topology: %lu CPU(s), NUMA node(s): %s",
+                 topo.node.size(), format_cpu_list(std::vector<int>(
+                         nodes.begin(), nodes.end())).c_str());
+    }
+
+    // Get the (optional) encoder stage settings, without encoder workers the
+    // frames are encoded by the thread serializing them
+    int encoder_workers = 0;
+    int encoder_queue_size = DEFAULT_ENCODER_QUEUE;
+    config_value_t* cfg_enc_workers = config_get(
+            m_config, CFG_ENCODER_WORKERS);
+    if(cfg_enc_workers != NULL) {
+        if(cfg_enc_workers->type != CVT_INTEGER ||
+                cfg_enc_workers->body.integer < 0) {
+            config_value_destroy(cfg_enc_workers);
+            config_value_destroy(udfs);
+            throw "\"encoder_workers\" must be a non-negative integer";
+        }
+        encoder_workers = cfg_enc_workers->body.integer;
+        config_value_destroy(cfg_enc_workers);
+    }
+    config_value_t* cfg_enc_queue = config_get(m_config, CFG_ENCODER_QUEUE);
+    if(cfg_enc_queue != NULL) {
+        if(cfg_enc_queue->type != CVT_INTEGER ||
+                cfg_enc_queue->body.integer <= 0) {
+            config_value_destroy(cfg_enc_queue);
+            config_value_destroy(udfs);
+            throw "\"encoder_queue_size\" must be a positive integer";
+        }
+        encoder_queue_size = cfg_enc_queue->body.integer;
+        config_value_destroy(cfg_enc_queue);
+    }
+    if(encoder_workers > 0) {
+        LOG_INFO("encoder_workers: %d, encoder_queue_size: %d",
+                 encoder_workers, encoder_queue_size);
+    }
+
+    m_profile = new Profiling();
+
+    // Name of the stage of the previously loaded UDF
+    std::string prev_stage_name;
+    UdfStage* stage = NULL;
+
+    // IDs of the UDFs in the graph, if the UDFs are connected by edges
+    std::vector<std::string> udf_ids;
+
+    // Number of threads running the branches of the UDF graph
+    int branch_workers = max_workers;
+
+    // Everything allocated while loading the UDFs is cleaned up if a UDF
+    // fails to load or the UDF configuration is invalid
+    try {
+        int len = (int) config_value_array_len(udfs);
+
+        for(int i = 0; i < len; i++) {
+            config_value_t* cfg_obj = config_value_array_get(udfs, i);
+            if(cfg_obj == NULL) {
+                throw "Failed to get configuration array element";
+            }
+            config_value_t* name = NULL;
+            const char* err = NULL;
+            if(cfg_obj->type != CVT_OBJECT) {
+                err = "UDF configuration must be objects";
+            } else {
+                name = config_value_object_get(cfg_obj, "name");
+                if(name == NULL) {
+                    err = "Failed to get UDF name";
+                } else if(name->type != CVT_STRING) {
+                    err = "UDF name must be a string";
+                }
+            }
+
+            // Get the (optional) ID of the UDF in the graph, which defaults to
+            // its name, its stage placement and the limit of threads
+            // executing the UDF at once, without a limit the UDF must be
+            // thread-safe
+            std::string udf_id;
+            std::string stage_name;
+            int stage_workers = DEFAULT_STAGE_WORKERS;
+            int udf_max_workers = 0;
+            if(err == NULL) {
+                udf_id = name->body.string;
+                err = get_udf_options(cfg_obj, udf_id, stage_name,
+                                      stage_workers, udf_max_workers);
+            }
+            if(err != NULL) {
+                if(name != NULL)
+                    config_value_destroy(name);
+                config_value_destroy(cfg_obj);
+                throw err;
+            }
+            udf_ids.push_back(udf_id);
+            if(udf_max_workers > 0) {
+                LOG_INFO("UDF %s max_workers: %d",
+                         name->body.string, udf_max_workers);
+            }
+
+            void (*free_ptr)(void*) = NULL;
+            if(cfg_obj->body.object->free == NULL) {
+                free_ptr = free_fn;
             } else {
-                std::string udf_entry_str = udf_name_str + "_" + rand_str + "_" + m_service_name + "_entry";
-                std::string udf_exit_str = udf_name_str + "_" + rand_str + "_" + m_service_name + "_exit";
+                free_ptr = cfg_obj->body.object->free;
+            }
+            config_t* cfg = config_new(
+                    (void*) cfg_obj, free_ptr, get_config_value, NULL);
+            if(cfg == NULL) {
+                config_value_destroy(name);
+                config_value_destroy(cfg_obj);
+                throw "Failed to initialize configuration for UDF";
+            }
+
+            LOG_DEBUG("Loading UDF...");
+            UdfHandle* handle = g_loader.load(
+                    name->body.string, cfg, udf_max_workers);
+            if(handle == NULL) {
+                config_value_destroy(name);
+                throw "Failed to load UDF";
+            }
+
+            if(m_profile->is_profiling_enabled()) {
+
+                std::string udf_name_str(name->body.string);
+                std::string rand_str = generate_rand_string(RANDOM_STR_LENGTH);
+                if(i == 0) {
+                    std::string udf_entry_str = udf_name_str + "_" + rand_str + "_" + m_service_name + "_first" + "_entry";
+                    std::string udf_exit_str = udf_name_str + "_" + rand_str + "_" + m_service_name + "_first" + "_exit";
+
+                    handle->set_prof_entry_key(udf_entry_str);
+                    handle->set_prof_exit_key(udf_exit_str);
+
+                } else {
+                    std::string udf_entry_str = udf_name_str + "_" + rand_str + "_" + m_service_name + "_entry";
+                    std::string udf_exit_str = udf_name_str + "_" + rand_str + "_" + m_service_name + "_exit";
+
+                    handle->set_prof_entry_key(udf_entry_str);
+                    handle->set_prof_exit_key(udf_exit_str);
+
+                }
+            }
+            config_value_destroy(name);
+            m_udfs.push_back(handle);
+
+            // Without pipelining all UDFs run in one stage, otherwise each UDF
+            // starts a new stage, unless it shares the stage name of the
+            // preceding UDF
+            if(stage == NULL || (pipelined && (stage_name.empty() ||
+                            stage_name != prev_stage_name))) {
+                stage = new UdfStage();
+                stage->graph = NULL;
+                stage->workers = 0;
+                stage->executor = NULL;
+                stage->scheduler = NULL;
+                stage->feeder = NULL;
+                m_stages.push_back(stage);
+            }
+            stage->udfs.push_back(handle);
+            if(pipelined && stage_workers > stage->workers) {
+                stage->workers = stage_workers;
+            }
+            prev_stage_name = stage_name;
+        }
+        if(stage == NULL) {
+            // No UDFs, frames are only passed through by a single stage,
+            // even if pipelining is enabled
+            if(pipelined) {
+                LOG_WARN_0("No UDFs to pipeline, frames are passed through");
+                pipelined = false;
+            }
+            stage = new UdfStage();
+            stage->graph = NULL;
+            stage->executor = NULL;
+            stage->scheduler = NULL;
+            stage->feeder = NULL;
+            m_stages.push_back(stage);
+        }
+        if(!pipelined) {
+            stage->workers = max_workers;
+        }
 
-                handle->set_prof_entry_key(udf_entry_str);
-                handle->set_prof_exit_key(udf_exit_str);
+        // Get the (optional) edges between the UDFs, without edges the UDFs
+        // form a chain in the order of the "udfs" array
+        config_value_t* cfg_edges = config_get(m_config, CFG_EDGES);
+        if(cfg_edges != NULL) {
+            const char* err = NULL;
+            config_value_t* cfg_branch_workers = config_get(
+                    m_config, CFG_BRANCH_WORKERS);
+            if(cfg_edges->type != CVT_ARRAY) {
+                err = "\"edges\" must be an array";
+            } else if(pipelined) {
+                err = "\"edges\" cannot be combined with \"pipelined\"";
+            } else if(cfg_branch_workers != NULL &&
+                    (cfg_branch_workers->type != CVT_INTEGER ||
+                     cfg_branch_workers->body.integer < 0)) {
+                err = "\"branch_workers\" must be a non-negative integer";
+            } else if(cfg_branch_workers != NULL) {
+                branch_workers = cfg_branch_workers->body.integer;
+            }
+            if(cfg_branch_workers != NULL)
+                config_value_destroy(cfg_branch_workers);
+
+            // Every UDF of the graph runs on its own, so that the frame can be
+            // routed between the UDFs
+            UdfGraph* graph = NULL;
+            int num_edges = 0;
+            if(err == NULL) {
+                graph = new UdfGraph([this](UdfHandle* handle, Frame* frame) {
+                    return run_udfs(std::vector<UdfHandle*>(1, handle), frame);
+                });
+                try {
+                    for(size_t i = 0; i < m_udfs.size(); i++) {
+                        graph->add_udf(udf_ids[i], m_udfs[i]);
+                    }
+                } catch(const char* ex) {
+                    err = ex;
+                }
+                num_edges = (int) config_value_array_len(cfg_edges);
+            }
+            for(int i = 0; i < num_edges && err == NULL; i++) {
+                err = add_graph_edge(graph, cfg_edges, i);
+            }
+            if(err == NULL) {
+                try {
+                    graph->finalize();
+                } catch(const char* ex) {
+                    err = ex;
+                }
+            }
+            config_value_destroy(cfg_edges);
+            if(err != NULL) {
+                if(graph != NULL) delete graph;
+                throw err;
+            }
+            LOG_INFO("UDF graph: %lu UDF(s), %d edge(s)",
+                     m_udfs.size(), num_edges);
 
+            if(graph->has_branches() && branch_workers > 0) {
+                LOG_INFO("branch_workers: %d", branch_workers);
             }
+            stage->graph = graph;
+        }
+    } catch(const char* ex) {
+        for(auto s : m_stages) {
+            if(s->graph != NULL) delete s->graph;
+            delete s;
+        }
+        m_stages.clear();
+        for(auto handle : m_udfs) {
+            delete handle;
+        }
+        m_udfs.clear();
+        delete m_profile;
+        m_profile = NULL;
+        config_value_destroy(udfs);
+        throw ex;
+    }
+
+    // Chain the stages together with bounded queues, so that a slow stage
+    // blocks the stages before it instead of letting frames pile up
+    size_t num_stages = m_stages.size();
+    for(size_t i = 0; i < num_stages; i++) {
+        UdfStage* s = m_stages[i];
+        s->first = (i == 0);
+        s->last = (i == num_stages - 1);
+        s->input_queue = s->first ?
+            m_udf_input_queue : m_stages[i - 1]->output_queue;
+        s->output_queue = s->last ?
+            m_udf_output_queue : new FrameQueue(stage_queue_size);
+        if(pipelined) {
+            LOG_INFO("Stage %lu: %lu UDF(s), %d worker(s)",
+                     i, s->udfs.size(), s->workers);
         }
-        config_value_destroy(name);
-        m_udfs.push_back(handle);
     }
     m_udf_push_entry_key = m_service_name + "_UDF_output_queue_ts";
     m_udf_push_block_key = m_service_name + "_UDF_output_queue_blocked_ts";
 
     config_value_destroy(udfs);
+
+    // The helpers are only allocated once the whole configuration has been
+    // validated, so that a configuration error does not leak them
+    if(ordered) {
+        m_reorder = new ReorderBuffer(
+                std::bind(&UdfManager::push_output, this,
+                          std::placeholders::_1),
+                reorder_size, reorder_latency);
+    }
+    m_input_shedder = new LoadShedder(input_policy, keep_every_nth);
+    m_output_shedder = new LoadShedder(output_policy, keep_every_nth);
+    m_manager_placement = manager_placement.release();
+    m_worker_placement = worker_placement.release();
+    m_encoder_placement = encoder_placement.release();
+    if(encoder_workers > 0) {
+        m_encoder = new WorkerPool(
+                encoder_workers, encoder_queue_size, m_encoder_placement,
+                "Encoder");
+    }
+
+    // Without branch workers the branches of the UDF graph run one after the
+    // other on the UDF worker processing the frame
+    if(stage->graph != NULL && stage->graph->has_branches() &&
+            branch_workers > 0) {
+        m_branch_pool = new WorkerPool(
+                branch_workers, branch_workers * BRANCH_QUEUED_PER_WORKER,
+                m_worker_placement, "UDF branch worker");
+        stage->graph->set_branch_pool(m_branch_pool);
+    }
+
+    // Initialize the thread executors, once all UDFs have been loaded
+    for(auto s : m_stages) {
+        if(work_stealing) {
+            // A single feeder thread pops the stage's input queue, instead
+            // of all workers contending for it
+            s->scheduler = new WorkStealingScheduler(s->workers);
+            s->feeder = new std::thread(&UdfManager::feed, this, s);
+        }
+        s->executor = new ThreadExecutor(
+                s->workers, std::bind(
+                    &UdfManager::run, this,
+                    std::placeholders::_1,
+                    std::placeholders::_2,
+                    std::placeholders::_3), (void*) s);
+    }
 }
 
 UdfManager::UdfManager(const UdfManager& src) {
@@ -193,14 +1126,63 @@ UdfManager::~UdfManager() {
         delete m_th;
     }
 
-    // Clean up the executor
-    delete m_executor;
+    // Clean up the executors and the queues between the stages
+    for(auto stage : m_stages) {
+        delete stage->executor;
+        if(stage->graph != NULL) {
+            delete stage->graph;
+        }
+        if(stage->scheduler != NULL) {
+            delete stage->feeder;
+            delete stage->scheduler;
+        }
+        if(!stage->last) {
+            while(!stage->output_queue->empty()) {
+                Frame* frame = stage->output_queue->pop();
+                if (frame != NULL) delete frame;
+            }
+            delete stage->output_queue;
+        }
+        delete stage;
+    }
+
+    // Delete the frames still waiting for the frames before them
+    if(m_reorder != NULL) {
+        LOG_INFO("Reorder buffer: %lu missing frame(s) skipped, "
+                 "%lu late frame(s) dropped",
+                 (unsigned long) m_reorder->get_skipped(),
+                 (unsigned long) m_reorder->get_late());
+        delete m_reorder;
+    }
+
+    // Report how many frames were shed because a queue was full
+    if(m_input_shedder->get_shed() > 0 || m_output_shedder->get_shed() > 0) {
+        LOG_INFO("Queue overflow: %lu input frame(s) and %lu output "
+                 "frame(s) shed",
+                 (unsigned long) m_input_shedder->get_shed(),
+                 (unsigned long) m_output_shedder->get_shed());
+    }
+    delete m_input_shedder;
+    delete m_output_shedder;
+
+    // The threads using the placements have been stopped
+    if(m_manager_placement != NULL) delete m_manager_placement;
+    if(m_worker_placement != NULL) delete m_worker_placement;
+    if(m_encoder_placement != NULL) delete m_encoder_placement;
+
+    if(m_expired.load() > 0) {
+        LOG_INFO("Latency budget: %lu frame(s) expired",
+                 (unsigned long) m_expired.load());
+    }
 
     LOG_DEBUG_0("Deleting all handles");
     for(auto handle : m_udfs) {
         delete handle;
     }
 
+    // Report how well frame buffers have been recycled
+    FrameBufferPool::get_instance()->log_stats();
+
     LOG_DEBUG_0("Deleting UDF timestamp related variables");
     if(m_profile) {
         delete m_profile;
@@ -230,112 +1212,448 @@ UdfManager::~UdfManager() {
 void UdfManager::run(int tid, std::atomic<bool>& stop, void* varg) {
     LOG_INFO_0("UDFManager thread started");
 
+    UdfStage* stage = (UdfStage*) varg;
+
+    if(m_worker_placement != NULL) {
+        m_worker_placement->apply("UDF worker " + std::to_string(tid));
+    }
+
     // How often to check if the thread should quit
     auto duration = std::chrono::milliseconds(250);
-    UdfRetCode ret = UDF_OK;
+
+    // Frames of the current batch and their sequence numbers
+    std::vector<Frame*> frames;
+    std::vector<uint64_t> seqs;
 
     while(!stop.load()) {
-        if(m_udf_input_queue->wait_for(duration)) {
-            LOG_DEBUG_0("Popping frame from input queue");
-            Frame* frame = m_udf_input_queue->pop();
-            if (frame == NULL) continue;
+        Frame* frame = next_frame(stage, tid, duration);
+        if(frame == NULL) {
+            if(stage->last && m_reorder != NULL) {
+                // Release the frames waiting for a frame which never
+                // showed up
+                m_reorder->flush();
+            }
+            continue;
+        }
 
-            EncodeType enc_type = frame->get_encode_type();
-            int enc_lvl = frame->get_encode_level();
+        // Fill up the batch with the frames arriving until the batch's
+        // deadline
+        frames.clear();
+        frames.push_back(frame);
+        if(m_batch_size > 1) {
+            auto deadline = std::chrono::steady_clock::now() +
+                m_batch_max_wait;
+            while((int) frames.size() < m_batch_size) {
+                auto remaining = std::chrono::duration_cast<
+                    std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now());
+                if(remaining.count() <= 0) break;
+                frame = next_frame(stage, tid, remaining);
+                if(frame == NULL) break;
+                frames.push_back(frame);
+            }
+        }
+
+        seqs.clear();
+        for(auto f : frames) {
+            seqs.push_back(f->get_sequence());
+        }
+
+        // Frames which are too old for their results to be of use do not
+        // get processed any further
+        if(m_latency_budget.count() > 0) {
+            expire_frames(stage, frames, seqs);
+            if(frames.empty()) continue;
+        }
+
+        for(auto f : frames) {
+            if(!stage->first) break;
+
+            EncodeType enc_type = f->get_encode_type();
+            int enc_lvl = f->get_encode_level();
 
             if((enc_type != m_enc_type) || (enc_lvl != m_enc_lvl)) {
                 try {
-                    frame->set_encoding(m_enc_type, m_enc_lvl);
+                    f->set_encoding(m_enc_type, m_enc_lvl);
                 } catch(const char *err) {
                     LOG_ERROR("Exception: %s", err);
                 } catch(...) {
                     LOG_ERROR("Exception occurred in set_encoding()");
                 }
             }
+        }
+
+        // Execute the stage's UDFs on the queued frame(s)
+        if(stage->graph != NULL) {
+            // The graph processes the frames one at a time, running the
+            // branches of each frame concurrently instead
+            for(size_t i = 0; i < frames.size(); i++) {
+                frames[i] = stage->graph->execute(frames[i]);
+            }
+        } else if(frames.size() == 1) {
+            frames[0] = run_udfs(stage->udfs, frames[0]);
+        } else {
+            LOG_DEBUG("Processing batch of %lu frames", frames.size());
+            run_udfs_batch(stage->udfs, frames);
+        }
+
+        for(size_t i = 0; i < frames.size(); i++) {
+            forward(stage, seqs[i], frames[i]);
+        }
 
-            // Loop over all UDFs and execute them on the queued frame
-            for(auto handle : m_udfs) {
-                if (frame != NULL) {
+        LOG_DEBUG_0("Finished processing frame");
+    }
 
-                    LOG_DEBUG_0("Running UdfHandle::process()");
+    LOG_INFO_0("UDFManager thread stopped");
+}
 
-                    // If the application using the UDF Manager is in profiling
-                    // mode, then add timestamps for UDF entry/exit, else just
-                    // run the UDF
-                    if(m_profile->is_profiling_enabled()) {
-                        msg_envelope_t* meta_data = frame->get_meta_data();
+void UdfManager::feed(UdfStage* stage) {
+    LOG_INFO_0("UDFManager feeder thread started");
 
-                        // Add entry timestamp
-                        DO_PROFILING(
-                                m_profile, meta_data,
-                                handle->get_prof_entry_key().c_str());
+    if(m_manager_placement != NULL) {
+        m_manager_placement->apply("UDF feeder");
+    }
 
-                        ret = handle->process(frame);
+    // How often to check if the thread should quit
+    auto duration = std::chrono::milliseconds(250);
 
-                        // Add exit timestamp
-                        DO_PROFILING(
-                                m_profile, meta_data,
-                                handle->get_prof_exit_key().c_str());
-                    } else {
-                        // Run the UDF by itself, with no profiling timestamps
-                        ret = handle->process(frame);
-                    }
+    while(!m_stop.load()) {
+        if(stage->input_queue->wait_for(duration)) {
+            Frame* frame = pop_frame(stage);
+            if(frame == NULL) continue;
 
-                    // Check the return code from the UDF
-                    switch (ret) {
-                        case UdfRetCode::UDF_DROP_FRAME:
-                            LOG_DEBUG_0("Dropping frame");
-                            delete frame;
-                            frame = NULL;
-                            break;
-                        case UdfRetCode::UDF_ERROR:
-                            LOG_ERROR_0("Failed to process frame");
-                            delete frame;
-                            frame = NULL;
-                            break;
-                        case UdfRetCode::UDF_FRAME_MODIFIED:
-                        case UdfRetCode::UDF_OK:
-                            LOG_DEBUG_0("UDF_OK");
-                            break;
-                        default:
-                            LOG_ERROR_0("Reached default case");
-                            delete frame;
-                            frame = NULL;
-                            break;
-                    }
-                    LOG_DEBUG_0("Done with UDF handle");
-                }
+            // Blocks while the stage's workers are behind
+            if(!stage->scheduler->push(frame)) {
+                if(m_reorder != NULL) m_reorder->skip(frame->get_sequence());
+                delete frame;
+            }
+        }
+    }
+
+    LOG_INFO_0("UDFManager feeder thread stopped");
+}
+
+Frame* UdfManager::pop_frame(UdfStage* stage) {
+    if(stage->first && m_reorder != NULL) {
+        // Pop and number the frame at once, so that the sequence numbers
+        // follow the order of the input queue
+        std::lock_guard<std::mutex> lk(m_seq_mtx);
+        Frame* frame = stage->input_queue->pop();
+        if(frame != NULL) frame->set_sequence(m_next_seq++);
+        return frame;
+    }
+    return stage->input_queue->pop();
+}
+
+Frame* UdfManager::next_frame(
+        UdfStage* stage, int tid, std::chrono::milliseconds timeout) {
+    if(stage->scheduler != NULL) {
+        return stage->scheduler->pop(tid, timeout);
+    } else if(stage->input_queue->wait_for(timeout)) {
+        LOG_DEBUG_0("Popping frame from input queue");
+        return pop_frame(stage);
+    }
+    return NULL;
+}
+
+void UdfManager::forward(UdfStage* stage, uint64_t seq, Frame* frame) {
+    if(frame == NULL) {
+        // Dropped frames must not hold back the frames after them
+        if(m_reorder != NULL) m_reorder->skip(seq);
+    } else if(stage->last) {
+        if(m_encoder != NULL && !frame->is_encoded()) {
+            // Encode on the encoder stage's threads, or on this thread if
+            // the encoder stage is behind
+            if(!m_encoder->submit(
+                        [this, seq, frame]() { encode_output(seq, frame); })) {
+                encode_output(seq, frame);
             }
+        } else {
+            publish(seq, frame);
+        }
+    } else {
+        // Blocks while the next stage is behind, which in turn holds
+        // back this stage's input queue
+        LOG_DEBUG_0("Pushing frame to next stage");
+        QueueRetCode ret_queue = stage->output_queue->push(frame);
+        if(ret_queue == QueueRetCode::QUEUE_FULL) {
+            ret_queue = stage->output_queue->push_wait(frame);
+        }
+        if(ret_queue != QueueRetCode::SUCCESS) {
+            LOG_ERROR_0("Failed to enqueue frame for the next stage, "
+                        "frame dropped");
+            delete frame;
+            if(m_reorder != NULL) m_reorder->skip(seq);
+        }
+    }
+}
+
+void UdfManager::publish(uint64_t seq, Frame* frame) {
+    if(m_reorder != NULL) {
+        m_reorder->push(seq, frame);
+    } else {
+        push_output(frame);
+    }
+}
+
+void UdfManager::encode_output(uint64_t seq, Frame* frame) {
+    try {
+        frame->encode();
+    } catch(const char* err) {
+        LOG_ERROR("Failed to encode frame, frame dropped: %s", err);
+        delete frame;
+        if(m_reorder != NULL) m_reorder->skip(seq);
+        return;
+    } catch(...) {
+        LOG_ERROR_0("Exception occurred in encode(), frame dropped");
+        delete frame;
+        if(m_reorder != NULL) m_reorder->skip(seq);
+        return;
+    }
+    publish(seq, frame);
+}
+
+void UdfManager::expire_frames(
+        UdfStage* stage, std::vector<Frame*>& frames,
+        std::vector<uint64_t>& seqs) {
+    size_t kept = 0;
+    for(size_t i = 0; i < frames.size(); i++) {
+        Frame* frame = check_latency_budget(frames[i]);
+        if(frame == NULL) {
+            forward(stage, seqs[i], NULL);
+        } else if(frame->is_encoded()) {
+            // Publish the stub without running the remaining stages, so that
+            // consumers still learn about the frame
+            publish(seqs[i], frame);
+        } else {
+            frames[kept] = frame;
+            seqs[kept] = seqs[i];
+            kept++;
+        }
+    }
+    frames.resize(kept);
+    seqs.resize(kept);
+}
+
+Frame* UdfManager::check_latency_budget(Frame* frame) {
+    if(m_latency_budget.count() <= 0 || frame->is_encoded()) {
+        return frame;
+    }
+    int64_t age = frame->get_age_ms();
+    if(age <= m_latency_budget.count()) {
+        return frame;
+    }
+
+    LOG_DEBUG("Frame expired (%ld ms old)", (long) age);
+    m_expired++;
+    if(!m_expired_stubs) {
+        delete frame;
+        return NULL;
+    }
+
+    // The pixels are of no use anymore, the placeholder keeps the stub
+    // cheap to publish
+    try {
+        for(int i = 0; i < frame->get_number_of_frames(); i++) {
+            void* data = calloc(1, 1);
+            if(data == NULL) {
+                throw "Failed to allocate placeholder";
+            }
+            try {
+                frame->set_data(i, data, free, data, 1, 1, 1);
+            } catch(const char* ex) {
+                free(data);
+                throw ex;
+            }
+            frame->set_encoding(EncodeType::NONE, 0, i);
+        }
+        frame->encode();
+    } catch(const char* ex) {
+        LOG_ERROR("Failed to create stub of expired frame, frame dropped: %s",
+                  ex);
+        delete frame;
+        return NULL;
+    }
+
+    msg_envelope_t* meta = frame->get_meta_data();
+    msg_envelope_elem_body_t* e_expired = msgbus_msg_envelope_new_bool(true);
+    msg_envelope_elem_body_t* e_age = msgbus_msg_envelope_new_integer(age);
+    if(msgbus_msg_envelope_put(meta, META_EXPIRED, e_expired) !=
+            MSG_SUCCESS) {
+        msgbus_msg_envelope_elem_destroy(e_expired);
+    }
+    if(msgbus_msg_envelope_put(meta, META_FRAME_AGE, e_age) !=
+            MSG_SUCCESS) {
+        msgbus_msg_envelope_elem_destroy(e_age);
+    }
+    return frame;
+}
+
+/**
+ * Check the return code of a UDF.
+ *
+ * @param ret - Return code of the UDF
+ * @return True if processing the frame should continue
+ */
+static bool check_udf_ret(UdfRetCode ret) {
+    switch (ret) {
+        case UdfRetCode::UDF_DROP_FRAME:
+            LOG_DEBUG_0("Dropping frame");
+            return false;
+        case UdfRetCode::UDF_ERROR:
+            LOG_ERROR_0("Failed to process frame");
+            return false;
+        case UdfRetCode::UDF_FRAME_MODIFIED:
+        case UdfRetCode::UDF_OK:
+            LOG_DEBUG_0("UDF_OK");
+            return true;
+        default:
+            LOG_ERROR_0("Reached default case");
+            return false;
+    }
+}
+
+Frame* UdfManager::run_udfs(
+        const std::vector<UdfHandle*>& udfs, Frame* frame) {
+    UdfRetCode ret = UDF_OK;
+
+    // Loop over the UDFs and execute them on the frame
+    for(auto handle : udfs) {
+        // The frame may exceed the latency budget while it is processed
+        frame = check_latency_budget(frame);
+        if(frame == NULL || frame->is_encoded()) {
+            return frame;
+        }
+
+        LOG_DEBUG_0("Running UdfHandle::process()");
+
+        // If the application using the UDF Manager is in profiling
+        // mode, then add timestamps for UDF entry/exit, else just
+        // run the UDF
+        if(m_profile->is_profiling_enabled()) {
+            msg_envelope_t* meta_data = frame->get_meta_data();
 
-            if (ret == UDF_OK) {
-                LOG_DEBUG_0("Pushing frame to output queue");
+            // Add entry timestamp
+            DO_PROFILING(
+                    m_profile, meta_data,
+                    handle->get_prof_entry_key().c_str());
 
-                // Add output queue entry timestamp
+            ret = handle->execute(frame);
+
+            // Add exit timestamp
+            DO_PROFILING(
+                    m_profile, meta_data,
+                    handle->get_prof_exit_key().c_str());
+        } else {
+            // Run the UDF by itself, with no profiling timestamps
+            ret = handle->execute(frame);
+        }
+
+        // Check the return code from the UDF
+        if(!check_udf_ret(ret)) {
+            delete frame;
+            return NULL;
+        }
+        LOG_DEBUG_0("Done with UDF handle");
+    }
+
+    return frame;
+}
+
+void UdfManager::run_udfs_batch(
+        const std::vector<UdfHandle*>& udfs, std::vector<Frame*>& frames) {
+    // Frames still alive, and their index in the batch
+    std::vector<Frame*> live;
+    std::vector<size_t> idx;
+    std::vector<UdfRetCode> rets;
+
+    for(auto handle : udfs) {
+        live.clear();
+        idx.clear();
+        for(size_t i = 0; i < frames.size(); i++) {
+            if(frames[i] == NULL) continue;
+            frames[i] = check_latency_budget(frames[i]);
+            if(frames[i] == NULL || frames[i]->is_encoded()) continue;
+            live.push_back(frames[i]);
+            idx.push_back(i);
+        }
+        if(live.empty()) break;
+        rets.assign(live.size(), UdfRetCode::UDF_OK);
+
+        LOG_DEBUG_0("Running UdfHandle::process_batch()");
+        bool profiling = m_profile->is_profiling_enabled();
+        if(profiling) {
+            // Add entry timestamps
+            for(auto frame : live) {
                 DO_PROFILING(
                         m_profile, frame->get_meta_data(),
-                        m_udf_push_entry_key.c_str());
-
-                QueueRetCode ret_queue = m_udf_output_queue->push(frame);
-                if(ret_queue == QueueRetCode::QUEUE_FULL) {
-                    ret_queue = m_udf_output_queue->push_wait(frame);
-                    if(ret_queue != QueueRetCode::SUCCESS) {
-                        LOG_ERROR_0("Failed to enqueue received message, "
-                                    "message dropped");
-                        delete frame;
-                    }
+                        handle->get_prof_entry_key().c_str());
+            }
+        }
 
-                    // Add timestamp which acts as a marker if queue if blocked
-                    DO_PROFILING(
-                            m_profile, frame->get_meta_data(),
-                            m_udf_push_block_key.c_str());
-                }
+        handle->execute_batch(live, rets);
+
+        for(size_t i = 0; i < live.size(); i++) {
+            if(profiling) {
+                // Add exit timestamp
+                DO_PROFILING(
+                        m_profile, live[i]->get_meta_data(),
+                        handle->get_prof_exit_key().c_str());
             }
 
-            LOG_DEBUG_0("Finished processing frame");
+            // Check the return code from the UDF
+            if(!check_udf_ret(rets[i])) {
+                delete live[i];
+                frames[idx[i]] = NULL;
+            }
         }
+        LOG_DEBUG_0("Done with UDF handle");
     }
+}
 
-    LOG_INFO_0("UDFManager thread stopped");
+void UdfManager::push_output(Frame* frame) {
+    LOG_DEBUG_0("Pushing frame to output queue");
+
+    // Same-host subscribers receive the frame's pixels through the shared
+    // memory ring when the frame is published
+    if(m_shm_ring != nullptr) {
+        frame->set_shm_ring(m_shm_ring);
+    }
+    if(m_pack_frames) {
+        frame->set_packed_layout(true);
+    }
+
+    // Add output queue entry timestamp
+    DO_PROFILING(
+            m_profile, frame->get_meta_data(),
+            m_udf_push_entry_key.c_str());
+
+    // A full queue either blocks or sheds frames, depending on the output
+    // queue's policy
+    bool blocked = false;
+    if(m_output_shedder->push(m_udf_output_queue, frame, &blocked) &&
+            blocked) {
+        // Add timestamp which acts as a marker if queue if blocked
+        DO_PROFILING(
+                m_profile, frame->get_meta_data(),
+                m_udf_push_block_key.c_str());
+    }
+}
+
+bool UdfManager::push_input(Frame* frame) {
+    return m_input_shedder->push(m_udf_input_queue, frame);
+}
+
+uint64_t UdfManager::get_input_shed() {
+    return m_input_shedder->get_shed();
+}
+
+uint64_t UdfManager::get_output_shed() {
+    return m_output_shedder->get_shed();
+}
+
+uint64_t UdfManager::get_expired() {
+    return m_expired.load();
 }
 
 // TODO: Remove this method...
@@ -345,6 +1663,28 @@ void UdfManager::start() {
 void UdfManager::stop() {
     if (!m_stop.load()) {
         m_stop.store(true);
-        m_executor->stop();
+
+        // Stop the stages front to back, so that a stage blocked on a full
+        // queue is drained by the (still running) stage after it
+        for(auto stage : m_stages) {
+            if(stage->feeder != NULL) {
+                stage->feeder->join();
+                stage->scheduler->stop();
+            }
+            stage->executor->stop();
+        }
+
+        // The UDF workers have finished the frames of the UDF graph
+        if(m_branch_pool != NULL) {
+            delete m_branch_pool;
+            m_branch_pool = NULL;
+        }
+
+        // The frames still queued for encoding are encoded and published
+        // before the encoder threads exit
+        if(m_encoder != NULL) {
+            delete m_encoder;
+            m_encoder = NULL;
+        }
     }
 }
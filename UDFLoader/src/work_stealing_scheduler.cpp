@@ -0,0 +1,248 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief @c WorkStealingScheduler implementation
+ */
+
+#include <thread>
+#include <sched.h>
+#include <eii/utils/logger.h>
+
+#include "eii/udf/work_stealing_scheduler.h"
+#include "eii/udf/cpu_topology.h"
+
+using namespace eii::udf;
+
+WorkStealingScheduler::WorkStealingScheduler(
+        int num_workers, size_t capacity) :
+    m_capacity(capacity), m_size(0), m_next(0), m_idle_workers(0),
+    m_full_waiters(0), m_stop(false), m_steals(0)
+{
+    if(num_workers <= 0) {
+        throw "Number of workers must be greater than 0";
+    }
+    if(m_capacity == 0) {
+        m_capacity = ((size_t) num_workers) * WORK_STEALING_FRAMES_PER_WORKER;
+    }
+    for(int i = 0; i < num_workers; i++) {
+        Worker* w = new Worker();
+        w->cpu.store(-1);
+        m_workers.push_back(w);
+    }
+
+    // Read the topology once up front, instead of in the first steal
+    get_cpu_topology();
+}
+
+WorkStealingScheduler::WorkStealingScheduler(
+        const WorkStealingScheduler& src) {
+    throw "This object should not be copied";
+}
+
+WorkStealingScheduler& WorkStealingScheduler::operator=(
+        const WorkStealingScheduler& src) {
+    return *this;
+}
+
+WorkStealingScheduler::~WorkStealingScheduler() {
+    for(auto w : m_workers) {
+        for(auto frame : w->frames) {
+            delete frame;
+        }
+        delete w;
+    }
+}
+
+bool WorkStealingScheduler::push(Frame* frame) {
+    // Wait for room
+    if(m_size.load() >= m_capacity) {
+        std::unique_lock<std::mutex> lk(m_wait_mtx);
+        m_full_waiters++;
+        while(m_size.load() >= m_capacity && !m_stop.load()) {
+            m_not_full.wait(lk);
+        }
+        m_full_waiters--;
+    }
+    if(m_stop.load()) {
+        return false;
+    }
+
+    Worker* w = m_workers[m_next++ % m_workers.size()];
+    {
+        std::lock_guard<std::mutex> lk(w->mtx);
+        w->frames.push_back(frame);
+        m_size++;
+    }
+
+    // Wake up a sleeping worker (the idle count is raised before a worker
+    // checks the size, so the wake up cannot be missed)
+    if(m_idle_workers.load() > 0) {
+        std::lock_guard<std::mutex> lk(m_wait_mtx);
+        m_not_empty.notify_one();
+    }
+
+    return true;
+}
+
+Frame* WorkStealingScheduler::pop(
+        int worker, std::chrono::milliseconds timeout) {
+    worker %= (int) m_workers.size();
+    m_workers[worker]->cpu.store(sched_getcpu());
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while(!m_stop.load()) {
+        Frame* frame = try_pop(worker);
+        if(frame != NULL) {
+            return frame;
+        }
+
+        std::unique_lock<std::mutex> lk(m_wait_mtx);
+        m_idle_workers++;
+        if(m_size.load() > 0) {
+            // A frame is queued, but its deque was locked by its owner or
+            // another thief
+            m_idle_workers--;
+            lk.unlock();
+            if(std::chrono::steady_clock::now() >= deadline) {
+                return NULL;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        std::cv_status status = m_not_empty.wait_until(lk, deadline);
+        m_idle_workers--;
+        if(status == std::cv_status::timeout) {
+            lk.unlock();
+            return try_pop(worker);
+        }
+    }
+
+    return NULL;
+}
+
+void WorkStealingScheduler::stop() {
+    std::lock_guard<std::mutex> lk(m_wait_mtx);
+    m_stop.store(true);
+    m_not_empty.notify_all();
+    m_not_full.notify_all();
+}
+
+size_t WorkStealingScheduler::get_size() {
+    return m_size.load();
+}
+
+int WorkStealingScheduler::get_num_workers() {
+    return (int) m_workers.size();
+}
+
+uint64_t WorkStealingScheduler::get_steals() {
+    return m_steals.load();
+}
+
+Frame* WorkStealingScheduler::try_pop(int worker) {
+    Worker* w = m_workers[worker];
+    {
+        std::lock_guard<std::mutex> lk(w->mtx);
+        if(!w->frames.empty()) {
+            Frame* frame = w->frames.front();
+            w->frames.pop_front();
+            taken();
+            return frame;
+        }
+    }
+    return steal(worker);
+}
+
+Frame* WorkStealingScheduler::steal(int worker) {
+    int num_workers = (int) m_workers.size();
+    if(num_workers == 1) {
+        return NULL;
+    }
+
+    const CpuTopology& topo = get_cpu_topology();
+    int cpu = m_workers[worker]->cpu.load();
+    int l3 = -1;
+    int node = -1;
+    if(cpu >= 0 && cpu < (int) topo.l3.size()) {
+        l3 = topo.l3[cpu];
+        node = topo.node[cpu];
+    }
+
+    // Pass 0: workers sharing the L3 cache, pass 1: workers on the same
+    // NUMA node, pass 2: all other workers
+    std::vector<Frame*> stolen;
+    for(int pass = 0; pass < 3; pass++) {
+        for(int i = 1; i < num_workers; i++) {
+            int victim = (worker + i) % num_workers;
+            Worker* v = m_workers[victim];
+
+            int v_cpu = v->cpu.load();
+            int v_pass = 2;
+            if(v_cpu >= 0 && v_cpu < (int) topo.l3.size()) {
+                if(l3 >= 0 && topo.l3[v_cpu] == l3) {
+                    v_pass = 0;
+                } else if(node >= 0 && topo.node[v_cpu] == node) {
+                    v_pass = 1;
+                }
+            }
+            if(v_pass != pass) {
+                continue;
+            }
+
+            // Skip deques which are busy, instead of waiting for them
+            std::unique_lock<std::mutex> lk(v->mtx, std::try_to_lock);
+            if(!lk.owns_lock() || v->frames.empty()) {
+                continue;
+            }
+            size_t count = (v->frames.size() + 1) / 2;
+            for(size_t j = 0; j < count; j++) {
+                stolen.push_back(v->frames.front());
+                v->frames.pop_front();
+            }
+            lk.unlock();
+
+            m_steals += count;
+
+            // Keep all but the first frame for later, without holding both
+            // locks at once
+            if(count > 1) {
+                Worker* w = m_workers[worker];
+                std::lock_guard<std::mutex> w_lk(w->mtx);
+                w->frames.insert(
+                        w->frames.end(), stolen.begin() + 1, stolen.end());
+            }
+            taken();
+            return stolen[0];
+        }
+    }
+
+    return NULL;
+}
+
+void WorkStealingScheduler::taken() {
+    m_size--;
+
+    // Wake up a producer waiting for room
+    if(m_full_waiters.load() > 0) {
+        std::lock_guard<std::mutex> lk(m_wait_mtx);
+        m_not_full.notify_one();
+    }
+}
@@ -0,0 +1,116 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Implementation of @c WorkerPool class
+ */
+
+#include <exception>
+#include <eii/utils/logger.h>
+
+#include "eii/udf/worker_pool.h"
+
+using namespace eii::udf;
+
+WorkerPool::WorkerPool(
+        int num_workers, int max_queued, ThreadPlacement* placement,
+        const std::string& name) :
+    m_max_queued(max_queued), m_stop(false), m_placement(placement),
+    m_name(name)
+{
+    if (num_workers <= 0) {
+        throw "Worker pool must have at least one worker";
+    }
+    if (max_queued <= 0) {
+        throw "Worker pool must allow at least one queued job";
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        m_threads.push_back(std::thread(&WorkerPool::run, this, i));
+    }
+}
+
+WorkerPool::WorkerPool(const WorkerPool& src) {
+    throw "This object should not be copied";
+}
+
+WorkerPool& WorkerPool::operator=(const WorkerPool& src) {
+    return *this;
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lk(m_mtx);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+
+    for (auto& th : m_threads) {
+        th.join();
+    }
+}
+
+bool WorkerPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lk(m_mtx);
+        if (m_stop || m_jobs.size() >= m_max_queued) {
+            return false;
+        }
+        m_jobs.push_back(job);
+    }
+    m_cv.notify_one();
+    return true;
+}
+
+int WorkerPool::get_num_workers() {
+    return (int) m_threads.size();
+}
+
+void WorkerPool::run(int index) {
+    if (m_placement != NULL) {
+        m_placement->apply(m_name + " " + std::to_string(index));
+    }
+
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lk(m_mtx);
+            m_cv.wait(lk, [this] { return m_stop || !m_jobs.empty(); });
+            if (m_jobs.empty()) {
+                // m_stop must be set
+                return;
+            }
+            job = m_jobs.front();
+            m_jobs.pop_front();
+        }
+
+        // Anything escaping a job must not take down the worker
+        try {
+            job();
+        } catch (const char* ex) {
+            LOG_ERROR("Unhandled error in %s job: %s", m_name.c_str(), ex);
+        } catch (const std::exception& ex) {
+            LOG_ERROR("Unhandled error in %s job: %s",
+                      m_name.c_str(), ex.what());
+        } catch (...) {
+            LOG_ERROR("Unhandled error in %s job", m_name.c_str());
+        }
+    }
+}
@@ -0,0 +1,150 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Unit tests for the color and layout conversion kernels
+ */
+
+#include <opencv2/opencv.hpp>
+#include <gtest/gtest.h>
+#include <eii/utils/logger.h>
+#include "eii/udf/color_convert.h"
+#include "eii/udf/frame.h"
+
+using namespace eii::udf;
+
+// Test class definition for doing setup
+class color_convert_tests : public ::testing::Test {
+protected:
+    void SetUp() override {
+        set_log_level(LOG_LVL_DEBUG);
+        LOG_INFO("Color conversion ISA: %s", get_color_convert_isa());
+    }
+};
+
+// Free method for frames which are owned by the test
+void free_nothing(void*) {}
+
+// Verify the color conversions against OpenCV, including padded rows
+TEST_F(color_convert_tests, color_conversions) {
+    cv::Mat parent(48, 80, CV_8UC3);
+    cv::randu(parent, 0, 255);
+    cv::Mat bgr = parent(cv::Rect(3, 2, 70, 40));
+
+    cv::Mat out;
+    cv::Mat expected;
+
+    convert_color(ColorConversion::BGR2RGB, bgr, out);
+    cv::cvtColor(bgr, expected, cv::COLOR_BGR2RGB);
+    ASSERT_EQ(cv::norm(out, expected, cv::NORM_INF), 0);
+
+    convert_color(ColorConversion::BGR2GRAY, bgr, out);
+    cv::cvtColor(bgr, expected, cv::COLOR_BGR2GRAY);
+    ASSERT_EQ(out.channels(), 1);
+    ASSERT_LE(cv::norm(out, expected, cv::NORM_INF), 1);
+
+    convert_color(ColorConversion::RGB2GRAY, bgr, out);
+    cv::cvtColor(bgr, expected, cv::COLOR_RGB2GRAY);
+    ASSERT_LE(cv::norm(out, expected, cv::NORM_INF), 1);
+
+    cv::Mat yuv(60, 70, CV_8UC1);
+    cv::randu(yuv, 0, 255);
+
+    convert_color(ColorConversion::NV12_2BGR, yuv, out);
+    cv::cvtColor(yuv, expected, cv::COLOR_YUV2BGR_NV12);
+    ASSERT_EQ(out.rows, 40);
+    ASSERT_LE(cv::norm(out, expected, cv::NORM_INF), 1);
+
+    convert_color(ColorConversion::I420_2BGR, yuv, out);
+    cv::cvtColor(yuv, expected, cv::COLOR_YUV2BGR_I420);
+    ASSERT_LE(cv::norm(out, expected, cv::NORM_INF), 1);
+
+    // Conversions which do not match the input
+    ASSERT_THROW(convert_color(ColorConversion::BGR2RGB, yuv, out),
+                 const char*);
+    ASSERT_THROW(convert_color(ColorConversion::NV12_2BGR, bgr, out),
+                 const char*);
+    ASSERT_THROW(convert_color(ColorConversion::BGR2RGB, out, out),
+                 const char*);
+}
+
+// Verify the layout conversions round trip for different element sizes
+TEST_F(color_convert_tests, layout_conversions) {
+    int types[] = { CV_8UC3, CV_16UC3, CV_32FC3, CV_8UC4 };
+    for (int type : types) {
+        cv::Mat hwc(30, 50, type);
+        cv::randu(hwc, 0, 255);
+
+        cv::Mat chw;
+        convert_color(ColorConversion::HWC2CHW, hwc, chw);
+        ASSERT_EQ(chw.dims, 3);
+        ASSERT_EQ(chw.size[0], hwc.channels());
+        ASSERT_EQ(chw.size[1], 30);
+        ASSERT_EQ(chw.size[2], 50);
+
+        // The first plane holds the first channel
+        cv::Mat plane(30, 50, CV_MAKETYPE(hwc.depth(), 1), chw.data);
+        cv::Mat channel;
+        cv::extractChannel(hwc, channel, 0);
+        ASSERT_EQ(cv::norm(plane, channel, cv::NORM_INF), 0);
+
+        cv::Mat back;
+        convert_color(ColorConversion::CHW2HWC, chw, back);
+        ASSERT_EQ(back.type(), type);
+        ASSERT_EQ(cv::norm(back, hwc, cv::NORM_INF), 0);
+    }
+}
+
+// Verify converting the frames of a Frame object in place
+TEST_F(color_convert_tests, frame_convert_color) {
+    cv::Mat bgr(40, 64, CV_8UC3);
+    cv::randu(bgr, 0, 255);
+    cv::Mat nv12(60, 64, CV_8UC1);
+    cv::randu(nv12, 0, 255);
+
+    Frame* frame = new Frame(
+            (void*) &bgr, free_nothing, (void*) bgr.data, 64, 40, 3);
+    frame->add_frame(
+            (void*) &nv12, free_nothing, (void*) nv12.data, 64, 40, 1,
+            EncodeType::NONE, 0, 0, PixelFormat::NV12);
+
+    frame->convert_color(ColorConversion::BGR2GRAY);
+    ASSERT_EQ(frame->get_channels(), 1);
+    ASSERT_EQ(frame->get_pixel_format(), PixelFormat::U8);
+
+    frame->convert_color(ColorConversion::NV12_2BGR, 1);
+    ASSERT_EQ(frame->get_channels(1), 3);
+    ASSERT_EQ(frame->get_height(1), 40);
+    ASSERT_EQ(frame->get_pixel_format(1), PixelFormat::U8);
+
+    cv::Mat expected;
+    cv::cvtColor(nv12, expected, cv::COLOR_YUV2BGR_NV12);
+    cv::Mat converted(
+            40, 64, CV_8UC3, frame->get_data(1), frame->get_stride(1));
+    ASSERT_LE(cv::norm(converted, expected, cv::NORM_INF), 1);
+
+    // The conversion must match the pixel format
+    ASSERT_THROW(frame->convert_color(ColorConversion::NV12_2BGR),
+                 const char*);
+    ASSERT_THROW(frame->convert_color(ColorConversion::HWC2CHW),
+                 const char*);
+
+    delete frame;
+}
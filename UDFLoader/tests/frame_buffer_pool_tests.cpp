@@ -0,0 +1,181 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Unit tests for the @c FrameBufferPool object
+ */
+
+#include <cstring>
+#include <sched.h>
+#include <opencv2/opencv.hpp>
+#include <gtest/gtest.h>
+#include <eii/utils/logger.h>
+#include "eii/udf/frame_buffer_pool.h"
+#include "eii/udf/cpu_topology.h"
+#include "eii/udf/frame.h"
+
+using namespace eii::udf;
+
+#define ASSERT_NOT_NULL(val) { \
+    if(val == NULL) FAIL() << "Value shoud not be NULL"; \
+}
+
+// Test class definition for doing setup
+class frame_buffer_pool_tests : public ::testing::Test {
+protected:
+    void SetUp() override {
+        set_log_level(LOG_LVL_DEBUG);
+    }
+};
+
+// Verify buffers are aligned and rounded up to their size class
+TEST_F(frame_buffer_pool_tests, alignment_and_size_classes) {
+    FrameBufferPool pool;
+
+    size_t sizes[] = { 1, 4096, 4097, 8192, 8193, 1920 * 1080 * 3 };
+    for (size_t size : sizes) {
+        void* buf = pool.acquire(size);
+        ASSERT_NOT_NULL(buf);
+        ASSERT_EQ(((uintptr_t) buf) % FRAME_BUFFER_ALIGNMENT, 0UL);
+        ASSERT_GE(pool.get_capacity(buf), size);
+        // Worst case slack is 25% above the minimum size class
+        if (size > 4096) {
+            ASSERT_LE(pool.get_capacity(buf), size + size / 4);
+        }
+        memset(buf, 0xff, size);
+        pool.release(buf);
+    }
+}
+
+// Verify released buffers are handed out again and counted as hits
+TEST_F(frame_buffer_pool_tests, recycle) {
+    FrameBufferPool pool;
+
+    void* first = pool.acquire(640 * 480 * 3);
+    ASSERT_NOT_NULL(first);
+    pool.release(first);
+
+    FrameBufferPoolStats stats = pool.get_stats();
+    ASSERT_EQ(stats.in_use_bytes, 0UL);
+    ASSERT_EQ(stats.resident_bytes, pool.get_capacity(first));
+
+    void* second = pool.acquire(640 * 480 * 3 - 10);
+    ASSERT_EQ(first, second);
+    pool.release(second);
+
+    stats = pool.get_stats();
+    ASSERT_EQ(stats.hits, 1UL);
+    ASSERT_EQ(stats.misses, 1UL);
+    ASSERT_DOUBLE_EQ(stats.hit_rate, 0.5);
+}
+
+// Verify the pool never caches more than its configured maximum
+TEST_F(frame_buffer_pool_tests, max_cached_bytes) {
+    FrameBufferPool pool(8192, false);
+
+    void* a = pool.acquire(8192);
+    void* b = pool.acquire(8192);
+    pool.release(a);
+    pool.release(b);
+
+    FrameBufferPoolStats stats = pool.get_stats();
+    ASSERT_EQ(stats.resident_bytes, 8192UL);
+    ASSERT_EQ(stats.evictions, 1UL);
+
+    pool.trim();
+    ASSERT_EQ(pool.get_stats().resident_bytes, 0UL);
+}
+
+// Verify huge page backed buffers are usable
+TEST_F(frame_buffer_pool_tests, hugepages) {
+    FrameBufferPool pool(FRAME_BUFFER_DEFAULT_MAX_CACHED, true);
+
+    size_t size = 3840 * 2160 * 3;
+    void* buf = pool.acquire(size);
+    ASSERT_NOT_NULL(buf);
+    ASSERT_EQ(((uintptr_t) buf) % FRAME_BUFFER_ALIGNMENT, 0UL);
+    memset(buf, 0x1, size);
+    pool.release(buf);
+}
+
+// Verify NUMA-local buffers are usable and recycled, and that they are not
+// cached once NUMA-local allocation is turned off
+TEST_F(frame_buffer_pool_tests, numa_local) {
+    FrameBufferPool pool;
+    pool.set_numa_local(true);
+
+    // Stay on one CPU, so that the buffer is reused from the same node
+    cpu_set_t set;
+    cpu_set_t old_set;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(old_set), &old_set), 0);
+    CPU_ZERO(&set);
+    CPU_SET(sched_getcpu(), &set);
+    ASSERT_EQ(sched_setaffinity(0, sizeof(set), &set), 0);
+
+    size_t size = 640 * 480 * 3;
+    void* first = pool.acquire(size);
+    ASSERT_NOT_NULL(first);
+    ASSERT_EQ(((uintptr_t) first) % FRAME_BUFFER_ALIGNMENT, 0UL);
+    memset(first, 0x1, size);
+    pool.release(first);
+
+    void* second = pool.acquire(size);
+    ASSERT_EQ(first, second);
+
+    pool.set_numa_local(false);
+    pool.release(second);
+    if (get_current_numa_node() >= 0) {
+        ASSERT_EQ(pool.get_stats().resident_bytes, 0UL);
+    }
+
+    ASSERT_EQ(sched_setaffinity(0, sizeof(old_set), &old_set), 0);
+}
+
+// Verify cv::Mat memory is drawn from and released to the pool
+TEST_F(frame_buffer_pool_tests, mat_allocator) {
+    FrameBufferPool pool;
+
+    cv::Mat* mat = new cv::Mat();
+    mat->allocator = pool.get_mat_allocator();
+    mat->create(480, 640, CV_8UC3);
+    ASSERT_EQ(((uintptr_t) mat->data) % FRAME_BUFFER_ALIGNMENT, 0UL);
+    ASSERT_GT(pool.get_stats().in_use_bytes, 0UL);
+
+    delete mat;
+    ASSERT_EQ(pool.get_stats().in_use_bytes, 0UL);
+}
+
+// Verify a pooled buffer can back a Frame and is released on serialization
+TEST_F(frame_buffer_pool_tests, frame_free_buffer) {
+    FrameBufferPool* pool = FrameBufferPool::get_instance();
+    size_t in_use = pool->get_stats().in_use_bytes;
+
+    void* buf = pool->acquire(14);
+    ASSERT_NOT_NULL(buf);
+    memcpy(buf, "Hello, World!", 14);
+
+    Frame* frame = new Frame(
+            buf, FrameBufferPool::free_buffer, buf, 14, 1, 1);
+    msg_envelope_t* msg = frame->serialize();
+    ASSERT_NOT_NULL(msg);
+    msgbus_msg_envelope_destroy(msg);
+
+    ASSERT_EQ(pool->get_stats().in_use_bytes, in_use);
+}
@@ -0,0 +1,217 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Unit tests for recording and replaying frames
+ */
+
+#include <opencv2/opencv.hpp>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <eii/utils/logger.h>
+#include "eii/udf/frame_recording.h"
+
+#define RECORDING_PATH "./frame-recording-tests.rec"
+
+// Maximum size of the frame queue, the ring queue cannot be unbounded
+#define QUEUE_SIZE 16
+
+using namespace eii::udf;
+
+// Free method for frames which are owned by the test
+void free_nothing(void*) {}
+
+// Test class definition for doing setup
+class frame_recording_tests : public ::testing::Test {
+protected:
+    cv::Mat m_bgr;
+    cv::Mat m_gray;
+
+    void SetUp() override {
+        set_log_level(LOG_LVL_DEBUG);
+        m_bgr.create(48, 64, CV_8UC3);
+        cv::randu(m_bgr, 0, 255);
+        m_gray.create(48, 64, CV_8UC1);
+        cv::randu(m_gray, 0, 255);
+    }
+
+    void TearDown() override {
+        unlink(RECORDING_PATH);
+    }
+
+    /**
+     * Record a raw single frame, a raw multi-frame and a PNG encoded frame.
+     */
+    void record_frames(FrameRecorder* recorder) {
+        recorder->record(new Frame(
+                (void*) &m_bgr, free_nothing, (void*) m_bgr.data,
+                64, 48, 3));
+
+        Frame* frame = new Frame(
+                (void*) &m_bgr, free_nothing, (void*) m_bgr.data, 64, 48, 3);
+        frame->add_frame(
+                (void*) &m_gray, free_nothing, (void*) m_gray.data,
+                64, 48, 1);
+        recorder->record(frame);
+
+        recorder->record(new Frame(
+                (void*) &m_gray, free_nothing, (void*) m_gray.data,
+                64, 48, 1, EncodeType::PNG, 4));
+    }
+
+    /**
+     * Verify the frames written by record_frames().
+     */
+    void verify_frames(FrameRecording* recording) {
+        ASSERT_EQ(recording->get_num_frames(), (size_t) 3);
+        ASSERT_LE(recording->get_timestamp(0), recording->get_timestamp(1));
+        ASSERT_LE(recording->get_timestamp(1), recording->get_timestamp(2));
+
+        Frame* frame = recording->get_frame(0);
+        ASSERT_EQ(frame->get_number_of_frames(), 1);
+        cv::Mat mat(48, 64, CV_8UC3,
+                    const_cast<void*>(frame->get_readonly_data()));
+        ASSERT_EQ(cv::norm(mat, m_bgr, cv::NORM_INF), 0);
+        delete frame;
+
+        frame = recording->get_frame(1);
+        ASSERT_EQ(frame->get_number_of_frames(), 2);
+        ASSERT_EQ(frame->get_channels(1), 1);
+        mat = cv::Mat(48, 64, CV_8UC1,
+                      const_cast<void*>(frame->get_readonly_data(1)));
+        ASSERT_EQ(cv::norm(mat, m_gray, cv::NORM_INF), 0);
+        delete frame;
+
+        frame = recording->get_frame(2);
+        ASSERT_EQ(frame->get_encode_type(), EncodeType::PNG);
+        mat = cv::Mat(48, 64, CV_8UC1,
+                      const_cast<void*>(frame->get_readonly_data()));
+        ASSERT_EQ(cv::norm(mat, m_gray, cv::NORM_INF), 0);
+        delete frame;
+
+        ASSERT_THROW(recording->get_frame(3), const char*);
+    }
+};
+
+// Test recording frames and reading them back
+TEST_F(frame_recording_tests, record_read) {
+    FrameRecorder* recorder = new FrameRecorder(RECORDING_PATH);
+    record_frames(recorder);
+    ASSERT_EQ(recorder->get_num_frames(), (size_t) 3);
+    recorder->close();
+    ASSERT_THROW(recorder->record(new Frame(
+                    (void*) &m_gray, free_nothing, (void*) m_gray.data,
+                    64, 48, 1)), const char*);
+    delete recorder;
+
+    FrameRecording* recording = new FrameRecording(RECORDING_PATH);
+    verify_frames(recording);
+
+    // Modifying a replayed frame does not modify the recording, and the
+    // frame stays valid after the recording is freed
+    Frame* frame = recording->get_frame(0);
+    memset(frame->get_data(), 0, 64 * 48 * 3);
+    delete recording;
+    cv::Mat mat(48, 64, CV_8UC3, frame->get_data());
+    ASSERT_EQ(cv::countNonZero(mat.reshape(1)), 0);
+    delete frame;
+
+    recording = new FrameRecording(RECORDING_PATH);
+    verify_frames(recording);
+    delete recording;
+}
+
+// Test reading a recording which was never closed (i.e. has no index)
+TEST_F(frame_recording_tests, recover_unindexed) {
+    FrameRecorder* recorder = new FrameRecorder(RECORDING_PATH);
+    record_frames(recorder);
+    delete recorder;
+
+    // Strip the index (3 offsets) and its 24 byte footer
+    struct stat st;
+    ASSERT_EQ(stat(RECORDING_PATH, &st), 0);
+    ASSERT_EQ(truncate(RECORDING_PATH, st.st_size - 3 * 8 - 24), 0);
+
+    FrameRecording* recording = new FrameRecording(RECORDING_PATH);
+    verify_frames(recording);
+    delete recording;
+
+    // A partially written record is ignored
+    ASSERT_EQ(truncate(RECORDING_PATH, st.st_size - 3 * 8 - 24 - 64), 0);
+    recording = new FrameRecording(RECORDING_PATH);
+    ASSERT_EQ(recording->get_num_frames(), (size_t) 2);
+    delete recording;
+}
+
+// Test replaying a recording into a frame queue
+TEST_F(frame_recording_tests, replay) {
+    FrameRecorder* recorder = new FrameRecorder(RECORDING_PATH);
+    record_frames(recorder);
+    delete recorder;
+
+    std::shared_ptr<FrameRecording> recording(
+            new FrameRecording(RECORDING_PATH));
+    FrameQueue* queue = new FrameQueue(QUEUE_SIZE);
+
+    FrameReplayer* replayer = new FrameReplayer(
+            recording, queue, ReplayTiming::AS_FAST_AS_POSSIBLE, 0, 2);
+    replayer->start();
+    replayer->wait();
+    ASSERT_EQ(replayer->get_frames_replayed(), (uint64_t) 6);
+    delete replayer;
+
+    int num_frames = 0;
+    while (!queue->empty()) {
+        Frame* frame = queue->pop();
+        ASSERT_EQ(frame->get_width(), 64);
+        delete frame;
+        num_frames++;
+    }
+    ASSERT_EQ(num_frames, 6);
+
+    // 6 frames at 100 fps take at least 50ms
+    auto start = std::chrono::steady_clock::now();
+    replayer = new FrameReplayer(
+            recording, queue, ReplayTiming::FIXED_RATE, 100, 2);
+    replayer->start();
+    replayer->wait();
+    ASSERT_GE(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(50));
+    ASSERT_EQ(replayer->get_frames_replayed(), (uint64_t) 6);
+    delete replayer;
+
+    // Stopping an endless replay
+    replayer = new FrameReplayer(
+            recording, queue, ReplayTiming::RECORDED, 30, 0);
+    replayer->start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    replayer->stop();
+    delete replayer;
+
+    ASSERT_THROW(new FrameReplayer(
+                recording, queue, ReplayTiming::FIXED_RATE, 0, 1),
+                 const char*);
+
+    while (!queue->empty()) {
+        delete queue->pop();
+    }
+    delete queue;
+}
@@ -26,6 +26,7 @@
 #include <gtest/gtest.h>
 #include <eii/utils/logger.h>
 #include "eii/udf/frame.h"
+#include "eii/udf/frame_buffer_pool.h"
 
 using namespace eii::udf;
 
@@ -877,3 +878,791 @@ TEST_F(frame_tests, multi_frame_set_data_0_png) {
 TEST_F(frame_tests, multi_frame_set_data_0) {
     base_set_data_test(0, EncodeType::NONE, 0);
 }
+
+/**
+ * Verify that a multi-frame @c Frame, whose frames are encoded in parallel
+ * during serialization, deserializes back into the same frames.
+ */
+TEST_F(frame_tests, multi_frame_parallel_encode) {
+    const int num_frames = 4;
+    Frame* frame = new Frame();
+
+    for (int i = 0; i < num_frames; i++) {
+        cv::Mat* cv_frame = new cv::Mat();
+        *cv_frame = cv::imread("./test_image.png");
+        frame->add_frame(
+            (void*) cv_frame, free_cv_frame, (void*) cv_frame->data,
+            cv_frame->cols, cv_frame->rows, cv_frame->channels(),
+            (i % 2 == 0) ? EncodeType::JPEG : EncodeType::PNG,
+            (i % 2 == 0) ? 50 : 4);
+    }
+
+    int width = frame->get_width();
+    int height = frame->get_height();
+
+    msg_envelope_t* encoded = frame->serialize();
+    ASSERT_NOT_NULL(encoded);
+
+    Frame* decoded = new Frame(encoded);
+    ASSERT_EQ(decoded->get_number_of_frames(), num_frames);
+    for (int i = 0; i < num_frames; i++) {
+        ASSERT_EQ(decoded->get_width(i), width);
+        ASSERT_EQ(decoded->get_height(i), height);
+        ASSERT_EQ(decoded->get_encode_type(i),
+                  (i % 2 == 0) ? EncodeType::JPEG : EncodeType::PNG);
+    }
+
+    delete decoded;
+}
+
+/**
+ * Test to verify that a single channel frame is decoded as a single channel
+ * frame directly into a pooled buffer, and that the lossless round trip
+ * preserves the pixels.
+ */
+TEST_F(frame_tests, encode_decode_png_grayscale) {
+    cv::Mat color = cv::imread("./test_image.png");
+    cv::Mat* gray = new cv::Mat();
+    cv::cvtColor(color, *gray, cv::COLOR_BGR2GRAY);
+
+    Frame* frame = new Frame(
+            (void*) gray, free_cv_frame, (void*) gray->data,
+            gray->cols, gray->rows, 1, EncodeType::PNG, 4);
+
+    msg_envelope_t* encoded = frame->serialize();
+    ASSERT_NOT_NULL(encoded);
+
+    Frame* decoded = new Frame(encoded);
+    ASSERT_EQ(decoded->get_width(), color.cols);
+    ASSERT_EQ(decoded->get_height(), color.rows);
+    ASSERT_EQ(decoded->get_channels(), 1);
+
+    // Decoded pixels come from the frame buffer pool
+    void* data = decoded->get_data(0);
+    ASSERT_EQ(((uintptr_t) data) % FRAME_BUFFER_ALIGNMENT, 0);
+
+    cv::Mat expected;
+    cv::cvtColor(color, expected, cv::COLOR_BGR2GRAY);
+    ASSERT_EQ(memcmp(data, expected.data, expected.total()), 0);
+
+    delete decoded;
+}
+
+/**
+ * Test to verify that a received encoded frame is only decoded when its data
+ * is accessed, and that an untouched frame is forwarded with its original
+ * encoded bytes.
+ */
+TEST_F(frame_tests, lazy_decode) {
+    cv::Mat* cv_frame = new cv::Mat();
+    *cv_frame = cv::imread("./test_image.png");
+    Frame* frame = new Frame(
+            (void*) cv_frame, free_cv_frame, (void*) cv_frame->data,
+            cv_frame->cols, cv_frame->rows, cv_frame->channels(),
+            EncodeType::JPEG, 50);
+    int width = frame->get_width();
+    int height = frame->get_height();
+
+    msg_envelope_t* encoded = frame->serialize();
+    ASSERT_NOT_NULL(encoded);
+
+    // Keep a copy of the encoded bytes to compare with after forwarding
+    msg_envelope_elem_body_t* blob;
+    msgbus_ret_t ret = msgbus_msg_envelope_get(encoded, NULL, &blob);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    std::vector<char> expected(
+            blob->body.blob->data,
+            blob->body.blob->data + blob->body.blob->len);
+
+    // Meta-data is available without decoding
+    Frame* received = new Frame(encoded);
+    ASSERT_FALSE(received->is_decoded());
+    ASSERT_EQ(received->get_width(), width);
+    ASSERT_EQ(received->get_height(), height);
+    ASSERT_EQ(received->get_channels(), 3);
+    ASSERT_EQ(received->get_encode_type(), EncodeType::JPEG);
+    ASSERT_FALSE(received->is_decoded());
+
+    // Forwarding with the same encoding never decodes the frame
+    msg_envelope_t* forwarded = received->serialize();
+    ASSERT_NOT_NULL(forwarded);
+    ret = msgbus_msg_envelope_get(forwarded, NULL, &blob);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(blob->body.blob->len, expected.size());
+    ASSERT_EQ(memcmp(blob->body.blob->data, expected.data(),
+                     expected.size()), 0);
+
+    // Accessing the data decodes the frame
+    Frame* decoded = new Frame(forwarded);
+    ASSERT_FALSE(decoded->is_decoded());
+    ASSERT_NOT_NULL(decoded->get_data(0));
+    ASSERT_TRUE(decoded->is_decoded());
+
+    delete decoded;
+}
+
+/**
+ * Test to verify that a frame which fails to decode is still received, and
+ * only fails once its pixels are accessed.
+ */
+TEST_F(frame_tests, lazy_decode_corrupt) {
+    cv::Mat* cv_frame = new cv::Mat();
+    *cv_frame = cv::imread("./test_image.png");
+    Frame* frame = new Frame(
+            (void*) cv_frame, free_cv_frame, (void*) cv_frame->data,
+            cv_frame->cols, cv_frame->rows, cv_frame->channels(),
+            EncodeType::JPEG, 50);
+
+    msg_envelope_t* encoded = frame->serialize();
+    ASSERT_NOT_NULL(encoded);
+
+    // Overwrite the JPEG header, so that the bytes can no longer be decoded
+    msg_envelope_elem_body_t* blob;
+    msgbus_ret_t ret = msgbus_msg_envelope_get(encoded, NULL, &blob);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    memset((void*) blob->body.blob->data, 0, 16);
+
+    Frame* received = new Frame(encoded);
+    ASSERT_FALSE(received->is_decoded());
+    ASSERT_THROW(received->get_readonly_data(0), const char*);
+    ASSERT_THROW(received->get_data(0), const char*);
+    ASSERT_FALSE(received->is_decoded());
+
+    delete received;
+}
+
+/**
+ * Test to verify that a frame whose pixels were only read is re-published
+ * with its original encoded bytes, and that writable access marks the frame
+ * as modified.
+ */
+TEST_F(frame_tests, encoded_passthrough) {
+    cv::Mat* cv_frame = new cv::Mat();
+    *cv_frame = cv::imread("./test_image.png");
+    Frame* frame = new Frame(
+            (void*) cv_frame, free_cv_frame, (void*) cv_frame->data,
+            cv_frame->cols, cv_frame->rows, cv_frame->channels(),
+            EncodeType::JPEG, 50);
+    int width = frame->get_width();
+    int height = frame->get_height();
+
+    msg_envelope_t* encoded = frame->serialize();
+    ASSERT_NOT_NULL(encoded);
+
+    msg_envelope_elem_body_t* blob;
+    msgbus_ret_t ret = msgbus_msg_envelope_get(encoded, NULL, &blob);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    std::vector<char> expected(
+            blob->body.blob->data,
+            blob->body.blob->data + blob->body.blob->len);
+
+    // Reading the pixels decodes the frame, but does not modify it
+    Frame* received = new Frame(encoded);
+    ASSERT_NOT_NULL(received->get_readonly_data(0));
+    ASSERT_TRUE(received->is_decoded());
+    ASSERT_FALSE(received->is_modified());
+
+    msg_envelope_t* forwarded = received->serialize();
+    ASSERT_NOT_NULL(forwarded);
+    ret = msgbus_msg_envelope_get(forwarded, NULL, &blob);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(blob->body.blob->len, expected.size());
+    ASSERT_EQ(memcmp(blob->body.blob->data, expected.data(),
+                     expected.size()), 0);
+
+    // Writable access marks the frame as modified, so it is re-encoded
+    Frame* modified = new Frame(forwarded);
+    ASSERT_FALSE(modified->is_modified());
+    ASSERT_NOT_NULL(modified->get_data(0));
+    ASSERT_TRUE(modified->is_modified());
+
+    msg_envelope_t* reencoded = modified->serialize();
+    ASSERT_NOT_NULL(reencoded);
+    Frame* decoded = new Frame(reencoded);
+    ASSERT_EQ(decoded->get_width(), width);
+    ASSERT_EQ(decoded->get_height(), height);
+    ASSERT_NOT_NULL(decoded->get_readonly_data(0));
+
+    delete decoded;
+}
+
+/**
+ * Test to verify that a crop of a larger frame is referenced with its parent's
+ * stride, and only compacted when the frame is serialized.
+ */
+TEST_F(frame_tests, strided_frame_serialize) {
+    cv::Mat* parent = new cv::Mat();
+    *parent = cv::imread("./test_image.png");
+    cv::Mat crop(*parent, cv::Rect(10, 20, 100, 50));
+    size_t stride = parent->step[0];
+    size_t row_size = crop.cols * crop.channels();
+    ASSERT_GT(stride, row_size);
+
+    // Keep a packed copy of the crop for comparison
+    cv::Mat expected = crop.clone();
+
+    Frame* frame = new Frame(
+            (void*) parent, free_cv_frame, (void*) crop.data,
+            crop.cols, crop.rows, crop.channels(), EncodeType::NONE, 0,
+            stride);
+    ASSERT_EQ(frame->get_stride(), stride);
+    ASSERT_EQ(frame->get_data(0), (void*) crop.data);
+
+    msg_envelope_t* encoded = frame->serialize();
+    ASSERT_NOT_NULL(encoded);
+
+    msg_envelope_elem_body_t* blob;
+    msgbus_ret_t ret = msgbus_msg_envelope_get(encoded, NULL, &blob);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(blob->body.blob->len, row_size * crop.rows);
+    ASSERT_EQ(memcmp(blob->body.blob->data, expected.data,
+                     row_size * crop.rows), 0);
+
+    // The received frame is tightly packed
+    Frame* received = new Frame(encoded);
+    ASSERT_EQ(received->get_width(), 100);
+    ASSERT_EQ(received->get_height(), 50);
+    ASSERT_EQ(received->get_stride(), row_size);
+
+    delete received;
+}
+
+/**
+ * Test to verify that a stride smaller than a row of pixels is rejected.
+ */
+TEST_F(frame_tests, invalid_stride) {
+    char data[64];
+    ASSERT_THROW(
+        new Frame((void*) data, free_frame, (void*) data, 8, 2, 3,
+                  EncodeType::NONE, 0, 8),
+        const char*);
+}
+
+/**
+ * Test to verify that 16-bit frames keep their pixel format through a raw and
+ * a PNG round trip.
+ */
+TEST_F(frame_tests, pixel_format_u16) {
+    const int width = 64;
+    const int height = 32;
+
+    for (EncodeType enc : { EncodeType::NONE, EncodeType::PNG }) {
+        cv::Mat* depth = new cv::Mat(height, width, CV_16UC1);
+        for (int y = 0; y < height; y++) {
+            uint16_t* row = depth->ptr<uint16_t>(y);
+            for (int x = 0; x < width; x++) {
+                row[x] = (uint16_t) (y * 1000 + x);
+            }
+        }
+        cv::Mat expected = depth->clone();
+
+        Frame* frame = new Frame(
+                (void*) depth, free_cv_frame, (void*) depth->data,
+                width, height, 1, enc, (enc == EncodeType::PNG) ? 4 : 0,
+                0, PixelFormat::U16);
+        ASSERT_EQ(frame->get_cv_type(), CV_16UC1);
+        ASSERT_EQ(frame->get_stride(), width * sizeof(uint16_t));
+
+        msg_envelope_t* encoded = frame->serialize();
+        ASSERT_NOT_NULL(encoded);
+
+        msg_envelope_elem_body_t* pix_fmt;
+        msgbus_ret_t ret = msgbus_msg_envelope_get(
+                encoded, "pixel_format", &pix_fmt);
+        ASSERT_EQ(ret, MSG_SUCCESS);
+        ASSERT_EQ(strcmp(pix_fmt->body.string, "u16"), 0);
+
+        Frame* decoded = new Frame(encoded);
+        ASSERT_EQ(decoded->get_pixel_format(), PixelFormat::U16);
+        ASSERT_EQ(decoded->get_cv_type(), CV_16UC1);
+        ASSERT_EQ(memcmp(decoded->get_readonly_data(0), expected.data,
+                         width * height * sizeof(uint16_t)), 0);
+
+        delete decoded;
+    }
+}
+
+/**
+ * Test to verify the buffer layout of planar YUV frames and that they cannot
+ * be JPEG encoded.
+ */
+TEST_F(frame_tests, pixel_format_nv12) {
+    const int width = 64;
+    const int height = 32;
+    uint8_t* buffer = new uint8_t[width * height * 3 / 2];
+
+    Frame* frame = new Frame(
+            (void*) buffer, free_frame, (void*) buffer, width, height, 1,
+            EncodeType::NONE, 0, 0, PixelFormat::NV12);
+    ASSERT_EQ(frame->get_rows(), height * 3 / 2);
+    ASSERT_EQ(frame->get_cv_type(), CV_8UC1);
+    ASSERT_THROW(frame->set_encoding(EncodeType::JPEG, 50), const char*);
+
+    msg_envelope_t* encoded = frame->serialize();
+    ASSERT_NOT_NULL(encoded);
+
+    msg_envelope_elem_body_t* blob;
+    msgbus_ret_t ret = msgbus_msg_envelope_get(encoded, NULL, &blob);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(blob->body.blob->len, (size_t) width * height * 3 / 2);
+
+    Frame* decoded = new Frame(encoded);
+    ASSERT_EQ(decoded->get_pixel_format(), PixelFormat::NV12);
+    ASSERT_EQ(decoded->get_height(), height);
+    ASSERT_EQ(decoded->get_rows(), height * 3 / 2);
+
+    // Planar YUV frames are single channel
+    ASSERT_THROW(
+        new Frame((void*) buffer, free_frame, (void*) buffer, width, height,
+                  3, EncodeType::NONE, 0, 0, PixelFormat::NV12),
+        const char*);
+
+    delete decoded;
+    delete[] buffer;
+}
+
+// Test that the core meta-data is written into the envelope when it is
+// handed out or the frame is serialized, including changes made with
+// set_data()
+TEST_F(frame_tests, meta_written_lazily) {
+    Frame* frame = init_multi_frame();
+
+    // Core meta-data is written when the envelope is handed out
+    msg_envelope_elem_body_t* w;
+    msgbus_ret_t ret = msgbus_msg_envelope_get(
+            frame->get_meta_data(), "width", &w);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(w->body.integer, 14);
+
+    char* data = new char[7];
+    memcpy(data, "Hello!", 7);
+    TestFrame* tf = new TestFrame(data);
+    frame->set_data(1, (void*) tf, test_frame_free, (void*) data, 7, 1, 1);
+    ASSERT_EQ(frame->get_width(1), 7);
+
+    msg_envelope_t* msg = frame->serialize();
+    ASSERT_NOT_NULL(msg);
+
+    ret = msgbus_msg_envelope_get(msg, "width", &w);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(w->body.integer, 14);
+
+    Frame* deserialized = new Frame(msg);
+    ASSERT_EQ(deserialized->get_number_of_frames(), 2);
+    ASSERT_EQ(deserialized->get_width(0), 14);
+    ASSERT_EQ(deserialized->get_width(1), 7);
+    ASSERT_EQ(strcmp((char*) deserialized->get_data(1), "Hello!"), 0);
+
+    // Deleting the deserialized frame also frees the original frame
+    delete deserialized;
+}
+
+// Test that frames created with share() read the same pixels, and that
+// writing to the pixels or meta-data of one frame does not affect the other
+TEST_F(frame_tests, shared_copy_on_write) {
+    Frame* frame = init_frame();
+    Frame* shared = frame->share();
+    ASSERT_NOT_NULL(shared);
+
+    // Both frames read the same pixels
+    ASSERT_TRUE(frame->is_shared());
+    ASSERT_TRUE(shared->is_shared());
+    ASSERT_EQ(frame->get_readonly_data(), shared->get_readonly_data());
+    ASSERT_EQ(shared->get_width(), 14);
+    ASSERT_EQ(shared->get_img_handle(), frame->get_img_handle());
+
+    // Writing copies the pixels
+    char* data = (char*) shared->get_data();
+    ASSERT_NE((const void*) data, frame->get_readonly_data());
+    ASSERT_EQ(strcmp(data, "Hello, World!"), 0);
+    memcpy(data, "Goodbye", 8);
+    ASSERT_FALSE(frame->is_shared());
+    ASSERT_FALSE(shared->is_shared());
+
+    // The meta-data is independent
+    msg_envelope_elem_body_t* add = msgbus_msg_envelope_new_string("test");
+    ASSERT_NOT_NULL(add);
+    msgbus_ret_t ret = msgbus_msg_envelope_put(
+            shared->get_meta_data(), "ADDED", add);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+
+    msg_envelope_t* msg = frame->serialize();
+    msg_envelope_t* shared_msg = shared->serialize();
+
+    msg_envelope_elem_body_t* a;
+    ret = msgbus_msg_envelope_get(msg, "ADDED", &a);
+    ASSERT_NE(ret, MSG_SUCCESS);
+    ret = msgbus_msg_envelope_get(shared_msg, "ADDED", &a);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+
+    msg_envelope_elem_body_t* blob;
+    ret = msgbus_msg_envelope_get(msg, NULL, &blob);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(strcmp(blob->body.blob->data, "Hello, World!"), 0);
+
+    ret = msgbus_msg_envelope_get(shared_msg, NULL, &blob);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(strcmp(blob->body.blob->data, "Goodbye"), 0);
+
+    msgbus_msg_envelope_destroy(msg);
+    msgbus_msg_envelope_destroy(shared_msg);
+}
+
+// Test that a shared frame keeps the pixels alive after the frame it was
+// shared from has been published and destroyed
+TEST_F(frame_tests, shared_outlives_source) {
+    Frame* frame = init_frame();
+    Frame* shared = frame->share();
+
+    msg_envelope_t* msg = frame->serialize();
+    msgbus_msg_envelope_destroy(msg);
+
+    ASSERT_FALSE(shared->is_shared());
+    ASSERT_EQ(strcmp((const char*) shared->get_readonly_data(),
+                     "Hello, World!"), 0);
+
+    delete shared;
+}
+
+/**
+ * Helper to verify that a frame compressed with a lossless encoding is
+ * decompressed to exactly the same pixels.
+ */
+void lossless_round_trip(
+        EncodeType encode_type, int encode_level, PixelFormat pixel_format,
+        int cv_type, int rows) {
+    const int width = 64;
+    const int height = 32;
+    cv::Mat mat_frame(rows, width, cv_type);
+    cv::randu(mat_frame, 0, 255);
+
+    Frame* frame = new Frame(
+            (void*) &mat_frame, free_frame, (void*) mat_frame.data,
+            width, height, mat_frame.channels(), encode_type, encode_level,
+            0, pixel_format);
+
+    msg_envelope_t* encoded = frame->serialize();
+    ASSERT_NOT_NULL(encoded);
+
+    msg_envelope_elem_body_t* enc_type;
+    msgbus_ret_t ret = msgbus_msg_envelope_get(
+            encoded, "encoding_type", &enc_type);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(strcmp(enc_type->body.string,
+                     (encode_type == EncodeType::LZ4) ? "lz4" : "zstd"), 0);
+
+    Frame* decoded = new Frame(encoded);
+    ASSERT_EQ(decoded->get_encode_type(), encode_type);
+    ASSERT_EQ(decoded->get_encode_level(), encode_level);
+    ASSERT_EQ(decoded->get_pixel_format(), pixel_format);
+
+    cv::Mat mat_decoded(
+            decoded->get_rows(), decoded->get_width(), decoded->get_cv_type(),
+            const_cast<void*>(decoded->get_readonly_data()),
+            decoded->get_stride());
+    ASSERT_EQ(cv::norm(mat_frame, mat_decoded, cv::NORM_INF), 0);
+
+    delete decoded;
+}
+
+// Test the lossless LZ4 and Zstandard encodings for different pixel formats
+TEST_F(frame_tests, encode_decode_lossless) {
+    lossless_round_trip(EncodeType::LZ4, 0, PixelFormat::U8, CV_8UC3, 32);
+    lossless_round_trip(EncodeType::LZ4, 9, PixelFormat::U16, CV_16UC1, 32);
+    lossless_round_trip(EncodeType::ZSTD, 1, PixelFormat::F32, CV_32FC1, 32);
+    lossless_round_trip(EncodeType::ZSTD, 3, PixelFormat::NV12, CV_8UC1, 48);
+
+    // Invalid encoding levels
+    cv::Mat mat_frame(32, 64, CV_8UC3);
+    ASSERT_THROW(
+        new Frame((void*) &mat_frame, free_frame, (void*) mat_frame.data,
+                  64, 32, 3, EncodeType::LZ4, 13),
+        const char*);
+    ASSERT_THROW(
+        new Frame((void*) &mat_frame, free_frame, (void*) mat_frame.data,
+                  64, 32, 3, EncodeType::ZSTD, 0),
+        const char*);
+}
+
+// Test sending frames through a shared memory ring
+TEST_F(frame_tests, shm_serialize_deserialize) {
+    std::shared_ptr<ShmRing> ring = ShmRing::create(
+            "/eii-frame-tests", 64, 4);
+
+    Frame* frame = init_multi_frame();
+    frame->set_shm_ring(ring);
+
+    msg_envelope_t* msg = frame->serialize();
+    ASSERT_NOT_NULL(msg);
+
+    // Only the descriptors are sent as a blob
+    msg_envelope_elem_body_t* elem = NULL;
+    msgbus_ret_t ret = msgbus_msg_envelope_get(msg, "shm_ring", &elem);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(strcmp(elem->body.string, "/eii-frame-tests"), 0);
+    ret = msgbus_msg_envelope_get(msg, NULL, &elem);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(elem->type, MSG_ENV_DT_BLOB);
+    ASSERT_EQ(elem->body.blob->len, 2 * sizeof(ShmFrameDescriptor));
+
+    Frame* deserialized = new Frame(msg);
+    ASSERT_EQ(deserialized->get_number_of_frames(), 2);
+    ASSERT_EQ(strcmp((const char*) deserialized->get_readonly_data(0),
+                     "Hello, World1"), 0);
+    ASSERT_EQ(strcmp((const char*) deserialized->get_readonly_data(1),
+                     "Hello, World2"), 0);
+
+    // Writing to the pixels must not modify the ring
+    const void* mapped = deserialized->get_readonly_data(0);
+    char* data = (char*) deserialized->get_data(0);
+    ASSERT_NE((const void*) data, mapped);
+    data[0] = 'J';
+    ASSERT_EQ(strcmp((const char*) mapped, "Hello, World1"), 0);
+
+    // Re-publishing without a ring sends the frames as blobs again
+    msg = deserialized->serialize();
+    ASSERT_NOT_NULL(msg);
+    ret = msgbus_msg_envelope_get(msg, "shm_ring", &elem);
+    ASSERT_EQ(ret, MSG_ERR_ELEM_NOT_EXIST);
+
+    Frame* reserialized = new Frame(msg);
+    ASSERT_EQ(strcmp((const char*) reserialized->get_readonly_data(0),
+                     "Jello, World1"), 0);
+    ASSERT_EQ(strcmp((const char*) reserialized->get_readonly_data(1),
+                     "Hello, World2"), 0);
+    delete reserialized;
+}
+
+// Test that frames are sent as blobs if they do not fit into the ring, and
+// that a reused slot is detected
+TEST_F(frame_tests, shm_ring_full) {
+    std::shared_ptr<ShmRing> ring = ShmRing::create(
+            "/eii-frame-tests", 8, 1);
+
+    // Frame is larger than a slot
+    Frame* frame = init_frame();
+    frame->set_shm_ring(ring);
+    msg_envelope_t* msg = frame->serialize();
+    msg_envelope_elem_body_t* elem = NULL;
+    msgbus_ret_t ret = msgbus_msg_envelope_get(msg, "shm_ring", &elem);
+    ASSERT_EQ(ret, MSG_ERR_ELEM_NOT_EXIST);
+    msgbus_msg_envelope_destroy(msg);
+
+    ring = ShmRing::create("/eii-frame-tests", 64, 1);
+
+    frame = init_frame();
+    frame->set_shm_ring(ring);
+    msg_envelope_t* first = frame->serialize();
+
+    // The slot is not pinned yet, so the second frame reuses it
+    frame = init_frame();
+    frame->set_shm_ring(ring);
+    msg_envelope_t* second = frame->serialize();
+    ASSERT_THROW(new Frame(first), const char*);
+    msgbus_msg_envelope_destroy(first);
+
+    // While the slot is pinned, the next frame is sent as a blob
+    Frame* deserialized = new Frame(second);
+    frame = init_frame();
+    frame->set_shm_ring(ring);
+    msg = frame->serialize();
+    ret = msgbus_msg_envelope_get(msg, "shm_ring", &elem);
+    ASSERT_EQ(ret, MSG_ERR_ELEM_NOT_EXIST);
+    msgbus_msg_envelope_destroy(msg);
+
+    // Releasing the pin makes the slot available again
+    delete deserialized;
+    frame = init_frame();
+    frame->set_shm_ring(ring);
+    msg = frame->serialize();
+    ret = msgbus_msg_envelope_get(msg, "shm_ring", &elem);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    msgbus_msg_envelope_destroy(msg);
+}
+
+// Test serializing a multi-frame object with the packed layout
+TEST_F(frame_tests, packed_layout) {
+    cv::Mat bgr(30, 50, CV_8UC3);
+    cv::randu(bgr, 0, 255);
+    cv::Mat gray(30, 50, CV_8UC1);
+    cv::randu(gray, 0, 255);
+
+    Frame* frame = init_multi_frame();
+    frame->add_frame(
+            (void*) &bgr, free_frame, (void*) bgr.data, 50, 30, 3);
+    frame->add_frame(
+            (void*) &gray, free_frame, (void*) gray.data, 50, 30, 1,
+            EncodeType::PNG, 4);
+    frame->set_packed_layout(true);
+
+    msg_envelope_t* msg = frame->serialize();
+    ASSERT_NOT_NULL(msg);
+
+    // All frames are in a single blob, at aligned offsets
+    msg_envelope_elem_body_t* elem = NULL;
+    msgbus_ret_t ret = msgbus_msg_envelope_get(msg, NULL, &elem);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(elem->type, MSG_ENV_DT_BLOB);
+    ret = msgbus_msg_envelope_get(msg, "packed_offsets", &elem);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(elem->body.array->len, (size_t) 4);
+    for (int i = 0; i < 4; i++) {
+        msg_envelope_elem_body_t* offset =
+            msgbus_msg_envelope_elem_array_get_at(elem, i);
+        ASSERT_EQ(offset->body.integer % 64, 0);
+    }
+
+    Frame* deserialized = new Frame(msg);
+    ASSERT_EQ(deserialized->get_number_of_frames(), 4);
+    ASSERT_EQ(strcmp((const char*) deserialized->get_readonly_data(0),
+                     "Hello, World1"), 0);
+    ASSERT_EQ(strcmp((const char*) deserialized->get_readonly_data(1),
+                     "Hello, World2"), 0);
+    cv::Mat mat(30, 50, CV_8UC3,
+                const_cast<void*>(deserialized->get_readonly_data(2)));
+    ASSERT_EQ(cv::norm(mat, bgr, cv::NORM_INF), 0);
+    ASSERT_EQ(deserialized->get_encode_type(3), EncodeType::PNG);
+    mat = cv::Mat(30, 50, CV_8UC1,
+                  const_cast<void*>(deserialized->get_readonly_data(3)));
+    ASSERT_EQ(cv::norm(mat, gray, cv::NORM_INF), 0);
+
+    // The frames in the packed blob are written in place, without copying
+    ASSERT_FALSE(deserialized->is_shared(2));
+    const void* pixels = deserialized->get_readonly_data(2);
+    ASSERT_EQ(deserialized->get_data(2), pixels);
+
+    // Re-serializing without the packed layout sends one blob per frame
+    msg = deserialized->serialize();
+    ret = msgbus_msg_envelope_get(msg, "packed_offsets", &elem);
+    ASSERT_EQ(ret, MSG_ERR_ELEM_NOT_EXIST);
+    ret = msgbus_msg_envelope_get(msg, NULL, &elem);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(elem->type, MSG_ENV_DT_ARRAY);
+
+    Frame* reserialized = new Frame(msg);
+    ASSERT_EQ(strcmp((const char*) reserialized->get_readonly_data(1),
+                     "Hello, World2"), 0);
+    mat = cv::Mat(30, 50, CV_8UC3,
+                  const_cast<void*>(reserialized->get_readonly_data(2)));
+    ASSERT_EQ(cv::norm(mat, bgr, cv::NORM_INF), 0);
+    delete reserialized;
+}
+
+// Test that the frame age is measured from the capture timestamp, which is
+// kept by shared frames
+TEST_F(frame_tests, capture_timestamp) {
+    Frame* frame = init_frame();
+    ASSERT_GT(frame->get_timestamp(), 0);
+    ASSERT_LT(frame->get_age_ms(), 1000);
+
+    // Captured 5 seconds ago
+    int64_t captured = frame->get_timestamp() - 5000000000LL;
+    frame->set_timestamp(captured);
+    ASSERT_GE(frame->get_age_ms(), 5000);
+
+    Frame* shared = frame->share();
+    ASSERT_EQ(shared->get_timestamp(), captured);
+
+    delete shared;
+    delete frame;
+}
+
+// Test encoding a frame ahead of its serialization
+TEST_F(frame_tests, encode_ahead) {
+    cv::Mat mat_frame(32, 64, CV_8UC3);
+    cv::randu(mat_frame, 0, 255);
+
+    Frame* frame = new Frame(
+            (void*) &mat_frame, free_frame, (void*) mat_frame.data,
+            mat_frame.cols, mat_frame.rows, mat_frame.channels(),
+            EncodeType::PNG, 4);
+    ASSERT_FALSE(frame->is_encoded());
+
+    frame->encode();
+    ASSERT_TRUE(frame->is_encoded());
+
+    // Encoding again has no effect
+    frame->encode();
+
+    // The pixels can no longer be accessed or changed, the meta-data can
+    ASSERT_NULL(frame->get_data(0));
+    ASSERT_NULL(frame->get_readonly_data(0));
+    ASSERT_THROW(frame->set_encoding(EncodeType::JPEG, 50), const char*);
+    ASSERT_NOT_NULL(frame->get_meta_data());
+
+    // Serializing only wraps the encoded bytes
+    msg_envelope_t* encoded = frame->serialize();
+    ASSERT_NOT_NULL(encoded);
+
+    Frame* decoded = new Frame(encoded);
+    ASSERT_EQ(decoded->get_encode_type(), EncodeType::PNG);
+    cv::Mat mat_decoded(
+            decoded->get_height(), decoded->get_width(), CV_8UC3,
+            const_cast<void*>(decoded->get_readonly_data()),
+            decoded->get_stride());
+    ASSERT_EQ(cv::norm(mat_frame, mat_decoded, cv::NORM_INF), 0);
+
+    delete decoded;
+}
+
+// Test merging the meta-data of a shared frame back into its source
+TEST_F(frame_tests, merge_meta_data) {
+    Frame* frame = init_frame();
+    msgbus_ret_t ret = msgbus_msg_envelope_put(
+            frame->get_meta_data(), "COMMON",
+            msgbus_msg_envelope_new_integer(1));
+    ASSERT_EQ(ret, MSG_SUCCESS);
+
+    Frame* shared = frame->share();
+    msg_envelope_elem_body_t* obj = msgbus_msg_envelope_new_object();
+    ASSERT_NOT_NULL(obj);
+    ret = msgbus_msg_envelope_elem_object_put(
+            obj, "label", msgbus_msg_envelope_new_string("a, \"b\" }"));
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ret = msgbus_msg_envelope_put(shared->get_meta_data(), "BRANCH", obj);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    msg_envelope_elem_body_t* arr = msgbus_msg_envelope_new_array();
+    ASSERT_NOT_NULL(arr);
+    ret = msgbus_msg_envelope_elem_array_add(
+            arr, msgbus_msg_envelope_new_floating(0.5));
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ret = msgbus_msg_envelope_put(shared->get_meta_data(), "SCORES", arr);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ret = msgbus_msg_envelope_put(
+            frame->get_meta_data(), "MAIN",
+            msgbus_msg_envelope_new_integer(2));
+    ASSERT_EQ(ret, MSG_SUCCESS);
+
+    frame->merge_meta_data(shared);
+    delete shared;
+
+    // The keys of the shared frame were added, the existing keys are
+    // unchanged
+    msg_envelope_t* meta = frame->get_meta_data();
+    msg_envelope_elem_body_t* elem = NULL;
+    ret = msgbus_msg_envelope_get(meta, "BRANCH", &elem);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(elem->type, MSG_ENV_DT_OBJECT);
+    msg_envelope_elem_body_t* label = msgbus_msg_envelope_elem_object_get(
+            elem, "label");
+    ASSERT_NOT_NULL(label);
+    ASSERT_EQ(strcmp(label->body.string, "a, \"b\" }"), 0);
+    ret = msgbus_msg_envelope_get(meta, "SCORES", &elem);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(elem->type, MSG_ENV_DT_ARRAY);
+    msg_envelope_elem_body_t* score = msgbus_msg_envelope_elem_array_get_at(
+            elem, 0);
+    ASSERT_NOT_NULL(score);
+    ASSERT_EQ(score->body.floating, 0.5);
+    ret = msgbus_msg_envelope_get(meta, "MAIN", &elem);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(elem->body.integer, 2);
+    ret = msgbus_msg_envelope_get(meta, "COMMON", &elem);
+    ASSERT_EQ(ret, MSG_SUCCESS);
+    ASSERT_EQ(elem->body.integer, 1);
+
+    // The frame can still be serialized
+    msg_envelope_t* msg = frame->serialize();
+    ASSERT_NOT_NULL(msg);
+    msgbus_msg_envelope_destroy(msg);
+}
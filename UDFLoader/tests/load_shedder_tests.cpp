@@ -0,0 +1,135 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Unit tests for the @c LoadShedder object
+ */
+
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <eii/utils/logger.h>
+#include "eii/udf/load_shedder.h"
+#include "test_frames.h"
+
+using namespace eii::udf;
+
+// Test class definition for doing setup
+class load_shedder_tests : public ::testing::Test {
+protected:
+    void SetUp() override {
+        set_log_level(LOG_LVL_DEBUG);
+    }
+};
+
+// Pop all frames from the queue, returning their sequence numbers
+static std::vector<uint64_t> drain(FrameQueue* queue) {
+    std::vector<uint64_t> seqs;
+    while(!queue->empty()) {
+        Frame* frame = queue->pop();
+        seqs.push_back(frame->get_sequence());
+        delete frame;
+    }
+    return seqs;
+}
+
+// Verify the policy names are parsed
+TEST_F(load_shedder_tests, parse_policy) {
+    ShedPolicy policy = SHED_BLOCK;
+    ASSERT_TRUE(parse_shed_policy("drop_oldest", &policy));
+    ASSERT_EQ(policy, SHED_DROP_OLDEST);
+    ASSERT_TRUE(parse_shed_policy("keep_every_nth", &policy));
+    ASSERT_EQ(policy, SHED_KEEP_EVERY_NTH);
+    ASSERT_FALSE(parse_shed_policy("drop_all", &policy));
+}
+
+// Verify frames pushed into a full queue are dropped
+TEST_F(load_shedder_tests, drop_newest) {
+    FrameQueue queue(2);
+    LoadShedder shedder(SHED_DROP_NEWEST);
+
+    for(uint64_t seq = 0; seq < 5; seq++) {
+        ASSERT_EQ(shedder.push(&queue, new_frame(seq)), seq < 2);
+    }
+
+    std::vector<uint64_t> expected = { 0, 1 };
+    ASSERT_EQ(drain(&queue), expected);
+    ASSERT_EQ(shedder.get_shed(), 3UL);
+}
+
+// Verify the stalest frames make room for the frames pushed into a full
+// queue
+TEST_F(load_shedder_tests, drop_oldest) {
+    FrameQueue queue(2);
+    LoadShedder shedder(SHED_DROP_OLDEST);
+
+    for(uint64_t seq = 0; seq < 5; seq++) {
+        ASSERT_TRUE(shedder.push(&queue, new_frame(seq)));
+    }
+
+    std::vector<uint64_t> expected = { 3, 4 };
+    ASSERT_EQ(drain(&queue), expected);
+    ASSERT_EQ(shedder.get_shed(), 3UL);
+}
+
+// Verify only every Nth frame pushed into a full queue waits for room
+TEST_F(load_shedder_tests, keep_every_nth) {
+    FrameQueue queue(1);
+    LoadShedder shedder(SHED_KEEP_EVERY_NTH, 3);
+
+    ASSERT_TRUE(shedder.push(&queue, new_frame(0)));
+    ASSERT_FALSE(shedder.push(&queue, new_frame(1)));
+    ASSERT_FALSE(shedder.push(&queue, new_frame(2)));
+
+    // The third overflowing frame blocks until the consumer makes room
+    std::thread consumer([&queue]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        delete queue.pop();
+    });
+    bool blocked = false;
+    ASSERT_TRUE(shedder.push(&queue, new_frame(3), &blocked));
+    ASSERT_TRUE(blocked);
+    consumer.join();
+
+    std::vector<uint64_t> expected = { 3 };
+    ASSERT_EQ(drain(&queue), expected);
+    ASSERT_EQ(shedder.get_shed(), 2UL);
+}
+
+// Verify the block policy never drops frames
+TEST_F(load_shedder_tests, block) {
+    FrameQueue queue(1);
+    LoadShedder shedder(SHED_BLOCK);
+
+    ASSERT_TRUE(shedder.push(&queue, new_frame(0)));
+    std::thread consumer([&queue]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        delete queue.pop();
+    });
+    bool blocked = false;
+    ASSERT_TRUE(shedder.push(&queue, new_frame(1), &blocked));
+    ASSERT_TRUE(blocked);
+    consumer.join();
+
+    std::vector<uint64_t> expected = { 1 };
+    ASSERT_EQ(drain(&queue), expected);
+    ASSERT_EQ(shedder.get_shed(), 0UL);
+}
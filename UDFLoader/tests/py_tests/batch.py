@@ -0,0 +1,46 @@
+# Copyright (c) 2021 Intel Corporation.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to
+# deal in the Software without restriction, including without limitation the
+# rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+# sell copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+"""Test UDF to verify that a Python UDF with a process_batch() method receives
+multiple frames at once.
+"""
+import numpy as np
+
+
+class Udf:
+    def __init__(self):
+        """Constructor
+        """
+        pass
+
+    def process(self, frame, meta):
+        """Single frame fallback, which should not be called with batching.
+        """
+        meta['BATCH'] = 1
+        return False, None, meta
+
+    def process_batch(self, frames, metas):
+        """Change all the values in the frames to 1 and add the batch size to
+        the meta-data of each frame.
+        """
+        for frame, meta in zip(frames, metas):
+            meta['ADDED'] = 55
+            meta['BATCH'] = len(frames)
+            frame.fill(1)
+        return [(False, frame, meta) for frame, meta in zip(frames, metas)]
@@ -0,0 +1,139 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Unit tests for the @c ReorderBuffer object
+ */
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <eii/utils/logger.h>
+#include "eii/udf/reorder_buffer.h"
+#include "test_frames.h"
+
+using namespace eii::udf;
+
+// Test class definition for doing setup
+class reorder_buffer_tests : public ::testing::Test {
+protected:
+    // Sequence numbers of the released frames, in release order
+    std::vector<uint64_t> released;
+
+    void SetUp() override {
+        set_log_level(LOG_LVL_DEBUG);
+    }
+
+    // Release function recording the order of the frames
+    std::function<void(Frame*)> release_fn() {
+        return [this](Frame* frame) {
+            released.push_back(frame->get_sequence());
+            delete frame;
+        };
+    }
+};
+
+// Verify frames finishing out of order are released in order
+TEST_F(reorder_buffer_tests, in_order) {
+    ReorderBuffer buffer(release_fn(), 8, 10000);
+
+    uint64_t order[] = { 3, 1, 0, 2, 4 };
+    for (uint64_t seq : order) {
+        buffer.push(seq, new_frame(seq));
+    }
+
+    std::vector<uint64_t> expected = { 0, 1, 2, 3, 4 };
+    ASSERT_EQ(released, expected);
+    ASSERT_EQ(buffer.get_skipped(), 0UL);
+}
+
+// Verify dropped frames do not leave a gap the buffer waits for
+TEST_F(reorder_buffer_tests, dropped_frames) {
+    ReorderBuffer buffer(release_fn(), 8, 10000);
+
+    buffer.push(1, new_frame(1));
+    ASSERT_TRUE(released.empty());
+    buffer.skip(0);
+    buffer.skip(2);
+    buffer.push(3, new_frame(3));
+
+    std::vector<uint64_t> expected = { 1, 3 };
+    ASSERT_EQ(released, expected);
+    ASSERT_EQ(buffer.get_skipped(), 0UL);
+}
+
+// Verify a missing frame is skipped after the latency cap, and deleted if it
+// shows up afterwards
+TEST_F(reorder_buffer_tests, latency_cap) {
+    ReorderBuffer buffer(release_fn(), 8, 50);
+
+    buffer.push(1, new_frame(1));
+    buffer.push(2, new_frame(2));
+    buffer.flush();
+    ASSERT_TRUE(released.empty());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    buffer.flush();
+
+    std::vector<uint64_t> expected = { 1, 2 };
+    ASSERT_EQ(released, expected);
+    ASSERT_EQ(buffer.get_skipped(), 1UL);
+
+    buffer.push(0, new_frame(0));
+    ASSERT_EQ(released, expected);
+    ASSERT_EQ(buffer.get_late(), 1UL);
+}
+
+// Verify pushing into a full buffer waits for the missing frame
+TEST_F(reorder_buffer_tests, full_buffer) {
+    ReorderBuffer buffer(release_fn(), 2, 10000);
+
+    buffer.push(1, new_frame(1));
+    buffer.push(2, new_frame(2));
+
+    std::thread th([&buffer]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        buffer.push(0, new_frame(0));
+    });
+    buffer.push(3, new_frame(3));
+    th.join();
+
+    std::vector<uint64_t> expected = { 0, 1, 2, 3 };
+    ASSERT_EQ(released, expected);
+    ASSERT_EQ(buffer.get_skipped(), 0UL);
+}
+
+// Verify a full buffer gives up on the missing frame after the latency cap
+TEST_F(reorder_buffer_tests, full_buffer_latency_cap) {
+    ReorderBuffer buffer(release_fn(), 2, 50);
+
+    auto start = std::chrono::steady_clock::now();
+    buffer.push(1, new_frame(1));
+    buffer.push(2, new_frame(2));
+    buffer.push(3, new_frame(3));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<uint64_t> expected = { 1, 2, 3 };
+    ASSERT_EQ(released, expected);
+    ASSERT_EQ(buffer.get_skipped(), 1UL);
+    ASSERT_GE(elapsed, std::chrono::milliseconds(50));
+}
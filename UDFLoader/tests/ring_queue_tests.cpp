@@ -0,0 +1,161 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Unit tests for the @c RingQueue object
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <eii/utils/logger.h>
+#include "eii/udf/ring_queue.h"
+
+using namespace eii::udf;
+using namespace eii::utils;
+
+#define NUM_THREADS       4
+#define FRAMES_PER_THREAD 50000
+
+// Test class definition for doing setup
+class ring_queue_tests : public ::testing::Test {
+protected:
+    void SetUp() override {
+        set_log_level(LOG_LVL_DEBUG);
+    }
+};
+
+// Verify elements are popped in the order they were pushed
+TEST_F(ring_queue_tests, fifo) {
+    RingQueue<int> queue(4);
+    ASSERT_TRUE(queue.empty());
+
+    // Wrap around the ring a few times
+    for(int i = 1; i <= 10; i++) {
+        ASSERT_EQ(queue.push(i), QueueRetCode::SUCCESS);
+        ASSERT_EQ(queue.push(i + 100), QueueRetCode::SUCCESS);
+        ASSERT_EQ(queue.get_size(), 2);
+        ASSERT_EQ(queue.front(), i);
+        ASSERT_EQ(queue.pop(), i);
+        ASSERT_EQ(queue.pop(), i + 100);
+        ASSERT_TRUE(queue.empty());
+    }
+
+    // Popping from an empty queue returns a default value
+    ASSERT_EQ(queue.pop(), 0);
+}
+
+// Verify push() fails when the queue is full
+TEST_F(ring_queue_tests, full) {
+    RingQueue<int> queue(3);
+    for(int i = 1; i <= 3; i++) {
+        ASSERT_EQ(queue.push(i), QueueRetCode::SUCCESS);
+    }
+    ASSERT_EQ(queue.push(4), QueueRetCode::QUEUE_FULL);
+    ASSERT_EQ(queue.get_size(), 3);
+
+    ASSERT_EQ(queue.pop(), 1);
+    ASSERT_EQ(queue.push(4), QueueRetCode::SUCCESS);
+    for(int i = 2; i <= 4; i++) {
+        ASSERT_EQ(queue.pop(), i);
+    }
+}
+
+// Verify a queue cannot be created without a maximum size
+TEST_F(ring_queue_tests, unbounded) {
+    ASSERT_THROW(RingQueue<int> queue(-1), const char*);
+    ASSERT_THROW(RingQueue<int> queue(0), const char*);
+}
+
+// Verify push_wait() blocks until a consumer makes room
+TEST_F(ring_queue_tests, push_wait) {
+    RingQueue<int> queue(1);
+    ASSERT_EQ(queue.push(1), QueueRetCode::SUCCESS);
+
+    std::atomic<bool> pushed(false);
+    std::thread producer([&]() {
+        queue.push_wait(2);
+        pushed = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(pushed.load());
+    ASSERT_EQ(queue.pop(), 1);
+    producer.join();
+    ASSERT_TRUE(pushed.load());
+    ASSERT_EQ(queue.pop(), 2);
+}
+
+// Verify wait_for() times out on an empty queue and wakes up on a push
+TEST_F(ring_queue_tests, wait_for) {
+    RingQueue<int> queue(4);
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_FALSE(queue.wait_for(std::chrono::milliseconds(50)));
+    ASSERT_GE(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(50));
+
+    std::thread producer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        queue.push(1);
+    });
+    ASSERT_TRUE(queue.wait_for(std::chrono::milliseconds(5000)));
+    ASSERT_EQ(queue.pop(), 1);
+    producer.join();
+}
+
+// Verify every element is popped exactly once with multiple producers and
+// consumers
+TEST_F(ring_queue_tests, mpmc) {
+    RingQueue<int> queue(64);
+    const int total = NUM_THREADS * FRAMES_PER_THREAD;
+    std::atomic<int> popped(0);
+    std::vector<std::atomic<int>> seen(total);
+    for(auto& s : seen) s = 0;
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < NUM_THREADS; t++) {
+        threads.push_back(std::thread([&, t]() {
+            for(int i = 0; i < FRAMES_PER_THREAD; i++) {
+                // Elements are offset by 1, since 0 means empty
+                queue.push_wait(t * FRAMES_PER_THREAD + i + 1);
+            }
+        }));
+        threads.push_back(std::thread([&]() {
+            while(popped.load() < total) {
+                if(!queue.wait_for(std::chrono::milliseconds(10))) continue;
+                int value = queue.pop();
+                if(value == 0) continue;
+                seen[value - 1]++;
+                popped++;
+            }
+        }));
+    }
+    for(auto& th : threads) {
+        th.join();
+    }
+
+    ASSERT_TRUE(queue.empty());
+    for(int i = 0; i < total; i++) {
+        ASSERT_EQ(seen[i].load(), 1);
+    }
+}
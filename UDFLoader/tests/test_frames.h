@@ -0,0 +1,51 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @file
+ * @brief Helpers shared by the UDFLoader unit tests
+ */
+
+#ifndef _EII_UDF_TEST_FRAMES_H
+#define _EII_UDF_TEST_FRAMES_H
+
+#include <cstdlib>
+#include "eii/udf/frame.h"
+
+namespace eii {
+namespace udf {
+
+/**
+ * Create a 1x1 single channel frame carrying the given sequence number.
+ *
+ * @param seq - Sequence number of the frame
+ * @return Frame*
+ */
+static inline Frame* new_frame(uint64_t seq) {
+    void* data = malloc(1);
+    Frame* frame = new Frame(data, free, data, 1, 1, 1);
+    frame->set_sequence(seq);
+    return frame;
+}
+
+} // udf
+} // eii
+
+#endif // _EII_UDF_TEST_FRAMES_H
@@ -0,0 +1,119 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Unit tests for the @c ThreadPlacement object and the CPU topology
+ */
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <gtest/gtest.h>
+#include <eii/utils/logger.h>
+#include "eii/udf/thread_placement.h"
+#include "eii/udf/cpu_topology.h"
+
+using namespace eii::udf;
+
+// Test class definition for doing setup
+class thread_placement_tests : public ::testing::Test {
+protected:
+    void SetUp() override {
+        set_log_level(LOG_LVL_DEBUG);
+    }
+};
+
+// Verify CPU lists are parsed and formatted
+TEST_F(thread_placement_tests, cpu_list) {
+    std::vector<int> cpus;
+    ASSERT_TRUE(parse_cpu_list("0-3,8,10-11\n", cpus));
+    std::vector<int> expected = { 0, 1, 2, 3, 8, 10, 11 };
+    ASSERT_EQ(cpus, expected);
+    ASSERT_EQ(format_cpu_list(cpus), "0-3,8,10-11");
+
+    cpus.clear();
+    ASSERT_TRUE(parse_cpu_list("", cpus));
+    ASSERT_TRUE(cpus.empty());
+    ASSERT_EQ(format_cpu_list(cpus), "");
+
+    ASSERT_FALSE(parse_cpu_list("a", cpus));
+    ASSERT_FALSE(parse_cpu_list("3-1", cpus));
+    ASSERT_FALSE(parse_cpu_list("1;2", cpus));
+    ASSERT_FALSE(parse_cpu_list("-1", cpus));
+}
+
+// Verify the NUMA nodes of the topology match the CPUs of the nodes
+TEST_F(thread_placement_tests, topology) {
+    const CpuTopology& topo = get_cpu_topology();
+    ASSERT_GT(topo.node.size(), 0UL);
+    for(int cpu = 0; cpu < (int) topo.node.size(); cpu++) {
+        int node = get_numa_node(cpu);
+        if(node < 0) continue;
+        std::vector<int> cpus = get_node_cpus(node);
+        ASSERT_NE(std::find(cpus.begin(), cpus.end(), cpu), cpus.end());
+    }
+    ASSERT_EQ(get_numa_node(-1), -1);
+    ASSERT_TRUE(get_node_cpus(-1).empty());
+}
+
+// Verify scheduling policy names are parsed
+TEST_F(thread_placement_tests, sched_policy) {
+    int policy = -1;
+    ASSERT_TRUE(parse_sched_policy("other", &policy));
+    ASSERT_EQ(policy, SCHED_OTHER);
+    ASSERT_TRUE(parse_sched_policy("fifo", &policy));
+    ASSERT_EQ(policy, SCHED_FIFO);
+    ASSERT_TRUE(parse_sched_policy("rr", &policy));
+    ASSERT_EQ(policy, SCHED_RR);
+    ASSERT_FALSE(parse_sched_policy("batch", &policy));
+}
+
+// Verify invalid placements are rejected
+TEST_F(thread_placement_tests, invalid) {
+    std::vector<int> none;
+    std::vector<int> bad_cpu = { CPU_SETSIZE };
+    ASSERT_THROW(ThreadPlacement p(bad_cpu), const char*);
+    ASSERT_THROW(ThreadPlacement p(none, SCHED_OTHER, 10), const char*);
+    ASSERT_THROW(ThreadPlacement p(none, SCHED_FIFO, 0), const char*);
+    ASSERT_THROW(ThreadPlacement p(none, SCHED_BATCH), const char*);
+    ASSERT_THROW(ThreadPlacement p(none, SCHED_OTHER, 0, 20), const char*);
+}
+
+// Verify a thread is pinned to the placement's CPU
+TEST_F(thread_placement_tests, pin) {
+    std::vector<int> cpus = { sched_getcpu() };
+    ThreadPlacement placement(cpus, SCHED_OTHER, 0, 1);
+    ASSERT_EQ(placement.get_cpus(), cpus);
+    ASSERT_EQ(placement.get_sched_policy(), SCHED_OTHER);
+
+    bool applied = false;
+    int cpu = -1;
+    std::thread th([&]() {
+        applied = placement.apply("test thread");
+        cpu = sched_getcpu();
+    });
+    th.join();
+
+    ASSERT_TRUE(applied);
+    ASSERT_EQ(cpu, cpus[0]);
+    std::string desc = ThreadPlacement::describe_current();
+    ASSERT_NE(desc.find("SCHED_OTHER"), std::string::npos);
+}
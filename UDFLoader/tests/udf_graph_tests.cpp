@@ -0,0 +1,341 @@
+// Copyright (c) 2021 Intel Corporation.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM,OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+/**
+ * @brief Unit tests for the @c UdfGraph and @c MetaPredicate objects
+ */
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <condition_variable>
+#include <gtest/gtest.h>
+#include <eii/utils/logger.h>
+#include "eii/udf/udf_graph.h"
+
+using namespace eii::udf;
+
+// The graph only hands its UDF handles to the function running them, so
+// the tests identify their UDFs by fake handles
+static UdfHandle* fake_udf(int id) {
+    return reinterpret_cast<UdfHandle*>((uintptr_t) (id + 1));
+}
+
+static int fake_udf_id(UdfHandle* handle) {
+    return (int) reinterpret_cast<uintptr_t>(handle) - 1;
+}
+
+static Frame* new_frame() {
+    void* data = malloc(1);
+    return new Frame(data, free, data, 1, 1, 1);
+}
+
+static void put_int(Frame* frame, const char* key, int64_t value) {
+    msg_envelope_elem_body_t* elem = msgbus_msg_envelope_new_integer(value);
+    ASSERT_EQ(msgbus_msg_envelope_put(frame->get_meta_data(), key, elem),
+              MSG_SUCCESS);
+}
+
+static bool has_key(Frame* frame, const char* key) {
+    msg_envelope_elem_body_t* elem = NULL;
+    return msgbus_msg_envelope_get(
+            frame->get_meta_data(), key, &elem) == MSG_SUCCESS;
+}
+
+// Test class definition for doing setup
+class udf_graph_tests : public ::testing::Test {
+protected:
+    // Names of the UDFs, indexed by their fake handle
+    std::vector<std::string> names;
+
+    // Names of the UDFs in the order they ran
+    std::mutex mtx;
+    std::vector<std::string> ran;
+
+    void SetUp() override {
+        set_log_level(LOG_LVL_DEBUG);
+    }
+
+    // Add a UDF to the graph, which tags the frame with its name when it
+    // runs
+    void add_udf(UdfGraph& graph, const std::string& name) {
+        names.push_back(name);
+        graph.add_udf(name, fake_udf((int) names.size() - 1));
+    }
+
+    // Record the UDF running and tag the frame with its name
+    Frame* tag(UdfHandle* handle, Frame* frame) {
+        std::string name = names[fake_udf_id(handle)];
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            ran.push_back(name);
+        }
+        put_int(frame, name.c_str(), 1);
+        return frame;
+    }
+
+    bool did_run(const std::string& name) {
+        std::lock_guard<std::mutex> lk(mtx);
+        for(auto& n : ran) {
+            if(n == name) return true;
+        }
+        return false;
+    }
+};
+
+// Verify the condition names are parsed
+TEST_F(udf_graph_tests, parse_condition) {
+    MetaCondition cond = META_EXISTS;
+    ASSERT_TRUE(parse_meta_condition("greater_than", &cond));
+    ASSERT_EQ(cond, META_GREATER_THAN);
+    ASSERT_TRUE(parse_meta_condition("not_equals", &cond));
+    ASSERT_EQ(cond, META_NOT_EQUALS);
+    ASSERT_FALSE(parse_meta_condition("matches", &cond));
+}
+
+// Verify the predicates on the meta-data of a frame
+TEST_F(udf_graph_tests, predicates) {
+    Frame* frame = new_frame();
+    put_int(frame, "count", 3);
+    msgbus_msg_envelope_put(
+            frame->get_meta_data(), "label",
+            msgbus_msg_envelope_new_string("defect"));
+
+    MetaPredicate exists("count", META_EXISTS,
+                         msgbus_msg_envelope_new_bool(true));
+    MetaPredicate missing("score", META_EXISTS,
+                          msgbus_msg_envelope_new_bool(false));
+    MetaPredicate equals("count", META_EQUALS,
+                         msgbus_msg_envelope_new_floating(3.0));
+    MetaPredicate label("label", META_EQUALS,
+                        msgbus_msg_envelope_new_string("defect"));
+    MetaPredicate not_equals("score", META_NOT_EQUALS,
+                             msgbus_msg_envelope_new_integer(1));
+    MetaPredicate greater("count", META_GREATER_THAN,
+                          msgbus_msg_envelope_new_integer(2));
+    MetaPredicate less("count", META_LESS_THAN,
+                       msgbus_msg_envelope_new_floating(2.5));
+    MetaPredicate mismatch("label", META_EQUALS,
+                           msgbus_msg_envelope_new_integer(1));
+
+    ASSERT_TRUE(exists.evaluate(frame));
+    ASSERT_TRUE(missing.evaluate(frame));
+    ASSERT_TRUE(equals.evaluate(frame));
+    ASSERT_TRUE(label.evaluate(frame));
+    ASSERT_TRUE(not_equals.evaluate(frame));
+    ASSERT_TRUE(greater.evaluate(frame));
+    ASSERT_FALSE(less.evaluate(frame));
+    ASSERT_FALSE(mismatch.evaluate(frame));
+
+    // Comparisons require a number
+    ASSERT_THROW(MetaPredicate("label", META_GREATER_THAN,
+                               msgbus_msg_envelope_new_string("a")),
+                 const char*);
+
+    delete frame;
+}
+
+// Verify invalid graphs are rejected
+TEST_F(udf_graph_tests, invalid) {
+    UdfGraph graph([this](UdfHandle* h, Frame* f) { return tag(h, f); });
+    add_udf(graph, "a");
+    add_udf(graph, "b");
+    ASSERT_THROW(graph.add_udf("a", fake_udf(2)), const char*);
+    ASSERT_THROW(graph.add_edge("a", "c"), const char*);
+
+    graph.add_edge("a", "b");
+    ASSERT_THROW(graph.add_edge("a", "b"), const char*);
+    graph.add_edge("b", "a");
+    ASSERT_THROW(graph.finalize(), const char*);
+}
+
+// Verify a graph without branches runs its UDFs in order
+TEST_F(udf_graph_tests, chain) {
+    UdfGraph graph([this](UdfHandle* h, Frame* f) { return tag(h, f); });
+    add_udf(graph, "a");
+    add_udf(graph, "b");
+    add_udf(graph, "c");
+    graph.add_edge("b", "c");
+    graph.add_edge("a", "b");
+    graph.finalize();
+    ASSERT_FALSE(graph.has_branches());
+
+    Frame* frame = graph.execute(new_frame());
+    ASSERT_NE(frame, nullptr);
+    std::vector<std::string> expected = { "a", "b", "c" };
+    ASSERT_EQ(ran, expected);
+    ASSERT_TRUE(has_key(frame, "c"));
+    delete frame;
+}
+
+// Verify a UDF only runs when the predicate of its incoming edge holds, and
+// that the frame is returned either way
+TEST_F(udf_graph_tests, routing) {
+    int next = 0;
+    UdfGraph graph([this, &next](UdfHandle* h, Frame* f) {
+        if(names[fake_udf_id(h)] == "filter") {
+            put_int(f, "defects", next++);
+        }
+        return tag(h, f);
+    });
+    add_udf(graph, "filter");
+    add_udf(graph, "classifier");
+    graph.add_edge("filter", "classifier", new MetaPredicate(
+                "defects", META_GREATER_THAN,
+                msgbus_msg_envelope_new_integer(0)));
+    graph.finalize();
+
+    Frame* frame = graph.execute(new_frame());
+    ASSERT_NE(frame, nullptr);
+    ASSERT_FALSE(did_run("classifier"));
+    delete frame;
+
+    frame = graph.execute(new_frame());
+    ASSERT_NE(frame, nullptr);
+    ASSERT_TRUE(did_run("classifier"));
+    ASSERT_TRUE(has_key(frame, "classifier"));
+    delete frame;
+}
+
+// Verify independent branches run concurrently on the branch pool and that
+// their meta-data is joined
+TEST_F(udf_graph_tests, parallel_branches) {
+    std::mutex branch_mtx;
+    std::condition_variable branch_cv;
+    int running = 0;
+    bool overlapped = true;
+
+    UdfGraph graph([&](UdfHandle* h, Frame* f) {
+        std::string name = names[fake_udf_id(h)];
+        if(name == "classifier" || name == "counter") {
+            // Wait for the other branch to start as well
+            std::unique_lock<std::mutex> lk(branch_mtx);
+            running++;
+            branch_cv.notify_all();
+            if(!branch_cv.wait_for(lk, std::chrono::seconds(5),
+                                   [&running] { return running == 2; })) {
+                overlapped = false;
+            }
+        } else if(name == "publish") {
+            EXPECT_TRUE(has_key(f, "classifier"));
+            EXPECT_TRUE(has_key(f, "counter"));
+        }
+        return tag(h, f);
+    });
+    add_udf(graph, "decode");
+    add_udf(graph, "classifier");
+    add_udf(graph, "counter");
+    add_udf(graph, "publish");
+    graph.add_edge("decode", "classifier");
+    graph.add_edge("decode", "counter");
+    graph.add_edge("classifier", "publish");
+    graph.add_edge("counter", "publish");
+    graph.finalize();
+    ASSERT_TRUE(graph.has_branches());
+
+    WorkerPool pool(2, 8);
+    graph.set_branch_pool(&pool);
+
+    Frame* frame = graph.execute(new_frame());
+    ASSERT_NE(frame, nullptr);
+    ASSERT_TRUE(overlapped);
+    ASSERT_EQ(ran.size(), 4u);
+    ASSERT_EQ(ran.back(), "publish");
+    ASSERT_TRUE(has_key(frame, "decode"));
+    ASSERT_TRUE(has_key(frame, "classifier"));
+    ASSERT_TRUE(has_key(frame, "counter"));
+    delete frame;
+}
+
+// Verify the frames of branches which do not meet again are joined too, and
+// that the branches run on the calling thread without a branch pool
+TEST_F(udf_graph_tests, multiple_roots) {
+    UdfGraph graph([this](UdfHandle* h, Frame* f) { return tag(h, f); });
+    add_udf(graph, "a");
+    add_udf(graph, "b");
+    add_udf(graph, "c");
+    graph.add_edge("a", "b");
+    graph.finalize();
+    ASSERT_TRUE(graph.has_branches());
+
+    Frame* frame = graph.execute(new_frame());
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(ran.size(), 3u);
+    ASSERT_TRUE(has_key(frame, "b"));
+    ASSERT_TRUE(has_key(frame, "c"));
+    delete frame;
+}
+
+// Verify a UDF dropping the frame drops it for the whole graph
+TEST_F(udf_graph_tests, drop) {
+    UdfGraph graph([this](UdfHandle* h, Frame* f) -> Frame* {
+        f = tag(h, f);
+        if(names[fake_udf_id(h)] == "b") {
+            delete f;
+            return NULL;
+        }
+        return f;
+    });
+    add_udf(graph, "a");
+    add_udf(graph, "b");
+    add_udf(graph, "c");
+    add_udf(graph, "d");
+    graph.add_edge("a", "b");
+    graph.add_edge("a", "c");
+    graph.add_edge("b", "d");
+    graph.add_edge("c", "d");
+    graph.finalize();
+
+    WorkerPool pool(2, 8);
+    graph.set_branch_pool(&pool);
+
+    ASSERT_EQ(graph.execute(new_frame()), nullptr);
+    ASSERT_FALSE(did_run("d"));
+}
+
+// Verify a UDF throwing drops the frame instead of leaving the graph waiting
+// for it
+TEST_F(udf_graph_tests, udf_error) {
+    UdfGraph graph([this](UdfHandle* h, Frame* f) -> Frame* {
+        f = tag(h, f);
+        if(names[fake_udf_id(h)] == "b") {
+            throw "Failed to decode the encoded frame";
+        }
+        return f;
+    });
+    add_udf(graph, "a");
+    add_udf(graph, "b");
+    add_udf(graph, "c");
+    add_udf(graph, "d");
+    graph.add_edge("a", "b");
+    graph.add_edge("a", "c");
+    graph.add_edge("b", "d");
+    graph.add_edge("c", "d");
+    graph.finalize();
+
+    WorkerPool pool(2, 8);
+    graph.set_branch_pool(&pool);
+
+    ASSERT_EQ(graph.execute(new_frame()), nullptr);
+    ASSERT_FALSE(did_run("d"));
+}
@@ -24,6 +24,8 @@
 
 #include <chrono>
 #include <cassert>
+#include <thread>
+#include <vector>
 #include <gtest/gtest.h>
 #include <opencv2/opencv.hpp>
 #include <eii/utils/logger.h>
@@ -38,6 +40,9 @@
 #define NEW_FRAME_DATA  "\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01"
 #define DATA_LEN 10
 
+// Maximum size of the frame queues, the ring queue cannot be unbounded
+#define QUEUE_SIZE 16
+
 using namespace eii::udf;
 
 #define ASSERT_NULL(val) { \
@@ -262,8 +267,8 @@ TEST(udfloader_tests, reinitialize) {
         config_t* config = json_config_new("test_udf_mgr_config.json");
         ASSERT_NOT_NULL(config);
 
-        FrameQueue* input_queue = new FrameQueue(-1);
-        FrameQueue* output_queue = new FrameQueue(-1);
+        FrameQueue* input_queue = new FrameQueue(QUEUE_SIZE);
+        FrameQueue* output_queue = new FrameQueue(QUEUE_SIZE);
 
         UdfManager* manager = new UdfManager(
                 config, input_queue, output_queue, "");
@@ -278,8 +283,8 @@ TEST(udfloader_tests, reinitialize) {
 
         delete manager;
 
-        input_queue = new FrameQueue(-1);
-        output_queue = new FrameQueue(-1);
+        input_queue = new FrameQueue(QUEUE_SIZE);
+        output_queue = new FrameQueue(QUEUE_SIZE);
         config = json_config_new("test_udf_mgr_config.json");
         manager = new UdfManager(config, input_queue, output_queue, "");
         manager->start();
@@ -290,6 +295,340 @@ TEST(udfloader_tests, reinitialize) {
     }
 }
 
+// Test to run the UDFs as a pipeline of stages, with backpressure from the
+// single frame queues between the stages
+TEST(udfloader_tests, pipelined) {
+    try {
+        config_t* config = json_config_new("test_udf_mgr_pipelined.json");
+        ASSERT_NOT_NULL(config);
+
+        FrameQueue* input_queue = new FrameQueue(QUEUE_SIZE);
+        FrameQueue* output_queue = new FrameQueue(QUEUE_SIZE);
+
+        UdfManager* manager = new UdfManager(
+                config, input_queue, output_queue, "");
+        manager->start();
+
+        const int num_frames = 8;
+        for(int i = 0; i < num_frames; i++) {
+            Frame* frame = init_frame();
+            ASSERT_NOT_NULL(frame);
+            input_queue->push(frame);
+        }
+
+        // Every frame must make it through all stages
+        auto sleep_time = std::chrono::seconds(3);
+        for(int i = 0; i < num_frames; i++) {
+            ASSERT_TRUE(output_queue->wait_for(sleep_time)) << "No frame";
+            Frame* frame = output_queue->pop();
+            ASSERT_NOT_NULL(frame);
+
+            uint8_t* frame_data = (uint8_t*) frame->get_data(0);
+            for(int j = 0; j < DATA_LEN; j++) {
+                ASSERT_EQ(frame_data[j], NEW_FRAME_DATA[j]);
+            }
+
+            msg_envelope_elem_body_t* added;
+            msgbus_ret_t m_ret = msgbus_msg_envelope_get(
+                    frame->get_meta_data(), "ADDED", &added);
+            ASSERT_EQ(m_ret, MSG_SUCCESS);
+            ASSERT_EQ(added->body.integer, 55);
+            delete frame;
+        }
+
+        delete manager;
+    } catch(const char* ex) {
+        FAIL() << ex;
+    }
+}
+
+// Test that a Python UDF with a process_batch() method gets the queued frames
+// in batches
+TEST(udfloader_tests, batch) {
+    try {
+        config_t* config = json_config_new("test_udf_mgr_batch.json");
+        ASSERT_NOT_NULL(config);
+
+        FrameQueue* input_queue = new FrameQueue(QUEUE_SIZE);
+        FrameQueue* output_queue = new FrameQueue(QUEUE_SIZE);
+
+        // Queue the frames before the worker starts, so that the first
+        // batch is full
+        const int num_frames = 8;
+        for(int i = 0; i < num_frames; i++) {
+            Frame* frame = init_frame();
+            ASSERT_NOT_NULL(frame);
+            input_queue->push(frame);
+        }
+
+        UdfManager* manager = new UdfManager(
+                config, input_queue, output_queue, "");
+        manager->start();
+
+        auto sleep_time = std::chrono::seconds(3);
+        for(int i = 0; i < num_frames; i++) {
+            ASSERT_TRUE(output_queue->wait_for(sleep_time)) << "No frame";
+            Frame* frame = output_queue->pop();
+            ASSERT_NOT_NULL(frame);
+
+            uint8_t* frame_data = (uint8_t*) frame->get_data(0);
+            for(int j = 0; j < DATA_LEN; j++) {
+                ASSERT_EQ(frame_data[j], NEW_FRAME_DATA[j]);
+            }
+
+            msg_envelope_elem_body_t* batch;
+            msgbus_ret_t m_ret = msgbus_msg_envelope_get(
+                    frame->get_meta_data(), "BATCH", &batch);
+            ASSERT_EQ(m_ret, MSG_SUCCESS);
+            ASSERT_GT(batch->body.integer, 1);
+            delete frame;
+        }
+
+        delete manager;
+    } catch(const char* ex) {
+        FAIL() << ex;
+    }
+}
+
+// Test that frames older than the latency budget skip the UDFs and are
+// published as stubs
+TEST(udfloader_tests, latency_budget) {
+    try {
+        config_t* config = json_config_new("test_udf_mgr_deadline.json");
+        ASSERT_NOT_NULL(config);
+
+        FrameQueue* input_queue = new FrameQueue(QUEUE_SIZE);
+        FrameQueue* output_queue = new FrameQueue(QUEUE_SIZE);
+
+        UdfManager* manager = new UdfManager(
+                config, input_queue, output_queue, "");
+        manager->start();
+
+        // Frame captured a minute ago, followed by a fresh frame
+        Frame* stale = init_frame();
+        ASSERT_NOT_NULL(stale);
+        stale->set_timestamp(stale->get_timestamp() - 60000000000LL);
+        input_queue->push(stale);
+        input_queue->push(init_frame());
+
+        auto sleep_time = std::chrono::seconds(3);
+        int num_expired = 0;
+        for(int i = 0; i < 2; i++) {
+            ASSERT_TRUE(output_queue->wait_for(sleep_time)) << "No frame";
+            Frame* frame = output_queue->pop();
+            ASSERT_NOT_NULL(frame);
+
+            // Only the fresh frame went through the UDF
+            msg_envelope_elem_body_t* elem;
+            msgbus_ret_t expired = msgbus_msg_envelope_get(
+                    frame->get_meta_data(), "expired", &elem);
+            msgbus_ret_t added = msgbus_msg_envelope_get(
+                    frame->get_meta_data(), "ADDED", &elem);
+            if(expired == MSG_SUCCESS) {
+                num_expired++;
+                ASSERT_NE(added, MSG_SUCCESS);
+                // The stub's pixels are replaced by a sealed 1x1 placeholder
+                ASSERT_TRUE(frame->is_encoded());
+                ASSERT_EQ(frame->get_width(), 1);
+                ASSERT_EQ(frame->get_height(), 1);
+            } else {
+                ASSERT_EQ(added, MSG_SUCCESS);
+            }
+            delete frame;
+        }
+        ASSERT_EQ(num_expired, 1);
+        ASSERT_EQ(manager->get_expired(), 1UL);
+
+        delete manager;
+    } catch(const char* ex) {
+        FAIL() << ex;
+    }
+}
+
+// Test that the encoder stage encodes the output frames before they are
+// pushed to the output queue
+TEST(udfloader_tests, encoder_stage) {
+    try {
+        config_t* config = json_config_new("test_udf_mgr_encoder.json");
+        ASSERT_NOT_NULL(config);
+
+        FrameQueue* input_queue = new FrameQueue(QUEUE_SIZE);
+        FrameQueue* output_queue = new FrameQueue(QUEUE_SIZE);
+
+        UdfManager* manager = new UdfManager(
+                config, input_queue, output_queue, "", EncodeType::PNG, 4);
+        manager->start();
+
+        const int num_frames = 8;
+        for(int i = 0; i < num_frames; i++) {
+            Frame* frame = init_frame();
+            ASSERT_NOT_NULL(frame);
+            input_queue->push(frame);
+        }
+
+        auto sleep_time = std::chrono::seconds(3);
+        for(int i = 0; i < num_frames; i++) {
+            ASSERT_TRUE(output_queue->wait_for(sleep_time)) << "No frame";
+            Frame* frame = output_queue->pop();
+            ASSERT_NOT_NULL(frame);
+            ASSERT_TRUE(frame->is_encoded());
+
+            // Serializing only wraps the PNG encoded bytes, which decode to
+            // the pixels written by the UDF
+            msg_envelope_t* msg = frame->serialize();
+            ASSERT_NOT_NULL(msg);
+            Frame* decoded = new Frame(msg);
+            ASSERT_EQ(decoded->get_encode_type(), EncodeType::PNG);
+            const uint8_t* frame_data =
+                (const uint8_t*) decoded->get_readonly_data(0);
+            for(int j = 0; j < DATA_LEN; j++) {
+                ASSERT_EQ(frame_data[j], NEW_FRAME_DATA[j]);
+            }
+            delete decoded;
+        }
+
+        delete manager;
+    } catch(const char* ex) {
+        FAIL() << ex;
+    }
+}
+
+// Test that frames are processed with the manager's, the UDF workers' and
+// the encoder's threads pinned to a CPU
+TEST(udfloader_tests, placement) {
+    try {
+        config_t* config = json_config_new("test_udf_mgr_placement.json");
+        ASSERT_NOT_NULL(config);
+
+        FrameQueue* input_queue = new FrameQueue(QUEUE_SIZE);
+        FrameQueue* output_queue = new FrameQueue(QUEUE_SIZE);
+
+        UdfManager* manager = new UdfManager(
+                config, input_queue, output_queue, "");
+        manager->start();
+
+        const int num_frames = 4;
+        for(int i = 0; i < num_frames; i++) {
+            Frame* frame = init_frame();
+            ASSERT_NOT_NULL(frame);
+            input_queue->push(frame);
+        }
+
+        auto sleep_time = std::chrono::seconds(3);
+        for(int i = 0; i < num_frames; i++) {
+            ASSERT_TRUE(output_queue->wait_for(sleep_time)) << "No frame";
+            Frame* frame = output_queue->pop();
+            ASSERT_NOT_NULL(frame);
+            ASSERT_TRUE(frame->is_encoded());
+            delete frame;
+        }
+
+        delete manager;
+    } catch(const char* ex) {
+        FAIL() << ex;
+    }
+}
+
+// Test that UDFs connected by edges run as a graph, with the branches after
+// the first UDF running concurrently and their meta-data joined
+TEST(udfloader_tests, graph) {
+    try {
+        config_t* config = json_config_new("test_udf_mgr_graph.json");
+        ASSERT_NOT_NULL(config);
+
+        FrameQueue* input_queue = new FrameQueue(QUEUE_SIZE);
+        FrameQueue* output_queue = new FrameQueue(QUEUE_SIZE);
+
+        UdfManager* manager = new UdfManager(
+                config, input_queue, output_queue, "");
+        manager->start();
+
+        const int num_frames = 4;
+        for(int i = 0; i < num_frames; i++) {
+            Frame* frame = init_frame();
+            ASSERT_NOT_NULL(frame);
+            input_queue->push(frame);
+        }
+
+        // The dropping UDF is never reached, since its edge's predicate
+        // does not hold
+        auto sleep_time = std::chrono::seconds(3);
+        for(int i = 0; i < num_frames; i++) {
+            ASSERT_TRUE(output_queue->wait_for(sleep_time)) << "No frame";
+            Frame* frame = output_queue->pop();
+            ASSERT_NOT_NULL(frame);
+
+            const uint8_t* frame_data =
+                (const uint8_t*) frame->get_readonly_data(0);
+            for(int j = 0; j < DATA_LEN; j++) {
+                ASSERT_EQ(frame_data[j], NEW_FRAME_DATA[j]);
+            }
+
+            msg_envelope_elem_body_t* added;
+            msgbus_ret_t m_ret = msgbus_msg_envelope_get(
+                    frame->get_meta_data(), "ADDED", &added);
+            ASSERT_EQ(m_ret, MSG_SUCCESS);
+            ASSERT_EQ(added->body.integer, 55);
+            delete frame;
+        }
+
+        delete manager;
+    } catch(const char* ex) {
+        FAIL() << ex;
+    }
+}
+
+/**
+ * UDF handle which tracks how many threads run its process() method at once
+ */
+class ConcurrencyUdfHandle : public UdfHandle {
+public:
+    std::atomic<int> active;
+    std::atomic<int> max_active;
+
+    ConcurrencyUdfHandle(int max_workers) :
+        UdfHandle("concurrency", max_workers), active(0), max_active(0)
+    {};
+
+    UdfRetCode process(Frame* frame) override {
+        int now = ++active;
+        int prev = max_active.load();
+        while(now > prev && !max_active.compare_exchange_weak(prev, now));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        active--;
+        return UdfRetCode::UDF_OK;
+    }
+};
+
+// Run execute() on the handle from multiple threads at once
+static void run_concurrent(UdfHandle* handle, int num_threads) {
+    std::vector<std::thread> threads;
+    for(int i = 0; i < num_threads; i++) {
+        threads.push_back(std::thread([handle]() {
+            for(int j = 0; j < 5; j++) {
+                Frame* frame = init_frame();
+                handle->execute(frame);
+                delete frame;
+            }
+        }));
+    }
+    for(auto& th : threads) {
+        th.join();
+    }
+}
+
+// Test that a UDF's max workers limits the threads executing it at once
+TEST(udfloader_tests, max_workers) {
+    ConcurrencyUdfHandle serial(1);
+    run_concurrent(&serial, 4);
+    ASSERT_EQ(serial.max_active.load(), 1);
+
+    ConcurrencyUdfHandle limited(2);
+    run_concurrent(&limited, 4);
+    ASSERT_LE(limited.max_active.load(), 2);
+    ASSERT_EQ(limited.get_max_workers(), 2);
+}
+
 void free_cv_frame(void* varg) {
     cv::Mat* mat = (cv::Mat*) varg;
     delete mat;
@@ -397,8 +736,8 @@ TEST(udfloader_tests, ) {
         ASSERT_NOT_NULL(config);
 
         // Initialize the input/output frame queues
-        FrameQueue* input_queue = new FrameQueue(-1);
-        FrameQueue* output_queue = new FrameQueue(-1);
+        FrameQueue* input_queue = new FrameQueue(QUEUE_SIZE);
+        FrameQueue* output_queue = new FrameQueue(QUEUE_SIZE);
 
         // Initialize the UDF manager
         UdfManager* manager = new UdfManager(
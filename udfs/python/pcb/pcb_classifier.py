@@ -24,6 +24,7 @@ import logging
 import cv2
 import numpy as np
 import json
+import udf
 import threading
 from openvino.inference_engine import IECore
 from distutils.util import strtobool
@@ -122,7 +123,7 @@ class Udf:
         matches = []
 
         # Perform BRISK on incoming frame
-        img_gray = cv2.cvtColor(frame, cv2.COLOR_BGR2GRAY)
+        img_gray = udf.convert_color(frame, udf.BGR2GRAY)
         img_kp = self.brisk.detect(img_gray, None)
         img_kp, img_des = self.brisk.compute(img_gray, img_kp)
 
@@ -157,7 +158,7 @@ class Udf:
             x, y, x1, y1 = defect_roi[roi]
             test_crop = test[y:y1, x:x1]
             test_img = cv2.resize(test_crop, (w, h))
-            test_img = test_img.transpose((2, 0, 1))
+            test_img = udf.convert_color(test_img, udf.HWC2CHW)
             self.lock.acquire()
             res = self.exec_net.infer(inputs={self.input_blob: test_img})
             self.lock.release()
@@ -23,6 +23,7 @@ import os
 import logging
 import cv2
 import numpy as np
+import udf
 from time import time
 import onnxruntime as rt
 from azureml.core.model import Model
@@ -100,7 +101,7 @@ class Udf:
         """
         # Resize frame / preprocess frame
         img = cv2.resize(frame, (self.input_shape[2], self.input_shape[3]))
-        img = img.transpose((2, 0, 1))
+        img = udf.convert_color(img, udf.HWC2CHW)
         X = np.asarray(img).astype(np.float32)
         X = np.expand_dims(X, axis=0)
 